@@ -45,6 +45,8 @@ class libhal_mac_conan(ConanFile):
     def package_info(self):
         self.cpp_info.set_property("cmake_target_name", "libhal::mac")
         self.cpp_info.libs = ["libhal-mac"]
+        if self.settings.os == "Macos":
+            self.cpp_info.frameworks = ["IOKit", "CoreFoundation"]
         self.buildenv_info.define("LIBHAL_PLATFORM", "mac")
         self.buildenv_info.define("LIBHAL_PLATFORM_LIBRARY", "mac")
 
@@ -0,0 +1,157 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark of hal::mac::bulk_sender over an emulated 921600 baud link
+//
+// A firmware sized image is sent through a link_emulator under several link
+// conditions: a clean link, added latency, and increasing byte error and
+// loss rates. Every condition is run once with the adaptive sliding window
+// and once with the window fixed at one full sized block, which moves data
+// like a stop and wait protocol. The receiver's copy is checked against the
+// image. Goodput, its share of the line rate, retransmissions and the block
+// size and window the sender settled on are written to stdout as a single
+// JSON document.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory_resource>
+#include <print>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <libhal-mac/bulk_transfer.hpp>
+#include <libhal-mac/link_emulator.hpp>
+
+namespace {
+using namespace std::literals;
+
+constexpr hal::u32 baud_rate = 921600;
+constexpr std::size_t image_bytes = 256 * 1024;
+
+struct condition
+{
+  char const* name;
+  std::chrono::milliseconds latency;
+  float loss_rate;
+  float error_rate;
+};
+
+struct run_results
+{
+  bool intact;
+  hal::mac::bulk_sender::statistics stats;
+};
+
+run_results run(condition const& p_condition,
+                std::span<hal::byte const> p_image,
+                bool p_stop_and_wait)
+{
+  auto* resource = std::pmr::new_delete_resource();
+  auto link = hal::mac::link_emulator::create(
+    resource,
+    { .baud_rate = baud_rate,
+      .latency = p_condition.latency,
+      .loss_rate = p_condition.loss_rate,
+      .error_rate = p_condition.error_rate });
+  auto host = hal::mac::emulated_serial::create(
+    resource, link, hal::mac::link_emulator::end::a);
+  auto device = hal::mac::emulated_serial::create(
+    resource, link, hal::mac::link_emulator::end::b);
+
+  std::vector<hal::byte> copy(p_image.size());
+  auto receiver = hal::mac::bulk_receiver::create(
+    resource,
+    device,
+    [&copy](hal::u32 p_offset, std::span<hal::byte const> p_data) {
+      std::ranges::copy(p_data, copy.begin() + p_offset);
+    });
+  std::atomic<bool> stop = false;
+  std::thread device_thread([&receiver, &stop]() {
+    while (not stop) {
+      receiver->service();
+      std::this_thread::sleep_for(50us);
+    }
+  });
+
+  hal::mac::bulk_sender::settings settings{};
+  if (p_stop_and_wait) {
+    settings.max_window = settings.max_block_size;
+  }
+  auto sender = hal::mac::bulk_sender::create(resource, host, settings);
+  sender->send(1, p_image);
+
+  stop = true;
+  device_thread.join();
+  return {
+    .intact = std::ranges::equal(copy, p_image),
+    .stats = sender->get_statistics(),
+  };
+}
+}  // namespace
+
+void application()
+{
+  constexpr condition conditions[] = {
+    { "clean", 0ms, 0.0f, 0.0f },
+    { "latency_5ms", 5ms, 0.0f, 0.0f },
+    { "errors_1e-5", 0ms, 0.0f, 1e-5f },
+    { "errors_1e-4_loss_1e-5_latency_2ms", 2ms, 1e-5f, 1e-4f },
+    { "errors_1e-3", 0ms, 0.0f, 1e-3f },
+  };
+  // Every byte takes 10 bit times: start bit, 8 data bits and stop bit
+  constexpr double line_rate = baud_rate / 10.0;
+
+  std::vector<hal::byte> image(image_bytes);
+  std::uint32_t state = 1;
+  for (auto& byte : image) {
+    state = state * 1103515245U + 12345U;
+    byte = static_cast<hal::byte>(state >> 24);
+  }
+
+  std::println("{{");
+  std::println("  \"benchmark\": \"libhal-mac bulk_transfer\",");
+  std::println("  \"baud_rate\": {},", baud_rate);
+  std::println("  \"line_rate_bytes_per_second\": {:.0f},", line_rate);
+  std::println("  \"image_bytes\": {},", image_bytes);
+  std::println("  \"runs\": [");
+  for (auto const& condition : conditions) {
+    for (bool const stop_and_wait : { false, true }) {
+      auto const [intact, stats] = run(condition, image, stop_and_wait);
+      bool const last = &condition == &conditions[4] && stop_and_wait;
+      std::println("    {{");
+      std::println("      \"condition\": \"{}\",", condition.name);
+      std::println("      \"window\": \"{}\",",
+                   stop_and_wait ? "one_block" : "adaptive");
+      std::println("      \"intact\": {},", intact);
+      std::println("      \"goodput_bytes_per_second\": {:.0f},",
+                   stats.goodput);
+      std::println("      \"line_rate_percent\": {:.1f},",
+                   100.0 * stats.goodput / line_rate);
+      std::println("      \"retransmissions\": {},", stats.retransmissions);
+      std::println("      \"timeouts\": {},", stats.timeouts);
+      std::println("      \"final_block_size\": {},", stats.block_size);
+      std::println("      \"final_window\": {},", stats.window);
+      std::println("      \"smoothed_rtt_ms\": {:.2f}",
+                   std::chrono::duration<double, std::milli>(
+                     stats.smoothed_rtt)
+                     .count());
+      std::println("    }}{}", last ? "" : ",");
+    }
+  }
+  std::println("  ]");
+  std::println("}}");
+}
@@ -0,0 +1,225 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Loopback benchmark of hal::mac::compressed_serial on a slow link
+//
+// A pseudo terminal stands in for the device and an echo thread sends every
+// byte written to the port back, paced to the given baud rate with 10 bits
+// per byte, so the link is the bottleneck just like a real UART. Telemetry
+// lines are sent once straight through the port and once through a
+// compressed_serial with several flush delays. For each baud rate and path
+// the effective throughput of a bulk transfer, the round trip latency of
+// single lines and the compression ratio are written to stdout as a single
+// JSON document.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory_resource>
+#include <optional>
+#include <poll.h>
+#include <print>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <libhal-mac/compressed_serial.hpp>
+#include <libhal-mac/serial.hpp>
+#include <libhal-util/as_bytes.hpp>
+
+namespace {
+using namespace std::literals;
+
+constexpr std::size_t bulk_bytes = 32 * 1024;
+constexpr std::size_t round_trips = 100;
+
+struct path
+{
+  char const* name;
+  bool compressed;
+  std::chrono::milliseconds flush_delay;
+};
+
+struct path_results
+{
+  double bytes_per_second;
+  double round_trip_p50_ms;
+  double round_trip_p99_ms;
+  double ratio;
+};
+
+std::vector<std::string> telemetry_lines(std::size_t p_bytes)
+{
+  std::vector<std::string> lines;
+  std::size_t total = 0;
+  for (int i = 0; total < p_bytes; i++) {
+    auto line = "[" + std::to_string(i * 125) + "] sensor " +
+                std::to_string(i % 4) + ": temperature=" +
+                std::to_string(20 + i % 7) + "." + std::to_string(i % 10) +
+                " C humidity=" + std::to_string(40 + i % 3) + " %\n";
+    total += line.size();
+    lines.push_back(std::move(line));
+  }
+  return lines;
+}
+
+path_results run(path const& p_path, hal::u32 p_baud_rate)
+{
+  auto* resource = std::pmr::new_delete_resource();
+  int const controller = ::posix_openpt(O_RDWR | O_NOCTTY);
+  ::grantpt(controller);
+  ::unlockpt(controller);
+  auto port =
+    hal::mac::serial::create(resource, ::ptsname(controller), 1024 * 1024);
+
+  std::optional<hal::v5::strong_ptr<hal::mac::compressed_serial>> compressed;
+  if (p_path.compressed) {
+    compressed = hal::mac::compressed_serial::create(
+      resource,
+      port,
+      { .receive_buffer_size = 1024 * 1024,
+        .flush_delay = p_path.flush_delay });
+  }
+  hal::v5::serial& endpoint =
+    compressed ? static_cast<hal::v5::serial&>(**compressed) : *port;
+
+  // Every byte takes 10 bit times on the wire: start, 8 data and stop bit
+  auto const byte_time = std::chrono::nanoseconds(10'000'000'000 / p_baud_rate);
+  std::atomic<bool> stop = false;
+  std::thread echo([controller, byte_time, &stop]() {
+    std::array<char, 256> buffer{};
+    pollfd descriptor{ .fd = controller, .events = POLLIN, .revents = 0 };
+    auto wire_free = std::chrono::steady_clock::now();
+    while (not stop) {
+      if (::poll(&descriptor, 1, 10) <= 0) {
+        continue;
+      }
+      auto const count = ::read(controller, buffer.data(), buffer.size());
+      if (count <= 0) {
+        break;
+      }
+      wire_free = std::max(wire_free, std::chrono::steady_clock::now()) +
+                  byte_time * count;
+      std::this_thread::sleep_until(wire_free);
+      [[maybe_unused]] auto const written =
+        ::write(controller, buffer.data(), static_cast<std::size_t>(count));
+    }
+  });
+
+  auto const received = [&]() -> std::uint64_t {
+    if (compressed) {
+      // Reading the cursor decompresses what the port received so far
+      static_cast<void>((*compressed)->receive_cursor());
+      return (*compressed)->get_statistics().bytes_received;
+    }
+    return port->get_statistics().bytes_received;
+  };
+
+  // Round trips of single lines, each waiting for the one before
+  auto const lines = telemetry_lines(bulk_bytes);
+  std::vector<double> samples;
+  std::uint64_t expected = 0;
+  for (std::size_t i = 0; i < round_trips; i++) {
+    auto const& line = lines[i];
+    auto const start = std::chrono::steady_clock::now();
+    endpoint.write(hal::as_bytes(line));
+    expected += line.size();
+    while (received() < expected) {
+      std::this_thread::sleep_for(20us);
+    }
+    samples.push_back(std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+  }
+
+  // Bulk transfer of all lines, written as fast as the path accepts them
+  auto const bulk_start = std::chrono::steady_clock::now();
+  std::uint64_t bulk_expected = expected;
+  for (auto const& line : lines) {
+    endpoint.write(hal::as_bytes(line));
+    bulk_expected += line.size();
+  }
+  if (compressed) {
+    (*compressed)->flush();
+  }
+  while (received() < bulk_expected) {
+    std::this_thread::sleep_for(100us);
+  }
+  auto const bulk_seconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - bulk_start)
+                              .count();
+
+  double ratio = 1.0;
+  if (compressed) {
+    auto const stats = (*compressed)->get_statistics();
+    ratio = static_cast<double>(stats.bytes_written) /
+            static_cast<double>(stats.link_bytes_sent);
+  }
+
+  stop = true;
+  echo.join();
+  compressed.reset();
+  ::close(controller);
+
+  std::ranges::sort(samples);
+  return {
+    .bytes_per_second =
+      static_cast<double>(bulk_expected - expected) / bulk_seconds,
+    .round_trip_p50_ms = samples[samples.size() / 2],
+    .round_trip_p99_ms = samples[samples.size() * 99 / 100],
+    .ratio = ratio,
+  };
+}
+}  // namespace
+
+void application()
+{
+  constexpr hal::u32 baud_rates[] = { 115200, 921600 };
+  constexpr path paths[] = {
+    { "uncompressed", false, 0ms },
+    { "compressed_flush_0ms", true, 0ms },
+    { "compressed_flush_2ms", true, 2ms },
+    { "compressed_flush_10ms", true, 10ms },
+  };
+
+  std::println("{{");
+  std::println("  \"benchmark\": \"libhal-mac compressed_serial loopback\",");
+  std::println("  \"bulk_bytes\": {},", bulk_bytes);
+  std::println("  \"round_trips\": {},", round_trips);
+  std::println("  \"runs\": [");
+  for (auto const baud_rate : baud_rates) {
+    for (auto const& path : paths) {
+      auto const results = run(path, baud_rate);
+      bool const last = baud_rate == baud_rates[1] && &path == &paths[3];
+      std::println("    {{");
+      std::println("      \"baud_rate\": {},", baud_rate);
+      std::println("      \"path\": \"{}\",", path.name);
+      std::println("      \"compression_ratio\": {:.2f},", results.ratio);
+      std::println("      \"throughput_bytes_per_second\": {:.0f},",
+                   results.bytes_per_second);
+      std::println("      \"round_trip_p50_ms\": {:.2f},",
+                   results.round_trip_p50_ms);
+      std::println("      \"round_trip_p99_ms\": {:.2f}",
+                   results.round_trip_p99_ms);
+      std::println("    }}{}", last ? "" : ",");
+    }
+  }
+  std::println("  ]");
+  std::println("}}");
+}
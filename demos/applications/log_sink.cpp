@@ -0,0 +1,169 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Logging benchmark comparing console_serial::write() with hal::mac::log_sink
+//
+// Producer threads log a fixed number of short messages to a console whose
+// output goes to /dev/null, so the numbers show the cost paid by the logging
+// thread rather than the terminal's speed. For each method and thread count
+// the mean time per message seen by the producers, the wall time including
+// the final flush and the sink's counters are written to stdout as a single
+// JSON document.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fcntl.h>
+#include <memory_resource>
+#include <optional>
+#include <print>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <libhal-mac/console.hpp>
+#include <libhal-mac/log_sink.hpp>
+#include <libhal-util/as_bytes.hpp>
+
+namespace {
+using namespace std::literals;
+
+constexpr std::size_t messages_per_thread = 200000;
+constexpr auto message = "sensor 3: temperature=23.5C pressure=1013hPa\n"sv;
+
+enum class method
+{
+  console_write,
+  log_sink_drop,
+  log_sink_block,
+};
+
+struct method_results
+{
+  double producer_ns_per_message;
+  double wall_ms;
+  std::uint64_t messages;
+  std::uint64_t dropped_messages;
+  std::uint64_t writes;
+};
+
+method_results run(method p_method, std::size_t p_threads)
+{
+  auto* resource = std::pmr::new_delete_resource();
+  int const null_input = ::open("/dev/null", O_RDONLY);
+  int const null_output = ::open("/dev/null", O_WRONLY);
+  auto console = hal::mac::console_serial::create(
+    resource, 32, { .input_fd = null_input, .output_fd = null_output });
+
+  std::optional<hal::v5::strong_ptr<hal::mac::log_sink>> sink;
+  if (p_method != method::console_write) {
+    sink = hal::mac::log_sink::create(
+      resource,
+      console,
+      { .ring_size = 64 * 1024,
+        .policy = p_method == method::log_sink_drop
+                    ? hal::mac::log_sink::overflow_policy::drop
+                    : hal::mac::log_sink::overflow_policy::block });
+  }
+
+  std::vector<std::chrono::nanoseconds> producer_times(p_threads);
+  std::vector<std::thread> producers;
+  auto const start = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < p_threads; i++) {
+    producers.emplace_back([&, i]() {
+      auto const bytes = hal::as_bytes(message);
+      auto const producer_start = std::chrono::steady_clock::now();
+      for (std::size_t n = 0; n < messages_per_thread; n++) {
+        if (sink) {
+          (*sink)->log(bytes);
+        } else {
+          console->write(bytes);
+        }
+      }
+      producer_times[i] = std::chrono::steady_clock::now() - producer_start;
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  if (sink) {
+    (*sink)->flush();
+  }
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+
+  auto const slowest = *std::ranges::max_element(producer_times);
+  method_results results{
+    .producer_ns_per_message = static_cast<double>(slowest.count()) /
+                               static_cast<double>(messages_per_thread),
+    .wall_ms = std::chrono::duration<double, std::milli>(elapsed).count(),
+    .messages = messages_per_thread * p_threads,
+    .dropped_messages = 0,
+    .writes = messages_per_thread * p_threads,
+  };
+
+  if (sink) {
+    auto const stats = (*sink)->get_statistics();
+    results.messages = stats.messages;
+    results.dropped_messages = stats.dropped_messages;
+    results.writes = stats.writes;
+  }
+
+  sink.reset();
+  ::close(null_input);
+  ::close(null_output);
+  return results;
+}
+
+void print_results(std::string_view p_name,
+                   std::size_t p_threads,
+                   method_results const& p_results,
+                   bool p_last)
+{
+  std::println("    {{");
+  std::println("      \"name\": \"{}\",", p_name);
+  std::println("      \"threads\": {},", p_threads);
+  std::println("      \"producer_ns_per_message\": {:.1f},",
+               p_results.producer_ns_per_message);
+  std::println("      \"wall_ms\": {:.1f},", p_results.wall_ms);
+  std::println("      \"messages\": {},", p_results.messages);
+  std::println("      \"dropped_messages\": {},", p_results.dropped_messages);
+  std::println("      \"writes\": {}", p_results.writes);
+  std::println("    }}{}", p_last ? "" : ",");
+}
+}  // namespace
+
+void application()
+{
+  constexpr std::size_t thread_counts[] = { 1, 4 };
+
+  std::println("{{");
+  std::println("  \"benchmark\": \"libhal-mac logging\",");
+  std::println("  \"messages_per_thread\": {},", messages_per_thread);
+  std::println("  \"message_size\": {},", message.size());
+  std::println("  \"methods\": [");
+  for (auto const threads : thread_counts) {
+    bool const last = threads == thread_counts[std::size(thread_counts) - 1];
+    print_results(
+      "console_write", threads, run(method::console_write, threads), false);
+    print_results(
+      "log_sink_drop", threads, run(method::log_sink_drop, threads), false);
+    print_results(
+      "log_sink_block", threads, run(method::log_sink_block, threads), last);
+  }
+  std::println("  ]");
+  std::println("}}");
+}
@@ -0,0 +1,136 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory_resource>
+#include <print>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <libhal-mac/precise_delay.hpp>
+#include <libhal-mac/steady_clock.hpp>
+
+namespace {
+struct percentiles
+{
+  double p50;
+  double p90;
+  double p99;
+  double max;
+};
+
+percentiles compute_percentiles(std::vector<double>& p_samples)
+{
+  std::ranges::sort(p_samples);
+  auto const at = [&p_samples](double p_fraction) {
+    auto const index = static_cast<std::size_t>(
+      p_fraction * static_cast<double>(p_samples.size() - 1));
+    return p_samples[index];
+  };
+  return { at(0.50), at(0.90), at(0.99), p_samples.back() };
+}
+
+template<class DelayFunction>
+percentiles measure(std::chrono::nanoseconds p_duration,
+                    int p_iterations,
+                    DelayFunction&& p_delay)
+{
+  std::vector<double> errors_us;
+  errors_us.reserve(p_iterations);
+
+  for (int i = 0; i < p_iterations; i++) {
+    auto const start = std::chrono::steady_clock::now();
+    p_delay(p_duration);
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+    auto const error = elapsed - p_duration;
+    errors_us.push_back(
+      std::chrono::duration<double, std::micro>(error).count());
+  }
+
+  return compute_percentiles(errors_us);
+}
+
+void print_row(std::string_view p_method,
+               std::chrono::nanoseconds p_duration,
+               percentiles const& p_result)
+{
+  std::println("{:<14} {:>10.0f} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f}",
+               p_method,
+               std::chrono::duration<double, std::micro>(p_duration).count(),
+               p_result.p50,
+               p_result.p90,
+               p_result.p99,
+               p_result.max);
+}
+}  // namespace
+
+void application()
+{
+  using namespace std::chrono_literals;
+  using mode = hal::mac::precise_delay::power_mode;
+
+  auto* heap_resource = std::pmr::new_delete_resource();
+  auto clock = hal::mac::steady_clock::create(heap_resource);
+  auto delay = hal::mac::precise_delay::create(heap_resource, clock);
+
+  constexpr std::array<std::chrono::nanoseconds, 9> durations = {
+    10us, 50us, 100us, 500us, 1ms, 5ms, 10ms, 50ms, 100ms
+  };
+  constexpr std::array<std::pair<std::string_view, mode>, 3> modes = {
+    std::pair{ "power_saving", mode::power_saving },
+    std::pair{ "balanced", mode::balanced },
+    std::pair{ "accuracy", mode::accuracy },
+  };
+
+  // Let the overshoot estimator converge before measuring
+  for (int i = 0; i < 100; i++) {
+    delay->delay(1ms);
+  }
+
+  std::println("Delay error (achieved - requested) in microseconds");
+  std::println("{:<14} {:>10} {:>10} {:>10} {:>10} {:>10}",
+               "method",
+               "target_us",
+               "p50",
+               "p90",
+               "p99",
+               "max");
+
+  for (auto const duration : durations) {
+    // Keep each row to roughly one second of wall time
+    auto const iterations =
+      static_cast<int>(std::clamp<std::int64_t>(1s / duration, 10, 1000));
+
+    print_row("sleep_for",
+              duration,
+              measure(duration, iterations, [](auto p_duration) {
+                std::this_thread::sleep_for(p_duration);
+              }));
+
+    for (auto const& [name, power_mode] : modes) {
+      delay->configure({ .mode = power_mode });
+      print_row(name,
+                duration,
+                measure(duration, iterations, [&delay](auto p_duration) {
+                  delay->delay(p_duration);
+                }));
+    }
+  }
+
+  std::println("Learned overshoot estimate: {} ns",
+               delay->overshoot_estimate().count());
+}
@@ -0,0 +1,210 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Receive latency benchmark of hal::mac::serial under CPU contention
+//
+// One thread per CPU spins to keep every CPU busy while single bytes are
+// written to a pseudo terminal at a steady pace. The time from each write to
+// the receive handler seeing the byte is measured for the default receive
+// thread, a SCHED_FIFO receive thread, a SCHED_FIFO receive thread pinned to
+// the last CPU and a busy polling receive thread pinned to the last CPU.
+// Real-time scheduling needs root or CAP_SYS_NICE, a configuration the
+// process may not use is reported as not permitted. The median, 99th
+// percentile and worst latency are written to stdout as a single JSON
+// document.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <span>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <libhal-mac/serial.hpp>
+#include <libhal/error.hpp>
+
+namespace {
+using namespace std::literals;
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t sample_count = 2000;
+constexpr auto sample_interval = 1ms;
+
+struct configuration
+{
+  char const* name;
+  hal::mac::receive_thread_settings receive_thread;
+};
+
+struct latency_results
+{
+  std::size_t received;
+  double p50_us;
+  double p99_us;
+  double max_us;
+};
+
+/**
+ * @brief Keeps every CPU busy with threads of default priority
+ */
+class cpu_hogs
+{
+public:
+  cpu_hogs()
+  {
+    auto const count = std::max(1U, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < count; i++) {
+      m_threads.emplace_back([this]() {
+        while (not m_stop.load(std::memory_order_relaxed)) {
+        }
+      });
+    }
+  }
+
+  ~cpu_hogs()
+  {
+    m_stop = true;
+    for (auto& thread : m_threads) {
+      thread.join();
+    }
+  }
+
+  cpu_hogs(cpu_hogs const&) = delete;
+  cpu_hogs& operator=(cpu_hogs const&) = delete;
+
+private:
+  std::atomic<bool> m_stop = false;
+  std::vector<std::thread> m_threads;
+};
+
+/**
+ * @return Latencies of the configuration, nothing if the process may not use
+ * its scheduling
+ */
+std::optional<latency_results> run(configuration const& p_configuration)
+{
+  int const controller = ::posix_openpt(O_RDWR | O_NOCTTY);
+  ::grantpt(controller);
+  ::unlockpt(controller);
+
+  hal::v5::optional_ptr<hal::mac::serial> port;
+  try {
+    port = hal::mac::serial::create(std::pmr::new_delete_resource(),
+                                    ::ptsname(controller),
+                                    256,
+                                    {},
+                                    hal::mac::flow_control::none,
+                                    p_configuration.receive_thread);
+  } catch (hal::operation_not_permitted const&) {
+    ::close(controller);
+    return std::nullopt;
+  }
+
+  std::vector<clock_type::time_point> sent(sample_count);
+  std::vector<clock_type::time_point> arrived;
+  arrived.reserve(sample_count);
+  std::mutex mutex;
+  port->on_receive([&arrived, &mutex](std::span<hal::byte const> p_first,
+                                      std::span<hal::byte const> p_second) {
+    auto const now = clock_type::now();
+    std::lock_guard lock(mutex);
+    arrived.insert(arrived.end(), p_first.size() + p_second.size(), now);
+  });
+
+  {
+    cpu_hogs const hogs;
+    auto next = clock_type::now();
+    for (auto& time : sent) {
+      next += sample_interval;
+      std::this_thread::sleep_until(next);
+      hal::byte const data = 0x55;
+      time = clock_type::now();
+      [[maybe_unused]] auto const written = ::write(controller, &data, 1);
+    }
+    std::this_thread::sleep_for(100ms);
+  }
+
+  port->on_receive({});
+  port = nullptr;
+  ::close(controller);
+
+  std::vector<double> latencies;
+  for (std::size_t i = 0; i < arrived.size() && i < sent.size(); i++) {
+    latencies.push_back(
+      std::chrono::duration<double, std::micro>(arrived[i] - sent[i]).count());
+  }
+  if (latencies.empty()) {
+    return latency_results{};
+  }
+  std::ranges::sort(latencies);
+  return latency_results{
+    .received = latencies.size(),
+    .p50_us = latencies[latencies.size() / 2],
+    .p99_us = latencies[latencies.size() * 99 / 100],
+    .max_us = latencies.back(),
+  };
+}
+}  // namespace
+
+void application()
+{
+  using policy = hal::mac::thread_settings::policy;
+  auto const cpus = std::clamp(std::thread::hardware_concurrency(), 1U, 64U);
+  hal::u64 const last_cpu = hal::u64{ 1 } << (cpus - 1);
+
+  configuration const configurations[] = {
+    { "default", {} },
+    { "fifo",
+      { .thread = { .scheduling = policy::fifo, .priority = 80 } } },
+    { "fifo_pinned",
+      { .thread = { .scheduling = policy::fifo,
+                    .priority = 80,
+                    .cpu_affinity = last_cpu } } },
+    { "busy_poll_pinned",
+      { .thread = { .cpu_affinity = last_cpu }, .busy_poll = true } },
+  };
+
+  std::println("{{");
+  std::println("  \"benchmark\": \"libhal-mac serial receive latency\",");
+  std::println("  \"cpus\": {},", std::thread::hardware_concurrency());
+  std::println("  \"cpu_hogs\": {},", std::thread::hardware_concurrency());
+  std::println("  \"samples\": {},", sample_count);
+  std::println("  \"configurations\": [");
+  for (auto const& configuration : configurations) {
+    auto const results = run(configuration);
+    bool const last = &configuration == &configurations[3];
+    std::println("    {{");
+    std::println("      \"name\": \"{}\",", configuration.name);
+    if (not results) {
+      std::println("      \"result\": \"not_permitted\"");
+    } else {
+      std::println("      \"result\": \"ok\",");
+      std::println("      \"received\": {},", results->received);
+      std::println("      \"p50_us\": {:.1f},", results->p50_us);
+      std::println("      \"p99_us\": {:.1f},", results->p99_us);
+      std::println("      \"max_us\": {:.1f}", results->max_us);
+    }
+    std::println("    }}{}", last ? "" : ",");
+  }
+  std::println("  ]");
+  std::println("}}");
+}
@@ -1,10 +1,13 @@
+#include <array>
 #include <memory_resource>
 #include <print>
 #include <span>
 #include <string_view>
 #include <thread>
 
+#include <libhal-mac/precise_delay.hpp>
 #include <libhal-mac/serial.hpp>
+#include <libhal-mac/steady_clock.hpp>
 #include <libhal-util/as_bytes.hpp>
 #include <libhal-util/serial.hpp>
 #include <libhal/error.hpp>
@@ -33,16 +36,30 @@ void application()
     hal::acquire_output_pin(heap_resource, serial, hal::mac::modem_out::rts);
 
   // USB serial devices reset sequence:
-  // Assert DTR and RTS
-  dtr->level(true);
-  rts->level(true);
-  std::this_thread::sleep_for(500ms);
-  // De-activate RTS (boot) line
-  rts->level(false);
-  std::this_thread::sleep_for(500ms);
-  // De-activate DTR (reset) line to reset device
-  dtr->level(false);
-  std::this_thread::sleep_for(500ms);
+  //   1. Assert DTR and RTS
+  //   2. De-activate RTS (boot) line
+  //   3. De-activate DTR (reset) line to reset device
+  // The sequence is timed precisely, so the hold times can be tuned down to
+  // what the target actually needs.
+  auto clock = hal::mac::steady_clock::create(heap_resource);
+  auto delay = hal::mac::precise_delay::create(heap_resource, clock);
+  std::array<hal::mac::serial::control_step, 3> const reset_sequence = { {
+    { .dtr = true, .rts = true, .hold = 100ms },
+    { .dtr = true, .rts = false, .hold = 100ms },
+    { .dtr = false, .rts = false, .hold = 100ms },
+  } };
+  std::array<hal::u64, reset_sequence.size()> applied_at{};
+
+  serial->run_control_sequence(*delay, reset_sequence, applied_at);
+
+  auto const ticks_per_us = clock->frequency() / 1'000'000.0f;
+  for (std::size_t i = 0; i < applied_at.size(); i++) {
+    std::println("Step {} applied at +{:.1f} us",
+                 i,
+                 static_cast<float>(applied_at[i] - applied_at[0]) /
+                   ticks_per_us);
+  }
+  std::println("DTR = {}, RTS = {}", dtr->level(), rts->level());
 
   auto const received_buffer = serial->receive_buffer();
   auto previous_cursor = serial->receive_cursor();
@@ -0,0 +1,176 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Receive path benchmark comparing a receive thread per port with ports
+// serviced by a shared hal::mac::io_reactor
+//
+// Many pseudo terminals are opened and a feeder thread writes small chunks to
+// all of them, the way a rack of slow devices trickles data. For each backend
+// the wall time, the process CPU time and the number of wait and read system
+// calls are written to stdout as a single JSON document.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory_resource>
+#include <print>
+#include <string_view>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <libhal-mac/io_reactor.hpp>
+#include <libhal-mac/serial.hpp>
+#include <libhal/functional.hpp>
+
+namespace {
+constexpr std::size_t port_count = 128;
+constexpr std::size_t chunk_size = 16;
+constexpr std::size_t chunks_per_port = 500;
+constexpr auto chunk_interval = std::chrono::microseconds(200);
+
+struct backend_results
+{
+  double wall_ms;
+  double cpu_ms;
+  std::uint64_t bytes_received;
+  std::uint64_t wait_calls;
+  std::uint64_t read_calls;
+};
+
+double process_cpu_ms()
+{
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+  auto const to_ms = [](timeval const& p_time) {
+    return static_cast<double>(p_time.tv_sec) * 1e3 +
+           static_cast<double>(p_time.tv_usec) / 1e3;
+  };
+  return to_ms(usage.ru_utime) + to_ms(usage.ru_stime);
+}
+
+using open_function = hal::v5::strong_ptr<hal::mac::serial>(char const*);
+
+/**
+ * @param p_open Opens a port with the backend under test
+ * @param p_reactor Reactor servicing the ports, nullptr for receive threads
+ */
+backend_results run(hal::callback<open_function> p_open,
+                    hal::mac::io_reactor* p_reactor)
+{
+  std::vector<int> controllers;
+  std::vector<hal::v5::strong_ptr<hal::mac::serial>> ports;
+
+  for (std::size_t i = 0; i < port_count; i++) {
+    int const controller = ::posix_openpt(O_RDWR | O_NOCTTY);
+    ::grantpt(controller);
+    ::unlockpt(controller);
+    controllers.push_back(controller);
+    ports.push_back(p_open(::ptsname(controller)));
+  }
+
+  auto const reactor_waits_before =
+    p_reactor ? p_reactor->get_statistics().wait_calls : 0;
+  std::array<char, chunk_size> chunk{};
+  chunk.fill('x');
+
+  auto const cpu_start = process_cpu_ms();
+  auto const start = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < chunks_per_port; i++) {
+    for (auto const controller : controllers) {
+      [[maybe_unused]] auto const written =
+        ::write(controller, chunk.data(), chunk.size());
+    }
+    std::this_thread::sleep_for(chunk_interval);
+  }
+
+  // Let the receive path catch up with the last chunk
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+  backend_results results{
+    .wall_ms = std::chrono::duration<double, std::milli>(elapsed).count(),
+    .cpu_ms = process_cpu_ms() - cpu_start,
+    .bytes_received = 0,
+    .wait_calls = 0,
+    .read_calls = 0,
+  };
+
+  for (auto const& port : ports) {
+    auto const stats = port->get_statistics();
+    results.bytes_received += stats.bytes_received;
+    results.wait_calls += stats.wait_calls;
+    results.read_calls += stats.read_calls;
+  }
+  if (p_reactor) {
+    results.wait_calls =
+      p_reactor->get_statistics().wait_calls - reactor_waits_before;
+  }
+
+  ports.clear();
+  for (auto const controller : controllers) {
+    ::close(controller);
+  }
+
+  return results;
+}
+
+void print_results(std::string_view p_name,
+                   backend_results const& p_results,
+                   bool p_last)
+{
+  std::println("    {{");
+  std::println("      \"name\": \"{}\",", p_name);
+  std::println("      \"wall_ms\": {:.1f},", p_results.wall_ms);
+  std::println("      \"cpu_ms\": {:.1f},", p_results.cpu_ms);
+  std::println("      \"bytes_received\": {},", p_results.bytes_received);
+  std::println("      \"wait_calls\": {},", p_results.wait_calls);
+  std::println("      \"read_calls\": {}", p_results.read_calls);
+  std::println("    }}{}", p_last ? "" : ",");
+}
+}  // namespace
+
+void application()
+{
+  auto* resource = std::pmr::new_delete_resource();
+  constexpr hal::usize buffer_size = 4096;
+
+  auto const threaded = run(
+    [resource](char const* p_path) {
+      return hal::mac::serial::create(resource, p_path, buffer_size);
+    },
+    nullptr);
+
+  auto reactor = hal::mac::io_reactor::create(resource);
+  auto const reactor_results = run(
+    [resource, &reactor](char const* p_path) {
+      return hal::mac::serial::create(resource, reactor, p_path, buffer_size);
+    },
+    &*reactor);
+
+  std::println("{{");
+  std::println("  \"benchmark\": \"libhal-mac serial receive backends\",");
+  std::println("  \"ports\": {},", port_count);
+  std::println("  \"chunk_size\": {},", chunk_size);
+  std::println("  \"chunks_per_port\": {},", chunks_per_port);
+  std::println("  \"backends\": [");
+  print_results("receive_thread", threaded, false);
+  print_results("io_reactor", reactor_results, true);
+  std::println("  ]");
+  std::println("}}");
+}
@@ -0,0 +1,189 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Forwarding benchmark comparing a forwarder built on the receive buffer with
+// hal::mac::serial_bridge
+//
+// A pseudo terminal stands in for the device and a pipe for the tool reaching
+// it. A feeder thread pushes a fixed amount of data into the device side as
+// fast as it is accepted and a drain thread empties the pipe. For each
+// forwarder the wall time, throughput, process CPU time and the bridge's
+// transfer counters are written to stdout as a single JSON document.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory_resource>
+#include <optional>
+#include <print>
+#include <span>
+#include <string_view>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+
+#include <libhal-mac/serial.hpp>
+#include <libhal-mac/serial_bridge.hpp>
+
+namespace {
+constexpr std::size_t total_bytes = 16 * 1024 * 1024;
+constexpr std::size_t chunk_size = 4096;
+
+enum class forwarder
+{
+  /// on_receive() handler writing each chunk from the receive buffer
+  receive_buffer,
+  bridge,
+  bridge_with_tee,
+};
+
+struct forwarder_results
+{
+  double wall_ms;
+  double cpu_ms;
+  double mib_per_second;
+  std::uint64_t bytes_forwarded;
+  std::uint64_t zero_copy_transfers;
+  std::uint64_t buffered_transfers;
+};
+
+double process_cpu_ms()
+{
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+  auto const to_ms = [](timeval const& p_time) {
+    return static_cast<double>(p_time.tv_sec) * 1e3 +
+           static_cast<double>(p_time.tv_usec) / 1e3;
+  };
+  return to_ms(usage.ru_utime) + to_ms(usage.ru_stime);
+}
+
+forwarder_results run(forwarder p_forwarder)
+{
+  auto* resource = std::pmr::new_delete_resource();
+  int const controller = ::posix_openpt(O_RDWR | O_NOCTTY);
+  ::grantpt(controller);
+  ::unlockpt(controller);
+  std::array<int, 2> tool_pipe{};
+  [[maybe_unused]] auto const piped = ::pipe(tool_pipe.data());
+
+  auto port = hal::mac::serial::create(resource, ::ptsname(controller), 65536);
+  std::optional<hal::v5::strong_ptr<hal::mac::serial_bridge>> bridge;
+
+  if (p_forwarder == forwarder::receive_buffer) {
+    port->on_receive([&tool_pipe](std::span<hal::byte const> p_first,
+                                  std::span<hal::byte const> p_second) {
+      for (auto const part : { p_first, p_second }) {
+        [[maybe_unused]] auto const written =
+          ::write(tool_pipe[1], part.data(), part.size());
+      }
+    });
+  } else {
+    bridge = hal::mac::serial_bridge::create(
+      resource,
+      port,
+      tool_pipe[1],
+      { .tee = p_forwarder == forwarder::bridge_with_tee });
+  }
+
+  std::atomic<std::size_t> drained = 0;
+  std::thread drain([&tool_pipe, &drained]() {
+    std::array<char, chunk_size> buffer{};
+    while (drained < total_bytes) {
+      auto const count = ::read(tool_pipe[0], buffer.data(), buffer.size());
+      if (count <= 0) {
+        break;
+      }
+      drained += static_cast<std::size_t>(count);
+    }
+  });
+
+  std::array<char, chunk_size> chunk{};
+  chunk.fill('x');
+  auto const cpu_start = process_cpu_ms();
+  auto const start = std::chrono::steady_clock::now();
+
+  for (std::size_t sent = 0; sent < total_bytes;) {
+    auto const written = ::write(controller, chunk.data(), chunk.size());
+    if (written > 0) {
+      sent += static_cast<std::size_t>(written);
+    }
+  }
+  drain.join();
+
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+  auto const wall_ms =
+    std::chrono::duration<double, std::milli>(elapsed).count();
+  forwarder_results results{
+    .wall_ms = wall_ms,
+    .cpu_ms = process_cpu_ms() - cpu_start,
+    .mib_per_second =
+      static_cast<double>(drained) / (1024.0 * 1024.0) / (wall_ms / 1e3),
+    .bytes_forwarded = drained,
+    .zero_copy_transfers = 0,
+    .buffered_transfers = 0,
+  };
+
+  if (bridge) {
+    auto const stats = (*bridge)->get_statistics();
+    results.zero_copy_transfers = stats.zero_copy_transfers;
+    results.buffered_transfers = stats.buffered_transfers;
+  }
+
+  bridge.reset();
+  port->on_receive({});
+  ::close(tool_pipe[0]);
+  ::close(tool_pipe[1]);
+  ::close(controller);
+  return results;
+}
+
+void print_results(std::string_view p_name,
+                   forwarder_results const& p_results,
+                   bool p_last)
+{
+  std::println("    {{");
+  std::println("      \"name\": \"{}\",", p_name);
+  std::println("      \"wall_ms\": {:.1f},", p_results.wall_ms);
+  std::println("      \"cpu_ms\": {:.1f},", p_results.cpu_ms);
+  std::println("      \"mib_per_second\": {:.1f},", p_results.mib_per_second);
+  std::println("      \"bytes_forwarded\": {},", p_results.bytes_forwarded);
+  std::println("      \"zero_copy_transfers\": {},",
+               p_results.zero_copy_transfers);
+  std::println("      \"buffered_transfers\": {}",
+               p_results.buffered_transfers);
+  std::println("    }}{}", p_last ? "" : ",");
+}
+}  // namespace
+
+void application()
+{
+  auto const receive_buffer = run(forwarder::receive_buffer);
+  auto const bridge = run(forwarder::bridge);
+  auto const bridge_with_tee = run(forwarder::bridge_with_tee);
+
+  std::println("{{");
+  std::println("  \"benchmark\": \"libhal-mac serial forwarding\",");
+  std::println("  \"total_bytes\": {},", total_bytes);
+  std::println("  \"chunk_size\": {},", chunk_size);
+  std::println("  \"forwarders\": [");
+  print_results("receive_buffer", receive_buffer, false);
+  print_results("serial_bridge", bridge, false);
+  print_results("serial_bridge_tee", bridge_with_tee, true);
+  std::println("  ]");
+  std::println("}}");
+}
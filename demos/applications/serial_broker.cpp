@@ -0,0 +1,286 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Cross-process throughput benchmark of hal::mac::serial_broker
+//
+// A client process is forked before any thread starts. The parent owns a
+// port on a pseudo terminal and a broker for it, and feeds the port with
+// serial::publish_received() so the pty's own speed does not limit the
+// result. The client attaches a shared_serial and copies every byte out of
+// the shared ring into a buffer of its own, checking the data as it goes.
+// It acknowledges each block over a pipe, and the parent keeps at most
+// three quarters of the ring unacknowledged, so nothing is overwritten.
+//
+// For several chunk sizes, the broker to client throughput and the memcpy()
+// bandwidth of one thread for the same chunk size are written to stdout as
+// a single JSON document. Every byte is copied three times on its way: into
+// the port's receive buffer, into the shared ring and out to the client. With
+// a single CPU the two processes take turns, and the result shows the cost
+// of scheduling rather than of copying.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory_resource>
+#include <optional>
+#include <print>
+#include <span>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <libhal-mac/serial.hpp>
+#include <libhal-mac/serial_broker.hpp>
+#include <libhal/error.hpp>
+
+namespace {
+constexpr std::array<std::size_t, 4> chunk_sizes = {
+  256, 4096, 16 * 1024, 64 * 1024
+};
+constexpr std::size_t bytes_per_run = 256 * 1024 * 1024;
+constexpr std::size_t ring_size = 1024 * 1024;
+constexpr std::size_t block_size = ring_size / 4;
+constexpr std::size_t window_blocks = 3;
+// The stream repeats every 251 bytes, a prime, so a misplaced block shows
+constexpr std::size_t pattern_period = 251;
+
+hal::byte expected_byte(std::uint64_t p_position)
+{
+  return static_cast<hal::byte>(p_position % pattern_period);
+}
+
+/// Copy every byte of each run out of the shared ring and acknowledge it
+[[noreturn]] void client(std::string const& p_name, int p_ack, int p_result)
+{
+  auto* resource = std::pmr::new_delete_resource();
+  auto const deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  std::optional<hal::v5::strong_ptr<hal::mac::shared_serial>> view;
+  while (not view) {
+    try {
+      view = hal::mac::shared_serial::create(resource, p_name);
+    } catch (hal::no_such_device const&) {
+    } catch (hal::operation_not_supported const&) {
+      // Attached while the broker was still writing the region's header
+    }
+    if (not view) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        ::_exit(EXIT_FAILURE);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  char const ready = 'r';
+  [[maybe_unused]] auto written = ::write(p_ack, &ready, 1);
+
+  auto const ring = (*view)->receive_buffer();
+  std::vector<hal::byte> local(block_size);
+  std::uint64_t consumed = 0;
+
+  for ([[maybe_unused]] auto const chunk_size : chunk_sizes) {
+    auto const end = consumed + bytes_per_run;
+    auto next_ack = consumed + block_size;
+    bool intact = true;
+
+    while (consumed < end) {
+      auto const sequence = (*view)->receive_sequence();
+      if (sequence == consumed) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (sequence - consumed > ring.size()) {
+        intact = false;
+      }
+
+      auto const from = static_cast<std::size_t>(consumed % ring.size());
+      auto const count =
+        std::min({ static_cast<std::size_t>(sequence - consumed),
+                   ring.size() - from,
+                   local.size() });
+      std::memcpy(local.data(), ring.data() + from, count);
+      intact = intact && local[0] == expected_byte(consumed) &&
+               local[count - 1] == expected_byte(consumed + count - 1);
+      consumed += count;
+
+      while (next_ack <= consumed) {
+        char const ack = 'a';
+        written = ::write(p_ack, &ack, 1);
+        next_ack += block_size;
+      }
+    }
+
+    char const result = intact ? 1 : 0;
+    written = ::write(p_result, &result, 1);
+  }
+
+  view.reset();
+  ::_exit(EXIT_SUCCESS);
+}
+
+/// Wait for acknowledgements until at most p_limit bytes are unacknowledged
+bool wait_for_acks(int p_ack,
+                   std::uint64_t& p_acknowledged,
+                   std::uint64_t p_produced,
+                   std::uint64_t p_limit)
+{
+  while (p_produced - p_acknowledged > p_limit) {
+    std::array<char, 64> acks{};
+    auto const count = ::read(p_ack, acks.data(), acks.size());
+    if (count <= 0) {
+      return false;
+    }
+    p_acknowledged += static_cast<std::uint64_t>(count) * block_size;
+  }
+  return true;
+}
+
+/// memcpy() bandwidth of one thread in p_chunk_size pieces between two rings
+double memcpy_bytes_per_second(std::size_t p_chunk_size)
+{
+  std::vector<hal::byte> source(ring_size, hal::byte{ 'x' });
+  std::vector<hal::byte> destination(ring_size);
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t copied = 0; copied < bytes_per_run; copied += p_chunk_size) {
+    auto const offset = copied % ring_size;
+    std::memcpy(destination.data() + offset,
+                source.data() + offset,
+                std::min(p_chunk_size, ring_size - offset));
+  }
+  auto const elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start);
+  // Keep the copies from being optimized away
+  if (destination[ring_size / 2] != hal::byte{ 'x' }) {
+    std::abort();
+  }
+  return static_cast<double>(bytes_per_run) / elapsed.count();
+}
+
+/// Feed the broker and print the results of each run
+bool broker_side(std::string const& p_name,
+                 char const* p_device,
+                 int p_ack,
+                 int p_result)
+{
+  auto* resource = std::pmr::new_delete_resource();
+  auto port =
+    hal::mac::serial::create(resource, p_device, 2 * chunk_sizes.back());
+  auto broker = hal::mac::serial_broker::create(
+    resource, port, p_name, { .receive_ring_size = ring_size });
+
+  // A whole number of pattern periods, so the stream continues seamlessly
+  // where the source wraps
+  std::vector<hal::byte> source(pattern_period * (ring_size / pattern_period));
+  for (std::size_t i = 0; i < source.size(); i++) {
+    source[i] = expected_byte(i);
+  }
+
+  char ready = 0;
+  bool ok = ::read(p_ack, &ready, 1) == 1;
+  std::uint64_t produced = 0;
+  std::uint64_t acknowledged = 0;
+
+  for (auto const chunk_size : chunk_sizes) {
+    auto const end = produced + bytes_per_run;
+    auto const start = std::chrono::steady_clock::now();
+
+    while (ok && produced < end) {
+      auto const limit = window_blocks * block_size - chunk_size;
+      if (not wait_for_acks(p_ack, acknowledged, produced, limit)) {
+        ok = false;
+        break;
+      }
+      auto const offset = static_cast<std::size_t>(produced % source.size());
+      auto const count = std::min({ chunk_size,
+                                    source.size() - offset,
+                                    static_cast<std::size_t>(end - produced) });
+      port->publish_received(std::span(source).subspan(offset, count));
+      produced += count;
+    }
+    ok = ok && wait_for_acks(p_ack, acknowledged, produced, 0);
+
+    auto const elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start);
+    char intact = 0;
+    ok = ok && ::read(p_result, &intact, 1) == 1;
+    if (not ok) {
+      break;
+    }
+
+    auto const throughput =
+      static_cast<double>(bytes_per_run) / elapsed.count();
+    auto const bandwidth = memcpy_bytes_per_second(chunk_size);
+    std::println("    {{");
+    std::println("      \"chunk_size\": {},", chunk_size);
+    std::println("      \"intact\": {},", intact == 1);
+    std::println("      \"bytes_per_second\": {:.0f},", throughput);
+    std::println("      \"memcpy_bytes_per_second\": {:.0f},", bandwidth);
+    std::println("      \"memcpy_percent\": {:.1f}",
+                 100.0 * throughput / bandwidth);
+    std::println("    }}{}", chunk_size == chunk_sizes.back() ? "" : ",");
+  }
+
+  return ok;
+}
+}  // namespace
+
+void application()
+{
+  auto const name = "/libhal-mac-bench-" + std::to_string(::getpid());
+  std::array<int, 2> ack_pipe{};
+  std::array<int, 2> result_pipe{};
+  if (::pipe(ack_pipe.data()) != 0 || ::pipe(result_pipe.data()) != 0) {
+    std::println(stderr, "failed to create the pipes");
+    return;
+  }
+
+  auto const child = ::fork();
+  if (child == 0) {
+    ::close(ack_pipe[0]);
+    ::close(result_pipe[0]);
+    client(name, ack_pipe[1], result_pipe[1]);
+  }
+  ::close(ack_pipe[1]);
+  ::close(result_pipe[1]);
+
+  std::println("{{");
+  std::println("  \"benchmark\": \"libhal-mac serial_broker cross-process\",");
+  std::println("  \"bytes_per_run\": {},", bytes_per_run);
+  std::println("  \"ring_bytes\": {},", ring_size);
+  std::println("  \"window_bytes\": {},", window_blocks * block_size);
+  std::println("  \"copies_per_byte\": 3,");
+  std::println("  \"runs\": [");
+  int const controller = ::posix_openpt(O_RDWR | O_NOCTTY);
+  ::grantpt(controller);
+  ::unlockpt(controller);
+  bool const ok =
+    broker_side(name, ::ptsname(controller), ack_pipe[0], result_pipe[0]);
+  std::println("  ]");
+  std::println("}}");
+  if (not ok) {
+    std::println(stderr, "the client process failed");
+  }
+
+  ::close(controller);
+  ::close(ack_pipe[0]);
+  ::close(result_pipe[0]);
+  ::waitpid(child, nullptr, 0);
+}
@@ -0,0 +1,176 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Loopback benchmark of the per-frame cost of hal::mac::serial_mux
+//
+// A pseudo terminal stands in for the device and an echo thread sends every
+// byte written to the port straight back. Messages of several sizes are
+// written in batches, and each batch is waited for until it was received
+// again, once directly on the port and once through a mux_channel. For each
+// message size the wall and CPU time per message of both paths and their
+// difference, the cost of framing, scheduling and demultiplexing one frame,
+// are written to stdout as a single JSON document.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory_resource>
+#include <optional>
+#include <poll.h>
+#include <print>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <libhal-mac/serial.hpp>
+#include <libhal-mac/serial_mux.hpp>
+
+namespace {
+constexpr std::size_t message_count = 20000;
+constexpr std::size_t batch_size = 64;
+constexpr std::size_t header_size = 5;
+
+struct path_results
+{
+  double wall_ns_per_message;
+  double cpu_ns_per_message;
+};
+
+double process_cpu_ms()
+{
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+  auto const to_ms = [](timeval const& p_time) {
+    return static_cast<double>(p_time.tv_sec) * 1e3 +
+           static_cast<double>(p_time.tv_usec) / 1e3;
+  };
+  return to_ms(usage.ru_utime) + to_ms(usage.ru_stime);
+}
+
+path_results run(bool p_mux, std::size_t p_message_size)
+{
+  auto* resource = std::pmr::new_delete_resource();
+  int const controller = ::posix_openpt(O_RDWR | O_NOCTTY);
+  ::grantpt(controller);
+  ::unlockpt(controller);
+  auto port =
+    hal::mac::serial::create(resource, ::ptsname(controller), 1024 * 1024);
+
+  std::optional<hal::v5::strong_ptr<hal::mac::serial_mux>> mux;
+  std::optional<hal::v5::strong_ptr<hal::mac::mux_channel>> channel;
+  if (p_mux) {
+    mux = hal::mac::serial_mux::create(resource, port);
+    channel = hal::mac::mux_channel::create(
+      resource, *mux, 1, { .receive_buffer_size = 1024 * 1024 });
+  }
+
+  std::atomic<bool> stop = false;
+  std::thread echo([controller, &stop]() {
+    std::array<char, 4096> buffer{};
+    pollfd descriptor{ .fd = controller, .events = POLLIN, .revents = 0 };
+    while (not stop) {
+      if (::poll(&descriptor, 1, 10) <= 0) {
+        continue;
+      }
+      auto const count = ::read(controller, buffer.data(), buffer.size());
+      if (count <= 0) {
+        break;
+      }
+      [[maybe_unused]] auto const written =
+        ::write(controller, buffer.data(), static_cast<std::size_t>(count));
+    }
+  });
+
+  auto const received = [&]() -> std::uint64_t {
+    if (channel) {
+      // Reading the cursor demultiplexes what the port received so far
+      static_cast<void>((*channel)->receive_cursor());
+      return (*channel)->get_statistics().bytes_received;
+    }
+    return port->get_statistics().bytes_received;
+  };
+
+  std::vector<hal::byte> message(p_message_size, 'x');
+  auto const cpu_start = process_cpu_ms();
+  auto const start = std::chrono::steady_clock::now();
+
+  for (std::size_t sent = 0; sent < message_count;) {
+    for (std::size_t i = 0; i < batch_size && sent < message_count; i++) {
+      if (channel) {
+        (*channel)->write(message);
+      } else {
+        port->write(message);
+      }
+      sent++;
+    }
+    while (received() < sent * p_message_size) {
+      std::this_thread::yield();
+    }
+  }
+
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+  auto const cpu_ms = process_cpu_ms() - cpu_start;
+  stop = true;
+  echo.join();
+  channel.reset();
+  mux.reset();
+  ::close(controller);
+
+  return {
+    .wall_ns_per_message =
+      static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+      static_cast<double>(message_count),
+    .cpu_ns_per_message = cpu_ms * 1e6 / static_cast<double>(message_count),
+  };
+}
+}  // namespace
+
+void application()
+{
+  constexpr std::size_t message_sizes[] = { 8, 32, 128, 256 };
+
+  std::println("{{");
+  std::println("  \"benchmark\": \"libhal-mac serial_mux loopback\",");
+  std::println("  \"messages\": {},", message_count);
+  std::println("  \"batch_size\": {},", batch_size);
+  std::println("  \"header_bytes\": {},", header_size);
+  std::println("  \"sizes\": [");
+  for (auto const size : message_sizes) {
+    auto const direct = run(false, size);
+    auto const muxed = run(true, size);
+    std::println("    {{");
+    std::println("      \"message_size\": {},", size);
+    std::println("      \"direct_wall_ns_per_message\": {:.0f},",
+                 direct.wall_ns_per_message);
+    std::println("      \"mux_wall_ns_per_message\": {:.0f},",
+                 muxed.wall_ns_per_message);
+    std::println("      \"direct_cpu_ns_per_message\": {:.0f},",
+                 direct.cpu_ns_per_message);
+    std::println("      \"mux_cpu_ns_per_message\": {:.0f},",
+                 muxed.cpu_ns_per_message);
+    std::println("      \"cpu_overhead_ns_per_frame\": {:.0f},",
+                 muxed.cpu_ns_per_message - direct.cpu_ns_per_message);
+    std::println("      \"header_overhead_percent\": {:.1f}",
+                 100.0 * static_cast<double>(header_size) /
+                   static_cast<double>(size));
+    std::println("    }}{}", size == message_sizes[3] ? "" : ",");
+  }
+  std::println("  ]");
+  std::println("}}");
+}
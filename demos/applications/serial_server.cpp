@@ -0,0 +1,207 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Localhost benchmark of hal::mac::serial_server and hal::mac::network_serial
+//
+// A pseudo terminal stands in for the device. For latency, an echo thread on
+// the device side returns every byte and a network_serial client measures
+// round trips of short messages. For throughput, the device side writes a
+// fixed amount of data as fast as the port accepts it and the client
+// receives it. Both are run with and without TCP_NODELAY, and the results
+// are written to stdout as a single JSON document.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory_resource>
+#include <poll.h>
+#include <print>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <libhal-mac/serial.hpp>
+#include <libhal-mac/serial_server.hpp>
+#include <libhal-util/as_bytes.hpp>
+
+namespace {
+using namespace std::literals;
+
+constexpr std::size_t round_trips = 2000;
+constexpr auto ping = "ping 0123456789\n"sv;
+constexpr std::size_t throughput_bytes = 8 * 1024 * 1024;
+
+struct device
+{
+  device()
+  {
+    controller = ::posix_openpt(O_RDWR | O_NOCTTY);
+    ::grantpt(controller);
+    ::unlockpt(controller);
+  }
+
+  ~device()
+  {
+    ::close(controller);
+  }
+
+  int controller = -1;
+};
+
+struct latency_results
+{
+  double p50_us;
+  double p99_us;
+  double max_us;
+};
+
+struct throughput_results
+{
+  double mib_per_second;
+  std::uint64_t dropped_bytes;
+};
+
+latency_results measure_latency(bool p_no_delay)
+{
+  auto* resource = std::pmr::new_delete_resource();
+  device target;
+  auto port =
+    hal::mac::serial::create(resource, ::ptsname(target.controller), 4096);
+  auto server = hal::mac::serial_server::create(
+    resource, port, { .no_delay = p_no_delay });
+  auto client = hal::mac::network_serial::create(
+    resource, "127.0.0.1", server->port(), { .no_delay = p_no_delay });
+
+  std::atomic<bool> stop = false;
+  std::thread echo([&target, &stop]() {
+    std::array<char, 4096> buffer{};
+    pollfd descriptor{
+      .fd = target.controller, .events = POLLIN, .revents = 0
+    };
+    while (not stop) {
+      if (::poll(&descriptor, 1, 10) <= 0) {
+        continue;
+      }
+      auto const count =
+        ::read(target.controller, buffer.data(), buffer.size());
+      if (count <= 0) {
+        break;
+      }
+      [[maybe_unused]] auto const written = ::write(
+        target.controller, buffer.data(), static_cast<std::size_t>(count));
+    }
+  });
+
+  std::vector<double> samples;
+  samples.reserve(round_trips);
+  for (std::size_t i = 0; i < round_trips; i++) {
+    auto const target_bytes = (i + 1) * ping.size();
+    auto const start = std::chrono::steady_clock::now();
+    client->write(hal::as_bytes(ping));
+    while (client->get_statistics().bytes_received < target_bytes) {
+      std::this_thread::yield();
+    }
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+    samples.push_back(
+      std::chrono::duration<double, std::micro>(elapsed).count());
+  }
+
+  stop = true;
+  echo.join();
+
+  std::ranges::sort(samples);
+  return {
+    .p50_us = samples[samples.size() / 2],
+    .p99_us = samples[samples.size() * 99 / 100],
+    .max_us = samples.back(),
+  };
+}
+
+throughput_results measure_throughput(bool p_no_delay)
+{
+  auto* resource = std::pmr::new_delete_resource();
+  device target;
+  auto port = hal::mac::serial::create(
+    resource, ::ptsname(target.controller), 256 * 1024);
+  auto server = hal::mac::serial_server::create(
+    resource, port, { .no_delay = p_no_delay, .batch_size = 16 * 1024 });
+  auto client = hal::mac::network_serial::create(
+    resource,
+    "127.0.0.1",
+    server->port(),
+    { .receive_buffer_size = 256 * 1024, .no_delay = p_no_delay });
+  while (not server->client_connected()) {
+    std::this_thread::sleep_for(1ms);
+  }
+
+  std::array<char, 4096> chunk{};
+  chunk.fill('x');
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t sent = 0; sent < throughput_bytes;) {
+    auto const written =
+      ::write(target.controller, chunk.data(), chunk.size());
+    if (written > 0) {
+      sent += static_cast<std::size_t>(written);
+    }
+  }
+
+  // Whatever the server dropped never arrives
+  auto const deadline = std::chrono::steady_clock::now() + 5s;
+  while (client->get_statistics().bytes_received +
+             server->get_statistics().dropped_bytes <
+           throughput_bytes &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(100us);
+  }
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+  auto const seconds = std::chrono::duration<double>(elapsed).count();
+
+  return {
+    .mib_per_second =
+      static_cast<double>(client->get_statistics().bytes_received) /
+      (1024.0 * 1024.0) / seconds,
+    .dropped_bytes = server->get_statistics().dropped_bytes,
+  };
+}
+}  // namespace
+
+void application()
+{
+  std::println("{{");
+  std::println("  \"benchmark\": \"libhal-mac serial_server localhost\",");
+  std::println("  \"round_trips\": {},", round_trips);
+  std::println("  \"message_size\": {},", ping.size());
+  std::println("  \"throughput_bytes\": {},", throughput_bytes);
+  std::println("  \"runs\": [");
+  for (bool const no_delay : { true, false }) {
+    auto const latency = measure_latency(no_delay);
+    auto const throughput = measure_throughput(no_delay);
+    std::println("    {{");
+    std::println("      \"no_delay\": {},", no_delay);
+    std::println("      \"round_trip_p50_us\": {:.1f},", latency.p50_us);
+    std::println("      \"round_trip_p99_us\": {:.1f},", latency.p99_us);
+    std::println("      \"round_trip_max_us\": {:.1f},", latency.max_us);
+    std::println("      \"throughput_mib_per_second\": {:.1f},",
+                 throughput.mib_per_second);
+    std::println("      \"dropped_bytes\": {}", throughput.dropped_bytes);
+    std::println("    }}{}", no_delay ? "," : "");
+  }
+  std::println("  ]");
+  std::println("}}");
+}
@@ -0,0 +1,200 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Micro-benchmark for hal::mac::steady_clock and hal::mac::legacy_steady_clock
+//
+// Results are written to stdout as a single JSON document so they can be
+// archived per release and per CPU and compared for regressions. All times are
+// reported in nanoseconds.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory_resource>
+#include <print>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <libhal-mac/steady_clock.hpp>
+#include <libhal/steady_clock.hpp>
+
+namespace {
+constexpr std::size_t call_cost_iterations = 1'000'000;
+constexpr std::size_t step_samples = 1'000'000;
+constexpr std::size_t cross_thread_samples = 200'000;
+/// Histogram buckets are powers of two of the step size in nanoseconds, the
+/// last bucket collects everything at or above 2^(buckets - 1) ns.
+constexpr std::size_t histogram_buckets = 24;
+
+struct clock_results
+{
+  double call_cost_ns;
+  double resolution_ns;
+  std::uint64_t zero_steps;
+  std::uint64_t backward_steps;
+  std::array<std::uint64_t, histogram_buckets> step_histogram;
+  std::uint64_t cross_thread_violations;
+  double cross_thread_max_violation_ns;
+};
+
+double ticks_to_ns(hal::steady_clock& p_clock, std::uint64_t p_ticks)
+{
+  return static_cast<double>(p_ticks) * 1e9 /
+         static_cast<double>(p_clock.frequency());
+}
+
+double measure_call_cost(hal::steady_clock& p_clock)
+{
+  // Accumulate into a volatile sink so the calls cannot be optimized away
+  std::uint64_t volatile sink = 0;
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < call_cost_iterations; i++) {
+    sink = sink + p_clock.uptime();
+  }
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         static_cast<double>(call_cost_iterations);
+}
+
+void measure_steps(hal::steady_clock& p_clock, clock_results& p_results)
+{
+  std::vector<std::uint64_t> samples(step_samples);
+  for (auto& sample : samples) {
+    sample = p_clock.uptime();
+  }
+
+  std::uint64_t smallest_step = UINT64_MAX;
+  p_results.step_histogram.fill(0);
+  p_results.zero_steps = 0;
+  p_results.backward_steps = 0;
+
+  for (std::size_t i = 1; i < samples.size(); i++) {
+    if (samples[i] < samples[i - 1]) {
+      p_results.backward_steps++;
+      continue;
+    }
+
+    auto const step = samples[i] - samples[i - 1];
+    if (step == 0) {
+      p_results.zero_steps++;
+      continue;
+    }
+
+    smallest_step = std::min(smallest_step, step);
+    auto const step_ns =
+      static_cast<std::uint64_t>(ticks_to_ns(p_clock, step) + 0.5);
+    auto const bucket = std::min<std::size_t>(
+      std::bit_width(step_ns), histogram_buckets - 1);
+    p_results.step_histogram[bucket]++;
+  }
+
+  p_results.resolution_ns =
+    smallest_step == UINT64_MAX ? 0.0 : ticks_to_ns(p_clock, smallest_step);
+}
+
+/**
+ * Checks that a timestamp taken on one thread, and observed by another thread
+ * afterwards, is never ahead of a timestamp the observer takes itself.
+ */
+void measure_cross_thread(hal::steady_clock& p_clock,
+                          clock_results& p_results)
+{
+  std::atomic<std::uint64_t> published{ 0 };
+  std::atomic<bool> done{ false };
+
+  std::thread producer([&] {
+    while (!done.load(std::memory_order_relaxed)) {
+      published.store(p_clock.uptime(), std::memory_order_release);
+    }
+  });
+
+  std::uint64_t violations = 0;
+  std::uint64_t max_violation = 0;
+  for (std::size_t i = 0; i < cross_thread_samples; i++) {
+    auto const observed = published.load(std::memory_order_acquire);
+    auto const local = p_clock.uptime();
+    if (observed > local) {
+      violations++;
+      max_violation = std::max(max_violation, observed - local);
+    }
+  }
+
+  done.store(true, std::memory_order_relaxed);
+  producer.join();
+
+  p_results.cross_thread_violations = violations;
+  p_results.cross_thread_max_violation_ns = ticks_to_ns(p_clock, max_violation);
+}
+
+clock_results run(hal::steady_clock& p_clock)
+{
+  clock_results results{};
+  results.call_cost_ns = measure_call_cost(p_clock);
+  measure_steps(p_clock, results);
+  measure_cross_thread(p_clock, results);
+  return results;
+}
+
+void print_results(std::string_view p_name,
+                   hal::steady_clock& p_clock,
+                   clock_results const& p_results,
+                   bool p_last)
+{
+  std::println("    {{");
+  std::println("      \"name\": \"{}\",", p_name);
+  std::println("      \"frequency_hz\": {:.0f},",
+               static_cast<double>(p_clock.frequency()));
+  std::println("      \"call_cost_ns\": {:.2f},", p_results.call_cost_ns);
+  std::println("      \"resolution_ns\": {:.2f},", p_results.resolution_ns);
+  std::println("      \"zero_steps\": {},", p_results.zero_steps);
+  std::println("      \"backward_steps\": {},", p_results.backward_steps);
+  std::print("      \"step_histogram_log2_ns\": [");
+  for (std::size_t i = 0; i < p_results.step_histogram.size(); i++) {
+    std::print("{}{}", i == 0 ? "" : ", ", p_results.step_histogram[i]);
+  }
+  std::println("],");
+  std::println("      \"cross_thread_violations\": {},",
+               p_results.cross_thread_violations);
+  std::println("      \"cross_thread_max_violation_ns\": {:.2f}",
+               p_results.cross_thread_max_violation_ns);
+  std::println("    }}{}", p_last ? "" : ",");
+}
+}  // namespace
+
+void application()
+{
+  auto* heap_resource = std::pmr::new_delete_resource();
+  auto clock = hal::mac::steady_clock::create(heap_resource);
+  auto legacy_clock = hal::mac::legacy_steady_clock::create(heap_resource);
+
+  auto const clock_results = run(*clock);
+  auto const legacy_results = run(*legacy_clock);
+
+  std::println("{{");
+  std::println("  \"benchmark\": \"libhal-mac steady_clock\",");
+  std::println("  \"hardware_concurrency\": {},",
+               std::thread::hardware_concurrency());
+  std::println("  \"call_cost_iterations\": {},", call_cost_iterations);
+  std::println("  \"step_samples\": {},", step_samples);
+  std::println("  \"cross_thread_samples\": {},", cross_thread_samples);
+  std::println("  \"clocks\": [");
+  print_results("steady_clock", *clock, clock_results, false);
+  print_results("legacy_steady_clock", *legacy_clock, legacy_results, true);
+  std::println("  ]");
+  std::println("}}");
+}
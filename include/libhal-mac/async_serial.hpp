@@ -0,0 +1,315 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <utility>
+
+#include <libhal/pointers.hpp>
+#include <libhal/units.hpp>
+
+#include "event_loop.hpp"
+#include "serial.hpp"
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Coroutine interface to a hal::mac::serial port
+ *
+ * Receive operations complete from the serial port's receive path: each
+ * published chunk is copied straight into the buffer of the pending operation
+ * and, once it is satisfied, the awaiting coroutine is posted to the
+ * scheduler. Writes are non-blocking and wait on the scheduler for the device
+ * to become writable whenever the kernel's transmit buffer is full.
+ *
+ * The awaitables live in the awaiting coroutine's frame, so operations never
+ * allocate. Only one receive operation may be pending at a time.
+ *
+ * Reading starts at the receive cursor observed when the object is created.
+ * If the port's receive buffer wraps around before the data is consumed, the
+ * overwritten data is lost, so size the receive buffer for the longest
+ * expected gap between reads.
+ *
+ * Example, echo lines back to the sender:
+ * ```cpp
+ * hal::mac::task<> echo(std::allocator_arg_t,
+ *                       std::pmr::polymorphic_allocator<>,
+ *                       hal::mac::async_serial& p_port)
+ * {
+ *   std::array<hal::byte, 128> buffer{};
+ *   while (true) {
+ *     auto const line = co_await p_port.async_read_until(buffer, '\n');
+ *     co_await p_port.async_write(line);
+ *   }
+ * }
+ * ```
+ */
+class async_serial
+  : public hal::v5::enable_strong_from_this<async_serial>
+  , private serial::receive_observer
+{
+public:
+  /**
+   * @brief Base of the receive awaitables
+   */
+  class receive_operation
+  {
+  public:
+    receive_operation(receive_operation const&) = delete;
+    receive_operation& operator=(receive_operation const&) = delete;
+
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> p_handle);
+
+  protected:
+    explicit receive_operation(async_serial& p_port)
+      : m_port(&p_port)
+    {
+    }
+    ~receive_operation() = default;
+
+    /**
+     * @brief Consume received data from the port
+     *
+     * Unread data is passed as two spans as it may wrap around the end of the
+     * receive buffer.
+     *
+     * @param p_first Oldest unread data
+     * @param p_second Unread data following p_first, may be empty
+     * @return Number of bytes consumed and whether the operation is complete
+     */
+    virtual std::pair<usize, bool> consume(
+      std::span<hal::byte const> p_first,
+      std::span<hal::byte const> p_second) = 0;
+
+  private:
+    friend class async_serial;
+    async_serial* m_port;
+    std::coroutine_handle<> m_handle = nullptr;
+  };
+
+  /**
+   * @brief Awaitable returned by async_read() and async_read_until()
+   */
+  class read_operation : public receive_operation
+  {
+  public:
+    read_operation(async_serial& p_port,
+                   std::span<hal::byte> p_buffer,
+                   std::optional<hal::byte> p_delimiter)
+      : receive_operation(p_port)
+      , m_buffer(p_buffer)
+      , m_delimiter(p_delimiter)
+    {
+    }
+
+    /**
+     * @return The part of the buffer that was filled
+     */
+    std::span<hal::byte> await_resume()
+    {
+      return m_buffer.first(m_filled);
+    }
+
+  private:
+    std::pair<usize, bool> consume(
+      std::span<hal::byte const> p_first,
+      std::span<hal::byte const> p_second) override;
+
+    std::span<hal::byte> m_buffer;
+    std::optional<hal::byte> m_delimiter;
+    usize m_filled = 0;
+  };
+
+  /**
+   * @brief Awaitable returned by wait_readable()
+   */
+  class readable_operation : public receive_operation
+  {
+  public:
+    explicit readable_operation(async_serial& p_port)
+      : receive_operation(p_port)
+    {
+    }
+
+    /**
+     * @return Number of received bytes waiting to be read
+     */
+    usize await_resume()
+    {
+      return m_available;
+    }
+
+  private:
+    std::pair<usize, bool> consume(
+      std::span<hal::byte const> p_first,
+      std::span<hal::byte const> p_second) override;
+
+    usize m_available = 0;
+  };
+
+  /**
+   * @brief Awaitable returned by async_write()
+   */
+  class write_operation
+  {
+  public:
+    write_operation(async_serial& p_port, std::span<hal::byte const> p_data)
+      : m_port(&p_port)
+      , m_data(p_data)
+    {
+    }
+
+    write_operation(write_operation const&) = delete;
+    write_operation& operator=(write_operation const&) = delete;
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> p_handle);
+    void await_resume();
+
+  private:
+    /**
+     * @brief Write as much as possible
+     *
+     * @return true if the operation completed, with or without an error
+     */
+    bool try_write();
+    void on_writable();
+
+    async_serial* m_port;
+    std::span<hal::byte const> m_data;
+    std::coroutine_handle<> m_handle = nullptr;
+    std::exception_ptr m_error = nullptr;
+  };
+
+  /**
+   * @brief Create an async_serial
+   *
+   * @param p_allocator Memory allocator for this object
+   * @param p_serial Serial port to operate on
+   * @param p_scheduler Scheduler that resumes the awaiting coroutines, such as
+   * an event_loop
+   * @return A strong_ptr to the created async_serial instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<async_serial> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial> p_serial,
+    hal::v5::strong_ptr<scheduler> p_scheduler);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  async_serial(hal::v5::strong_ptr_only_token,
+               hal::v5::strong_ptr<serial> p_serial,
+               hal::v5::strong_ptr<scheduler> p_scheduler);
+
+  /**
+   * @brief Stop observing the serial port
+   *
+   * No operation may be pending.
+   */
+  ~async_serial();
+
+  // Non-copyable and non-movable
+  async_serial(async_serial const&) = delete;
+  async_serial& operator=(async_serial const&) = delete;
+  async_serial(async_serial&&) = delete;
+  async_serial& operator=(async_serial&&) = delete;
+
+  /**
+   * @brief Read exactly p_buffer.size() bytes
+   *
+   * @param p_buffer Buffer to fill
+   * @return Awaitable producing the filled buffer
+   */
+  [[nodiscard]] read_operation async_read(std::span<hal::byte> p_buffer)
+  {
+    return read_operation(*this, p_buffer, std::nullopt);
+  }
+
+  /**
+   * @brief Read until a delimiter is received or the buffer is full
+   *
+   * @param p_buffer Buffer to fill
+   * @param p_delimiter Byte that ends the read, it is included in the result
+   * @return Awaitable producing the filled part of the buffer
+   */
+  [[nodiscard]] read_operation async_read_until(std::span<hal::byte> p_buffer,
+                                                hal::byte p_delimiter)
+  {
+    return read_operation(*this, p_buffer, p_delimiter);
+  }
+
+  /**
+   * @brief Wait until received data is available
+   *
+   * @return Awaitable producing the number of bytes waiting to be read
+   */
+  [[nodiscard]] readable_operation wait_readable()
+  {
+    return readable_operation(*this);
+  }
+
+  /**
+   * @brief Write all of p_data without blocking the scheduler
+   *
+   * @param p_data Data to write, must stay valid until the write completes
+   * @return Awaitable completing once the device accepted all of the data
+   * @throws hal::io_error when awaited if the device hung up
+   */
+  [[nodiscard]] write_operation async_write(std::span<hal::byte const> p_data)
+  {
+    return write_operation(*this, p_data);
+  }
+
+  /**
+   * @brief Get the serial port this object operates on
+   */
+  [[nodiscard]] serial& port()
+  {
+    return *m_serial;
+  }
+
+private:
+  void on_receive(usize p_cursor) override;
+
+  /**
+   * @brief Let an operation consume unread data, m_mutex must be held
+   *
+   * @return true if the operation completed
+   */
+  bool run_operation(receive_operation& p_operation, usize p_cursor);
+
+  /**
+   * @brief Add the bytes published up to p_cursor, m_mutex must be held
+   */
+  void count_received(usize p_cursor);
+
+  hal::v5::strong_ptr<serial> m_serial;
+  hal::v5::strong_ptr<scheduler> m_scheduler;
+  /// Guards m_seen_cursor, m_unread and m_pending
+  std::mutex m_mutex;
+  /// Receive cursor as of the last count_received()
+  usize m_seen_cursor = 0;
+  /// Received bytes not consumed yet, they end at m_seen_cursor
+  usize m_unread = 0;
+  /// Receive operation waiting for data
+  receive_operation* m_pending = nullptr;
+};
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,489 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <libhal/functional.hpp>
+#include <libhal/pointers.hpp>
+#include <libhal/serial.hpp>
+#include <libhal/units.hpp>
+
+#include "simulated_clock.hpp"
+
+namespace hal::mac::inline v1 {
+namespace detail {
+/**
+ * @brief Parser state for the frames of bulk_sender and bulk_receiver
+ */
+struct bulk_frame_reader
+{
+  /// Link receive cursor up to which data was parsed
+  usize link_cursor = 0;
+  std::array<hal::byte, 5> header{};
+  usize header_size = 0;
+  /// Payload and CRC of the frame being received
+  std::pmr::vector<hal::byte> body;
+  usize body_size = 0;
+  usize body_remaining = 0;
+  /// Whether the current body is kept, false when it cannot fit
+  bool keep_body = false;
+  /// Frames that failed their header check or CRC, or did not fit
+  hal::u64 corrupt_frames = 0;
+};
+}  // namespace detail
+
+/**
+ * @brief Sends images over a serial link with a sliding window protocol
+ *
+ * bulk_sender and bulk_receiver transfer an image, such as a firmware
+ * update, reliably over any hal::v5::serial, including links that lose or
+ * corrupt bytes. Instead of waiting for each block to be acknowledged, the
+ * sender keeps a window of blocks in flight so the link never idles for a
+ * round trip.
+ *
+ * Every frame starts with a 5 byte header and ends with a CRC-32:
+ *
+ * | Byte     | Content                                              |
+ * |----------|------------------------------------------------------|
+ * | 0        | 0xB5, marks the start of a frame                     |
+ * | 1        | Frame type: open, accept, data or acknowledge        |
+ * | 2, 3     | Payload length, little endian                        |
+ * | 4        | Header check, byte 1 ^ byte 2 ^ byte 3 ^ 0x5A        |
+ * | 5...     | Payload, little endian fields                        |
+ * | Last 4   | CRC-32 of bytes 1 to 3 and the payload               |
+ *
+ * Blocks are addressed by byte offset and acknowledged one by one, each
+ * acknowledgement also carrying the offset below which the receiver has
+ * all data and echoing the sequence number of the transmission it answers.
+ * A block whose acknowledgement is missing when a later transmission was
+ * acknowledged is sent again right away, since a serial link does not
+ * reorder data; otherwise the oldest missing block is sent again when the
+ * retransmission timeout expires, and the timeout doubles until a round
+ * trip is measured again. Only the missing blocks are sent again.
+ *
+ * The sender adapts to the link while it sends:
+ * - The round trip time is measured from every acknowledgement of a
+ *   block's latest transmission, and sets the retransmission timeout.
+ * - The window is twice the measured delivery rate times the smallest round
+ *   trip, enough to keep the link busy without piling up data in buffers.
+ * - The block size shrinks as the share of blocks that need retransmission
+ *   grows, trading frame overhead against resending long blocks.
+ *
+ * A transfer is identified by an id chosen by the application. Opening a
+ * transfer whose id and size match the one the receiver holds resumes it
+ * from the first byte the receiver is missing, so a send() interrupted by
+ * a timeout or a restart of the sending program continues where it left
+ * off.
+ *
+ * Given a simulated_clock, timeouts, round trips and waits for
+ * acknowledgements use simulated time, which pairs with a link_emulator on
+ * the same clock for tests that sit through timeouts in no time.
+ *
+ * Example:
+ * ```cpp
+ * auto sender = hal::mac::bulk_sender::create(allocator, uart);
+ * sender->send(0x0102'0003, firmware_image);
+ * auto const stats = sender->get_statistics();
+ * std::println("{} bytes/s", stats.goodput);
+ * ```
+ */
+class bulk_sender : public hal::v5::enable_strong_from_this<bulk_sender>
+{
+public:
+  struct settings
+  {
+    /// Largest block of data in one frame, at most 65523
+    usize max_block_size = 1024;
+    /// Smallest block size the sender shrinks to on a noisy link
+    usize min_block_size = 64;
+    /// Largest amount of unacknowledged data, the receiver may lower it
+    usize max_window = 64 * 1024;
+    /// Retransmission timeout until a round trip was measured
+    hal::time_duration initial_timeout = std::chrono::milliseconds(250);
+    /// Smallest margin of the retransmission timeout over the round trip
+    hal::time_duration min_timeout = std::chrono::milliseconds(10);
+    /// Times a block or the request to open is sent again before giving up
+    hal::u32 max_retransmissions = 16;
+    /// Time between checks for acknowledgements while nothing can be sent
+    hal::time_duration poll_interval = std::chrono::microseconds(100);
+  };
+
+  /**
+   * @brief Counters and link measurements of the last send()
+   */
+  struct statistics
+  {
+    /// Image bytes acknowledged by the receiver
+    hal::u64 bytes_delivered;
+    /// Image bytes the receiver already had when send() started
+    hal::u64 bytes_resumed;
+    /// Image bytes sent, retransmissions included
+    hal::u64 data_bytes_sent;
+    /// Bytes written to the link, frame overhead included
+    hal::u64 link_bytes_sent;
+    hal::u64 blocks_sent;
+    hal::u64 retransmissions;
+    /// Retransmissions caused by an expired timeout
+    hal::u64 timeouts;
+    /// Received frames that failed their header check or CRC
+    hal::u64 corrupt_frames;
+    /// Duration of send()
+    hal::time_duration elapsed;
+    /// Delivered bytes per second
+    float goodput;
+    hal::time_duration smoothed_rtt;
+    hal::time_duration min_rtt;
+    /// Window at the end of send()
+    usize window;
+    /// Block size at the end of send()
+    usize block_size;
+  };
+
+  /**
+   * @brief Create a bulk_sender with default settings
+   *
+   * @param p_allocator Memory allocator for this object and its buffers
+   * @param p_link Serial port connected to a bulk_receiver
+   * @return A strong_ptr to the created bulk_sender instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<bulk_sender> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<hal::v5::serial> p_link);
+
+  /**
+   * @brief Create a bulk_sender
+   *
+   * @param p_allocator Memory allocator for this object and its buffers
+   * @param p_link Serial port connected to a bulk_receiver
+   * @param p_settings Block sizes, window and timeouts
+   * @param p_clock Simulated time to measure and wait with, real time if
+   * null
+   * @return A strong_ptr to the created bulk_sender instance
+   * @throws hal::argument_out_of_domain if a size or the number of
+   * retransmissions is 0, min_block_size is above max_block_size, or
+   * max_block_size is above 65523
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<bulk_sender> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<hal::v5::serial> p_link,
+    settings const& p_settings,
+    hal::v5::optional_ptr<simulated_clock> p_clock = nullptr);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  bulk_sender(hal::v5::strong_ptr_only_token,
+              std::pmr::polymorphic_allocator<> p_allocator,
+              hal::v5::strong_ptr<hal::v5::serial> p_link,
+              settings const& p_settings,
+              hal::v5::optional_ptr<simulated_clock> p_clock);
+
+  // Non-copyable and non-movable
+  bulk_sender(bulk_sender const&) = delete;
+  bulk_sender& operator=(bulk_sender const&) = delete;
+  bulk_sender(bulk_sender&&) = delete;
+  bulk_sender& operator=(bulk_sender&&) = delete;
+
+  /**
+   * @brief Send an image, resuming where the receiver's copy ends
+   *
+   * Blocks until the receiver acknowledged the whole image. Only one thread
+   * may send at a time.
+   *
+   * @param p_transfer_id Identifies the image, the same id and size resume
+   * an interrupted transfer
+   * @param p_image Data to send
+   * @throws hal::argument_out_of_domain if the image is 4 GiB or larger
+   * @throws hal::timed_out if the receiver does not answer, or a block was
+   * sent max_retransmissions more times without being acknowledged
+   */
+  void send(hal::u32 p_transfer_id, std::span<hal::byte const> p_image);
+
+  /**
+   * @brief Get the counters of the current or last send()
+   *
+   * May be called from another thread while send() runs.
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics();
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * @brief A block that was sent and not yet acknowledged
+   */
+  struct block
+  {
+    hal::u32 offset;
+    hal::u32 length;
+    /// Time of the latest transmission
+    clock::time_point sent;
+    /// Order of the latest transmission among all transmissions
+    hal::u32 sequence;
+    /// Bytes delivered and time at the latest transmission, to measure
+    /// the delivery rate
+    hal::u64 delivered_at_send;
+    clock::time_point delivered_time_at_send;
+    hal::u32 transmissions;
+    bool acknowledged;
+  };
+
+  /**
+   * @brief Open the transfer and get the receiver's resume offset
+   */
+  hal::u32 open(hal::u32 p_transfer_id, hal::u32 p_size);
+
+  void transmit(block& p_block, std::span<hal::byte const> p_image);
+
+  /**
+   * @brief Split a block about to be sent again down to the block size
+   *
+   * The rest becomes a block of its own, sent right after it.
+   */
+  void split(usize p_index);
+  void write_frame(hal::byte p_type,
+                   std::span<hal::byte const> p_fields,
+                   std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Process the acknowledgements the link received
+   */
+  void receive_acknowledgements(hal::u32 p_transfer_id);
+  void acknowledge(hal::u32 p_cumulative,
+                   hal::u32 p_offset,
+                   hal::u32 p_length,
+                   hal::u32 p_sequence);
+  void measure(block const& p_block,
+               clock::time_point p_now,
+               bool p_latest_transmission);
+  void adapt();
+  [[nodiscard]] clock::duration retransmission_timeout() const;
+
+  /**
+   * @brief Current time, real or simulated
+   */
+  [[nodiscard]] clock::time_point now();
+
+  /**
+   * @brief Wait poll_interval for acknowledgements to arrive
+   */
+  void wait_for_link();
+
+  hal::v5::strong_ptr<hal::v5::serial> m_link;
+  settings m_settings;
+  /// Simulated time, null to use real time
+  hal::v5::optional_ptr<simulated_clock> m_clock;
+  detail::bulk_frame_reader m_reader;
+  std::pmr::vector<hal::byte> m_frame;
+
+  // Transfer state, only used by the sending thread
+  std::pmr::deque<block> m_in_flight;
+  hal::u32 m_transfer_id = 0;
+  /// Offset below which the receiver has all data
+  hal::u32 m_cumulative = 0;
+  /// Offset of the first byte never sent
+  hal::u32 m_next_offset = 0;
+  hal::u32 m_next_sequence = 0;
+  /// Sequence of the latest transmission that was acknowledged
+  hal::u32 m_highest_acknowledged = 0;
+  hal::u64 m_delivered = 0;
+  clock::time_point m_delivered_time{};
+  usize m_in_flight_bytes = 0;
+  usize m_receiver_window = 0;
+  /// Accepted answer to the latest request to open
+  bool m_accepted = false;
+  hal::u32 m_resume_offset = 0;
+  bool m_has_rtt = false;
+  clock::duration m_smoothed_rtt{};
+  clock::duration m_rtt_variation{};
+  clock::duration m_min_rtt{};
+  /// Timeouts since the last round trip was measured
+  hal::u32 m_backoff = 0;
+  /// Highest recent delivery rate in bytes per second
+  double m_delivery_rate = 0.0;
+  /// Recent share of transmissions that were not acknowledged
+  double m_frame_error_rate = 0.0;
+
+  /// Guards m_statistics, m_window and m_block_size
+  std::mutex m_statistics_mutex;
+  statistics m_statistics{};
+  usize m_window = 0;
+  usize m_block_size = 0;
+};
+
+/**
+ * @brief Receives images sent by a bulk_sender
+ *
+ * Data is handed to the sink in order, each byte once, as soon as
+ * everything before it arrived. Blocks that arrive after a missing block
+ * are kept in a window_size reorder buffer until the missing block was
+ * sent again. Received frames are processed and acknowledged whenever
+ * service() is called, which must happen at least once per link receive
+ * buffer of traffic.
+ */
+class bulk_receiver
+  : public hal::v5::enable_strong_from_this<bulk_receiver>
+{
+public:
+  /// Receives data at p_offset of the image, in order
+  using sink = void(hal::u32 p_offset, std::span<hal::byte const> p_data);
+
+  struct settings
+  {
+    /// Size of the reorder buffer, also the largest window of the sender
+    usize window_size = 16 * 1024;
+  };
+
+  /**
+   * @brief State of the current transfer
+   */
+  struct progress
+  {
+    hal::u32 transfer_id;
+    /// Size of the image
+    hal::u32 size;
+    /// Bytes handed to the sink, from the start of the image
+    hal::u32 received;
+    bool complete;
+  };
+
+  /**
+   * @brief Counters describing the receiver's traffic
+   */
+  struct statistics
+  {
+    hal::u64 blocks_received;
+    /// Blocks whose data was already received
+    hal::u64 duplicate_blocks;
+    /// Frames that failed their header check or CRC
+    hal::u64 corrupt_frames;
+    /// Frames of another transfer, or beyond the reorder buffer
+    hal::u64 ignored_frames;
+    hal::u64 acknowledgements_sent;
+  };
+
+  /**
+   * @brief Create a bulk_receiver with default settings
+   *
+   * @param p_allocator Memory allocator for this object and its buffers
+   * @param p_link Serial port connected to a bulk_sender
+   * @param p_sink Receives the image data in order
+   * @return A strong_ptr to the created bulk_receiver instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<bulk_receiver> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<hal::v5::serial> p_link,
+    hal::callback<sink> p_sink);
+
+  /**
+   * @brief Create a bulk_receiver
+   *
+   * Parsing starts at the link's current receive cursor.
+   *
+   * @param p_allocator Memory allocator for this object and its buffers
+   * @param p_link Serial port connected to a bulk_sender
+   * @param p_sink Receives the image data in order
+   * @param p_settings Reorder buffer size
+   * @return A strong_ptr to the created bulk_receiver instance
+   * @throws hal::argument_out_of_domain if window_size is below 256 or
+   * above 1 MiB
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<bulk_receiver> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<hal::v5::serial> p_link,
+    hal::callback<sink> p_sink,
+    settings const& p_settings);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  bulk_receiver(hal::v5::strong_ptr_only_token,
+                std::pmr::polymorphic_allocator<> p_allocator,
+                hal::v5::strong_ptr<hal::v5::serial> p_link,
+                hal::callback<sink> p_sink,
+                settings const& p_settings);
+
+  // Non-copyable and non-movable
+  bulk_receiver(bulk_receiver const&) = delete;
+  bulk_receiver& operator=(bulk_receiver const&) = delete;
+  bulk_receiver(bulk_receiver&&) = delete;
+  bulk_receiver& operator=(bulk_receiver&&) = delete;
+
+  /**
+   * @brief Process and acknowledge the frames received since the last call
+   *
+   * The sink is called from here.
+   */
+  void service();
+
+  /**
+   * @brief Continue a transfer whose first bytes were received earlier
+   *
+   * For example by an earlier run of the program that stored them. The
+   * next request to open p_transfer_id with p_size resumes at p_received.
+   *
+   * @param p_transfer_id Id of the interrupted transfer
+   * @param p_size Size of its image
+   * @param p_received Bytes of the image that were already stored
+   * @throws hal::argument_out_of_domain if p_received is above p_size
+   */
+  void resume(hal::u32 p_transfer_id, hal::u32 p_size, hal::u32 p_received);
+
+  /**
+   * @brief Get the state of the current transfer
+   */
+  [[nodiscard]] progress get_progress();
+
+  /**
+   * @brief Get the receiver's counters
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics();
+
+private:
+  void on_open(std::span<hal::byte const> p_payload);
+  void on_data(std::span<hal::byte const> p_payload);
+  /// Hand contiguous data from the reorder buffer to the sink
+  void deliver();
+  void write_frame(hal::byte p_type, std::span<hal::byte const> p_fields);
+
+  hal::v5::strong_ptr<hal::v5::serial> m_link;
+  hal::callback<sink> m_sink;
+  settings m_settings;
+  detail::bulk_frame_reader m_reader;
+  std::pmr::vector<hal::byte> m_frame;
+  /// Image data after m_progress.received, at offset % window_size
+  std::pmr::vector<hal::byte> m_reorder;
+  /// Whether each byte of m_reorder holds received data
+  std::pmr::vector<bool> m_present;
+
+  /// Guards m_progress and m_statistics
+  std::mutex m_mutex;
+  progress m_progress{};
+  /// Whether a transfer was opened or resumed
+  bool m_open = false;
+  statistics m_statistics{};
+};
+}  // namespace hal::mac::inline v1
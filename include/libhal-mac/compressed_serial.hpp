@@ -0,0 +1,289 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <libhal/pointers.hpp>
+#include <libhal/serial.hpp>
+#include <libhal/units.hpp>
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Compresses everything written to a serial link and decompresses
+ * everything received from it
+ *
+ * Written data is collected into blocks of up to block_size bytes, and each
+ * block is compressed in the LZ4 block format and sent as one frame. Each
+ * frame starts with a 5 byte header:
+ *
+ * | Byte | Content                                               |
+ * |------|-------------------------------------------------------|
+ * | 0    | 0xC5, marks the start of a frame                      |
+ * | 1    | Flags, bit 0: stored uncompressed, bit 1: independent |
+ * | 2, 3 | Payload length, little endian                         |
+ * | 4    | Header check, byte 1 ^ byte 2 ^ byte 3 ^ 0x5A         |
+ *
+ * Matches may refer back up to window_size bytes into earlier blocks, which
+ * is what makes short lines of logs and telemetry compress well. The
+ * decompressing peer needs window_size + block_size bytes of memory for that
+ * history, and a peer using the reference LZ4 library can decode the
+ * payloads with LZ4_decompress_safe_continue(). Blocks that compression
+ * would not shrink are sent stored, so incompressible data grows by no more
+ * than the header.
+ *
+ * A block is sent when it is full, when flush() is called, or flush_delay
+ * after its first byte was written. With a flush_delay of 0 every write is
+ * sent as soon as it was compressed, so frame boundaries of the protocol on
+ * top are kept. A longer delay collects several small writes into one block
+ * for a better ratio at the cost of that much latency, and write() returns
+ * before such data is on the link.
+ *
+ * Linked blocks require a link that neither loses nor corrupts data: after
+ * a bad block the history of both ends differs, so the receiver discards
+ * everything up to the next independent block. The first block is always
+ * independent. Enable independent_blocks on lossy links, which makes every
+ * block independent and gives up the compression that comes from earlier
+ * blocks.
+ *
+ * Received data is decompressed whenever the receive cursor is read, or
+ * when service() is called, and must keep up with the link just like a
+ * serial_mux channel.
+ *
+ * Example:
+ * ```cpp
+ * auto link = hal::mac::compressed_serial::create(
+ *   allocator, uart, { .flush_delay = std::chrono::milliseconds(2) });
+ * link->write(hal::as_bytes("temperature=23.5 C\n"sv));
+ * ```
+ */
+class compressed_serial : public hal::v5::serial
+{
+public:
+  struct options
+  {
+    /// Size of the decompressed receive buffer
+    usize receive_buffer_size = 4096;
+    /// Largest uncompressed block, at most 65535, the same on both ends
+    usize block_size = 1024;
+    /// How far back matches may refer, at most 65535, the same on both ends
+    usize window_size = 4096;
+    /// Longest time written data waits for more data before it is sent
+    hal::time_duration flush_delay{ 0 };
+    /// Compress every block on its own, without earlier blocks' data
+    bool independent_blocks = false;
+  };
+
+  /**
+   * @brief Counters describing the compression
+   */
+  struct statistics
+  {
+    /// Bytes passed to write()
+    hal::u64 bytes_written;
+    /// Bytes written to the link, headers included
+    hal::u64 link_bytes_sent;
+    hal::u64 blocks_sent;
+    /// Blocks sent uncompressed because compression did not shrink them
+    hal::u64 stored_blocks;
+    /// Decompressed bytes received
+    hal::u64 bytes_received;
+    /// Bytes taken from the link, headers included
+    hal::u64 link_bytes_received;
+    hal::u64 blocks_received;
+    /// Blocks that could not be decompressed, or that depend on a block
+    /// which could not
+    hal::u64 corrupt_blocks;
+    /// Headers that failed their check, each causes a resynchronization
+    hal::u64 header_errors;
+  };
+
+  /**
+   * @brief Create a compressed_serial with default options
+   *
+   * @param p_allocator Memory allocator for this object and its buffers
+   * @param p_link Serial port carrying the compressed frames
+   * @return A strong_ptr to the created compressed_serial instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<compressed_serial> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<hal::v5::serial> p_link);
+
+  /**
+   * @brief Create a compressed_serial
+   *
+   * Decompression starts at the link's current receive cursor. A thread that
+   * sends delayed blocks is started if flush_delay is above 0.
+   *
+   * @param p_allocator Memory allocator for this object and its buffers
+   * @param p_link Serial port carrying the compressed frames
+   * @param p_options Buffer sizes and flush behavior
+   * @return A strong_ptr to the created compressed_serial instance
+   * @throws hal::argument_out_of_domain if a size is 0 or block_size or
+   * window_size is above 65535
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<compressed_serial> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<hal::v5::serial> p_link,
+    options const& p_options);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  compressed_serial(hal::v5::strong_ptr_only_token,
+                    std::pmr::polymorphic_allocator<> p_allocator,
+                    hal::v5::strong_ptr<hal::v5::serial> p_link,
+                    options const& p_options);
+
+  /**
+   * @brief Send data that is still waiting and stop the flush thread
+   *
+   * Errors of that last write are ignored.
+   */
+  ~compressed_serial() override;
+
+  // Non-copyable and non-movable
+  compressed_serial(compressed_serial const&) = delete;
+  compressed_serial& operator=(compressed_serial const&) = delete;
+  compressed_serial(compressed_serial&&) = delete;
+  compressed_serial& operator=(compressed_serial&&) = delete;
+
+  /**
+   * @brief Compress and send the data that is waiting for flush_delay
+   *
+   * @throws hal::io_error or the link's exception if a block could not be
+   * written, including a delayed block the flush thread failed to write
+   */
+  void flush();
+
+  /**
+   * @brief Decompress the data the link received since the last call
+   */
+  void service();
+
+  /**
+   * @brief Get the compression counters
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics() const;
+
+private:
+  /// Forwards the settings to the link
+  void driver_configure(hal::v5::serial::settings const& p_settings) override;
+
+  /**
+   * @throws hal::io_error or the link's exception if a block could not be
+   * written
+   */
+  void driver_write(std::span<hal::byte const> p_data) override;
+  std::span<hal::byte const> driver_receive_buffer() override;
+  usize driver_cursor() override;
+
+  /**
+   * @brief Compress and send the pending block, m_transmit_mutex must be held
+   */
+  void send_block();
+
+  /**
+   * @brief Make room for the next block, keeping window_size bytes of history
+   *
+   * m_transmit_mutex must be held and no data may be pending.
+   */
+  void slide_transmit_history();
+
+  /**
+   * @brief Parse link data, m_receive_mutex must be held
+   */
+  void decompress(std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Decompress the complete frame in m_frame_in
+   */
+  void receive_block(hal::byte p_flags);
+
+  /**
+   * @brief Append decompressed data, m_receive_mutex must be held
+   */
+  void publish(std::span<hal::byte const> p_data);
+
+  void flush_thread_function();
+
+  hal::v5::strong_ptr<hal::v5::serial> m_link;
+  options m_options;
+
+  /// Guards the compressor, the flush thread state and writes to the link
+  std::mutex m_transmit_mutex;
+  std::condition_variable m_flush_requested;
+  /// Earlier data followed by the pending block
+  std::pmr::vector<hal::byte> m_transmit_history;
+  usize m_transmit_history_size = 0;
+  /// Bytes at the end of m_transmit_history that were not sent yet
+  usize m_pending = 0;
+  /// Position + 1 of the last occurrence of each hashed 4 byte sequence
+  std::pmr::vector<hal::u32> m_match_table;
+  /// Header and payload of the frame being sent
+  std::pmr::vector<hal::byte> m_frame_out;
+  /// Time the oldest pending byte was written
+  std::chrono::steady_clock::time_point m_pending_since{};
+  /// Error of a delayed block, reported by the next write or flush
+  std::exception_ptr m_deferred_error = nullptr;
+  bool m_stop_thread = false;
+
+  /// Guards the decompressor
+  std::mutex m_receive_mutex;
+  /// Link receive cursor up to which data was parsed
+  usize m_link_cursor = 0;
+  std::array<hal::byte, 5> m_header{};
+  usize m_header_size = 0;
+  /// Payload of the frame being received
+  std::pmr::vector<hal::byte> m_frame_in;
+  usize m_frame_in_size = 0;
+  usize m_payload_remaining = 0;
+  /// Whether the current payload is kept, false when it cannot fit
+  bool m_keep_payload = false;
+  hal::byte m_payload_flags = 0;
+  /// Decompressed data the received matches refer to
+  std::pmr::vector<hal::byte> m_receive_history;
+  usize m_receive_history_size = 0;
+  /// Whether the history matches the sender's, false until an independent
+  /// block arrived
+  bool m_history_valid = false;
+  std::pmr::vector<hal::byte> m_receive_buffer;
+  std::atomic<usize> m_receive_cursor{ 0 };
+
+  std::atomic<hal::u64> m_bytes_written{ 0 };
+  std::atomic<hal::u64> m_link_bytes_sent{ 0 };
+  std::atomic<hal::u64> m_blocks_sent{ 0 };
+  std::atomic<hal::u64> m_stored_blocks{ 0 };
+  std::atomic<hal::u64> m_bytes_received{ 0 };
+  std::atomic<hal::u64> m_link_bytes_received{ 0 };
+  std::atomic<hal::u64> m_blocks_received{ 0 };
+  std::atomic<hal::u64> m_corrupt_blocks{ 0 };
+  std::atomic<hal::u64> m_header_errors{ 0 };
+
+  /// Sends delayed blocks, only started if flush_delay is above 0
+  std::thread m_flush_thread;
+};
+}  // namespace hal::mac::inline v1
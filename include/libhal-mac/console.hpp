@@ -14,16 +14,24 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <memory_resource>
+#include <optional>
 #include <span>
 #include <thread>
 #include <vector>
 
+#include <termios.h>
+#include <unistd.h>
+
 #include <libhal/pointers.hpp>
 #include <libhal/serial.hpp>
 #include <libhal/units.hpp>
 
+#include "readiness_event.hpp"
+#include "scheduled_thread.hpp"
+
 namespace hal::mac::inline v1 {
 /**
  * @brief Serial communication interface using macOS console (stdin/stdout)
@@ -36,33 +44,97 @@ namespace hal::mac::inline v1 {
  * The implementation uses a background thread to continuously read from stdin
  * and store data in a circular buffer, while write operations are sent
  * directly to stdout.
+ *
+ * By default the terminal keeps its line discipline, so input only arrives
+ * once the user presses enter. Select terminal_mode::cbreak or
+ * terminal_mode::raw to receive every keystroke as soon as it is typed, for
+ * example when driving an interactive shell written for a real UART.
  */
 class console_serial : public hal::v5::serial
 {
 public:
   /**
-   * @brief Create a console serial instance
+   * @brief How the input terminal is set up while the console exists
+   */
+  enum class terminal_mode : hal::u8
+  {
+    /// Leave the terminal as it is, input arrives line by line
+    unchanged,
+    /// Disable line buffering and echo, keep signal keys such as Ctrl+C and
+    /// output processing
+    cbreak,
+    /// Pass every byte through untouched, including Ctrl+C, and disable
+    /// output processing so "\n" is no longer expanded to "\r\n"
+    raw,
+  };
+
+  /**
+   * @brief Console options
+   */
+  struct options
+  {
+    /// Terminal setup, only applied when input_fd is a terminal
+    terminal_mode mode = terminal_mode::unchanged;
+    /// Descriptor input is read from
+    int input_fd = STDIN_FILENO;
+    /// Descriptor output is written to
+    int output_fd = STDOUT_FILENO;
+    /// Scheduling of the receive thread and whether it busy polls. A busy
+    /// polling thread spins on poll() with a zero timeout, as input_fd is
+    /// usually shared with the shell and must stay blocking.
+    receive_thread_settings receive_thread{};
+  };
+
+  /**
+   * @brief Create a console serial instance on stdin and stdout
    *
    * @param p_allocator Memory allocator for internal buffer management
    * @param p_buffer_size Size of the internal circular receive buffer (min: 32)
    * @return A strong_ptr to the created console_serial instance
+   * @throws hal::argument_out_of_domain if p_buffer_size is 0
    */
   [[nodiscard]] static hal::v5::strong_ptr<console_serial> create(
     std::pmr::polymorphic_allocator<> p_allocator,
     hal::usize p_buffer_size);
 
+  /**
+   * @brief Create a console serial instance
+   *
+   * When a terminal mode other than terminal_mode::unchanged is selected, the
+   * previous terminal attributes are restored when the console is destroyed.
+   * They are also restored if the process is ended by SIGINT, SIGTERM,
+   * SIGHUP or SIGQUIT while those signals still have their default action,
+   * so a killed application does not leave the user's shell unusable.
+   *
+   * @param p_allocator Memory allocator for internal buffer management
+   * @param p_buffer_size Size of the internal circular receive buffer (min: 32)
+   * @param p_options Input and output descriptors and the terminal mode
+   * @return A strong_ptr to the created console_serial instance
+   * @throws hal::argument_out_of_domain if p_buffer_size is 0
+   * @throws hal::operation_not_permitted if the terminal mode cannot be
+   * applied, or the process may not use the receive thread's real-time
+   * priority
+   * @throws hal::argument_out_of_domain if the receive thread settings are
+   * invalid, see scheduled_thread
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<console_serial> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::usize p_buffer_size,
+    options const& p_options);
+
   /**
    * @brief Public constructor - but use create() instead
    */
   console_serial(hal::v5::strong_ptr_only_token,
                  std::pmr::polymorphic_allocator<> p_allocator,
-                 hal::usize p_buffer_size);
+                 hal::usize p_buffer_size,
+                 options const& p_options);
 
   /**
    * @brief Destroy the console serial object
    *
    * Stops the background receive thread and waits for it to complete before
-   * destruction.
+   * destruction, then restores the terminal attributes.
    */
   ~console_serial() override;
 
@@ -72,6 +144,40 @@ public:
   console_serial(console_serial&&) = delete;
   console_serial& operator=(console_serial&&) = delete;
 
+  using hal::v5::serial::write;
+
+  /**
+   * @brief Write several buffers back to back without concatenating them
+   *
+   * Flushes stdout's buffer to keep earlier output in order, then hands the
+   * buffers to writev() on the output descriptor, so a message made of
+   * several buffers normally takes a single system call and no copies.
+   * Partial writes are resumed where they ended.
+   *
+   * @param p_buffers Buffers to write in order, empty buffers are skipped
+   * @throws hal::io_error if the output cannot be written
+   */
+  void write(std::span<std::span<hal::byte const> const> p_buffers);
+
+  /**
+   * @brief Get a descriptor that becomes readable when input was received
+   *
+   * Console writes block until stdout accepted the data, so unlike
+   * hal::mac::serial the descriptor only signals received data. Do not read
+   * from the descriptor, call acknowledge_readiness() instead.
+   *
+   * @return Descriptor to wait on for readability
+   */
+  [[nodiscard]] int readiness_handle() const;
+
+  /**
+   * @brief Reset the readiness descriptor
+   *
+   * Call this after the descriptor became readable and before checking the
+   * receive cursor, so that later input signals it again.
+   */
+  void acknowledge_readiness();
+
 private:
   void driver_configure(hal::v5::serial::settings const& p_settings) override;
   void driver_write(std::span<hal::byte const> p_data) override;
@@ -79,7 +185,17 @@ private:
   hal::usize driver_cursor() override;
 
   /**
-   * @brief Background thread function for reading from stdin
+   * @brief Apply the terminal mode to the input terminal
+   */
+  void enter_terminal_mode();
+
+  /**
+   * @brief Restore the terminal attributes saved by enter_terminal_mode()
+   */
+  void restore_terminal();
+
+  /**
+   * @brief Background thread function for reading from the input descriptor
    */
   void receive_thread_function();
 
@@ -87,11 +203,21 @@ private:
   std::pmr::polymorphic_allocator<> m_allocator;
   /// Circular buffer for storing received data from stdin
   std::pmr::vector<hal::byte> m_receive_buffer;
+  /// Descriptors and terminal mode
+  options m_options;
+  /// Terminal attributes to restore, empty if they were left unchanged
+  std::optional<termios> m_saved_terminal;
+  /// Slot in the signal restore table, empty if none was free
+  std::optional<hal::usize> m_restore_slot;
+  /// Wakes the receive thread for shutdown
+  std::array<int, 2> m_wake_pipe{ -1, -1 };
   /// Atomic cursor position for thread-safe buffer access
   std::atomic<hal::usize> m_receive_cursor{ 0 };
+  /// Signalled whenever new input is published
+  readiness_event m_readiness;
   /// Atomic flag to signal thread termination
   std::atomic<bool> m_stop_thread{ false };
-  /// Background thread for reading from stdin
-  std::thread m_receive_thread;
+  /// Background thread for reading from the input descriptor
+  scheduled_thread m_receive_thread;
 };
 }  // namespace hal::mac::inline v1
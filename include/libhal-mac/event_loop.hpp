@@ -0,0 +1,478 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <libhal/functional.hpp>
+#include <libhal/pointers.hpp>
+#include <libhal/units.hpp>
+
+namespace hal::mac::inline v1 {
+namespace detail {
+/**
+ * @brief Allocates coroutine frames from a polymorphic allocator
+ *
+ * A coroutine whose first parameter (after the object, for member functions)
+ * is std::allocator_arg followed by a std::pmr::polymorphic_allocator<> gets
+ * its frame from that allocator. Any other coroutine uses
+ * std::pmr::get_default_resource(). The memory resource is stored behind the
+ * frame so the frame can be returned to it.
+ */
+struct frame_allocation
+{
+  static void* operator new(std::size_t p_size)
+  {
+    return allocate(p_size, std::pmr::get_default_resource());
+  }
+
+  template<typename... Args>
+  static void* operator new(
+    std::size_t p_size,
+    std::allocator_arg_t,
+    std::pmr::polymorphic_allocator<> const& p_allocator,
+    Args const&...)
+  {
+    return allocate(p_size, p_allocator.resource());
+  }
+
+  template<typename Self, typename... Args>
+  static void* operator new(
+    std::size_t p_size,
+    Self const&,
+    std::allocator_arg_t,
+    std::pmr::polymorphic_allocator<> const& p_allocator,
+    Args const&...)
+  {
+    return allocate(p_size, p_allocator.resource());
+  }
+
+  static void operator delete(void* p_frame, std::size_t p_size)
+  {
+    std::pmr::memory_resource* resource = nullptr;
+    auto const frame_size = resource_offset(p_size);
+    std::memcpy(&resource,
+                static_cast<std::byte*>(p_frame) + frame_size,
+                sizeof(resource));
+    resource->deallocate(
+      p_frame, frame_size + sizeof(resource), alignof(std::max_align_t));
+  }
+
+private:
+  static constexpr std::size_t resource_offset(std::size_t p_size)
+  {
+    constexpr auto alignment = alignof(std::pmr::memory_resource*);
+    return (p_size + alignment - 1) & ~(alignment - 1);
+  }
+
+  static void* allocate(std::size_t p_size,
+                        std::pmr::memory_resource* p_resource)
+  {
+    auto const frame_size = resource_offset(p_size);
+    auto* frame = p_resource->allocate(frame_size + sizeof(p_resource),
+                                       alignof(std::max_align_t));
+    std::memcpy(static_cast<std::byte*>(frame) + frame_size,
+                &p_resource,
+                sizeof(p_resource));
+    return frame;
+  }
+};
+
+/**
+ * @brief Promise state shared by every task result type
+ */
+class task_promise_base : public frame_allocation
+{
+public:
+  struct final_awaiter
+  {
+    bool await_ready() noexcept
+    {
+      return false;
+    }
+
+    template<typename Promise>
+    std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<Promise> p_handle) noexcept
+    {
+      // Symmetric transfer back to the awaiting coroutine
+      if (auto continuation = p_handle.promise().m_continuation) {
+        return continuation;
+      }
+      return std::noop_coroutine();
+    }
+
+    void await_resume() noexcept
+    {
+    }
+  };
+
+  std::suspend_always initial_suspend() noexcept
+  {
+    return {};
+  }
+
+  final_awaiter final_suspend() noexcept
+  {
+    return {};
+  }
+
+  void unhandled_exception() noexcept
+  {
+    m_exception = std::current_exception();
+  }
+
+  std::coroutine_handle<> m_continuation = nullptr;
+  std::exception_ptr m_exception = nullptr;
+};
+
+template<typename T>
+class task_promise : public task_promise_base
+{
+public:
+  template<typename U>
+  void return_value(U&& p_value)
+  {
+    m_value.emplace(std::forward<U>(p_value));
+  }
+
+  T result()
+  {
+    if (m_exception) {
+      std::rethrow_exception(m_exception);
+    }
+    return std::move(*m_value);
+  }
+
+private:
+  std::optional<T> m_value;
+};
+
+template<>
+class task_promise<void> : public task_promise_base
+{
+public:
+  void return_void() noexcept
+  {
+  }
+
+  void result()
+  {
+    if (m_exception) {
+      std::rethrow_exception(m_exception);
+    }
+  }
+};
+
+/**
+ * @brief Fire and forget coroutine used to run spawned tasks
+ */
+class detached_task
+{
+public:
+  struct promise_type : frame_allocation
+  {
+    detached_task get_return_object() noexcept
+    {
+      return detached_task{
+        std::coroutine_handle<promise_type>::from_promise(*this)
+      };
+    }
+
+    std::suspend_always initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never final_suspend() noexcept
+    {
+      return {};
+    }
+
+    void return_void() noexcept
+    {
+    }
+
+    void unhandled_exception() noexcept
+    {
+      std::terminate();
+    }
+  };
+
+  std::coroutine_handle<> handle;
+};
+}  // namespace detail
+
+/**
+ * @brief Lazily started coroutine producing a value of type T
+ *
+ * A task starts running when it is awaited and resumes its awaiter when it
+ * completes. Exceptions thrown by the coroutine are rethrown to the awaiter.
+ *
+ * Frames are allocated from std::pmr::get_default_resource() unless the
+ * coroutine takes `std::allocator_arg_t, std::pmr::polymorphic_allocator<>`
+ * as its first two parameters, in which case the frame comes from that
+ * allocator:
+ * ```cpp
+ * hal::mac::task<hal::usize> read_line(std::allocator_arg_t,
+ *                                      std::pmr::polymorphic_allocator<>,
+ *                                      hal::mac::async_serial& p_port,
+ *                                      std::span<hal::byte> p_line)
+ * {
+ *   auto const line = co_await p_port.async_read_until(p_line, '\n');
+ *   co_return line.size();
+ * }
+ * ```
+ *
+ * @tparam T Type of the value produced by the coroutine
+ */
+template<typename T = void>
+class [[nodiscard]] task
+{
+public:
+  struct promise_type : detail::task_promise<T>
+  {
+    task get_return_object() noexcept
+    {
+      return task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+    }
+  };
+
+  task(task&& p_other) noexcept
+    : m_handle(std::exchange(p_other.m_handle, nullptr))
+  {
+  }
+
+  task& operator=(task&& p_other) noexcept
+  {
+    if (this != &p_other) {
+      if (m_handle) {
+        m_handle.destroy();
+      }
+      m_handle = std::exchange(p_other.m_handle, nullptr);
+    }
+    return *this;
+  }
+
+  task(task const&) = delete;
+  task& operator=(task const&) = delete;
+
+  ~task()
+  {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+
+  std::coroutine_handle<> await_suspend(
+    std::coroutine_handle<> p_continuation) noexcept
+  {
+    m_handle.promise().m_continuation = p_continuation;
+    return m_handle;
+  }
+
+  T await_resume()
+  {
+    return m_handle.promise().result();
+  }
+
+private:
+  explicit task(std::coroutine_handle<promise_type> p_handle)
+    : m_handle(p_handle)
+  {
+  }
+
+  std::coroutine_handle<promise_type> m_handle;
+};
+
+/**
+ * @brief Interface of the event loop that resumes asynchronous operations
+ *
+ * libhal-mac ships event_loop. To drive async_serial from another loop
+ * (asio, libuv, a GUI toolkit, ...) implement these two operations on top of
+ * it.
+ */
+class scheduler
+{
+public:
+  /**
+   * @brief Resume a coroutine on the scheduler's thread
+   *
+   * Must be thread safe, it is called from serial receive threads.
+   *
+   * @param p_handle Coroutine to resume
+   */
+  void post(std::coroutine_handle<> p_handle)
+  {
+    driver_post(p_handle);
+  }
+
+  /**
+   * @brief Call a handler on the scheduler's thread once a descriptor is
+   * writable
+   *
+   * The handler is called once. It may call wait_writable() again.
+   *
+   * @param p_fd Descriptor to wait for
+   * @param p_handler Handler to call
+   */
+  void wait_writable(int p_fd, hal::callback<void()> p_handler)
+  {
+    driver_wait_writable(p_fd, std::move(p_handler));
+  }
+
+  virtual ~scheduler() = default;
+
+private:
+  virtual void driver_post(std::coroutine_handle<> p_handle) = 0;
+  virtual void driver_wait_writable(int p_fd,
+                                    hal::callback<void()> p_handler) = 0;
+};
+
+/**
+ * @brief Single threaded event loop for coroutine based applications
+ *
+ * Tasks are started with spawn() and executed by run() on the calling thread.
+ * While nothing is ready to run the loop sleeps in poll() on a wakeup pipe
+ * and on the descriptors passed to wait_writable(), so an idle loop uses no
+ * CPU.
+ *
+ * The frames of spawned tasks' wrappers come from the loop's allocator, and
+ * the ready queue keeps its capacity, so a loop in steady state does not
+ * allocate.
+ *
+ * Example:
+ * ```cpp
+ * auto loop = hal::mac::event_loop::create(allocator);
+ * auto port = hal::mac::async_serial::create(allocator, serial, loop);
+ * loop->spawn(echo(std::allocator_arg, allocator, *port));
+ * loop->run();
+ * ```
+ */
+class event_loop
+  : public scheduler
+  , public hal::v5::enable_strong_from_this<event_loop>
+{
+public:
+  /**
+   * @brief Create an event loop
+   *
+   * @param p_allocator Memory allocator for this object, its queues and the
+   * wrappers of spawned tasks
+   * @return A strong_ptr to the created event_loop instance
+   * @throws hal::operation_not_permitted if the wakeup pipe cannot be created
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<event_loop> create(
+    std::pmr::polymorphic_allocator<> p_allocator);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  event_loop(hal::v5::strong_ptr_only_token,
+             std::pmr::polymorphic_allocator<> p_allocator);
+
+  /**
+   * @brief Close the wakeup pipe
+   *
+   * Every spawned task must have completed, as suspended tasks are not
+   * destroyed.
+   */
+  ~event_loop() override;
+
+  // Non-copyable and non-movable
+  event_loop(event_loop const&) = delete;
+  event_loop& operator=(event_loop const&) = delete;
+  event_loop(event_loop&&) = delete;
+  event_loop& operator=(event_loop&&) = delete;
+
+  /**
+   * @brief Schedule a task to run on the loop
+   *
+   * The task starts on the next iteration of run(). Thread safe.
+   *
+   * @param p_task Task to run, owned by the loop until it completes
+   */
+  void spawn(task<void> p_task);
+
+  /**
+   * @brief Run the loop on the calling thread
+   *
+   * Returns once every spawned task has completed or stop() was called.
+   *
+   * @throws Rethrows the first exception that escaped a spawned task
+   */
+  void run();
+
+  /**
+   * @brief Make run() return after the current iteration. Thread safe.
+   */
+  void stop();
+
+private:
+  void driver_post(std::coroutine_handle<> p_handle) override;
+  void driver_wait_writable(int p_fd,
+                            hal::callback<void()> p_handler) override;
+
+  /**
+   * @brief Coroutine that owns a spawned task and records its outcome
+   */
+  detail::detached_task run_spawned(std::allocator_arg_t,
+                                    std::pmr::polymorphic_allocator<>,
+                                    task<void> p_task);
+
+  /**
+   * @brief Sleep until something is posted or a descriptor becomes writable
+   */
+  void wait_for_events();
+
+  struct writable_wait
+  {
+    int fd;
+    hal::callback<void()> handler;
+  };
+
+  std::pmr::polymorphic_allocator<> m_allocator;
+  /// Guards m_ready, m_writable_waits and m_sleeping
+  std::mutex m_mutex;
+  std::pmr::vector<std::coroutine_handle<>> m_ready;
+  /// Handles being resumed by the current iteration, swapped with m_ready
+  std::pmr::vector<std::coroutine_handle<>> m_resuming;
+  std::pmr::vector<writable_wait> m_writable_waits;
+  /// Handlers of writable descriptors being called by the current iteration
+  std::pmr::vector<hal::callback<void()>> m_writable_ready;
+  /// True while run() sleeps in poll() and needs the wakeup pipe written
+  bool m_sleeping = false;
+  std::array<int, 2> m_wake_pipe{ -1, -1 };
+  std::atomic<usize> m_active_tasks{ 0 };
+  std::atomic<bool> m_stop{ false };
+  std::exception_ptr m_error = nullptr;
+};
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,137 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <libhal/functional.hpp>
+#include <libhal/pointers.hpp>
+#include <libhal/units.hpp>
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Shared I/O thread that services many file descriptors
+ *
+ * By default every hal::mac::serial runs its own receive thread that sleeps in
+ * poll() on a single descriptor. With hundreds of ports that is hundreds of
+ * threads, each making a wait and a read system call per chunk of data.
+ *
+ * An io_reactor replaces all of them with a single thread. The thread waits
+ * on a kqueue (macOS) or epoll (Linux) instance and harvests readiness for up
+ * to 64 descriptors per system call, then calls the handler of each ready
+ * descriptor. Platforms with neither fall back to poll().
+ *
+ * Pass an io_reactor to serial::create() to use it as the serial port's I/O
+ * backend.
+ */
+class io_reactor : public hal::v5::enable_strong_from_this<io_reactor>
+{
+public:
+  /**
+   * @brief Called on the reactor thread when a descriptor is readable
+   *
+   * Handlers must not block and must not call watch() or unwatch(). Return
+   * false to stop watching the descriptor.
+   */
+  using handler = bool();
+
+  struct statistics
+  {
+    /// Number of wait system calls (kevent, epoll_wait or poll)
+    hal::u64 wait_calls;
+    /// Number of readiness events dispatched to handlers
+    hal::u64 events;
+  };
+
+  /**
+   * @brief Create an io_reactor and start its thread
+   *
+   * @param p_allocator Memory allocator for this object and its handler table
+   * @return A strong_ptr to the created io_reactor instance
+   * @throws hal::operation_not_permitted if the kernel event queue or wakeup
+   * pipe cannot be created
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<io_reactor> create(
+    std::pmr::polymorphic_allocator<> p_allocator);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  io_reactor(hal::v5::strong_ptr_only_token,
+             std::pmr::polymorphic_allocator<> p_allocator);
+
+  /**
+   * @brief Stop the reactor thread and release the event queue
+   */
+  ~io_reactor();
+
+  // Non-copyable and non-movable
+  io_reactor(io_reactor const&) = delete;
+  io_reactor& operator=(io_reactor const&) = delete;
+  io_reactor(io_reactor&&) = delete;
+  io_reactor& operator=(io_reactor&&) = delete;
+
+  /**
+   * @brief Start watching a descriptor for readability
+   *
+   * @param p_fd Descriptor to watch, must not already be watched
+   * @param p_handler Handler to call when the descriptor is readable
+   * @throws hal::operation_not_permitted if the descriptor cannot be added
+   */
+  void watch(int p_fd, hal::callback<handler> p_handler);
+
+  /**
+   * @brief Stop watching a descriptor
+   *
+   * Once this returns the descriptor's handler is not running and will not be
+   * called again. Does nothing if the descriptor is not watched.
+   *
+   * @param p_fd Descriptor to stop watching
+   */
+  void unwatch(int p_fd);
+
+  /**
+   * @brief Get counters describing the work done by the reactor thread
+   *
+   * events / wait_calls is the average number of descriptors serviced per
+   * wait system call.
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics() const;
+
+private:
+  void reactor_thread_function();
+  void wake();
+  void remove_from_poller(int p_fd);
+
+  /// Guards m_handlers and is held while handlers run
+  std::mutex m_mutex;
+  std::pmr::unordered_map<int, hal::callback<handler>> m_handlers;
+  /// kqueue or epoll instance, -1 on platforms that use poll()
+  int m_poller = -1;
+  /// Pipe used to wake the reactor thread for shutdown
+  std::array<int, 2> m_wake_pipe{ -1, -1 };
+  std::atomic<hal::u64> m_wait_calls{ 0 };
+  std::atomic<hal::u64> m_events{ 0 };
+  std::atomic<bool> m_stop_thread{ false };
+  std::thread m_thread;
+};
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,335 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory_resource>
+#include <mutex>
+#include <random>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <libhal/pointers.hpp>
+#include <libhal/serial.hpp>
+#include <libhal/units.hpp>
+
+#include "simulated_clock.hpp"
+
+namespace hal::mac::inline v1 {
+class emulated_serial;
+
+/**
+ * @brief Emulates a slow, lossy serial cable between two in-process ports
+ *
+ * Each direction of the link behaves like a UART line: every byte takes 10
+ * bit times at baud_rate, a start bit, 8 data bits and a stop bit, and
+ * arrives latency after it left the line. Writes queue up to
+ * transmit_buffer_size bytes ahead of the line, like a driver's transmit
+ * buffer, and block beyond that. Received bytes are handed over in bursts
+ * of up to 16 bytes, like a UART receive FIFO.
+ *
+ * Faults are injected per byte: a byte is lost with probability loss_rate
+ * and otherwise has one bit flipped with probability error_rate. Faults are
+ * drawn from a generator seeded with seed, so the same traffic sees the
+ * same faults in every run.
+ *
+ * This lets protocol code such as bulk_sender be tested and benchmarked at
+ * the line rates and error rates of real hardware without any hardware.
+ *
+ * Given a simulated_clock, the link runs on simulated time instead: bytes
+ * are delivered by handlers scheduled on the clock rather than by a thread,
+ * and a write that fills the transmit buffer sleeps on the clock. A slow
+ * link then costs no wall time, and the same traffic arrives at the same
+ * simulated times in every run.
+ *
+ * Example:
+ * ```cpp
+ * auto link = hal::mac::link_emulator::create(
+ *   allocator, { .baud_rate = 921600, .error_rate = 1e-5f });
+ * auto host = hal::mac::emulated_serial::create(
+ *   allocator, link, hal::mac::link_emulator::end::a);
+ * auto device = hal::mac::emulated_serial::create(
+ *   allocator, link, hal::mac::link_emulator::end::b);
+ * ```
+ */
+class link_emulator : public hal::v5::enable_strong_from_this<link_emulator>
+{
+public:
+  /**
+   * @brief The two ends of the link
+   */
+  enum class end : hal::u8
+  {
+    a,
+    b,
+  };
+
+  struct settings
+  {
+    /// Line rate of both directions
+    hal::u32 baud_rate = 115200;
+    /// Delay between a byte leaving the line and arriving at the other end
+    hal::time_duration latency{ 0 };
+    /// Probability that a byte is lost
+    float loss_rate = 0.0f;
+    /// Probability that a byte that is not lost has one bit flipped
+    float error_rate = 0.0f;
+    /// Bytes a write may queue ahead of the line before it blocks
+    usize transmit_buffer_size = 4096;
+    /// Seed of the fault generator
+    hal::u32 seed = 1;
+  };
+
+  /**
+   * @brief Counters describing one direction of the link
+   */
+  struct statistics
+  {
+    /// Bytes written at the sending end
+    hal::u64 bytes_sent;
+    /// Bytes that arrived at the receiving end, corrupted ones included
+    hal::u64 bytes_delivered;
+    hal::u64 bytes_lost;
+    hal::u64 bytes_corrupted;
+  };
+
+  /**
+   * @brief Create a link_emulator with default settings
+   *
+   * @param p_allocator Memory allocator for this object and bytes in flight
+   * @return A strong_ptr to the created link_emulator instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<link_emulator> create(
+    std::pmr::polymorphic_allocator<> p_allocator);
+
+  /**
+   * @brief Create a link_emulator and start its delivery thread
+   *
+   * @param p_allocator Memory allocator for this object and bytes in flight
+   * @param p_settings Line rate, latency and fault rates
+   * @param p_clock Simulated time to run on, no delivery thread is started.
+   * The clock must not be advanced while the link is destroyed.
+   * @return A strong_ptr to the created link_emulator instance
+   * @throws hal::argument_out_of_domain if baud_rate or transmit_buffer_size
+   * is 0, or a rate is not within 0 to 1
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<link_emulator> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    settings const& p_settings,
+    hal::v5::optional_ptr<simulated_clock> p_clock = nullptr);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  link_emulator(hal::v5::strong_ptr_only_token,
+                std::pmr::polymorphic_allocator<> p_allocator,
+                settings const& p_settings,
+                hal::v5::optional_ptr<simulated_clock> p_clock);
+
+  /**
+   * @brief Stop delivering, bytes still in flight are discarded
+   */
+  ~link_emulator();
+
+  // Non-copyable and non-movable
+  link_emulator(link_emulator const&) = delete;
+  link_emulator& operator=(link_emulator const&) = delete;
+  link_emulator(link_emulator&&) = delete;
+  link_emulator& operator=(link_emulator&&) = delete;
+
+  /**
+   * @brief Get the counters of the direction starting at p_from
+   *
+   * @param p_from End the bytes were written at
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics(end p_from);
+
+private:
+  friend class emulated_serial;
+
+  /**
+   * @brief Bytes of one write, arriving one byte time apart
+   */
+  struct chunk
+  {
+    std::chrono::steady_clock::time_point first_arrival;
+    std::pmr::vector<hal::byte> data;
+    usize delivered = 0;
+  };
+
+  /**
+   * @brief State of the direction starting at one end
+   */
+  struct direction
+  {
+    std::pmr::deque<chunk> in_flight;
+    /// Time the last queued byte leaves the line
+    std::chrono::steady_clock::time_point line_free{};
+    /// Port at the receiving end, null while it is not open
+    emulated_serial* receiver = nullptr;
+    statistics counters{};
+  };
+
+  /**
+   * @brief Current time, real or simulated
+   */
+  [[nodiscard]] std::chrono::steady_clock::time_point now();
+
+  void attach(emulated_serial& p_port, end p_end);
+  void detach(end p_end);
+  void transmit(end p_from, std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Hand over every byte due by p_now, m_mutex must be held
+   *
+   * @return Time the next burst of this direction is due, max() if none
+   */
+  std::chrono::steady_clock::time_point deliver(
+    direction& p_direction,
+    std::chrono::steady_clock::time_point p_now);
+
+  void delivery_thread_function();
+
+  /**
+   * @brief Deliver what is due and schedule the next delivery on the
+   * simulated clock, m_mutex must be held
+   */
+  void schedule_delivery();
+
+  /**
+   * @brief Handler of the delivery scheduled as p_generation
+   */
+  void on_delivery_timer(hal::u64 p_generation);
+
+  std::pmr::polymorphic_allocator<> m_allocator;
+  settings m_settings;
+  std::chrono::nanoseconds m_byte_time;
+
+  /// Guards everything below
+  std::mutex m_mutex;
+  /// Signalled when bytes were queued or the emulator stops
+  std::condition_variable m_work;
+  std::array<direction, 2> m_directions;
+  std::minstd_rand m_faults;
+  std::uniform_real_distribution<float> m_probability{ 0.0f, 1.0f };
+  bool m_stop_thread = false;
+  std::thread m_thread;
+  /// Simulated time, null to use real time and the delivery thread
+  hal::v5::optional_ptr<simulated_clock> m_clock;
+  /// Pending delivery on the simulated clock, 0 if none
+  simulated_clock::timer_id m_delivery_timer = 0;
+  /// Time of the pending delivery, max() if none
+  std::chrono::steady_clock::time_point m_delivery_due =
+    std::chrono::steady_clock::time_point::max();
+  /// Counts scheduled deliveries, so a replaced one that was already
+  /// running does nothing
+  hal::u64 m_delivery_generation = 0;
+};
+
+/**
+ * @brief One end of a link_emulator
+ *
+ * Settings passed to configure() are ignored, the emulator's baud_rate
+ * applies to both directions.
+ */
+class emulated_serial : public hal::v5::serial
+{
+public:
+  struct options
+  {
+    /// Size of the port's receive buffer
+    usize receive_buffer_size = 4096;
+  };
+
+  /**
+   * @brief Open an end of a link_emulator with default options
+   *
+   * @param p_allocator Memory allocator for this object and its buffer
+   * @param p_emulator Link to connect to
+   * @param p_end End of the link this port sits at
+   * @return A strong_ptr to the created emulated_serial instance
+   * @throws hal::device_or_resource_busy if the end is already open
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<emulated_serial> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<link_emulator> p_emulator,
+    link_emulator::end p_end);
+
+  /**
+   * @brief Open an end of a link_emulator
+   *
+   * @param p_allocator Memory allocator for this object and its buffer
+   * @param p_emulator Link to connect to
+   * @param p_end End of the link this port sits at
+   * @param p_options Receive buffer size
+   * @return A strong_ptr to the created emulated_serial instance
+   * @throws hal::argument_out_of_domain if the buffer size is 0
+   * @throws hal::device_or_resource_busy if the end is already open
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<emulated_serial> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<link_emulator> p_emulator,
+    link_emulator::end p_end,
+    options const& p_options);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  emulated_serial(hal::v5::strong_ptr_only_token,
+                  std::pmr::polymorphic_allocator<> p_allocator,
+                  hal::v5::strong_ptr<link_emulator> p_emulator,
+                  link_emulator::end p_end,
+                  options const& p_options);
+
+  /**
+   * @brief Close the end, bytes arriving later are discarded
+   */
+  ~emulated_serial() override;
+
+  // Non-copyable and non-movable
+  emulated_serial(emulated_serial const&) = delete;
+  emulated_serial& operator=(emulated_serial const&) = delete;
+  emulated_serial(emulated_serial&&) = delete;
+  emulated_serial& operator=(emulated_serial&&) = delete;
+
+private:
+  friend class link_emulator;
+
+  void driver_configure(hal::v5::serial::settings const& p_settings) override;
+
+  /**
+   * @brief Queue data on the line, blocking while the transmit buffer is full
+   */
+  void driver_write(std::span<hal::byte const> p_data) override;
+  std::span<hal::byte const> driver_receive_buffer() override;
+  usize driver_cursor() override;
+
+  /**
+   * @brief Append arrived data, the emulator's m_mutex must be held
+   */
+  void publish(std::span<hal::byte const> p_data);
+
+  hal::v5::strong_ptr<link_emulator> m_emulator;
+  link_emulator::end m_end;
+  std::pmr::vector<hal::byte> m_receive_buffer;
+  std::atomic<usize> m_receive_cursor{ 0 };
+};
+}  // namespace hal::mac::inline v1
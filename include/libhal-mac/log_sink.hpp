@@ -0,0 +1,266 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <libhal/pointers.hpp>
+#include <libhal/units.hpp>
+
+#include "console.hpp"
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Asynchronous log output through a console_serial
+ *
+ * Every thread that calls log() gets its own single producer, single consumer
+ * ring, so logging takes no lock and makes no system call: the message is
+ * copied into the ring and published with one atomic store. A background
+ * drainer thread collects the data of all rings and hands it to the console
+ * as one gathered write, so the output costs one system call per drain pass
+ * instead of one per message.
+ *
+ * Memory is bounded by settings::ring_size times settings::max_producers.
+ * When a ring is full, settings::policy decides whether the message is
+ * dropped or the producer waits for the drainer.
+ *
+ * Messages are written whole and each thread's messages keep their order.
+ * Messages of different threads are interleaved in drain order, not in the
+ * order they were logged.
+ *
+ * A ring stays assigned to its thread until the thread exits, after which it
+ * is reused by the next new producer.
+ *
+ * Example:
+ * ```cpp
+ * auto console = hal::mac::console_serial::create(allocator, 32);
+ * auto logger = hal::mac::log_sink::create(allocator, console);
+ * logger->log(hal::as_bytes("motor started\n"sv));
+ * ```
+ */
+class log_sink : public hal::v5::enable_strong_from_this<log_sink>
+{
+public:
+  /**
+   * @brief What log() does when the calling thread's ring is full
+   */
+  enum class overflow_policy : hal::u8
+  {
+    /// Discard the message and count it, the producer never waits
+    drop,
+    /// Wait until the drainer made room, no message is lost
+    block,
+  };
+
+  struct settings
+  {
+    /// Bytes buffered per producer thread, rounded up to a power of two
+    usize ring_size = 16 * 1024;
+    /// Threads that may log at the same time
+    usize max_producers = 32;
+    /// Behavior when a producer's ring is full
+    overflow_policy policy = overflow_policy::drop;
+    /// Longest time logged data waits before the drainer writes it
+    hal::time_duration flush_interval = std::chrono::milliseconds(1);
+  };
+
+  /**
+   * @brief Counters describing the sink's traffic
+   */
+  struct statistics
+  {
+    /// Messages accepted by log()
+    hal::u64 messages;
+    /// Bytes accepted by log()
+    hal::u64 bytes;
+    /// Messages discarded because a ring was full or the message was larger
+    /// than a ring
+    hal::u64 dropped_messages;
+    /// Gathered writes made by the drainer
+    hal::u64 writes;
+  };
+
+  /**
+   * @brief Create a log_sink with default settings
+   *
+   * @param p_allocator Memory allocator for this object and the rings
+   * @param p_output Console the log is written to
+   * @return A strong_ptr to the created log_sink instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<log_sink> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<console_serial> p_output);
+
+  /**
+   * @brief Create a log_sink and start its drainer thread
+   *
+   * @param p_allocator Memory allocator for this object and the rings
+   * @param p_output Console the log is written to
+   * @param p_settings Buffering settings
+   * @return A strong_ptr to the created log_sink instance
+   * @throws hal::argument_out_of_domain if ring_size or max_producers is 0 or
+   * flush_interval is not positive
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<log_sink> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<console_serial> p_output,
+    settings const& p_settings);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  log_sink(hal::v5::strong_ptr_only_token,
+           std::pmr::polymorphic_allocator<> p_allocator,
+           hal::v5::strong_ptr<console_serial> p_output,
+           settings const& p_settings);
+
+  /**
+   * @brief Write everything logged so far and stop the drainer thread
+   *
+   * No thread may be logging.
+   */
+  ~log_sink();
+
+  // Non-copyable and non-movable
+  log_sink(log_sink const&) = delete;
+  log_sink& operator=(log_sink const&) = delete;
+  log_sink(log_sink&&) = delete;
+  log_sink& operator=(log_sink&&) = delete;
+
+  /**
+   * @brief Queue a message for output
+   *
+   * @param p_message Message to write, copied before this returns
+   * @return true if the message was queued, false if it was dropped
+   * @throws hal::resource_unavailable_try_again if max_producers threads
+   * already own a ring
+   */
+  bool log(std::span<hal::byte const> p_message);
+
+  /**
+   * @brief Block until everything logged before this call was written
+   *
+   * @throws hal::io_error if writing to the console failed, the data was
+   * discarded
+   */
+  void flush();
+
+  /**
+   * @brief Get the sink's counters
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics() const;
+
+private:
+  friend class log_sink_thread_cache;
+
+  /**
+   * @brief Ring written by one producer thread and read by the drainer
+   *
+   * Positions count bytes since the ring was created and are masked to index
+   * the data. The producer's and the drainer's positions live on separate
+   * cache lines.
+   */
+  struct producer_ring
+  {
+    alignas(64) std::atomic<hal::u64> head{ 0 };
+    /// Producer's copy of tail, reloaded only when the ring looks full
+    hal::u64 cached_tail = 0;
+    /// Counters, written by the producer only
+    std::atomic<hal::u64> messages{ 0 };
+    std::atomic<hal::u64> bytes{ 0 };
+    std::atomic<hal::u64> dropped{ 0 };
+    alignas(64) std::atomic<hal::u64> tail{ 0 };
+    /// Whether a live thread produces into this ring
+    std::atomic<bool> owned{ false };
+    /// Allocated from the sink's allocator when the ring is first claimed
+    std::span<hal::byte> data;
+  };
+
+  /**
+   * @brief Find or assign the calling thread's ring
+   */
+  producer_ring& ring_for_this_thread();
+
+  /**
+   * @brief Assign a free ring to the calling thread
+   *
+   * @return Index of the ring in m_rings
+   */
+  usize claim_ring();
+
+  /**
+   * @brief Count a dropped message
+   */
+  static void drop(producer_ring& p_ring);
+
+  /**
+   * @brief Start a drain pass early, callable without the lock
+   */
+  void request_drain();
+
+  /**
+   * @brief Block until a drain pass that started after this call completed
+   */
+  void wait_for_drain();
+
+  void drainer_thread_function();
+
+  /**
+   * @brief Write the data queued in all rings
+   */
+  void drain();
+
+  std::pmr::polymorphic_allocator<> m_allocator;
+  hal::v5::strong_ptr<console_serial> m_output;
+  settings m_settings;
+  /// Identifies this sink in thread caches, never reused
+  hal::u64 m_id;
+  /// Ring capacity minus one
+  usize m_mask;
+  /// Fixed size, ring data is allocated when first claimed
+  std::pmr::vector<producer_ring> m_rings;
+  /// Rings with allocated data, published after the data is allocated
+  std::atomic<usize> m_ring_count{ 0 };
+  /// Spans handed to the console by drain(), sized for every ring
+  std::pmr::vector<std::span<hal::byte const>> m_gather;
+  /// Head of each ring when drain() collected its data
+  std::pmr::vector<hal::u64> m_drain_heads;
+  /// Guards claiming rings and the drainer's state
+  mutable std::mutex m_mutex;
+  /// Signalled to start a drain pass early
+  std::condition_variable m_work;
+  /// Signalled after each drain pass
+  std::condition_variable m_progress;
+  hal::u64 m_passes_started = 0;
+  hal::u64 m_passes_completed = 0;
+  /// Set by producers without the lock, cleared when a pass starts
+  std::atomic<bool> m_drain_requested{ false };
+  bool m_stop_thread = false;
+  std::atomic<hal::u64> m_writes{ 0 };
+  /// First write error, reported once by flush()
+  std::exception_ptr m_error = nullptr;
+  std::thread m_thread;
+};
+}  // namespace hal::mac::inline v1
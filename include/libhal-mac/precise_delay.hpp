@@ -0,0 +1,202 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory_resource>
+
+#include <libhal/pointers.hpp>
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+namespace hal::mac::inline v1 {
+class simulated_clock;
+
+/**
+ * @brief Hybrid sleep/spin delay built on top of a steady clock
+ *
+ * `hal::delay(clock, duration)` spins on the clock, which burns an entire core
+ * on a host machine, while `std::this_thread::sleep_for` hands control to the
+ * OS scheduler and typically wakes up 50 to 1000 µs late. This class combines
+ * the two: it sleeps until shortly before the deadline and then spins on the
+ * clock for the remainder.
+ *
+ * The amount of time reserved for spinning is learned at runtime. Every sleep
+ * measures how late the OS woke the thread up and feeds that overshoot into a
+ * running estimate (mean and mean deviation, similar to how TCP estimates
+ * round trip times). The `power_mode` setting decides how much of that
+ * estimate is reserved for spinning.
+ *
+ * Example usage:
+ * ```cpp
+ * auto clock = hal::mac::steady_clock::create(allocator);
+ * auto delay = hal::mac::precise_delay::create(allocator, clock);
+ *
+ * delay->delay(250us);
+ * ```
+ *
+ * When the clock is a simulated_clock, however it was passed in, delays sleep
+ * on simulated time instead and end exactly at their deadline.
+ *
+ * This class is thread safe. Concurrent callers share the overshoot estimate.
+ */
+class precise_delay : public hal::v5::enable_strong_from_this<precise_delay>
+{
+public:
+  /**
+   * @brief Trade off between CPU usage and delay accuracy
+   */
+  enum class power_mode : hal::u8
+  {
+    /**
+     * @brief Never spin
+     *
+     * Sleep until the deadline minus the average overshoot. Delays are
+     * accurate on average but individual delays may end early or late by the
+     * OS's wakeup jitter.
+     */
+    power_saving,
+    /**
+     * @brief Sleep until a typical overshoot before the deadline then spin
+     *
+     * Spins for the average overshoot plus a few deviations. Most delays end
+     * within a few microseconds of the deadline.
+     */
+    balanced,
+    /**
+     * @brief Sleep until the worst observed overshoot then spin
+     *
+     * Reserves enough spin time to cover the largest recent overshoot. Uses the
+     * most CPU but is the least likely to be late.
+     */
+    accuracy,
+  };
+
+  struct settings
+  {
+    /// CPU usage vs accuracy trade off
+    power_mode mode = power_mode::balanced;
+    /// Upper bound on the time spent spinning at the end of a single delay.
+    /// Delays shorter than this are performed entirely by spinning, unless the
+    /// mode is `power_saving`.
+    hal::time_duration max_spin = std::chrono::milliseconds(2);
+  };
+
+  /**
+   * @brief Create a precise delay instance with default settings
+   *
+   * @param p_allocator Memory allocator for this object
+   * @param p_clock Steady clock used to measure time
+   * @return A strong_ptr to the created precise_delay instance
+   * @throws hal::operation_not_supported if the clock reports a frequency of
+   * 0 Hz or below
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<precise_delay> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<hal::steady_clock> p_clock);
+
+  /**
+   * @brief Create a precise delay instance
+   *
+   * @param p_allocator Memory allocator for this object
+   * @param p_clock Steady clock used to measure time
+   * @param p_settings Initial settings
+   * @return A strong_ptr to the created precise_delay instance
+   * @throws hal::operation_not_supported if the clock reports a frequency of
+   * 0 Hz or below
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<precise_delay> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<hal::steady_clock> p_clock,
+    settings const& p_settings);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  precise_delay(hal::v5::strong_ptr_only_token,
+                hal::v5::strong_ptr<hal::steady_clock> p_clock,
+                settings const& p_settings);
+
+  // Non-copyable and non-movable
+  precise_delay(precise_delay const&) = delete;
+  precise_delay& operator=(precise_delay const&) = delete;
+  precise_delay(precise_delay&&) = delete;
+  precise_delay& operator=(precise_delay&&) = delete;
+
+  /**
+   * @brief Change the settings of this delay
+   *
+   * The learned overshoot estimate is kept.
+   *
+   * @param p_settings New settings
+   */
+  void configure(settings const& p_settings);
+
+  /**
+   * @brief Block the calling thread for the given duration
+   *
+   * @param p_duration Amount of time to wait. Durations of zero or below
+   * return immediately.
+   */
+  void delay(hal::time_duration p_duration);
+
+  /**
+   * @brief Block the calling thread until the clock reaches a deadline
+   *
+   * Returns immediately if the deadline has already passed.
+   *
+   * @param p_deadline Deadline in ticks of the clock's uptime()
+   */
+  void delay_until(hal::u64 p_deadline);
+
+  /**
+   * @brief Current estimate of how late the OS wakes up from a sleep
+   *
+   * @return Mean sleep overshoot learned so far
+   */
+  [[nodiscard]] hal::time_duration overshoot_estimate() const;
+
+  /**
+   * @brief Access the clock used by this delay
+   *
+   * Useful for computing deadlines for `delay_until()`.
+   *
+   * @return Reference to the underlying clock
+   */
+  [[nodiscard]] hal::steady_clock& clock();
+
+private:
+  [[nodiscard]] hal::i64 ticks_to_ns(hal::i64 p_ticks) const;
+  [[nodiscard]] hal::i64 ns_to_ticks(hal::i64 p_nanoseconds) const;
+  [[nodiscard]] hal::i64 spin_margin_ns() const;
+  void record_overshoot(hal::i64 p_overshoot_ns);
+
+  hal::v5::strong_ptr<hal::steady_clock> m_clock;
+  /// m_clock when it is simulated, delays then sleep on it. Kept alive by
+  /// m_clock.
+  simulated_clock* m_simulated_clock;
+  /// Clock frequency cached at construction
+  double m_frequency;
+  std::atomic<power_mode> m_mode;
+  std::atomic<hal::i64> m_max_spin_ns;
+  /// Smoothed mean of the sleep overshoot in nanoseconds
+  std::atomic<hal::i64> m_overshoot_mean_ns;
+  /// Smoothed mean deviation of the sleep overshoot in nanoseconds
+  std::atomic<hal::i64> m_overshoot_deviation_ns;
+  /// Largest recent overshoot in nanoseconds, decays over time
+  std::atomic<hal::i64> m_overshoot_peak_ns;
+};
+}  // namespace hal::mac::inline v1
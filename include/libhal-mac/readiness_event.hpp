@@ -0,0 +1,73 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Pollable descriptor that a driver thread makes readable
+ *
+ * Backed by an eventfd on Linux and a non-blocking pipe elsewhere. Only the
+ * first signal() after an acknowledge() makes a system call, so a busy
+ * driver does not pay for a write per chunk of data.
+ */
+class readiness_event
+{
+public:
+  /**
+   * @brief Create the underlying descriptor(s)
+   *
+   * @throws hal::operation_not_permitted if the descriptor cannot be created
+   */
+  readiness_event();
+
+  /**
+   * @brief Close the underlying descriptor(s)
+   */
+  ~readiness_event();
+
+  readiness_event(readiness_event const&) = delete;
+  readiness_event& operator=(readiness_event const&) = delete;
+  readiness_event(readiness_event&&) = delete;
+  readiness_event& operator=(readiness_event&&) = delete;
+
+  /**
+   * @brief Make the descriptor readable. Thread safe.
+   */
+  void signal();
+
+  /**
+   * @brief Make the descriptor unreadable until the next signal()
+   *
+   * Call this before looking at the state the event announces, so that any
+   * change made after that look is signalled again.
+   */
+  void acknowledge();
+
+  /**
+   * @brief Get the descriptor to wait on for readability
+   *
+   * @return Descriptor to pass to poll(), epoll, kqueue, libuv, ...
+   */
+  [[nodiscard]] int native_handle() const;
+
+private:
+  /// eventfd in both entries on Linux, otherwise read and write end of a pipe
+  std::array<int, 2> m_fds{ -1, -1 };
+  std::atomic<bool> m_signaled{ false };
+};
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,146 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+#include <pthread.h>
+
+#include <libhal/functional.hpp>
+#include <libhal/units.hpp>
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Scheduling of a thread started by a driver
+ */
+struct thread_settings
+{
+  /**
+   * @brief Scheduling policy of the thread
+   */
+  enum class policy : hal::u8
+  {
+    /// The OS's default time sharing policy
+    standard,
+    /// Real-time: runs until it blocks or a higher priority thread is ready
+    fifo,
+    /// Real-time: like fifo, but takes turns with threads of equal priority
+    round_robin,
+  };
+
+  policy scheduling = policy::standard;
+  /// Real-time priority for fifo and round_robin, 0 for standard. Linux
+  /// accepts 1 to 99, see sched_get_priority_min() and max().
+  int priority = 0;
+  /// CPUs the thread may run on, bit n for CPU n, 0 for any CPU. Ignored on
+  /// macOS, which has no way to pin a thread to a CPU.
+  hal::u64 cpu_affinity = 0;
+  /// Stack size in bytes, 0 for the system default
+  usize stack_size = 0;
+  /// Name shown by debuggers and tools such as top, at most 15 characters
+  /// are kept
+  std::string_view name{};
+};
+
+/**
+ * @brief Settings of a driver's receive thread
+ */
+struct receive_thread_settings
+{
+  thread_settings thread{};
+  /// Spin on non-blocking reads instead of sleeping until data arrives.
+  /// This saves the wake up latency of the thread at the cost of a full
+  /// CPU, so pin the thread to a CPU of its own with thread.cpu_affinity.
+  bool busy_poll = false;
+};
+
+/**
+ * @brief A thread started with a scheduling policy, CPU affinity, stack
+ * size and name
+ *
+ * Used by drivers for the threads that sit on a latency critical path, such
+ * as the receive thread of hal::mac::serial. The settings are applied
+ * before the thread runs its first instruction, so a real-time thread is
+ * never preempted in its start up and never runs on a CPU it may not use.
+ *
+ * Like std::thread, a scheduled_thread must be joined before it is
+ * destroyed or assigned to.
+ *
+ * Example:
+ * ```cpp
+ * hal::mac::scheduled_thread worker(
+ *   { .scheduling = hal::mac::thread_settings::policy::fifo,
+ *     .priority = 80,
+ *     .cpu_affinity = 1 << 3,
+ *     .name = "motor-control" },
+ *   [&]() { control_loop(); });
+ * ```
+ */
+class scheduled_thread
+{
+public:
+  /**
+   * @brief Create an object that does not represent a thread
+   */
+  scheduled_thread() = default;
+
+  /**
+   * @brief Start a thread running p_function
+   *
+   * @param p_settings Scheduling, CPU affinity, stack size and name
+   * @param p_function Function the thread runs
+   * @throws hal::argument_out_of_domain if the priority is not valid for the
+   * policy, the affinity names no CPU of this system or the stack size is
+   * below the system's minimum
+   * @throws hal::operation_not_permitted if the process may not use the
+   * real-time policy or priority, which usually needs root or CAP_SYS_NICE
+   * @throws hal::resource_unavailable_try_again if the OS cannot create
+   * another thread
+   */
+  scheduled_thread(thread_settings const& p_settings,
+                   hal::callback<void()> p_function);
+
+  /**
+   * @brief Terminates the program if the thread was not joined
+   */
+  ~scheduled_thread();
+
+  scheduled_thread(scheduled_thread const&) = delete;
+  scheduled_thread& operator=(scheduled_thread const&) = delete;
+  scheduled_thread(scheduled_thread&& p_other) noexcept;
+  scheduled_thread& operator=(scheduled_thread&& p_other) noexcept;
+
+  /**
+   * @brief Check whether this object represents a thread not yet joined
+   */
+  [[nodiscard]] bool joinable() const;
+
+  /**
+   * @brief Wait for the thread to finish
+   */
+  void join();
+
+  /**
+   * @brief Get the POSIX handle of the thread
+   *
+   * @return Handle for pthread functions, only valid while joinable()
+   */
+  [[nodiscard]] pthread_t native_handle() const;
+
+private:
+  std::optional<pthread_t> m_handle;
+};
+}  // namespace hal::mac::inline v1
@@ -14,20 +14,107 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <memory_resource>
+#include <mutex>
+#include <optional>
 #include <span>
+#include <string>
 #include <string_view>
 #include <thread>
 #include <vector>
 
 #include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+#include <libhal/input_pin.hpp>
+#include <libhal/interrupt_pin.hpp>
 #include <libhal/output_pin.hpp>
 #include <libhal/pointers.hpp>
 #include <libhal/serial.hpp>
 #include <libhal/units.hpp>
 
+#include "io_reactor.hpp"
+#include "precise_delay.hpp"
+#include "readiness_event.hpp"
+#include "scheduled_thread.hpp"
+
 namespace hal::mac::inline v1 {
+/**
+ * @brief Modem control lines driven by the host
+ */
+enum class modem_out
+{
+  dtr,
+  rts,
+};
+
+/**
+ * @brief Modem status lines driven by the device
+ */
+enum class modem_in
+{
+  /// Data Set Ready
+  dsr,
+  /// Clear To Send
+  cts,
+  /// Data Carrier Detect
+  dcd,
+  /// Ring Indicator
+  ri,
+};
+
+/**
+ * @brief Connection state of a serial port
+ */
+enum class connection_state
+{
+  /// The device is open and usable
+  connected,
+  /// The device hung up or was removed and is being waited for
+  disconnected,
+};
+
+/**
+ * @brief Flow control used to pace data between host and device
+ */
+enum class flow_control
+{
+  /// No flow control, the receiver must keep up with the line rate
+  none,
+  /// RTS/CTS handshake lines, the device deasserts CTS to pause the host
+  hardware,
+  /// XON/XOFF characters sent in band, 0x13 pauses and 0x11 resumes
+  software,
+};
+
+/**
+ * @brief Half-duplex RS-485 direction control
+ */
+struct rs485_settings
+{
+  /// RTS level that enables the line driver, true for asserted
+  bool rts_on_send = true;
+  /// Time the driver is enabled before the first bit is sent
+  hal::time_duration delay_before_send{ 0 };
+  /// Time the driver stays enabled after the last bit was sent
+  hal::time_duration delay_after_send{ 0 };
+};
+
+/**
+ * @brief A change of state observed on a modem status line
+ */
+struct modem_edge
+{
+  /// Line that changed
+  modem_in line;
+  /// New level of the line, true for asserted
+  bool level;
+  /// Time at which the change was observed
+  std::chrono::steady_clock::time_point timestamp;
+};
+
 /**
  * @brief Darwin (macOS) implementation of the serial interface
  *
@@ -64,6 +151,27 @@ namespace hal::mac::inline v1 {
  * auto new_cursor = serial_port->receive_cursor();
  * // Process new data between old_cursor and new_cursor
  * ```
+ *
+ * If the device hangs up or is unplugged, the receive thread notices the
+ * hangup, reports `connection_state::disconnected` and waits for the device
+ * path to reappear (inotify on Linux, kqueue on macOS, with a backoff timer as
+ * a fallback). Once it does, the port is reopened under the same file
+ * descriptor, the last applied settings and modem output states are restored
+ * and `connection_state::connected` is reported. The receive buffer and
+ * cursor are kept across the reconnect. Writes while disconnected throw
+ * `hal::io_error`.
+ *
+ * The receive thread's scheduling policy, priority, CPU affinity, stack size
+ * and name can be set when the port is created. Under load a receive thread
+ * at the default priority may be preempted for milliseconds, a real-time
+ * thread pinned to a CPU other threads avoid sees data within microseconds.
+ * For the lowest latency the thread can busy poll, spinning on non-blocking
+ * reads instead of sleeping until data arrives, at the cost of a full CPU.
+ *
+ * Ports created with an io_reactor do not get a receive thread of their own.
+ * Instead the reactor thread reads from every port that has data, which lets
+ * one thread service hundreds of ports. A receive thread is only started for
+ * the duration of a reconnect.
  */
 class serial
   : public hal::v5::serial
@@ -77,6 +185,38 @@ public:
    * @param p_device_path Path to the serial device (e.g.,
    * "/dev/cu.usbserial-*")
    * @param p_buffer_size Size of the receive buffer in bytes (must be > 0)
+   * @param p_settings Initial line settings
+   * @param p_flow_control Initial flow control, see set_flow_control()
+   * @param p_receive_thread Scheduling of the receive thread and whether it
+   * busy polls
+   * @return A strong_ptr to the created serial instance
+   * @throws hal::argument_out_of_domain if buffer_size is 0, or the receive
+   * thread settings are invalid, see scheduled_thread
+   * @throws hal::no_such_device if the device path doesn't exist
+   * @throws hal::operation_not_permitted if the device cannot be opened, or
+   * the process may not use the receive thread's real-time priority
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<serial> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    std::string_view p_device_path,
+    usize p_buffer_size,
+    hal::v5::serial::settings const& p_settings = {},
+    flow_control p_flow_control = flow_control::none,
+    receive_thread_settings const& p_receive_thread = {});
+
+  /**
+   * @brief Create a serial instance serviced by a shared io_reactor
+   *
+   * Same as the other overload, except that received data is read by the
+   * reactor's thread instead of a receive thread owned by this port.
+   *
+   * @param p_allocator Memory allocator for the receive buffer
+   * @param p_reactor Reactor that services this port's receive path
+   * @param p_device_path Path to the serial device (e.g.,
+   * "/dev/cu.usbserial-*")
+   * @param p_buffer_size Size of the receive buffer in bytes (must be > 0)
+   * @param p_settings Initial line settings
+   * @param p_flow_control Initial flow control, see set_flow_control()
    * @return A strong_ptr to the created serial instance
    * @throws hal::argument_out_of_domain if buffer_size is 0
    * @throws hal::no_such_device if the device path doesn't exist
@@ -84,18 +224,23 @@ public:
    */
   [[nodiscard]] static hal::v5::strong_ptr<serial> create(
     std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<io_reactor> p_reactor,
     std::string_view p_device_path,
     usize p_buffer_size,
-    hal::v5::serial::settings const& p_settings = {});
+    hal::v5::serial::settings const& p_settings = {},
+    flow_control p_flow_control = flow_control::none);
 
   /**
    * @brief Public constructor - but use create() instead
    */
   serial(hal::v5::strong_ptr_only_token,
          std::pmr::polymorphic_allocator<> p_allocator,
+         hal::v5::optional_ptr<io_reactor> p_reactor,
          std::string_view p_device_path,
          usize p_buffer_size,
-         hal::v5::serial::settings const& p_settings);
+         hal::v5::serial::settings const& p_settings,
+         flow_control p_flow_control,
+         receive_thread_settings const& p_receive_thread);
 
   /**
    * @brief Destructor - stops the receive thread and closes the device
@@ -108,9 +253,92 @@ public:
   serial(serial&&) = delete;
   serial& operator=(serial&&) = delete;
 
+  /**
+   * @brief Get the last successfully applied line settings
+   *
+   * @return Settings passed to the last successful configure()
+   */
+  [[nodiscard]] hal::v5::serial::settings get_settings() const;
+
+  /**
+   * @brief Select the flow control used by the device
+   *
+   * Flow control is enforced by the OS serial driver. While the device has
+   * paused the host, write() blocks in poll() until the device resumes, and
+   * write_some() returns 0, which makes async_serial::async_write() wait
+   * for writability on its scheduler. With flow_control::software the
+   * driver also sends XOFF when its own receive buffer fills and consumes
+   * XON/XOFF characters from the received data. The setting is restored
+   * after a reconnect.
+   *
+   * @param p_flow_control Flow control to use
+   * @throws hal::operation_not_permitted if the device rejects the setting,
+   * the previous flow control stays in effect
+   */
+  void set_flow_control(flow_control p_flow_control);
+
+  /**
+   * @brief Get the flow control selected for the device
+   *
+   * @return Last successfully applied flow control
+   */
+  [[nodiscard]] flow_control get_flow_control() const;
+
+  /**
+   * @brief Switch the port to half-duplex RS-485 operation
+   *
+   * RTS drives the transceiver's driver enable. Where the OS serial driver
+   * supports it (TIOCSRS485 on Linux) the kernel toggles RTS around each
+   * transmission. Otherwise every write() becomes a transaction: RTS is
+   * asserted, delay_before_send passes, the data is written, tcdrain() waits
+   * until the last bit left the UART, delay_after_send passes and RTS is
+   * released before write() returns. Concurrent writes are serialized so
+   * transactions never overlap.
+   *
+   * In the software fallback write_some() performs a complete transaction as
+   * well, so it may block for the time it takes to send the data.
+   *
+   * The kernel applies the delays with millisecond resolution and rounds
+   * them up. The software fallback reports the time from the end of
+   * transmission to the release of the bus through get_statistics(). Those
+   * counters are not updated in kernel mode, check rs485_in_kernel() before
+   * reading them. The mode is restored after a reconnect.
+   *
+   * Example, Modbus RTU over an RS-485 adapter:
+   * ```cpp
+   * serial->enable_rs485({ .delay_after_send = 50us }, delay);
+   * serial->write(request);
+   * ```
+   *
+   * @param p_settings Direction control settings
+   * @param p_delay Delay used to time the software fallback. Without one the
+   * thread sleeps, which usually ends tens of microseconds late.
+   * @throws hal::operation_not_permitted if RTS cannot be driven
+   */
+  void enable_rs485(rs485_settings const& p_settings,
+                    hal::v5::optional_ptr<precise_delay> p_delay = nullptr);
+
+  /**
+   * @brief Return the port to full-duplex operation
+   *
+   * Releases the line driver if the software fallback was in use.
+   */
+  void disable_rs485();
+
+  /**
+   * @brief Determine if direction control is performed by the OS driver
+   *
+   * @return true if RS-485 is enabled and the kernel toggles RTS, false if
+   * RS-485 is disabled or the software fallback is in use
+   */
+  [[nodiscard]] bool rs485_in_kernel() const;
+
   /**
    * @brief Set the DTR (Data Terminal Ready) signal state
    *
+   * Performs a single TIOCMBIS/TIOCMBIC ioctl, which only touches the DTR bit,
+   * so concurrent changes to other modem lines cannot be lost.
+   *
    * @param p_state true to assert DTR (set high), false to de-assert (set low)
    * @throws hal::operation_not_permitted if the operation fails
    */
@@ -119,11 +347,34 @@ public:
   /**
    * @brief Set the RTS (Request To Send) signal state
    *
+   * Performs a single TIOCMBIS/TIOCMBIC ioctl, which only touches the RTS bit,
+   * so concurrent changes to other modem lines cannot be lost.
+   *
    * @param p_state true to assert RTS (set high), false to de-assert (set low)
    * @throws hal::operation_not_permitted if the operation fails
    */
   void set_rts(bool p_state);
 
+  /**
+   * @brief Get the last DTR state set through this object
+   *
+   * Reads a cached copy of the output state and does not perform a system
+   * call. The cache is seeded from the device when the port is opened.
+   *
+   * @return true if DTR is asserted
+   */
+  [[nodiscard]] bool get_dtr() const;
+
+  /**
+   * @brief Get the last RTS state set through this object
+   *
+   * Reads a cached copy of the output state and does not perform a system
+   * call. The cache is seeded from the device when the port is opened.
+   *
+   * @return true if RTS is asserted
+   */
+  [[nodiscard]] bool get_rts() const;
+
   /**
    * @brief Get the current state of control signals
    *
@@ -136,6 +387,8 @@ public:
     bool rts;
     bool dsr;  // Data Set Ready (read-only)
     bool cts;  // Clear To Send (read-only)
+    bool dcd;  // Data Carrier Detect (read-only)
+    bool ri;   // Ring Indicator (read-only)
   };
 
   [[nodiscard]] control_signals get_control_signals();
@@ -143,22 +396,460 @@ public:
   /**
    * @brief Set both DTR and RTS in one operation
    *
+   * If both lines are set to the same state this is a single ioctl, otherwise
+   * one ioctl asserts and another de-asserts.
+   *
    * @param p_dtr_state DTR state
    * @param p_rts_state RTS state
    * @throws hal::operation_not_permitted if the operation fails
    */
   void set_control_signals(bool p_dtr_state, bool p_rts_state);
 
+  /**
+   * @brief A single step of a modem control sequence
+   */
+  struct control_step
+  {
+    /// DTR state to apply at the start of this step
+    bool dtr;
+    /// RTS state to apply at the start of this step
+    bool rts;
+    /// Amount of time to hold this state before the next step is applied
+    hal::time_duration hold;
+  };
+
+  /**
+   * @brief Play back a DTR/RTS waveform with precise timing
+   *
+   * Each step is applied with set_control_signals() at an absolute deadline
+   * computed from the start of the sequence, so timing errors do not
+   * accumulate across steps. The sequence runs on a dedicated thread that
+   * requests the highest scheduling priority the OS will grant and the calling
+   * thread blocks until the last step's hold time has elapsed.
+   *
+   * Example, a typical USB-UART reset into application mode:
+   * ```cpp
+   * std::array<hal::mac::serial::control_step, 3> const reset = {{
+   *   { .dtr = true, .rts = true, .hold = 10ms },
+   *   { .dtr = true, .rts = false, .hold = 10ms },
+   *   { .dtr = false, .rts = false, .hold = 50ms },
+   * }};
+   * std::array<hal::u64, 3> applied_at{};
+   * serial->run_control_sequence(*delay, reset, applied_at);
+   * ```
+   *
+   * @param p_delay Delay used to time the steps. Timestamps are in ticks of
+   * its clock.
+   * @param p_steps Steps to apply in order
+   * @param p_timestamps Receives the clock uptime at which each step's modem
+   * lines were actually updated. Must be empty or at least as long as p_steps.
+   * @throws hal::argument_out_of_domain if p_timestamps is non-empty and
+   * shorter than p_steps
+   * @throws hal::operation_not_permitted if a modem line cannot be changed
+   */
+  void run_control_sequence(precise_delay& p_delay,
+                            std::span<control_step const> p_steps,
+                            std::span<hal::u64> p_timestamps);
+
+  /**
+   * @brief Get the level of a modem status line
+   *
+   * While an edge handler is registered the level is read from the state
+   * tracked by the modem watcher thread without a system call. Otherwise this
+   * performs a single TIOCMGET.
+   *
+   * @param p_line Status line to read
+   * @return true if the line is asserted
+   * @throws hal::operation_not_permitted if the operation fails
+   */
+  [[nodiscard]] bool get_modem_input(modem_in p_line);
+
+  /**
+   * @brief Register a handler for edges on a modem status line
+   *
+   * The first registration starts a modem watcher thread that polls TIOCMGET
+   * every millisecond. Where the driver counts line transitions (TIOCGICOUNT
+   * on Linux) a pulse shorter than that is reported as a pair of edges with
+   * the same timestamp. No signal handlers are installed.
+   *
+   * Handlers are called from the watcher thread. Only one handler may be
+   * registered per line; registering a new one replaces the previous one and
+   * passing an empty callback removes it. Handlers must not register or
+   * remove handlers themselves.
+   *
+   * @param p_line Status line to watch
+   * @param p_handler Handler to call with each observed edge
+   */
+  void on_modem_edge(modem_in p_line,
+                     hal::callback<void(modem_edge const&)> p_handler);
+
+  /**
+   * @brief Get the current connection state of the port
+   *
+   * @return connection_state::connected if the device is usable
+   */
+  [[nodiscard]] connection_state get_connection_state() const;
+
+  /**
+   * @brief Register a handler for connection state changes
+   *
+   * The handler is called from the receive thread when the device hangs up and
+   * again once it has been reopened. Passing an empty callback removes the
+   * handler.
+   *
+   * @param p_handler Handler to call with the new state
+   */
+  void on_connection_change(hal::callback<void(connection_state)> p_handler);
+
+  /**
+   * @brief Handler for newly received data
+   *
+   * The data may wrap around the end of the receive buffer, so it is passed
+   * as two spans. p_second is empty unless the data wrapped.
+   */
+  using receive_handler = void(std::span<hal::byte const> p_first,
+                               std::span<hal::byte const> p_second);
+
+  /**
+   * @brief Register a handler called with each chunk of received data
+   *
+   * This emulates a UART receive interrupt. The handler is called from the
+   * receive thread right after new data is published to the receive buffer,
+   * with exactly the bytes received since its previous call. Dispatch does not
+   * allocate and the spans point into the receive buffer, so the handler must
+   * consume the data before returning.
+   *
+   * With a coalescing window the receive thread holds back the handler for up
+   * to p_coalesce after the first undelivered byte arrives, so bursts are
+   * delivered in a single call. Data is delivered early once half the receive
+   * buffer is pending, so it is never overwritten before the handler sees it.
+   *
+   * The handler must not block and must not register handlers itself.
+   * Passing an empty callback removes the handler.
+   *
+   * Example:
+   * ```cpp
+   * serial->on_receive([&](auto p_first, auto p_second) {
+   *   modbus.feed(p_first);
+   *   modbus.feed(p_second);
+   * });
+   * ```
+   *
+   * @param p_handler Handler to call with new data
+   * @param p_coalesce How long to gather data before calling the handler, 0
+   * to call it for every chunk read from the device
+   * @throws hal::operation_not_supported if p_coalesce is non-zero and the
+   * port is serviced by an io_reactor, which has no timers
+   */
+  void on_receive(hal::callback<receive_handler> p_handler,
+                  std::chrono::microseconds p_coalesce = {});
+
+  /**
+   * @brief Counters describing the I/O performed by a port
+   */
+  struct statistics
+  {
+    /// Bytes published to the receive buffer
+    hal::u64 bytes_received;
+    /// Bytes accepted by the device
+    hal::u64 bytes_transmitted;
+    /// read() system calls made by the receive path
+    hal::u64 read_calls;
+    /// write() system calls made by the transmit path
+    hal::u64 write_calls;
+    /// Readiness waits made by this port's receive thread, always 0 for ports
+    /// serviced by an io_reactor, see io_reactor::get_statistics(), and for
+    /// a busy polling receive thread
+    hal::u64 wait_calls;
+    /// Number of times the device was reopened after a hangup
+    hal::u64 reconnects;
+    /// RS-485 write transactions completed by the software fallback. The
+    /// RS-485 counters stay unchanged while the kernel toggles RTS, see
+    /// rs485_in_kernel(), as its turnaround is not observable from user space.
+    hal::u64 rs485_transactions;
+    /// Sum over all software RS-485 transactions of the time from the last bit
+    /// leaving the UART until write() returned with the bus released, in
+    /// nanoseconds
+    hal::u64 rs485_turnaround_total_ns;
+    /// Longest software RS-485 turnaround observed, in nanoseconds
+    hal::u64 rs485_turnaround_max_ns;
+  };
+
+  /**
+   * @brief Get the I/O counters of this port
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics() const;
+
+  /**
+   * @brief Interface for objects notified when received data is published
+   *
+   * Observers are linked into an intrusive list, so attaching one never
+   * allocates.
+   */
+  class receive_observer
+  {
+  public:
+    /**
+     * @brief Called from the receive path after new data was published
+     *
+     * Must not block and must not attach or detach observers. Every call
+     * moves the cursor by less than the size of the receive buffer, so an
+     * observer seeing each call can count how many bytes arrived.
+     *
+     * @param p_cursor New value of the receive cursor
+     */
+    virtual void on_receive(usize p_cursor) = 0;
+
+  protected:
+    receive_observer() = default;
+    ~receive_observer() = default;
+
+  private:
+    friend class serial;
+    receive_observer* m_next_observer = nullptr;
+  };
+
+  /**
+   * @brief Start notifying an observer of received data
+   *
+   * @param p_observer Observer to notify, must be detached before it is
+   * destroyed
+   */
+  void attach_observer(receive_observer& p_observer);
+
+  /**
+   * @brief Stop notifying an observer
+   *
+   * Once this returns the observer is not running and will not be called
+   * again. Does nothing if the observer is not attached.
+   *
+   * @param p_observer Observer to remove
+   */
+  void detach_observer(receive_observer& p_observer);
+
+  using hal::v5::serial::write;
+
+  /**
+   * @brief Write several buffers back to back without concatenating them
+   *
+   * The buffers are handed to the device with writev(), so a message built
+   * from separate header, payload and CRC buffers normally takes a single
+   * system call and no copies. Partial writes are resumed where they ended,
+   * the same as the single buffer write(). In RS-485 mode all buffers form
+   * one transaction.
+   *
+   * Example:
+   * ```cpp
+   * std::array<std::span<hal::byte const>, 3> const frame = {
+   *   header, payload, crc
+   * };
+   * serial->write(frame);
+   * ```
+   *
+   * @param p_buffers Buffers to write in order, empty buffers are skipped
+   * @throws hal::io_error if the device hung up or the write failed
+   */
+  void write(std::span<std::span<hal::byte const> const> p_buffers);
+
+  /**
+   * @brief Write as much data as the device accepts without blocking
+   *
+   * Performs a single non-blocking write(). Used by asynchronous writers that
+   * wait for writability of native_handle() instead of blocking.
+   *
+   * @param p_data Data to write
+   * @return Number of bytes accepted, 0 if the device cannot take more data
+   * right now
+   * @throws hal::io_error if the device hung up or the write failed
+   */
+  [[nodiscard]] usize write_some(std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Get the file descriptor of the device
+   *
+   * The descriptor number stays the same across reconnects. Intended for
+   * readiness polling only, reading from it steals data from the receive
+   * path.
+   *
+   * @return Device file descriptor
+   */
+  [[nodiscard]] int native_handle() const;
+
+  /**
+   * @brief Get a descriptor that becomes readable when the port needs service
+   *
+   * The descriptor becomes readable when new data is published to the receive
+   * buffer, and when the device accepts data again after a write found its
+   * transmit buffer full. Add it to an external event loop (epoll, kqueue,
+   * libuv, ...) to multiplex many ports without polling receive_cursor().
+   * It is an eventfd on Linux and a pipe elsewhere.
+   *
+   * Transmit notifications require the port's own receive thread, ports
+   * serviced by an io_reactor only signal received data.
+   *
+   * Do not read from the descriptor, call acknowledge_readiness() instead.
+   *
+   * @return Descriptor to wait on for readability
+   */
+  [[nodiscard]] int readiness_handle() const;
+
+  /**
+   * @brief Reset the readiness descriptor
+   *
+   * Call this after the descriptor became readable and before checking the
+   * receive cursor or retrying a write, so that later changes signal it again.
+   */
+  void acknowledge_readiness();
+
+  /**
+   * @brief Transfers data from the device in place of the receive path's read
+   *
+   * @param p_fd Device file descriptor, readable
+   * @return Bytes consumed from the device, 0 at end of file or -1 with errno
+   * set, like read()
+   */
+  using receive_bypass = hal::isize(int p_fd);
+
+  /**
+   * @brief Let another component consume the device's received data
+   *
+   * For components that take over the port's data path, such as
+   * serial_bridge. Waiting, hangup detection and reconnects stay with the
+   * receive path, only the read is replaced. Once this returns the previous
+   * bypass is not running.
+   *
+   * @param p_bypass Bypass to install, empty to restore normal reception
+   * @throws hal::operation_not_permitted if another bypass is installed
+   */
+  void set_receive_bypass(hal::callback<receive_bypass> p_bypass);
+
+  /**
+   * @brief Copy data into the receive buffer and publish it
+   *
+   * Only called by a receive bypass, which is the receive path while it is
+   * installed.
+   */
+  void publish_received(std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Whether RS-485 direction control is done in user space
+   *
+   * Writes must then go through write(), which drives RTS around them,
+   * instead of straight to native_handle().
+   */
+  [[nodiscard]] bool rs485_in_software() const;
+
+  /**
+   * @brief Count bytes written straight to native_handle() by a component
+   * that bypasses write()
+   *
+   * @param p_bytes Number of bytes the device accepted
+   */
+  void record_transmitted(usize p_bytes);
+
 private:
+  /**
+   * @brief Publish a new receive cursor to readers, observers and handlers
+   */
+  void publish_cursor(usize p_cursor);
+
   /**
    * @brief Background thread function for reading data
    */
   void receive_thread_function();
 
   /**
-   * @brief Convert libhal settings to termios configuration
+   * @brief Receive thread function that spins on non-blocking reads
+   */
+  void busy_poll_thread_function();
+
+  /**
+   * @brief Read available data from the device into the receive buffer
+   *
+   * Reads straight into the free space after the cursor, so a chunk takes a
+   * single read() and no intermediate copy.
+   *
+   * @return false if the device hung up
+   */
+  [[nodiscard]] bool service_receive();
+
+  /**
+   * @brief Notify every attached observer of a new receive cursor
+   */
+  void notify_observers(usize p_cursor);
+
+  /**
+   * @brief Deliver undelivered data to the receive handler
+   *
+   * Called from the receive path.
+   *
+   * @param p_cursor Current receive cursor
+   * @param p_window_expired true if the coalescing window ended
+   */
+  void dispatch_receive(usize p_cursor, bool p_window_expired);
+
+  /**
+   * @brief Number of bytes that may be written at the receive cursor
+   *
+   * One byte always stays free, as a cursor that went a full lap would look
+   * like no data arrived. With a receive handler, bytes it has not been given
+   * yet are not overwritten either, they are delivered first if the buffer
+   * has no room left.
+   *
+   * @param p_cursor Current receive cursor
+   */
+  [[nodiscard]] usize receive_space(usize p_cursor);
+
+  /**
+   * @brief Register this port's receive path with the io_reactor
+   */
+  void watch_receive();
+
+  /**
+   * @brief Reactor handler, reads data or hands a hangup to a reconnect thread
+   *
+   * @return false to stop the reactor from watching the descriptor
+   */
+  bool on_readable();
+
+  /**
+   * @brief Wait for the device to come back and reopen it
+   *
+   * Called from the receive thread after a hangup. Returns once the device
+   * has been reopened or a stop has been requested.
+   */
+  void reconnect();
+
+  /**
+   * @brief Reconfigure a freshly opened device under the existing descriptor
+   *
+   * @param p_new_fd Newly opened descriptor of the device
+   * @return true if the device is ready for use
    */
-  void apply_termios_settings(hal::v5::serial::settings const& p_settings);
+  [[nodiscard]] bool adopt_reopened_device(int p_new_fd);
+
+  /**
+   * @brief Update the connection state and notify the handler
+   */
+  void set_connection_state(connection_state p_state);
+
+  /**
+   * @brief Background thread function for watching modem status lines
+   */
+  void modem_thread_function();
+
+  /**
+   * @brief Convert libhal settings to termios configuration and apply it
+   *
+   * The caller holds m_settings_mutex.
+   *
+   * @param p_settings Line settings to apply
+   * @param p_flow_control Flow control to apply
+   */
+  void apply_termios_settings(hal::v5::serial::settings const& p_settings,
+                              flow_control p_flow_control);
 
   // Implementation of serial interface
   void driver_configure(hal::v5::serial::settings const& p_settings) override;
@@ -166,31 +857,158 @@ private:
   std::span<hal::byte const> driver_receive_buffer() override;
   usize driver_cursor() override;
 
+  /**
+   * @brief Hand RS-485 direction control to the kernel if it supports it
+   *
+   * @return true if the kernel accepted the settings
+   */
+  [[nodiscard]] bool apply_kernel_rs485(rs485_settings const& p_settings);
+
+  /**
+   * @brief Set the RS-485 driver enable through RTS
+   *
+   * @param p_enabled true to drive the bus
+   */
+  void set_rs485_driver(bool p_enabled);
+
+  /**
+   * @brief Wait for an RS-485 delay with the configured precision
+   */
+  void rs485_wait(hal::time_duration p_duration);
+
+  /**
+   * @brief Write all buffers as one software-controlled RS-485 transaction
+   */
+  void write_rs485_transaction(
+    std::span<std::span<hal::byte const> const> p_buffers);
+
+  /**
+   * @brief Write all buffers, waiting for the device whenever it is busy
+   */
+  void write_all(std::span<std::span<hal::byte const> const> p_buffers);
+
+  /**
+   * @brief Assert and de-assert modem output bits and update the shadow state
+   *
+   * @param p_assert TIOCM_* bits to assert
+   * @param p_deassert TIOCM_* bits to de-assert
+   */
+  void update_modem_outputs(int p_assert, int p_deassert);
+
+  hal::v5::optional_ptr<io_reactor> m_reactor;
+  std::pmr::string m_device_path;
   std::pmr::vector<hal::byte> m_receive_buffer;
   int m_fd = -1;
+  /// Guards m_settings and m_flow_control, which configure(),
+  /// set_flow_control() and the reconnect thread all apply
+  mutable std::mutex m_settings_mutex;
+  /// Last successfully applied settings, restored after a reconnect
+  hal::v5::serial::settings m_settings{};
+  /// Applied by driver_configure() along with m_settings
+  flow_control m_flow_control = flow_control::none;
+  /// Serializes RS-485 transactions and changes to the RS-485 state
+  std::mutex m_rs485_mutex;
+  /// Active RS-485 settings, guarded by m_rs485_mutex
+  std::optional<rs485_settings> m_rs485;
+  /// Times the software fallback, guarded by m_rs485_mutex
+  hal::v5::optional_ptr<precise_delay> m_rs485_delay;
+  /// Set when RS-485 is enabled and the kernel toggles RTS
+  std::atomic<bool> m_rs485_in_kernel{ false };
+  /// Set when RS-485 is enabled and writes toggle RTS themselves
+  std::atomic<bool> m_rs485_in_software{ false };
+  std::atomic<connection_state> m_connection_state{
+    connection_state::connected
+  };
+  /// Guards m_connection_handler
+  std::mutex m_connection_mutex;
+  hal::callback<void(connection_state)> m_connection_handler;
+  /// Serializes modem output ioctls with updates to the shadow state
+  std::mutex m_modem_mutex;
+  /// Shadow copy of the TIOCM_DTR and TIOCM_RTS output bits
+  std::atomic<int> m_modem_outputs{ 0 };
+  /// Guards the modem edge handlers and the start of the watcher thread
+  std::mutex m_modem_handler_mutex;
+  /// Edge handlers indexed by modem_in
+  std::array<hal::callback<void(modem_edge const&)>, 4> m_modem_handlers;
+  /// Modem status bits last observed by the watcher thread
+  std::atomic<int> m_modem_inputs{ 0 };
+  /// True while the watcher thread is tracking m_modem_inputs
+  std::atomic<bool> m_modem_thread_running{ false };
+  std::thread m_modem_thread;
+  std::atomic<hal::u64> m_bytes_received{ 0 };
+  std::atomic<hal::u64> m_bytes_transmitted{ 0 };
+  std::atomic<hal::u64> m_read_calls{ 0 };
+  std::atomic<hal::u64> m_write_calls{ 0 };
+  std::atomic<hal::u64> m_wait_calls{ 0 };
+  std::atomic<hal::u64> m_reconnects{ 0 };
+  std::atomic<hal::u64> m_rs485_transactions{ 0 };
+  std::atomic<hal::u64> m_rs485_turnaround_total_ns{ 0 };
+  std::atomic<hal::u64> m_rs485_turnaround_max_ns{ 0 };
+  readiness_event m_readiness;
+  /// Set when a write found the device's transmit buffer full
+  std::atomic<bool> m_transmit_blocked{ false };
+  /// Serializes the receive path's read with changes to m_receive_bypass
+  std::mutex m_bypass_mutex;
+  hal::callback<receive_bypass> m_receive_bypass;
+  /// Guards the observer list and is held while observers run
+  std::mutex m_observer_mutex;
+  /// Head of the intrusive observer list, read without the lock to skip
+  /// notification when there are no observers
+  std::atomic<receive_observer*> m_observers{ nullptr };
+  /// Guarded by m_observer_mutex
+  hal::callback<receive_handler> m_receive_handler;
+  /// Guarded by m_observer_mutex
+  std::chrono::microseconds m_receive_coalesce{ 0 };
+  /// Receive cursor at the last handler call, guarded by m_observer_mutex
+  usize m_dispatched_cursor = 0;
+  /// Lets the receive path skip dispatch without locking
+  std::atomic<bool> m_has_receive_handler{ false };
+  /// End of the current coalescing window, only used by the receive path
+  std::optional<std::chrono::steady_clock::time_point> m_dispatch_deadline;
   std::atomic<usize> m_receive_cursor{ 0 };
   std::atomic<bool> m_stop_thread{ false };
-  std::thread m_receive_thread;
-};
-
-enum class modem_out
-{
-  dtr,
-  rts,
-};
-
-enum class modem_in
-{
-  dsr,
-  cts,
+  /// Receive thread, or for reactor serviced ports the reconnect thread
+  scheduled_thread m_receive_thread;
 };
 
 hal::v5::strong_ptr<hal::output_pin> acquire_output_pin(
   std::pmr::polymorphic_allocator<> p_allocator,
   hal::v5::strong_ptr<serial> p_manager,
   modem_out p_pin);
+
+/**
+ * @brief Acquire a modem status line as an input pin
+ *
+ * @param p_allocator Memory allocator for the pin
+ * @param p_manager Serial port that owns the line
+ * @param p_pin Status line to read
+ * @return Input pin reading the status line
+ */
+hal::v5::strong_ptr<hal::input_pin> acquire_input_pin(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_manager,
+  modem_in p_pin);
+
+/**
+ * @brief Acquire a modem status line as an interrupt pin
+ *
+ * The pin is driven by serial::on_modem_edge() and therefore occupies the edge
+ * handler slot of its line. Pull resistor settings are ignored as the line
+ * is driven by the device.
+ *
+ * @param p_allocator Memory allocator for the pin
+ * @param p_manager Serial port that owns the line
+ * @param p_pin Status line to watch
+ * @return Interrupt pin triggered by edges of the status line
+ */
+hal::v5::strong_ptr<hal::interrupt_pin> acquire_interrupt_pin(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_manager,
+  modem_in p_pin);
 }  // namespace hal::mac::inline v1
 
 namespace hal {
+using hal::mac::v1::acquire_input_pin;
+using hal::mac::v1::acquire_interrupt_pin;
 using hal::mac::v1::acquire_output_pin;
 }
@@ -0,0 +1,235 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+#include <libhal/pointers.hpp>
+#include <libhal/units.hpp>
+
+#include "serial.hpp"
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Forwards data between a serial port and another file descriptor
+ *
+ * Lets tools that expect a pty, pipe or socket reach a device owned by this
+ * process. Data received from the device goes straight to the peer instead of
+ * into the port's receive buffer, and data read from the peer is written to
+ * the device.
+ *
+ * On Linux the data moves through kernel pipe buffers with splice(), so it
+ * never enters user space. Where splice() is unavailable, or a descriptor
+ * does not support it, the bridge falls back to read() and write() through
+ * an intermediate buffer.
+ *
+ * Received data is forwarded by the port's receive path, so hangups and
+ * reconnects of the device are handled as usual and forwarding resumes once
+ * the device is back. A slow peer holds up the receive path, so bridge ports
+ * with their own receive thread rather than an io_reactor. Data from the
+ * peer is forwarded by a thread owned by the bridge.
+ *
+ * With tee enabled, received data is also published to the port's receive
+ * buffer, observers and receive handler, so local consumers keep working.
+ * This costs one copy to user space. Coalescing windows of the receive
+ * handler do not apply to bridged data.
+ *
+ * A terminal peer, typically the controller side of a pty, stays bridged
+ * when the tool on the other side closes it. Received data is dropped until
+ * a tool opens the terminal again, then forwarding resumes. Any other peer
+ * is disconnected for good once it reaches end of file or fails.
+ *
+ * A write-only peer, such as stdout or the write end of a pipe, only
+ * receives the device's data. Like any writer to pipes and sockets, the
+ * bridge raises SIGPIPE when the peer's reader goes away, so applications
+ * whose peers may disappear should ignore that signal.
+ *
+ * Example, expose a device through a pty:
+ * ```cpp
+ * int const controller = ::posix_openpt(O_RDWR | O_NOCTTY);
+ * auto bridge = hal::mac::serial_bridge::create(allocator, serial, controller);
+ * ```
+ */
+class serial_bridge : public hal::v5::enable_strong_from_this<serial_bridge>
+{
+public:
+  struct settings
+  {
+    /// Also publish received data to the port's receive buffer
+    bool tee = false;
+    /// Largest amount of data moved per transfer
+    usize transfer_size = 16 * 1024;
+  };
+
+  /**
+   * @brief Counters describing the work done by the bridge
+   */
+  struct statistics
+  {
+    /// Bytes forwarded from the device to the peer
+    hal::u64 bytes_to_peer;
+    /// Bytes forwarded from the peer to the device
+    hal::u64 bytes_to_device;
+    /// Transfers made with splice()
+    hal::u64 zero_copy_transfers;
+    /// Transfers made with read() and write()
+    hal::u64 buffered_transfers;
+  };
+
+  /**
+   * @brief Create a bridge with default settings
+   *
+   * @param p_allocator Memory allocator for this object and its buffer
+   * @param p_serial Serial port to forward
+   * @param p_peer Descriptor to forward to and from, not owned by the bridge
+   * @return A strong_ptr to the created serial_bridge instance
+   * @throws hal::operation_not_permitted if the port is already bridged or
+   * the bridge's pipes cannot be created
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<serial_bridge> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial> p_serial,
+    int p_peer);
+
+  /**
+   * @brief Create a bridge
+   *
+   * @param p_allocator Memory allocator for this object and its buffer
+   * @param p_serial Serial port to forward
+   * @param p_peer Descriptor to forward to and from, not owned by the bridge
+   * @param p_settings Bridge settings
+   * @return A strong_ptr to the created serial_bridge instance
+   * @throws hal::argument_out_of_domain if transfer_size is 0
+   * @throws hal::operation_not_permitted if the port is already bridged or
+   * the bridge's pipes cannot be created
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<serial_bridge> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial> p_serial,
+    int p_peer,
+    settings const& p_settings);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  serial_bridge(hal::v5::strong_ptr_only_token,
+                std::pmr::polymorphic_allocator<> p_allocator,
+                hal::v5::strong_ptr<serial> p_serial,
+                int p_peer,
+                settings const& p_settings);
+
+  /**
+   * @brief Stop forwarding and return the port to normal reception
+   */
+  ~serial_bridge();
+
+  // Non-copyable and non-movable
+  serial_bridge(serial_bridge const&) = delete;
+  serial_bridge& operator=(serial_bridge const&) = delete;
+  serial_bridge(serial_bridge&&) = delete;
+  serial_bridge& operator=(serial_bridge&&) = delete;
+
+  /**
+   * @brief Determine if the peer is still connected
+   *
+   * Once the peer reaches end of file or fails, forwarding to it stops and
+   * received data is only published if tee is enabled. A terminal peer is
+   * disconnected only while no tool has its other side open.
+   *
+   * @return true while the peer is usable
+   */
+  [[nodiscard]] bool peer_connected() const;
+
+  /**
+   * @brief Get counters describing the work done by the bridge
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics() const;
+
+private:
+  /**
+   * @brief Receive bypass, forwards whatever the device has to the peer
+   */
+  hal::isize forward_from_device(int p_fd);
+
+  /**
+   * @brief Forwards data from the peer to the device until stopped
+   */
+  void peer_thread_function();
+
+  /**
+   * @brief Forward one chunk from the peer to the device
+   *
+   * @return false if the peer reached end of file or failed
+   */
+  bool forward_from_peer();
+
+  /**
+   * @brief Write all of the data to a descriptor
+   *
+   * @return false if the descriptor failed or the bridge is stopping
+   */
+  bool write_fully(int p_fd, std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Move p_size bytes from a pipe to a descriptor with splice()
+   *
+   * Falls back to copying through p_scratch and clears p_zero_copy if the
+   * descriptor does not support splice(). On failure the rest of the data is
+   * discarded so the pipe is empty for the next transfer.
+   *
+   * @return false if the destination failed
+   */
+  bool drain_pipe(int p_pipe,
+                  int p_fd,
+                  usize p_size,
+                  std::span<hal::byte> p_scratch,
+                  std::atomic<bool>& p_zero_copy);
+
+  hal::v5::strong_ptr<serial> m_serial;
+  int m_peer;
+  settings m_settings;
+  /// Used by the receive path for buffered transfers and tee
+  std::pmr::vector<hal::byte> m_receive_buffer;
+  /// Used by the peer thread for buffered transfers
+  std::pmr::vector<hal::byte> m_transmit_buffer;
+  /// Pipe carrying device data to the peer, unused without splice()
+  std::array<int, 2> m_receive_pipe{ -1, -1 };
+  /// Pipe carrying peer data to the device, unused without splice()
+  std::array<int, 2> m_transmit_pipe{ -1, -1 };
+  /// Pipe receiving a copy of device data for tee, unused without splice()
+  std::array<int, 2> m_tee_pipe{ -1, -1 };
+  /// Pipe used to wake the peer thread for shutdown
+  std::array<int, 2> m_wake_pipe{ -1, -1 };
+  /// Cleared when splice() is rejected by the device or peer
+  std::atomic<bool> m_receive_zero_copy{ false };
+  std::atomic<bool> m_transmit_zero_copy{ false };
+  /// Hangups of a terminal peer are temporary, see peer_thread_function()
+  bool m_peer_is_terminal;
+  std::atomic<bool> m_peer_connected{ true };
+  /// Ends waits for a slow descriptor during destruction
+  std::atomic<bool> m_stop{ false };
+  std::atomic<hal::u64> m_bytes_to_peer{ 0 };
+  std::atomic<hal::u64> m_bytes_to_device{ 0 };
+  std::atomic<hal::u64> m_zero_copy_transfers{ 0 };
+  std::atomic<hal::u64> m_buffered_transfers{ 0 };
+  std::thread m_peer_thread;
+};
+}  // namespace hal::mac::inline v1
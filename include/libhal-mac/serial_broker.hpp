@@ -0,0 +1,269 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <libhal/pointers.hpp>
+#include <libhal/serial.hpp>
+#include <libhal/units.hpp>
+
+#include "serial.hpp"
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Shares one serial port with other processes
+ *
+ * The process that owns a hal::mac::serial creates a broker under a POSIX
+ * shared memory name. Other processes then open a shared_serial with the
+ * same name and get a hal::v5::serial of their own for the port.
+ *
+ * Received data is copied once, from the port's receive buffer into a ring
+ * in the shared memory region, and a 64-bit sequence counter is advanced.
+ * Clients read that ring in place, each with its own cursor, so adding
+ * clients adds no copies and no work on the broker's side.
+ *
+ * Writes of all clients go through a transmit queue in the same region.
+ * Each client write is queued as one or more records, each of which reaches
+ * the port contiguously. A broker thread takes records in submission order
+ * and writes them to the port straight from shared memory.
+ *
+ * The name must begin with a '/', and macOS limits it to 31 characters. It
+ * is removed again when the broker is destroyed. A broker that crashed
+ * leaves the name behind, remove it with `shm_unlink()` before creating a
+ * new broker under the same name.
+ *
+ * Example:
+ * ```cpp
+ * // Owning process
+ * auto port = hal::mac::serial::create(allocator, "/dev/tty.usbserial-1");
+ * auto broker = hal::mac::serial_broker::create(allocator, port, "/board1");
+ *
+ * // Any other process
+ * auto view = hal::mac::shared_serial::create(allocator, "/board1");
+ * view->write(hal::as_bytes("reset\n"sv));
+ * ```
+ */
+class serial_broker
+  : public hal::v5::enable_strong_from_this<serial_broker>
+  , private serial::receive_observer
+{
+public:
+  struct settings
+  {
+    /// Bytes of received data kept in shared memory for clients
+    usize receive_ring_size = 1024 * 1024;
+    /// Bytes of the transmit queue shared by all clients, rounded up to a
+    /// multiple of 8
+    usize transmit_queue_size = 64 * 1024;
+    /// How long the transmit thread sleeps while the queue is empty
+    hal::time_duration transmit_poll_interval = std::chrono::microseconds(100);
+  };
+
+  /**
+   * @brief Counters describing the broker's traffic
+   */
+  struct statistics
+  {
+    /// Received bytes published to clients
+    hal::u64 bytes_published;
+    /// Bytes written to the port on behalf of clients
+    hal::u64 bytes_transmitted;
+    /// Transmit records written to the port
+    hal::u64 transmit_records;
+    /// Transmit records discarded because writing to the port failed
+    hal::u64 transmit_errors;
+  };
+
+  /**
+   * @brief Create a serial_broker with default settings
+   *
+   * @param p_allocator Memory allocator for this object
+   * @param p_serial Serial port to share
+   * @param p_name POSIX shared memory name, such as "/board1"
+   * @return A strong_ptr to the created serial_broker instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<serial_broker> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial> p_serial,
+    std::string_view p_name);
+
+  /**
+   * @brief Create the shared memory region and start publishing
+   *
+   * Publishing starts with the data the port receives next.
+   *
+   * @param p_allocator Memory allocator for this object
+   * @param p_serial Serial port to share
+   * @param p_name POSIX shared memory name, such as "/board1"
+   * @param p_settings Region sizes
+   * @return A strong_ptr to the created serial_broker instance
+   * @throws hal::argument_out_of_domain if the name does not begin with '/'
+   * or a size is 0
+   * @throws hal::device_or_resource_busy if the name is already in use
+   * @throws hal::operation_not_permitted if the region cannot be created
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<serial_broker> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial> p_serial,
+    std::string_view p_name,
+    settings const& p_settings);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  serial_broker(hal::v5::strong_ptr_only_token,
+                std::pmr::polymorphic_allocator<> p_allocator,
+                hal::v5::strong_ptr<serial> p_serial,
+                std::string_view p_name,
+                settings const& p_settings);
+
+  /**
+   * @brief Stop publishing and remove the shared memory name
+   *
+   * Clients keep their mapping and the data received so far, their writes
+   * fail from now on.
+   */
+  ~serial_broker();
+
+  // Non-copyable and non-movable
+  serial_broker(serial_broker const&) = delete;
+  serial_broker& operator=(serial_broker const&) = delete;
+  serial_broker(serial_broker&&) = delete;
+  serial_broker& operator=(serial_broker&&) = delete;
+
+  /**
+   * @brief Get the shared memory name clients open
+   */
+  [[nodiscard]] std::string_view name() const;
+
+  /**
+   * @brief Get the broker's counters
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics() const;
+
+private:
+  void on_receive(usize p_cursor) override;
+
+  void transmit_thread_function();
+
+  hal::v5::strong_ptr<serial> m_serial;
+  std::pmr::string m_name;
+  settings m_settings;
+  int m_fd = -1;
+  /// Whole shared memory region
+  std::span<hal::byte> m_region;
+  /// Port's received byte count up to which data was published
+  hal::u64 m_bytes_seen = 0;
+  std::atomic<hal::u64> m_bytes_transmitted{ 0 };
+  std::atomic<hal::u64> m_transmit_records{ 0 };
+  std::atomic<hal::u64> m_transmit_errors{ 0 };
+  std::atomic<bool> m_stop_thread{ false };
+  std::thread m_transmit_thread;
+};
+
+/**
+ * @brief Serial port view of a port shared by a serial_broker
+ *
+ * The receive buffer is the broker's shared ring, mapped read-only, so
+ * receive_buffer() and receive_cursor() behave as for any other serial port
+ * without copying. The ring is written by the broker's process, so data is
+ * overwritten when this view falls more than a ring size behind.
+ * receive_sequence() counts every byte ever received and lets readers detect
+ * that.
+ *
+ * Writes are queued for the broker and this view waits only while the
+ * shared transmit queue is full. Port settings belong to the broker's
+ * process and cannot be changed through a view.
+ */
+class shared_serial : public hal::v5::serial
+{
+public:
+  /**
+   * @brief Attach to a serial_broker
+   *
+   * @param p_allocator Memory allocator for this object
+   * @param p_name Shared memory name the broker was created with
+   * @return A strong_ptr to the created shared_serial instance
+   * @throws hal::no_such_device if no broker uses the name
+   * @throws hal::operation_not_supported if the region was not created by a
+   * compatible serial_broker
+   * @throws hal::operation_not_permitted if the region cannot be mapped
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<shared_serial> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    std::string_view p_name);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  shared_serial(hal::v5::strong_ptr_only_token, std::string_view p_name);
+
+  ~shared_serial() override;
+
+  // Non-copyable and non-movable
+  shared_serial(shared_serial const&) = delete;
+  shared_serial& operator=(shared_serial const&) = delete;
+  shared_serial(shared_serial&&) = delete;
+  shared_serial& operator=(shared_serial&&) = delete;
+
+  /**
+   * @brief Get the number of bytes the broker received since it was created
+   *
+   * The receive cursor is this value modulo the receive buffer size.
+   */
+  [[nodiscard]] hal::u64 receive_sequence() const;
+
+  /**
+   * @brief Check whether the broker still serves this view
+   *
+   * @return false once the broker was destroyed
+   */
+  [[nodiscard]] bool broker_connected() const;
+
+private:
+  /**
+   * @throws hal::operation_not_supported always, the broker's process owns
+   * the port settings
+   */
+  void driver_configure(hal::v5::serial::settings const& p_settings) override;
+
+  /**
+   * @throws hal::io_error if the broker was destroyed
+   */
+  void driver_write(std::span<hal::byte const> p_data) override;
+  std::span<hal::byte const> driver_receive_buffer() override;
+  usize driver_cursor() override;
+
+  /**
+   * @brief Queue one record, waiting while the queue is full
+   */
+  void submit(std::span<hal::byte const> p_data);
+
+  int m_fd = -1;
+  /// Header and transmit queue, mapped read-write
+  std::span<hal::byte> m_control;
+  /// Receive ring, mapped read-only
+  std::span<hal::byte const> m_receive_ring;
+};
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,341 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <libhal/pointers.hpp>
+#include <libhal/serial.hpp>
+#include <libhal/units.hpp>
+
+namespace hal::mac::inline v1 {
+class mux_channel;
+
+/**
+ * @brief Carries several logical channels over one serial link
+ *
+ * Every write to a channel is sent as one or more frames. Each frame starts
+ * with a 5 byte header:
+ *
+ * | Byte | Content                                               |
+ * |------|-------------------------------------------------------|
+ * | 0    | 0xA5, marks the start of a frame                      |
+ * | 1    | Channel id                                            |
+ * | 2, 3 | Payload length, little endian                         |
+ * | 4    | Header check, byte 1 ^ byte 2 ^ byte 3 ^ 0x5A         |
+ *
+ * The header check lets the receiver find frame boundaries again after
+ * noise or a lost byte. Payloads are not checked, protocols that need
+ * integrity carry their own CRC.
+ *
+ * Received data is demultiplexed whenever a channel's receive cursor is
+ * read, or when service() is called. Frame headers are parsed in place in
+ * the link's receive buffer and payloads are copied from there straight into
+ * the receive buffer of their channel, without an intermediate frame buffer.
+ * Demultiplexing must keep up with the link: data the link overwrites before
+ * it was demultiplexed is lost, so read a channel or call service() at least
+ * once per link receive buffer of traffic.
+ *
+ * Writes are scheduled frame by frame with smooth weighted round robin. A
+ * channel with weight 3 gets three frames onto the link for every frame of a
+ * channel with weight 1 while both are writing, so a large telemetry write
+ * cannot hold back the console for more than a few frames. There is no
+ * writer thread: the thread that finds the link idle sends frames for all
+ * waiting channels until its own write is complete.
+ *
+ * Example:
+ * ```cpp
+ * auto mux = hal::mac::serial_mux::create(allocator, uart);
+ * auto console = hal::mac::mux_channel::create(allocator, mux, 0);
+ * auto telemetry = hal::mac::mux_channel::create(
+ *   allocator, mux, 1, { .receive_buffer_size = 4096, .weight = 1 });
+ * console->write(hal::as_bytes("help\n"sv));
+ * ```
+ */
+class serial_mux : public hal::v5::enable_strong_from_this<serial_mux>
+{
+public:
+  struct settings
+  {
+    /// Largest payload of a single transmitted frame, at most 65535
+    usize max_payload = 256;
+  };
+
+  /**
+   * @brief Counters describing the link's framing
+   */
+  struct statistics
+  {
+    /// Headers that failed their check, each causes a resynchronization
+    hal::u64 header_errors;
+    /// Bytes skipped while looking for the start of a frame
+    hal::u64 discarded_bytes;
+    /// Frames received for channels that are not open
+    hal::u64 unrouted_frames;
+  };
+
+  /**
+   * @brief Create a serial_mux with default settings
+   *
+   * @param p_allocator Memory allocator for this object and its channels
+   * @param p_link Serial port carrying the frames
+   * @return A strong_ptr to the created serial_mux instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<serial_mux> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<hal::v5::serial> p_link);
+
+  /**
+   * @brief Create a serial_mux
+   *
+   * Demultiplexing starts at the link's current receive cursor.
+   *
+   * @param p_allocator Memory allocator for this object and its channels
+   * @param p_link Serial port carrying the frames
+   * @param p_settings Framing settings
+   * @return A strong_ptr to the created serial_mux instance
+   * @throws hal::argument_out_of_domain if max_payload is 0 or above 65535
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<serial_mux> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<hal::v5::serial> p_link,
+    settings const& p_settings);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  serial_mux(hal::v5::strong_ptr_only_token,
+             std::pmr::polymorphic_allocator<> p_allocator,
+             hal::v5::strong_ptr<hal::v5::serial> p_link,
+             settings const& p_settings);
+
+  // Non-copyable and non-movable
+  serial_mux(serial_mux const&) = delete;
+  serial_mux& operator=(serial_mux const&) = delete;
+  serial_mux(serial_mux&&) = delete;
+  serial_mux& operator=(serial_mux&&) = delete;
+
+  /**
+   * @brief Demultiplex the data the link received since the last call
+   */
+  void service();
+
+  /**
+   * @brief Get the framing counters
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics() const;
+
+private:
+  friend class mux_channel;
+
+  void attach(mux_channel& p_channel);
+  void detach(mux_channel& p_channel);
+
+  /**
+   * @brief Parse link data, m_receive_mutex must be held
+   */
+  void demultiplex(std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Send a channel's data, sending other channels' frames meanwhile
+   */
+  void transmit(mux_channel& p_channel, std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Send frames until p_own was sent, m_transmit_mutex must be held
+   */
+  void run_transmitter(std::unique_lock<std::mutex>& p_lock,
+                       mux_channel& p_own);
+
+  /**
+   * @brief Pick the channel that sends the next frame
+   *
+   * m_transmit_mutex must be held and at least one channel must be waiting.
+   */
+  mux_channel& next_channel();
+
+  std::pmr::polymorphic_allocator<> m_allocator;
+  hal::v5::strong_ptr<hal::v5::serial> m_link;
+  settings m_settings;
+
+  /// Guards the channel table and the parser state
+  std::mutex m_receive_mutex;
+  std::array<mux_channel*, 256> m_channels{};
+  /// Link receive cursor up to which data was parsed
+  usize m_link_cursor = 0;
+  std::array<hal::byte, 5> m_header{};
+  usize m_header_size = 0;
+  usize m_payload_remaining = 0;
+  /// Channel the current payload belongs to, null to discard it
+  mux_channel* m_payload_channel = nullptr;
+  std::atomic<hal::u64> m_header_errors{ 0 };
+  std::atomic<hal::u64> m_discarded_bytes{ 0 };
+  std::atomic<hal::u64> m_unrouted_frames{ 0 };
+
+  /// Guards the transmit state of all channels
+  std::mutex m_transmit_mutex;
+  /// Signalled when a channel's write completed or the link became idle
+  std::condition_variable m_transmit_done;
+  /// Open channels, in the order they were opened
+  std::pmr::vector<mux_channel*> m_transmit_channels;
+  /// Whether a thread is sending frames
+  bool m_transmitting = false;
+  /// Header and payload of the frame being sent, used by the sending thread
+  std::pmr::vector<hal::byte> m_frame;
+};
+
+/**
+ * @brief One logical channel of a serial_mux
+ *
+ * Behaves like any other serial port: received data appears in its own
+ * receive buffer and writes are framed for this channel. Settings passed to
+ * configure() are ignored, the link's settings apply to all channels.
+ */
+class mux_channel : public hal::v5::serial
+{
+public:
+  struct options
+  {
+    /// Size of the channel's receive buffer
+    usize receive_buffer_size = 1024;
+    /// Share of the link while several channels are writing
+    hal::u16 weight = 1;
+  };
+
+  /**
+   * @brief Counters describing a channel's traffic
+   */
+  struct statistics
+  {
+    hal::u64 frames_sent;
+    /// Payload bytes sent
+    hal::u64 bytes_sent;
+    hal::u64 frames_received;
+    /// Payload bytes received
+    hal::u64 bytes_received;
+  };
+
+  /**
+   * @brief Open a channel with default options
+   *
+   * @param p_allocator Memory allocator for this object and its buffer
+   * @param p_mux Multiplexer to open the channel on
+   * @param p_id Channel id, the same on both ends of the link
+   * @return A strong_ptr to the created mux_channel instance
+   * @throws hal::device_or_resource_busy if the channel is already open
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<mux_channel> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial_mux> p_mux,
+    hal::u8 p_id);
+
+  /**
+   * @brief Open a channel
+   *
+   * @param p_allocator Memory allocator for this object and its buffer
+   * @param p_mux Multiplexer to open the channel on
+   * @param p_id Channel id, the same on both ends of the link
+   * @param p_options Buffer size and transmit weight
+   * @return A strong_ptr to the created mux_channel instance
+   * @throws hal::argument_out_of_domain if the buffer size or weight is 0
+   * @throws hal::device_or_resource_busy if the channel is already open
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<mux_channel> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial_mux> p_mux,
+    hal::u8 p_id,
+    options const& p_options);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  mux_channel(hal::v5::strong_ptr_only_token,
+              std::pmr::polymorphic_allocator<> p_allocator,
+              hal::v5::strong_ptr<serial_mux> p_mux,
+              hal::u8 p_id,
+              options const& p_options);
+
+  /**
+   * @brief Close the channel, later frames for it are discarded
+   */
+  ~mux_channel() override;
+
+  // Non-copyable and non-movable
+  mux_channel(mux_channel const&) = delete;
+  mux_channel& operator=(mux_channel const&) = delete;
+  mux_channel(mux_channel&&) = delete;
+  mux_channel& operator=(mux_channel&&) = delete;
+
+  /**
+   * @brief Get the channel id
+   */
+  [[nodiscard]] hal::u8 id() const
+  {
+    return m_id;
+  }
+
+  /**
+   * @brief Get the channel's counters
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics() const;
+
+private:
+  friend class serial_mux;
+
+  void driver_configure(hal::v5::serial::settings const& p_settings) override;
+
+  /**
+   * @throws hal::io_error or the link's exception if a frame could not be
+   * written
+   */
+  void driver_write(std::span<hal::byte const> p_data) override;
+  std::span<hal::byte const> driver_receive_buffer() override;
+  usize driver_cursor() override;
+
+  /**
+   * @brief Append payload data, the mux's m_receive_mutex must be held
+   */
+  void publish(std::span<hal::byte const> p_data);
+
+  hal::v5::strong_ptr<serial_mux> m_mux;
+  hal::u8 m_id;
+  hal::u16 m_weight;
+  std::pmr::vector<hal::byte> m_receive_buffer;
+  std::atomic<usize> m_receive_cursor{ 0 };
+
+  /// Data of the write in progress, guarded by the mux's m_transmit_mutex
+  std::span<hal::byte const> m_pending;
+  /// Error of the write in progress, guarded by the mux's m_transmit_mutex
+  std::exception_ptr m_transmit_error = nullptr;
+  /// Smooth weighted round robin credit, guarded by m_transmit_mutex
+  hal::i32 m_credit = 0;
+
+  std::atomic<hal::u64> m_frames_sent{ 0 };
+  std::atomic<hal::u64> m_bytes_sent{ 0 };
+  std::atomic<hal::u64> m_frames_received{ 0 };
+  std::atomic<hal::u64> m_bytes_received{ 0 };
+};
+}  // namespace hal::mac::inline v1
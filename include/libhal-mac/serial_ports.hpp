@@ -0,0 +1,168 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libhal/functional.hpp>
+#include <libhal/pointers.hpp>
+#include <libhal/serial.hpp>
+#include <libhal/units.hpp>
+
+#include "serial.hpp"
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Description of a serial port present on the system
+ */
+struct serial_port_info
+{
+  /// Path to open with serial::create(), e.g. "/dev/cu.usbserial-A50285BI"
+  std::pmr::string path{};
+  /// USB vendor ID, 0 if the port is not a USB device
+  hal::u16 vendor_id = 0;
+  /// USB product ID, 0 if the port is not a USB device
+  hal::u16 product_id = 0;
+  /// USB serial number string, empty if unavailable
+  std::pmr::string serial_number{};
+  /// USB manufacturer string, empty if unavailable
+  std::pmr::string manufacturer{};
+  /// USB product string, empty if unavailable
+  std::pmr::string product{};
+};
+
+/**
+ * @brief List the serial ports currently present on the system
+ *
+ * On macOS ports are discovered through IOKit and the callout device
+ * (/dev/cu.*) is reported, as opening it does not block waiting for carrier
+ * detect. USB metadata is read from the port's USB device in the IORegistry.
+ *
+ * On Linux ports are discovered through /sys/class/tty. Placeholder legacy
+ * ports without hardware behind them are skipped, and USB metadata is read
+ * from the port's USB device in sysfs.
+ *
+ * @param p_allocator Allocator for the returned vector and its strings
+ * @return Ports sorted by path
+ */
+[[nodiscard]] std::pmr::vector<serial_port_info> enumerate_serial_ports(
+  std::pmr::polymorphic_allocator<> p_allocator);
+
+/**
+ * @brief Open many serial ports at once
+ *
+ * Opening and configuring a USB serial port can take tens of milliseconds, so
+ * the ports are opened in parallel by a small pool of threads. The
+ * allocator's memory resource must be thread safe, such as
+ * std::pmr::new_delete_resource() or a std::pmr::synchronized_pool_resource.
+ *
+ * Example, open every FTDI adapter on the system:
+ * ```cpp
+ * auto ports = hal::mac::enumerate_serial_ports(allocator);
+ * std::erase_if(ports, [](auto const& p_port) {
+ *   return p_port.vendor_id != 0x0403;
+ * });
+ * auto serials = hal::mac::open_serial_ports(allocator, ports, 4096);
+ * ```
+ *
+ * @param p_allocator Memory allocator for the serial objects and result
+ * @param p_ports Ports to open
+ * @param p_buffer_size Receive buffer size of each port
+ * @param p_settings Settings applied to each port
+ * @return One entry per port in p_ports, in the same order. Ports that could
+ * not be opened are left empty.
+ */
+[[nodiscard]] std::pmr::vector<hal::v5::optional_ptr<serial>>
+open_serial_ports(std::pmr::polymorphic_allocator<> p_allocator,
+                  std::span<serial_port_info const> p_ports,
+                  usize p_buffer_size,
+                  hal::v5::serial::settings const& p_settings = {});
+
+/**
+ * @brief Event driven notification of serial ports being added and removed
+ *
+ * A background thread waits for device notifications (IOKit matching
+ * notifications on macOS, inotify on /dev on Linux) and calls the handler
+ * for each port that appeared or disappeared since the last notification.
+ * Ports that already exist when the watcher is created are reported as
+ * added. No polling takes place on macOS and Linux.
+ *
+ * The handler is called from the watcher thread.
+ */
+class serial_port_watcher
+  : public hal::v5::enable_strong_from_this<serial_port_watcher>
+{
+public:
+  enum class event : hal::u8
+  {
+    added,
+    removed,
+  };
+
+  using handler = void(event p_event, serial_port_info const& p_port);
+
+  /**
+   * @brief Create a serial port watcher
+   *
+   * @param p_allocator Memory allocator for this object and its port list
+   * @param p_handler Handler called for every added or removed port
+   * @return A strong_ptr to the created serial_port_watcher instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<serial_port_watcher> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::callback<handler> p_handler);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  serial_port_watcher(hal::v5::strong_ptr_only_token,
+                      std::pmr::polymorphic_allocator<> p_allocator,
+                      hal::callback<handler> p_handler);
+
+  /**
+   * @brief Stops the watcher thread
+   */
+  ~serial_port_watcher();
+
+  // Non-copyable and non-movable
+  serial_port_watcher(serial_port_watcher const&) = delete;
+  serial_port_watcher& operator=(serial_port_watcher const&) = delete;
+  serial_port_watcher(serial_port_watcher&&) = delete;
+  serial_port_watcher& operator=(serial_port_watcher&&) = delete;
+
+private:
+  /**
+   * @brief Background thread waiting for device notifications
+   */
+  void watch_thread_function();
+
+  /**
+   * @brief Enumerate ports and report differences with the last enumeration
+   */
+  void rescan();
+
+  std::pmr::polymorphic_allocator<> m_allocator;
+  hal::callback<handler> m_handler;
+  /// Ports reported by the last rescan, sorted by path
+  std::pmr::vector<serial_port_info> m_known_ports;
+  std::atomic<bool> m_stop_thread{ false };
+  std::thread m_watch_thread;
+};
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,447 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <libhal/pointers.hpp>
+#include <libhal/serial.hpp>
+#include <libhal/units.hpp>
+
+#include "readiness_event.hpp"
+#include "serial.hpp"
+
+namespace hal::mac::inline v1 {
+namespace detail {
+/**
+ * @brief Telnet parser and option state of one end of a connection
+ */
+struct telnet_session
+{
+  /// Bytes of a subnegotiation collected so far
+  std::array<hal::byte, 16> subnegotiation{};
+  usize subnegotiation_size = 0;
+  /// Parser state, see serial_server.cpp
+  hal::u8 state = 0;
+  /// Negotiation command being parsed
+  hal::byte verb = 0;
+  /// Options this end agreed to perform
+  std::array<bool, 256> local_enabled{};
+  /// Options the peer agreed to perform
+  std::array<bool, 256> remote_enabled{};
+};
+}  // namespace detail
+
+/**
+ * @brief Serves a serial port to a TCP client
+ *
+ * Replaces running ser2net next to the application: the port stays owned
+ * by this process and one network client at a time gets its data stream.
+ * Further connections are refused while a client is connected.
+ *
+ * With RFC 2217 enabled the stream is a Telnet connection and the client can
+ * change the baud rate, parity and stop bits, and drive DTR and RTS, the
+ * same as with ser2net's telnet mode. Tools such as pyserial's `rfc2217://`
+ * URLs and network_serial connect to it. Without it the connection carries
+ * raw data only.
+ *
+ * Received data is sent in batches of up to batch_size bytes, optionally
+ * held for batch_delay to fill them. Buffering is bounded: data is read from
+ * the port's receive buffer when the socket accepts more, and data a slow
+ * client lets the port overwrite is counted as dropped instead of queued.
+ * Data from the client is written to the port as it arrives, one write per
+ * read from the socket.
+ *
+ * Example:
+ * ```cpp
+ * auto port = hal::mac::serial::create(allocator, "/dev/tty.usbserial-1");
+ * auto server = hal::mac::serial_server::create(
+ *   allocator, port, { .bind_address = "0.0.0.0", .port = 4000 });
+ * ```
+ */
+class serial_server
+  : public hal::v5::enable_strong_from_this<serial_server>
+  , private serial::receive_observer
+{
+public:
+  struct settings
+  {
+    /// IPv4 address to listen on, "0.0.0.0" for every interface
+    std::string_view bind_address = "127.0.0.1";
+    /// TCP port to listen on, 0 picks a free one, see port()
+    hal::u16 port = 0;
+    /// Accept RFC 2217 port control, otherwise forward raw data only
+    bool rfc2217 = true;
+    /// Send small batches immediately instead of waiting for more data
+    bool no_delay = true;
+    /// Largest amount of port data sent in one batch
+    usize batch_size = 4096;
+    /// How long received data may wait for more data to join its batch
+    hal::time_duration batch_delay{ 0 };
+    /// Kernel send and receive buffer size of the client socket, 0 keeps the
+    /// system default
+    usize socket_buffer_size = 64 * 1024;
+  };
+
+  /**
+   * @brief Counters describing the server's traffic
+   */
+  struct statistics
+  {
+    /// Clients accepted
+    hal::u64 connections;
+    /// Clients refused because another client was connected
+    hal::u64 rejected_connections;
+    /// Port data sent to clients
+    hal::u64 bytes_to_network;
+    /// Client data written to the port
+    hal::u64 bytes_to_port;
+    /// Port data overwritten before a slow client accepted it
+    hal::u64 dropped_bytes;
+    /// RFC 2217 commands handled
+    hal::u64 control_commands;
+  };
+
+  /**
+   * @brief Create a serial_server with default settings
+   *
+   * @param p_allocator Memory allocator for this object
+   * @param p_serial Serial port to serve
+   * @return A strong_ptr to the created serial_server instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<serial_server> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial> p_serial);
+
+  /**
+   * @brief Start listening for clients
+   *
+   * @param p_allocator Memory allocator for this object
+   * @param p_serial Serial port to serve
+   * @param p_settings Listening address and batching settings
+   * @return A strong_ptr to the created serial_server instance
+   * @throws hal::argument_out_of_domain if the address is not an IPv4
+   * address or batch_size is 0
+   * @throws hal::device_or_resource_busy if the TCP port is in use
+   * @throws hal::operation_not_permitted if the socket cannot be created
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<serial_server> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial> p_serial,
+    settings const& p_settings);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  serial_server(hal::v5::strong_ptr_only_token,
+                std::pmr::polymorphic_allocator<> p_allocator,
+                hal::v5::strong_ptr<serial> p_serial,
+                settings const& p_settings);
+
+  /**
+   * @brief Disconnect the client and stop listening
+   */
+  ~serial_server();
+
+  // Non-copyable and non-movable
+  serial_server(serial_server const&) = delete;
+  serial_server& operator=(serial_server const&) = delete;
+  serial_server(serial_server&&) = delete;
+  serial_server& operator=(serial_server&&) = delete;
+
+  /**
+   * @brief Get the TCP port the server listens on
+   */
+  [[nodiscard]] hal::u16 port() const;
+
+  /**
+   * @brief Check whether a client is connected
+   */
+  [[nodiscard]] bool client_connected() const;
+
+  /**
+   * @brief Get the server's counters
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics() const;
+
+private:
+  void on_receive(usize p_cursor) override;
+
+  void server_thread_function();
+  void accept_client();
+  void disconnect_client();
+
+  /**
+   * @brief Read from the client and write its data to the port
+   *
+   * @return false if the client disconnected
+   */
+  bool receive_from_client();
+
+  /**
+   * @brief Move port data into the send buffer, escaping it for Telnet
+   *
+   * @return Time until the current batch is due, zero if it is ready
+   */
+  hal::time_duration fill_batch();
+
+  /**
+   * @brief Send as much of the send buffer as the socket accepts
+   *
+   * @return false if the client disconnected
+   */
+  bool send_to_client();
+
+  void negotiate(hal::byte p_verb, hal::byte p_option);
+  void handle_command(std::span<hal::byte const> p_command);
+  void reply(hal::byte p_command, std::span<hal::byte const> p_value);
+
+  hal::v5::strong_ptr<serial> m_serial;
+  settings m_settings;
+  int m_listen_fd = -1;
+  int m_client_fd = -1;
+  hal::u16 m_port = 0;
+  /// Signalled for received port data and to stop the server thread
+  readiness_event m_wake;
+  std::atomic<bool> m_stop_thread{ false };
+  std::atomic<bool> m_client_connected{ false };
+
+  /// Guards the port position reported by on_receive()
+  std::mutex m_port_mutex;
+  usize m_port_cursor = 0;
+  hal::u64 m_port_received = 0;
+  /// Port's received byte count up to which data was batched
+  hal::u64 m_bytes_seen = 0;
+  /// When the oldest data not yet sent was noticed
+  std::chrono::steady_clock::time_point m_batch_start{};
+  bool m_batch_pending = false;
+
+  /// Escaped data and replies waiting for the socket
+  std::pmr::vector<hal::byte> m_send_buffer;
+  usize m_send_offset = 0;
+  /// Data read from the socket
+  std::pmr::vector<hal::byte> m_receive_chunk;
+  /// Client data for the port, without Telnet commands
+  std::pmr::vector<hal::byte> m_port_data;
+  detail::telnet_session m_telnet;
+
+  std::atomic<hal::u64> m_connections{ 0 };
+  std::atomic<hal::u64> m_rejected_connections{ 0 };
+  std::atomic<hal::u64> m_bytes_to_network{ 0 };
+  std::atomic<hal::u64> m_bytes_to_port{ 0 };
+  std::atomic<hal::u64> m_dropped_bytes{ 0 };
+  std::atomic<hal::u64> m_control_commands{ 0 };
+  std::thread m_thread;
+};
+
+/**
+ * @brief Serial port reached over TCP
+ *
+ * Connects to a serial_server, ser2net or any other RFC 2217 server, or to
+ * a raw TCP serial server with rfc2217 disabled, and behaves like a local
+ * port: received data appears in the receive buffer and writes are sent to
+ * the remote port.
+ *
+ * configure() and set_control_signals() send RFC 2217 commands and wait
+ * for the server to confirm them. Each write is escaped and sent with a
+ * single send() call.
+ *
+ * Example:
+ * ```cpp
+ * auto port = hal::mac::network_serial::create(allocator, "10.0.0.5", 4000);
+ * port->configure({ .baud_rate = 9600 });
+ * port->write(hal::as_bytes("reset\n"sv));
+ * ```
+ */
+class network_serial : public hal::v5::serial
+{
+public:
+  struct settings
+  {
+    /// Received bytes the receive buffer holds before the oldest are
+    /// overwritten
+    usize receive_buffer_size = 4096;
+    /// Negotiate RFC 2217 port control, otherwise exchange raw data only
+    bool rfc2217 = true;
+    /// Send each write immediately instead of waiting for more data
+    bool no_delay = true;
+    /// Kernel send and receive buffer size of the socket, 0 keeps the system
+    /// default
+    usize socket_buffer_size = 64 * 1024;
+    /// How long configure() and set_control_signals() wait for the server
+    hal::time_duration reply_timeout = std::chrono::seconds(1);
+  };
+
+  /**
+   * @brief Counters describing the connection's traffic
+   */
+  struct statistics
+  {
+    /// Data bytes written, before escaping
+    hal::u64 bytes_sent;
+    /// Data bytes received, after removing Telnet commands
+    hal::u64 bytes_received;
+    /// send() calls made
+    hal::u64 send_calls;
+  };
+
+  /**
+   * @brief Connect with default settings
+   *
+   * @param p_allocator Memory allocator for this object and its buffers
+   * @param p_host IPv4 address or host name of the server
+   * @param p_port TCP port of the server
+   * @return A strong_ptr to the created network_serial instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<network_serial> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    std::string_view p_host,
+    hal::u16 p_port);
+
+  /**
+   * @brief Connect to a serial server
+   *
+   * @param p_allocator Memory allocator for this object and its buffers
+   * @param p_host IPv4 address or host name of the server
+   * @param p_port TCP port of the server
+   * @param p_settings Buffer and connection settings
+   * @return A strong_ptr to the created network_serial instance
+   * @throws hal::argument_out_of_domain if receive_buffer_size is 0
+   * @throws hal::no_such_device if the host is unknown or refused the
+   * connection
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<network_serial> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    std::string_view p_host,
+    hal::u16 p_port,
+    settings const& p_settings);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  network_serial(hal::v5::strong_ptr_only_token,
+                 std::pmr::polymorphic_allocator<> p_allocator,
+                 std::string_view p_host,
+                 hal::u16 p_port,
+                 settings const& p_settings);
+
+  /**
+   * @brief Close the connection and stop the receive thread
+   */
+  ~network_serial() override;
+
+  // Non-copyable and non-movable
+  network_serial(network_serial const&) = delete;
+  network_serial& operator=(network_serial const&) = delete;
+  network_serial(network_serial&&) = delete;
+  network_serial& operator=(network_serial&&) = delete;
+
+  /**
+   * @brief Set the remote port's DTR and RTS lines
+   *
+   * @param p_dtr_state true to assert DTR
+   * @param p_rts_state true to assert RTS
+   * @throws hal::operation_not_supported if rfc2217 is disabled
+   * @throws hal::timed_out if the server did not confirm in time
+   * @throws hal::io_error if the connection was lost
+   */
+  void set_control_signals(bool p_dtr_state, bool p_rts_state);
+
+  /**
+   * @brief Check whether the connection is still open
+   */
+  [[nodiscard]] bool connected() const;
+
+  /**
+   * @brief Get the connection's counters
+   *
+   * @return Current counter values
+   */
+  [[nodiscard]] statistics get_statistics() const;
+
+private:
+  /**
+   * @throws hal::operation_not_supported if rfc2217 is disabled
+   * @throws hal::argument_out_of_domain if the server kept other settings
+   * @throws hal::timed_out if the server did not confirm in time
+   * @throws hal::io_error if the connection was lost
+   */
+  void driver_configure(hal::v5::serial::settings const& p_settings) override;
+
+  /**
+   * @throws hal::io_error if the connection was lost
+   */
+  void driver_write(std::span<hal::byte const> p_data) override;
+  std::span<hal::byte const> driver_receive_buffer() override;
+  usize driver_cursor() override;
+
+  void receive_thread_function();
+  void publish(std::span<hal::byte const> p_data);
+  void negotiate(hal::byte p_verb, hal::byte p_option);
+  void handle_reply(std::span<hal::byte const> p_reply);
+
+  /**
+   * @brief Send RFC 2217 commands and wait until each was answered
+   *
+   * @param p_commands Command code and value of each command
+   * @return Last value the server answered with, indexed by command code
+   */
+  std::array<hal::u32, 16> run_commands(
+    std::span<std::pair<hal::byte, hal::u32> const> p_commands);
+
+  /**
+   * @brief Send bytes that are already escaped, m_send_mutex must be held
+   */
+  void send_all(std::span<hal::byte const> p_data);
+
+  settings m_settings;
+  int m_fd = -1;
+  std::pmr::vector<hal::byte> m_receive_buffer;
+  std::atomic<usize> m_receive_cursor{ 0 };
+  std::atomic<bool> m_connected{ true };
+
+  /// Serializes writes, commands and negotiation replies on the socket
+  std::mutex m_send_mutex;
+  std::pmr::vector<hal::byte> m_send_buffer;
+
+  /// Guards the replies below
+  std::mutex m_reply_mutex;
+  std::condition_variable m_reply_received;
+  /// Replies received and last value per RFC 2217 command
+  std::array<hal::u64, 16> m_reply_count{};
+  std::array<hal::u32, 16> m_reply_value{};
+
+  /// Only used by the receive thread
+  detail::telnet_session m_telnet;
+  std::pmr::vector<hal::byte> m_pending_replies;
+
+  std::atomic<hal::u64> m_bytes_sent{ 0 };
+  std::atomic<hal::u64> m_bytes_received{ 0 };
+  std::atomic<hal::u64> m_send_calls{ 0 };
+  std::thread m_thread;
+};
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,229 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <libhal/functional.hpp>
+#include <libhal/pointers.hpp>
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Steady clock whose time only moves when told to
+ *
+ * Time starts at 0 and stands still until advance() moves it, or, with
+ * auto_advance, until every thread taking part in the simulation waits on
+ * the clock. The clock then jumps straight to the earliest deadline any of
+ * them waits for. A test that sits through 30 seconds of protocol timeouts
+ * finishes in the time it takes to run its code, and sees the same times in
+ * every run.
+ *
+ * Code waits on simulated time with sleep_for() and sleep_until(), or
+ * schedules a handler with schedule() that the thread moving time runs at
+ * the deadline. link_emulator, bulk_sender and precise_delay accept a
+ * simulated_clock in place of real time.
+ *
+ * Threads that run while simulated time stands still must attach() to the
+ * clock, so it only moves once they wait on it. An attached thread must not
+ * block on anything but the clock, or time stops for good. A thread that is
+ * not attached, like the test's main thread in most tests, is never waited
+ * for.
+ *
+ * uptime() counts nanoseconds, the frequency is 1 GHz.
+ *
+ * Example:
+ * ```cpp
+ * auto clock = hal::mac::simulated_clock::create(allocator);
+ * auto link = hal::mac::link_emulator::create(
+ *   allocator, { .baud_rate = 9600 }, clock);
+ * // ...
+ * clock->sleep_for(30s);  // returns at once, link deliveries included
+ * ```
+ */
+class simulated_clock
+  : public hal::steady_clock
+  , public hal::v5::enable_strong_from_this<simulated_clock>
+{
+public:
+  struct settings
+  {
+    /// Jump to the earliest deadline once every attached thread waits on
+    /// the clock, instead of waiting for advance()
+    bool auto_advance = true;
+  };
+
+  /// Identifies a handler passed to schedule()
+  using timer_id = hal::u64;
+
+  /**
+   * @brief Create a simulated clock that advances automatically
+   *
+   * @param p_allocator Memory allocator for this object and its timers
+   * @return A strong_ptr to the created simulated_clock instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<simulated_clock> create(
+    std::pmr::polymorphic_allocator<> p_allocator);
+
+  /**
+   * @brief Create a simulated clock
+   *
+   * @param p_allocator Memory allocator for this object and its timers
+   * @param p_settings Whether time advances automatically
+   * @return A strong_ptr to the created simulated_clock instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<simulated_clock> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    settings const& p_settings);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  simulated_clock(hal::v5::strong_ptr_only_token,
+                  std::pmr::polymorphic_allocator<> p_allocator,
+                  settings const& p_settings);
+
+  // Non-copyable and non-movable
+  simulated_clock(simulated_clock const&) = delete;
+  simulated_clock& operator=(simulated_clock const&) = delete;
+  simulated_clock(simulated_clock&&) = delete;
+  simulated_clock& operator=(simulated_clock&&) = delete;
+
+  /**
+   * @brief Current simulated time
+   *
+   * @return Time since the clock was created
+   */
+  [[nodiscard]] hal::time_duration now();
+
+  /**
+   * @brief Move time forward
+   *
+   * Time stops at every deadline on the way: sleeping threads whose deadline
+   * passed wake up, handlers run, and the next step waits until every woken
+   * attached thread waits on the clock again. Each sees the time it asked
+   * for, as if the time had passed for real.
+   *
+   * @param p_amount Amount of time to move forward, 0 to only run what is
+   * due
+   */
+  void advance(hal::time_duration p_amount);
+
+  /**
+   * @brief Block the calling thread for an amount of simulated time
+   *
+   * @param p_duration Amount of time to wait, 0 or below returns at once
+   */
+  void sleep_for(hal::time_duration p_duration);
+
+  /**
+   * @brief Block the calling thread until simulated time reaches a deadline
+   *
+   * With auto_advance, the thread that leaves no attached thread running
+   * moves time to the next deadline itself.
+   *
+   * @param p_deadline Time since the clock was created
+   */
+  void sleep_until(hal::time_duration p_deadline);
+
+  /**
+   * @brief Run a handler once simulated time reaches a deadline
+   *
+   * The handler runs on the thread that moves time, without the clock's
+   * lock held. It may schedule and cancel handlers, but must not sleep on
+   * or advance the clock. A deadline that already passed runs at the next
+   * advance.
+   *
+   * @param p_deadline Time since the clock was created
+   * @param p_handler Handler to run
+   * @return Id for cancel()
+   */
+  timer_id schedule(hal::time_duration p_deadline,
+                    hal::callback<void()> p_handler);
+
+  /**
+   * @brief Drop a handler that has not run yet
+   *
+   * @param p_timer Id returned by schedule()
+   * @return true if the handler was dropped, false if it ran or is running
+   */
+  bool cancel(timer_id p_timer);
+
+  /**
+   * @brief Make simulated time wait for the calling thread
+   *
+   * Until detach(), time only moves while this thread waits on the clock.
+   *
+   * @throws hal::argument_out_of_domain if the thread is already attached
+   */
+  void attach();
+
+  /**
+   * @brief Stop making simulated time wait for the calling thread
+   *
+   * @throws hal::argument_out_of_domain if the thread is not attached
+   */
+  void detach();
+
+private:
+  /**
+   * @brief A thread blocked in sleep_until()
+   */
+  struct sleeper
+  {
+    bool attached;
+    bool woken = false;
+  };
+
+  hal::hertz driver_frequency() override;
+  hal::u64 driver_uptime() override;
+
+  /// Everything below requires m_mutex to be held
+  [[nodiscard]] bool caller_attached() const;
+  [[nodiscard]] usize running_threads() const;
+  [[nodiscard]] std::optional<hal::time_duration> next_deadline() const;
+
+  /**
+   * @brief Move time to p_time, wake due sleepers and run due handlers
+   */
+  void step(std::unique_lock<std::mutex>& p_lock, hal::time_duration p_time);
+
+  settings m_settings;
+  std::mutex m_mutex;
+  /// Signalled when time moved or a thread started or stopped waiting
+  std::condition_variable m_changed;
+  hal::time_duration m_now{ 0 };
+  /// Pending handlers ordered by deadline, then by the order scheduled
+  std::pmr::map<std::pair<hal::time_duration, timer_id>,
+                hal::callback<void()>>
+    m_timers;
+  std::pmr::multimap<hal::time_duration, sleeper*> m_sleepers;
+  std::pmr::vector<std::thread::id> m_attached;
+  /// Attached threads blocked in sleep_until()
+  usize m_sleeping_attached = 0;
+  timer_id m_next_timer = 1;
+  /// Set while a thread steps time, so only one does at a time
+  bool m_stepping = false;
+};
+}  // namespace hal::mac::inline v1
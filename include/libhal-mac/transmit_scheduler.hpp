@@ -0,0 +1,229 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <libhal/pointers.hpp>
+#include <libhal/units.hpp>
+
+#include "serial.hpp"
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Priority classes of a transmit_scheduler
+ */
+enum class transmit_lane : hal::u8
+{
+  /// Control messages such as aborts and keep-alives, sent first
+  urgent,
+  /// Streams and large transfers, sent when no urgent message is waiting
+  bulk,
+};
+
+/**
+ * @brief Prioritized transmit queue in front of a hal::mac::serial
+ *
+ * A dedicated writer thread drains two lanes. Urgent messages are always
+ * written whole and ahead of any queued bulk data. Bulk messages are written
+ * in chunks sized so that each one occupies the line for at most
+ * settings::max_line_hold at the port's current baud rate, and the writer
+ * keeps no more than one chunk queued in the OS driver (TIOCOUTQ). An urgent
+ * message therefore waits at most about two chunk times, no matter how much
+ * bulk data is queued.
+ *
+ * Chunk boundaries are the only points where urgent messages are inserted.
+ * With settings::split_bulk_messages disabled bulk messages are written whole
+ * instead, which keeps them contiguous on the line at the cost of a longer
+ * wait for urgent messages.
+ *
+ * Messages are copied into the lane's queue, so the caller's buffer can be
+ * reused as soon as send() returns.
+ *
+ * Example, abort a firmware upload:
+ * ```cpp
+ * auto tx = hal::mac::transmit_scheduler::create(allocator, serial);
+ * tx->send(hal::mac::transmit_lane::bulk, firmware_image);
+ * // ...
+ * tx->send(hal::mac::transmit_lane::urgent, abort_command);
+ * ```
+ */
+class transmit_scheduler
+  : public hal::v5::enable_strong_from_this<transmit_scheduler>
+{
+public:
+  struct settings
+  {
+    /// Longest time a single bulk chunk may occupy the line
+    hal::time_duration max_line_hold = std::chrono::milliseconds(5);
+    /// Split bulk messages into chunks so urgent messages can overtake them
+    bool split_bulk_messages = true;
+    /// Bulk data that may be queued before send() blocks, urgent messages
+    /// never block
+    usize max_queued_bulk_bytes = 64 * 1024;
+  };
+
+  /**
+   * @brief Counters describing the traffic of one lane
+   */
+  struct lane_statistics
+  {
+    /// Messages completely written to the device
+    hal::u64 messages;
+    /// Bytes written to the device
+    hal::u64 bytes;
+    /// Sum of the time from send() until the last byte was accepted by the
+    /// device, in nanoseconds
+    hal::u64 latency_total_ns;
+    /// Longest latency observed, in nanoseconds
+    hal::u64 latency_max_ns;
+  };
+
+  /**
+   * @brief Create a transmit_scheduler with default settings
+   *
+   * @param p_allocator Memory allocator for this object and queued messages
+   * @param p_serial Serial port to write to
+   * @return A strong_ptr to the created transmit_scheduler instance
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<transmit_scheduler> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial> p_serial);
+
+  /**
+   * @brief Create a transmit_scheduler and start its writer thread
+   *
+   * @param p_allocator Memory allocator for this object and queued messages
+   * @param p_serial Serial port to write to
+   * @param p_settings Scheduling settings
+   * @return A strong_ptr to the created transmit_scheduler instance
+   * @throws hal::argument_out_of_domain if max_line_hold is not positive
+   */
+  [[nodiscard]] static hal::v5::strong_ptr<transmit_scheduler> create(
+    std::pmr::polymorphic_allocator<> p_allocator,
+    hal::v5::strong_ptr<serial> p_serial,
+    settings const& p_settings);
+
+  /**
+   * @brief Public constructor - but use create() instead
+   */
+  transmit_scheduler(hal::v5::strong_ptr_only_token,
+                     std::pmr::polymorphic_allocator<> p_allocator,
+                     hal::v5::strong_ptr<serial> p_serial,
+                     settings const& p_settings);
+
+  /**
+   * @brief Stop the writer thread
+   *
+   * Waits for the chunk or urgent message being written, queued data that has
+   * not been started is discarded. Call flush() first to send everything.
+   */
+  ~transmit_scheduler();
+
+  // Non-copyable and non-movable
+  transmit_scheduler(transmit_scheduler const&) = delete;
+  transmit_scheduler& operator=(transmit_scheduler const&) = delete;
+  transmit_scheduler(transmit_scheduler&&) = delete;
+  transmit_scheduler& operator=(transmit_scheduler&&) = delete;
+
+  /**
+   * @brief Queue a message for transmission
+   *
+   * Messages of the same lane are written in the order they were sent.
+   *
+   * @param p_lane Priority class of the message
+   * @param p_data Message to send, copied before this returns
+   * @throws hal::io_error if a previous write failed, queued data was
+   * discarded
+   */
+  void send(transmit_lane p_lane, std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Block until every queued message was accepted by the device
+   *
+   * @throws hal::io_error if a write failed, queued data was discarded
+   */
+  void flush();
+
+  /**
+   * @brief Get the traffic counters of a lane
+   *
+   * @param p_lane Lane to report on
+   * @return Current counter values
+   */
+  [[nodiscard]] lane_statistics get_statistics(transmit_lane p_lane) const;
+
+private:
+  struct message
+  {
+    std::pmr::vector<hal::byte> data;
+    std::chrono::steady_clock::time_point queued_at;
+    /// Bytes already written
+    usize offset = 0;
+  };
+
+  void writer_thread_function();
+
+  /**
+   * @brief Wait until the OS driver holds at most one chunk of output
+   */
+  void wait_for_line(usize p_chunk_size);
+
+  /**
+   * @brief Time the line takes to carry one byte at the current settings
+   */
+  [[nodiscard]] std::chrono::nanoseconds byte_time() const;
+
+  /**
+   * @brief Update a lane's counters after writing part of a message
+   *
+   * m_mutex must be held.
+   */
+  void record(transmit_lane p_lane, message const& p_message, usize p_bytes);
+
+  /**
+   * @brief Discard queued data after a write failed, m_mutex must be held
+   */
+  void fail(std::exception_ptr p_error);
+
+  hal::v5::strong_ptr<serial> m_serial;
+  settings m_settings;
+  /// Guards the queues, statistics and m_error
+  mutable std::mutex m_mutex;
+  /// Signalled when data is queued or the writer should stop
+  std::condition_variable m_work;
+  /// Signalled when data was written, for send() and flush()
+  std::condition_variable m_progress;
+  /// Queues indexed by transmit_lane
+  std::array<std::pmr::deque<message>, 2> m_lanes;
+  std::array<lane_statistics, 2> m_statistics{};
+  usize m_queued_bulk_bytes = 0;
+  /// First write error, reported once by send() or flush()
+  std::exception_ptr m_error = nullptr;
+  /// Read without the lock while waiting for the line
+  std::atomic<bool> m_stop_thread{ false };
+  std::thread m_thread;
+};
+}  // namespace hal::mac::inline v1
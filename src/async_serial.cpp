@@ -0,0 +1,200 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/async_serial.hpp>
+
+#include <algorithm>
+#include <mutex>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+namespace hal::mac::inline v1 {
+
+hal::v5::strong_ptr<async_serial> async_serial::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_serial,
+  hal::v5::strong_ptr<scheduler> p_scheduler)
+{
+  return hal::v5::make_strong_ptr<async_serial>(
+    p_allocator, p_serial, p_scheduler);
+}
+
+async_serial::async_serial(hal::v5::strong_ptr_only_token,
+                           hal::v5::strong_ptr<serial> p_serial,
+                           hal::v5::strong_ptr<scheduler> p_scheduler)
+  : m_serial(p_serial)
+  , m_scheduler(p_scheduler)
+  , m_seen_cursor(p_serial->receive_cursor())
+{
+  m_serial->attach_observer(*this);
+}
+
+async_serial::~async_serial()
+{
+  m_serial->detach_observer(*this);
+}
+
+void async_serial::on_receive(usize p_cursor)
+{
+  std::lock_guard lock(m_mutex);
+  if (m_pending == nullptr) {
+    count_received(p_cursor);
+    return;
+  }
+  if (not run_operation(*m_pending, p_cursor)) {
+    return;
+  }
+
+  auto const handle = m_pending->m_handle;
+  m_pending = nullptr;
+  m_scheduler->post(handle);
+}
+
+void async_serial::count_received(usize p_cursor)
+{
+  auto const size = m_serial->receive_buffer().size();
+  // Every publish moves the cursor by less than a lap, so the distance from
+  // the last cursor seen is the number of bytes that arrived. Beyond a full
+  // buffer of unread data, the oldest bytes were overwritten.
+  m_unread = std::min(m_unread + (p_cursor + size - m_seen_cursor) % size,
+                      size);
+  m_seen_cursor = p_cursor;
+}
+
+bool async_serial::run_operation(receive_operation& p_operation,
+                                 usize p_cursor)
+{
+  count_received(p_cursor);
+
+  auto const buffer = m_serial->receive_buffer();
+  auto const start = (p_cursor + buffer.size() - m_unread) % buffer.size();
+  auto const first_size = std::min(m_unread, buffer.size() - start);
+  auto const first = buffer.subspan(start, first_size);
+  auto const second = buffer.first(m_unread - first_size);
+
+  auto const [consumed, complete] = p_operation.consume(first, second);
+  m_unread -= consumed;
+  return complete;
+}
+
+bool async_serial::receive_operation::await_ready()
+{
+  std::lock_guard lock(m_port->m_mutex);
+  return m_port->run_operation(*this, m_port->m_serial->receive_cursor());
+}
+
+bool async_serial::receive_operation::await_suspend(
+  std::coroutine_handle<> p_handle)
+{
+  std::lock_guard lock(m_port->m_mutex);
+
+  if (m_port->m_pending != nullptr) {
+    throw hal::operation_not_permitted(m_port);
+  }
+
+  // Data may have been published between await_ready() and now, in which case
+  // its notification was missed and the operation must be retried here.
+  if (m_port->run_operation(*this, m_port->m_serial->receive_cursor())) {
+    return false;
+  }
+
+  m_handle = p_handle;
+  m_port->m_pending = this;
+  return true;
+}
+
+std::pair<usize, bool> async_serial::read_operation::consume(
+  std::span<hal::byte const> p_first,
+  std::span<hal::byte const> p_second)
+{
+  usize consumed = 0;
+
+  for (auto const data : { p_first, p_second }) {
+    auto const space = m_buffer.size() - m_filled;
+    auto chunk = data.first(std::min(space, data.size()));
+
+    if (m_delimiter) {
+      auto const delimiter = std::ranges::find(chunk, *m_delimiter);
+      if (delimiter != chunk.end()) {
+        chunk = chunk.first(
+          static_cast<usize>(delimiter - chunk.begin()) + 1);
+        std::ranges::copy(chunk, m_buffer.begin() + m_filled);
+        m_filled += chunk.size();
+        return { consumed + chunk.size(), true };
+      }
+    }
+
+    std::ranges::copy(chunk, m_buffer.begin() + m_filled);
+    m_filled += chunk.size();
+    consumed += chunk.size();
+  }
+
+  return { consumed, m_filled == m_buffer.size() };
+}
+
+std::pair<usize, bool> async_serial::readable_operation::consume(
+  std::span<hal::byte const> p_first,
+  std::span<hal::byte const> p_second)
+{
+  m_available = p_first.size() + p_second.size();
+  return { 0, m_available != 0 };
+}
+
+bool async_serial::write_operation::await_ready()
+{
+  return try_write();
+}
+
+void async_serial::write_operation::await_suspend(
+  std::coroutine_handle<> p_handle)
+{
+  m_handle = p_handle;
+  m_port->m_scheduler->wait_writable(m_port->m_serial->native_handle(),
+                                     [this]() { on_writable(); });
+}
+
+void async_serial::write_operation::await_resume()
+{
+  if (m_error) {
+    std::rethrow_exception(m_error);
+  }
+}
+
+bool async_serial::write_operation::try_write()
+{
+  try {
+    while (not m_data.empty()) {
+      auto const written = m_port->m_serial->write_some(m_data);
+      if (written == 0) {
+        return false;
+      }
+      m_data = m_data.subspan(written);
+    }
+  } catch (...) {
+    m_error = std::current_exception();
+  }
+  return true;
+}
+
+void async_serial::write_operation::on_writable()
+{
+  if (try_write()) {
+    m_port->m_scheduler->post(m_handle);
+    return;
+  }
+  m_port->m_scheduler->wait_writable(m_port->m_serial->native_handle(),
+                                     [this]() { on_writable(); });
+}
+}  // namespace hal::mac::inline v1
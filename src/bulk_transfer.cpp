@@ -0,0 +1,829 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/bulk_transfer.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <utility>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+#include "frame_header.hpp"
+
+namespace hal::mac::inline v1 {
+
+namespace {
+constexpr hal::byte frame_sync = 0xB5;
+constexpr usize crc_size = 4;
+
+// Frame types and the size of their fixed fields
+constexpr hal::byte frame_open = 1;
+constexpr usize open_size = 8;
+constexpr hal::byte frame_accept = 2;
+constexpr usize accept_size = 12;
+constexpr hal::byte frame_data = 3;
+constexpr usize data_fields_size = 12;
+constexpr hal::byte frame_acknowledge = 4;
+constexpr usize acknowledge_size = 20;
+
+constexpr usize max_payload = std::numeric_limits<hal::u16>::max();
+constexpr usize data_overhead =
+  frame_header_size + data_fields_size + crc_size;
+/// Weight of a new sample in the frame error rate average
+constexpr double error_rate_gain = 1.0 / 16.0;
+/// Share of the highest delivery rate kept for every new rate sample
+constexpr double delivery_rate_decay = 0.99;
+/// Most doublings of the retransmission timeout after timeouts in a row
+constexpr hal::u32 max_backoff = 6;
+
+constexpr std::array<hal::u32, 256> crc_table = []() {
+  std::array<hal::u32, 256> table{};
+  for (hal::u32 i = 0; i < table.size(); i++) {
+    hal::u32 value = i;
+    for (int bit = 0; bit < 8; bit++) {
+      value = (value & 1) != 0 ? (value >> 1) ^ 0xEDB8'8320 : value >> 1;
+    }
+    table[i] = value;
+  }
+  return table;
+}();
+
+/// CRC-32 as used by Ethernet and zlib, continued from p_crc
+hal::u32 crc32(hal::u32 p_crc, std::span<hal::byte const> p_data)
+{
+  for (auto const byte : p_data) {
+    p_crc = crc_table[(p_crc ^ byte) & 0xFF] ^ (p_crc >> 8);
+  }
+  return p_crc;
+}
+
+void put_u32(std::span<hal::byte> p_data, usize p_position, hal::u32 p_value)
+{
+  for (usize i = 0; i < 4; i++) {
+    p_data[p_position + i] = static_cast<hal::byte>(p_value >> (8 * i));
+  }
+}
+
+hal::u32 get_u32(std::span<hal::byte const> p_data, usize p_position)
+{
+  hal::u32 value = 0;
+  for (usize i = 0; i < 4; i++) {
+    value |= hal::u32{ p_data[p_position + i] } << (8 * i);
+  }
+  return value;
+}
+
+/**
+ * @brief Build a frame in p_frame
+ *
+ * @return Size of the frame
+ */
+usize build_frame(std::span<hal::byte> p_frame,
+                  hal::byte p_type,
+                  std::span<hal::byte const> p_fields,
+                  std::span<hal::byte const> p_data)
+{
+  auto const length = p_fields.size() + p_data.size();
+  write_frame_header(p_frame, frame_sync, p_type, length);
+  std::ranges::copy(p_fields, p_frame.begin() + frame_header_size);
+  std::ranges::copy(p_data,
+                    p_frame.begin() + frame_header_size + p_fields.size());
+
+  auto crc = crc32(0xFFFF'FFFF, p_frame.subspan(1, 3));
+  crc = ~crc32(crc, p_frame.subspan(frame_header_size, length));
+  put_u32(p_frame, frame_header_size + length, crc);
+  return frame_header_size + length + crc_size;
+}
+
+/**
+ * @brief Check the CRC of a complete frame and hand over its payload
+ */
+template<typename Handler>
+void finish_frame(detail::bulk_frame_reader& p_reader, Handler& p_on_frame)
+{
+  if (not p_reader.keep_body) {
+    p_reader.corrupt_frames++;
+    return;
+  }
+
+  auto const body = std::span(p_reader.body).first(p_reader.body_size);
+  auto const payload = body.first(body.size() - crc_size);
+  auto crc = crc32(0xFFFF'FFFF, std::span(p_reader.header).subspan(1, 3));
+  crc = ~crc32(crc, payload);
+  if (crc != get_u32(body, payload.size())) {
+    p_reader.corrupt_frames++;
+    return;
+  }
+  p_on_frame(p_reader.header[1], payload);
+}
+
+template<typename Handler>
+void parse_frames(detail::bulk_frame_reader& p_reader,
+                  std::span<hal::byte const> p_data,
+                  Handler& p_on_frame)
+{
+  while (not p_data.empty()) {
+    if (p_reader.body_remaining > 0) {
+      auto const count = std::min(p_reader.body_remaining, p_data.size());
+      if (p_reader.keep_body) {
+        std::copy_n(p_data.begin(),
+                    count,
+                    p_reader.body.begin() + p_reader.body_size);
+        p_reader.body_size += count;
+      }
+      p_reader.body_remaining -= count;
+      p_data = p_data.subspan(count);
+      if (p_reader.body_remaining == 0) {
+        finish_frame(p_reader, p_on_frame);
+      }
+      continue;
+    }
+
+    auto const scan = read_frame_header(
+      frame_sync, p_reader.header, p_reader.header_size, p_data);
+    p_reader.corrupt_frames += scan.rejected;
+    if (not scan.header) {
+      continue;
+    }
+
+    p_reader.body_remaining = scan.header->length + crc_size;
+    p_reader.keep_body = p_reader.body_remaining <= p_reader.body.size();
+    p_reader.body_size = 0;
+  }
+}
+
+/**
+ * @brief Parse the frames a link received since the last call
+ */
+template<typename Handler>
+void read_frames(detail::bulk_frame_reader& p_reader,
+                 hal::v5::serial& p_link,
+                 Handler&& p_on_frame)
+{
+  auto const buffer = p_link.receive_buffer();
+  auto const cursor = p_link.receive_cursor();
+  auto const previous = std::exchange(p_reader.link_cursor, cursor);
+
+  // Parse in place, in at most two pieces when the link's data wrapped
+  if (cursor > previous) {
+    parse_frames(
+      p_reader, buffer.subspan(previous, cursor - previous), p_on_frame);
+  } else if (cursor < previous) {
+    parse_frames(p_reader, buffer.subspan(previous), p_on_frame);
+    parse_frames(p_reader, buffer.first(cursor), p_on_frame);
+  }
+}
+}  // namespace
+
+hal::v5::strong_ptr<bulk_sender> bulk_sender::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::v5::serial> p_link)
+{
+  return create(p_allocator, p_link, settings{});
+}
+
+hal::v5::strong_ptr<bulk_sender> bulk_sender::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::v5::serial> p_link,
+  settings const& p_settings,
+  hal::v5::optional_ptr<simulated_clock> p_clock)
+{
+  if (p_settings.min_block_size == 0 ||
+      p_settings.min_block_size > p_settings.max_block_size ||
+      p_settings.max_block_size > max_payload - data_fields_size ||
+      p_settings.max_window == 0 || p_settings.max_retransmissions == 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<bulk_sender>(
+    p_allocator, p_allocator, p_link, p_settings, p_clock);
+}
+
+bulk_sender::bulk_sender(hal::v5::strong_ptr_only_token,
+                         std::pmr::polymorphic_allocator<> p_allocator,
+                         hal::v5::strong_ptr<hal::v5::serial> p_link,
+                         settings const& p_settings,
+                         hal::v5::optional_ptr<simulated_clock> p_clock)
+  : m_link(p_link)
+  , m_settings(p_settings)
+  , m_clock(p_clock)
+  , m_reader{ .link_cursor = m_link->receive_cursor(),
+              .body = std::pmr::vector<hal::byte>(
+                acknowledge_size + crc_size, 0, p_allocator) }
+  , m_frame(data_overhead + p_settings.max_block_size, 0, p_allocator)
+  , m_in_flight(p_allocator)
+{
+}
+
+void bulk_sender::send(hal::u32 p_transfer_id,
+                       std::span<hal::byte const> p_image)
+{
+  if (p_image.size() > std::numeric_limits<hal::u32>::max()) {
+    throw hal::argument_out_of_domain(this);
+  }
+  auto const size = static_cast<hal::u32>(p_image.size());
+  auto const start = now();
+
+  m_in_flight.clear();
+  m_transfer_id = p_transfer_id;
+  m_in_flight_bytes = 0;
+  m_next_sequence = 1;
+  m_highest_acknowledged = 0;
+  m_delivered = 0;
+  m_delivered_time = start;
+  m_has_rtt = false;
+  m_backoff = 0;
+  m_delivery_rate = 0.0;
+  m_frame_error_rate = 0.0;
+  m_receiver_window = m_settings.max_window;
+  {
+    std::lock_guard lock(m_statistics_mutex);
+    m_statistics = {};
+    m_block_size = m_settings.max_block_size;
+    m_window = std::min(4 * m_block_size, m_settings.max_window);
+  }
+
+  auto const resume_offset = open(p_transfer_id, size);
+  m_cumulative = resume_offset;
+  m_next_offset = resume_offset;
+  adapt();
+  {
+    std::lock_guard lock(m_statistics_mutex);
+    m_statistics.bytes_resumed = resume_offset;
+  }
+
+  while (m_cumulative < size) {
+    receive_acknowledgements(p_transfer_id);
+    bool sent = false;
+
+    // Blocks sent before an acknowledged block were lost on the way there
+    // or their acknowledgement was lost on the way back. The timeout only
+    // resends the oldest block, its acknowledgement reveals any others lost.
+    auto const now = this->now();
+    auto const timeout = retransmission_timeout();
+    bool oldest = true;
+    for (usize i = 0; i < m_in_flight.size(); i++) {
+      auto& entry = m_in_flight[i];
+      if (entry.acknowledged) {
+        continue;
+      }
+      if (entry.transmissions == 0) {
+        // Rest of a block that was split to be sent again
+        oldest = false;
+        transmit(entry, p_image);
+        sent = true;
+        continue;
+      }
+      bool const lost = entry.sequence < m_highest_acknowledged;
+      bool const expired = oldest && now - entry.sent > timeout;
+      oldest = false;
+      if (not lost && not expired) {
+        continue;
+      }
+      if (entry.transmissions > m_settings.max_retransmissions) {
+        throw hal::timed_out(this);
+      }
+      if (not lost) {
+        m_backoff = std::min(m_backoff + 1, max_backoff);
+      }
+      m_frame_error_rate += (1.0 - m_frame_error_rate) * error_rate_gain;
+      adapt();
+      {
+        std::lock_guard lock(m_statistics_mutex);
+        m_statistics.retransmissions++;
+        if (not lost) {
+          m_statistics.timeouts++;
+        }
+      }
+      split(i);
+      transmit(m_in_flight[i], p_image);
+      sent = true;
+    }
+
+    while (m_next_offset < size) {
+      usize window = 0;
+      usize block_size = 0;
+      {
+        std::lock_guard lock(m_statistics_mutex);
+        window = m_window;
+        block_size = m_block_size;
+      }
+      auto const length = static_cast<hal::u32>(
+        std::min<usize>(block_size, size - m_next_offset));
+      if (not m_in_flight.empty() && m_in_flight_bytes + length > window) {
+        break;
+      }
+
+      m_in_flight.push_back(block{
+        .offset = m_next_offset,
+        .length = length,
+        .sent = {},
+        .sequence = 0,
+        .delivered_at_send = 0,
+        .delivered_time_at_send = {},
+        .transmissions = 0,
+        .acknowledged = false,
+      });
+      m_in_flight_bytes += length;
+      m_next_offset += length;
+      transmit(m_in_flight.back(), p_image);
+      sent = true;
+      receive_acknowledgements(p_transfer_id);
+    }
+
+    if (not sent) {
+      wait_for_link();
+    }
+  }
+
+  auto const elapsed = now() - start;
+  std::lock_guard lock(m_statistics_mutex);
+  m_statistics.elapsed = elapsed;
+  m_statistics.goodput = static_cast<float>(
+    static_cast<double>(size - resume_offset) /
+    std::chrono::duration<double>(elapsed).count());
+}
+
+bulk_sender::statistics bulk_sender::get_statistics()
+{
+  std::lock_guard lock(m_statistics_mutex);
+  auto result = m_statistics;
+  result.window = m_window;
+  result.block_size = m_block_size;
+  return result;
+}
+
+hal::u32 bulk_sender::open(hal::u32 p_transfer_id, hal::u32 p_size)
+{
+  std::array<hal::byte, open_size> fields{};
+  put_u32(fields, 0, p_transfer_id);
+  put_u32(fields, 4, p_size);
+  m_accepted = false;
+
+  for (hal::u32 attempt = 0; attempt <= m_settings.max_retransmissions;
+       attempt++) {
+    // A short frame's round trip says little about a queue of blocks, so
+    // the initial timeout applies until a block's round trip was measured
+    write_frame(frame_open, fields, {});
+    auto const sent = now();
+
+    while (now() - sent < retransmission_timeout()) {
+      receive_acknowledgements(p_transfer_id);
+      if (m_accepted) {
+        return std::min(m_resume_offset, p_size);
+      }
+      wait_for_link();
+    }
+  }
+
+  throw hal::timed_out(this);
+}
+
+void bulk_sender::transmit(block& p_block, std::span<hal::byte const> p_image)
+{
+  std::array<hal::byte, data_fields_size> fields{};
+  put_u32(fields, 0, m_transfer_id);
+  put_u32(fields, 4, p_block.offset);
+  put_u32(fields, 8, m_next_sequence);
+
+  p_block.sequence = m_next_sequence++;
+  p_block.delivered_at_send = m_delivered;
+  p_block.delivered_time_at_send = m_delivered_time;
+  p_block.transmissions++;
+  write_frame(frame_data,
+              fields,
+              p_image.subspan(p_block.offset, p_block.length));
+  // The timeout starts once the link accepted the block
+  p_block.sent = now();
+
+  std::lock_guard lock(m_statistics_mutex);
+  m_statistics.blocks_sent++;
+  m_statistics.data_bytes_sent += p_block.length;
+}
+
+void bulk_sender::split(usize p_index)
+{
+  usize block_size = 0;
+  {
+    std::lock_guard lock(m_statistics_mutex);
+    block_size = m_block_size;
+  }
+
+  auto& entry = m_in_flight[p_index];
+  if (entry.length <= block_size) {
+    return;
+  }
+  auto rest = entry;
+  rest.offset += static_cast<hal::u32>(block_size);
+  rest.length -= static_cast<hal::u32>(block_size);
+  rest.transmissions = 0;
+  entry.length = static_cast<hal::u32>(block_size);
+  m_in_flight.insert(m_in_flight.begin() + p_index + 1, rest);
+}
+
+void bulk_sender::write_frame(hal::byte p_type,
+                              std::span<hal::byte const> p_fields,
+                              std::span<hal::byte const> p_data)
+{
+  auto const size = build_frame(m_frame, p_type, p_fields, p_data);
+  m_link->write(std::span(m_frame).first(size));
+
+  std::lock_guard lock(m_statistics_mutex);
+  m_statistics.link_bytes_sent += size;
+}
+
+void bulk_sender::receive_acknowledgements(hal::u32 p_transfer_id)
+{
+  read_frames(m_reader,
+              *m_link,
+              [this, p_transfer_id](hal::byte p_type,
+                                    std::span<hal::byte const> p_payload) {
+                if (get_u32(p_payload, 0) != p_transfer_id) {
+                  return;
+                }
+                if (p_type == frame_accept &&
+                    p_payload.size() == accept_size) {
+                  m_accepted = true;
+                  m_resume_offset = get_u32(p_payload, 4);
+                  m_receiver_window = get_u32(p_payload, 8);
+                } else if (p_type == frame_acknowledge &&
+                           p_payload.size() == acknowledge_size) {
+                  acknowledge(get_u32(p_payload, 4),
+                              get_u32(p_payload, 8),
+                              get_u32(p_payload, 12),
+                              get_u32(p_payload, 16));
+                }
+              });
+
+  std::lock_guard lock(m_statistics_mutex);
+  m_statistics.corrupt_frames = m_reader.corrupt_frames;
+}
+
+void bulk_sender::acknowledge(hal::u32 p_cumulative,
+                              hal::u32 p_offset,
+                              hal::u32 p_length,
+                              hal::u32 p_sequence)
+{
+  if (p_cumulative > m_cumulative && p_cumulative <= m_next_offset) {
+    m_cumulative = p_cumulative;
+  }
+  // Every transmission before the one that arrived has arrived or is lost
+  if (p_sequence < m_next_sequence) {
+    m_highest_acknowledged = std::max(m_highest_acknowledged, p_sequence);
+  }
+
+  auto const now = this->now();
+  bool progressed = false;
+  for (auto& entry : m_in_flight) {
+    bool const selected = entry.offset == p_offset && entry.length == p_length;
+    bool const covered = entry.offset + entry.length <= m_cumulative;
+    if (entry.acknowledged || not(selected || covered)) {
+      continue;
+    }
+
+    entry.acknowledged = true;
+    m_in_flight_bytes -= entry.length;
+    m_delivered += entry.length;
+    m_delivered_time = now;
+    bool const latest = selected && entry.sequence == p_sequence;
+    if (latest) {
+      m_frame_error_rate -= m_frame_error_rate * error_rate_gain;
+    }
+    measure(entry, now, latest);
+    progressed = true;
+  }
+
+  while (not m_in_flight.empty() && m_in_flight.front().acknowledged) {
+    m_in_flight.pop_front();
+  }
+
+  if (progressed) {
+    adapt();
+    std::lock_guard lock(m_statistics_mutex);
+    m_statistics.bytes_delivered = m_cumulative - m_statistics.bytes_resumed;
+  }
+}
+
+void bulk_sender::measure(block const& p_block,
+                          clock::time_point p_now,
+                          bool p_latest_transmission)
+{
+  // The echoed sequence tells which transmission of a block arrived, so
+  // only blocks acknowledged by the cumulative offset give no round trip
+  if (p_latest_transmission) {
+    auto const rtt = p_now - p_block.sent;
+    m_backoff = 0;
+    if (not m_has_rtt) {
+      m_has_rtt = true;
+      m_smoothed_rtt = rtt;
+      m_rtt_variation = rtt / 2;
+      m_min_rtt = rtt;
+    } else {
+      m_rtt_variation =
+        (3 * m_rtt_variation + std::chrono::abs(m_smoothed_rtt - rtt)) / 4;
+      m_smoothed_rtt = (7 * m_smoothed_rtt + rtt) / 8;
+      m_min_rtt = std::min(m_min_rtt, rtt);
+    }
+  }
+
+  auto const interval = std::chrono::duration<double>(
+    p_now - p_block.delivered_time_at_send);
+  if (interval.count() > 0.0) {
+    auto const rate =
+      static_cast<double>(m_delivered - p_block.delivered_at_send) /
+      interval.count();
+    m_delivery_rate = std::max(rate, m_delivery_rate * delivery_rate_decay);
+  }
+}
+
+void bulk_sender::adapt()
+{
+  // Expected share of useful bytes for block size L, frame overhead h and
+  // byte error rate p is L / (L + h) * (1 - p)^(L + h), which peaks where
+  // L * (L + h) = h / p
+  auto const overhead = static_cast<double>(data_overhead);
+  std::lock_guard lock(m_statistics_mutex);
+  auto block_size = m_settings.max_block_size;
+  // A frame of n bytes survives with probability (1 - p)^n
+  auto const frame_error_rate = std::min(m_frame_error_rate, 0.99);
+  auto const byte_error_rate = -std::log1p(-frame_error_rate) /
+                               (static_cast<double>(m_block_size) + overhead);
+  if (byte_error_rate > 0.0) {
+    auto const best =
+      (std::sqrt(overhead * overhead + 4.0 * overhead / byte_error_rate) -
+       overhead) /
+      2.0;
+    block_size = std::clamp(static_cast<usize>(best),
+                            m_settings.min_block_size,
+                            m_settings.max_block_size);
+  }
+  // Keep several blocks in flight even with a small receiver window
+  block_size = std::min(
+    block_size, std::max(m_settings.min_block_size, m_receiver_window / 4));
+
+  auto window = 4 * block_size;
+  if (m_has_rtt && m_delivery_rate > 0.0) {
+    auto const bandwidth_delay =
+      m_delivery_rate * std::chrono::duration<double>(m_min_rtt).count();
+    window = std::max(window, static_cast<usize>(2.0 * bandwidth_delay));
+  }
+  window = std::min({ window, m_settings.max_window, m_receiver_window });
+
+  m_block_size = block_size;
+  m_window = window;
+  m_statistics.smoothed_rtt = m_smoothed_rtt;
+  m_statistics.min_rtt = m_min_rtt;
+}
+
+bulk_sender::clock::time_point bulk_sender::now()
+{
+  if (m_clock) {
+    return clock::time_point(m_clock->now());
+  }
+  return clock::now();
+}
+
+void bulk_sender::wait_for_link()
+{
+  if (m_clock) {
+    m_clock->sleep_for(m_settings.poll_interval);
+  } else {
+    std::this_thread::sleep_for(m_settings.poll_interval);
+  }
+}
+
+bulk_sender::clock::duration bulk_sender::retransmission_timeout() const
+{
+  clock::duration timeout = m_settings.initial_timeout;
+  if (m_has_rtt) {
+    // A steady queue leaves almost no variation, so the margin over the
+    // round trip never drops below min_timeout
+    timeout = m_smoothed_rtt + std::max<clock::duration>(
+                                 4 * m_rtt_variation, m_settings.min_timeout);
+  }
+  // Every timeout in a row doubles the next one
+  return timeout * (1 << m_backoff);
+}
+
+hal::v5::strong_ptr<bulk_receiver> bulk_receiver::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::v5::serial> p_link,
+  hal::callback<sink> p_sink)
+{
+  return create(p_allocator, p_link, std::move(p_sink), settings{});
+}
+
+hal::v5::strong_ptr<bulk_receiver> bulk_receiver::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::v5::serial> p_link,
+  hal::callback<sink> p_sink,
+  settings const& p_settings)
+{
+  if (p_settings.window_size < 256 || p_settings.window_size > 1024 * 1024) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<bulk_receiver>(
+    p_allocator, p_allocator, p_link, std::move(p_sink), p_settings);
+}
+
+bulk_receiver::bulk_receiver(hal::v5::strong_ptr_only_token,
+                             std::pmr::polymorphic_allocator<> p_allocator,
+                             hal::v5::strong_ptr<hal::v5::serial> p_link,
+                             hal::callback<sink> p_sink,
+                             settings const& p_settings)
+  : m_link(p_link)
+  , m_sink(std::move(p_sink))
+  , m_settings(p_settings)
+  , m_reader{ .link_cursor = m_link->receive_cursor(),
+              .body = std::pmr::vector<hal::byte>(
+                std::min(data_fields_size + p_settings.window_size,
+                         max_payload) +
+                  crc_size,
+                0,
+                p_allocator) }
+  , m_frame(frame_header_size + acknowledge_size + crc_size, 0, p_allocator)
+  , m_reorder(p_settings.window_size, 0, p_allocator)
+  , m_present(p_settings.window_size, false, p_allocator)
+{
+}
+
+void bulk_receiver::service()
+{
+  read_frames(
+    m_reader,
+    *m_link,
+    [this](hal::byte p_type, std::span<hal::byte const> p_payload) {
+      if (p_type == frame_open && p_payload.size() == open_size) {
+        on_open(p_payload);
+      } else if (p_type == frame_data &&
+                 p_payload.size() >= data_fields_size) {
+        on_data(p_payload);
+      }
+    });
+
+  std::lock_guard lock(m_mutex);
+  m_statistics.corrupt_frames = m_reader.corrupt_frames;
+}
+
+void bulk_receiver::resume(hal::u32 p_transfer_id,
+                           hal::u32 p_size,
+                           hal::u32 p_received)
+{
+  if (p_received > p_size) {
+    throw hal::argument_out_of_domain(this);
+  }
+
+  std::lock_guard lock(m_mutex);
+  m_progress = {
+    .transfer_id = p_transfer_id,
+    .size = p_size,
+    .received = p_received,
+    .complete = p_received == p_size,
+  };
+  m_open = true;
+  std::fill(m_present.begin(), m_present.end(), false);
+}
+
+bulk_receiver::progress bulk_receiver::get_progress()
+{
+  std::lock_guard lock(m_mutex);
+  return m_progress;
+}
+
+bulk_receiver::statistics bulk_receiver::get_statistics()
+{
+  std::lock_guard lock(m_mutex);
+  return m_statistics;
+}
+
+void bulk_receiver::on_open(std::span<hal::byte const> p_payload)
+{
+  auto const transfer_id = get_u32(p_payload, 0);
+  auto const size = get_u32(p_payload, 4);
+
+  std::array<hal::byte, accept_size> fields{};
+  {
+    std::lock_guard lock(m_mutex);
+    // Anything but the transfer in progress starts from scratch
+    if (not m_open || transfer_id != m_progress.transfer_id ||
+        size != m_progress.size) {
+      m_progress = {
+        .transfer_id = transfer_id,
+        .size = size,
+        .received = 0,
+        .complete = size == 0,
+      };
+      std::fill(m_present.begin(), m_present.end(), false);
+    }
+    m_open = true;
+    put_u32(fields, 0, transfer_id);
+    put_u32(fields, 4, m_progress.received);
+    put_u32(fields, 8, static_cast<hal::u32>(m_settings.window_size));
+  }
+  write_frame(frame_accept, fields);
+}
+
+void bulk_receiver::on_data(std::span<hal::byte const> p_payload)
+{
+  auto const transfer_id = get_u32(p_payload, 0);
+  auto const offset = get_u32(p_payload, 4);
+  auto const sequence = get_u32(p_payload, 8);
+  auto const data = p_payload.subspan(data_fields_size);
+  auto const window = m_reorder.size();
+  progress current{};
+  bool open = false;
+  {
+    std::lock_guard lock(m_mutex);
+    current = m_progress;
+    open = m_open;
+  }
+  auto const received = current.received;
+
+  if (not open || transfer_id != current.transfer_id ||
+      offset > current.size || data.size() > current.size - offset) {
+    std::lock_guard lock(m_mutex);
+    m_statistics.ignored_frames++;
+    return;
+  }
+
+  auto const end = offset + data.size();
+  auto acknowledged_length = static_cast<hal::u32>(data.size());
+  {
+    std::lock_guard lock(m_mutex);
+    m_statistics.blocks_received++;
+    if (end <= received) {
+      m_statistics.duplicate_blocks++;
+    } else if (end > received + window) {
+      // Acknowledge what is complete, but not this block
+      m_statistics.ignored_frames++;
+      acknowledged_length = 0;
+    }
+  }
+
+  if (end > received && end <= received + window) {
+    for (auto position = std::max<usize>(offset, received); position < end;
+         position++) {
+      m_reorder[position % window] = data[position - offset];
+      m_present[position % window] = true;
+    }
+    deliver();
+  }
+
+  std::array<hal::byte, acknowledge_size> fields{};
+  put_u32(fields, 0, transfer_id);
+  put_u32(fields, 4, get_progress().received);
+  put_u32(fields, 8, offset);
+  put_u32(fields, 12, acknowledged_length);
+  put_u32(fields, 16, sequence);
+  write_frame(frame_acknowledge, fields);
+
+  std::lock_guard lock(m_mutex);
+  m_statistics.acknowledgements_sent++;
+}
+
+void bulk_receiver::deliver()
+{
+  auto const [transfer_id, size, start_received, complete] = get_progress();
+  auto const window = m_reorder.size();
+  auto received = start_received;
+
+  while (received < size && m_present[received % window]) {
+    auto const start = received % window;
+    usize run = 0;
+    while (received + run < size && start + run < window &&
+           m_present[start + run]) {
+      m_present[start + run] = false;
+      run++;
+    }
+    m_sink(received, std::span(m_reorder).subspan(start, run));
+    received += static_cast<hal::u32>(run);
+  }
+
+  std::lock_guard lock(m_mutex);
+  m_progress.received = received;
+  m_progress.complete = received == size;
+}
+
+void bulk_receiver::write_frame(hal::byte p_type,
+                                std::span<hal::byte const> p_fields)
+{
+  auto const size = build_frame(m_frame, p_type, p_fields, {});
+  m_link->write(std::span(m_frame).first(size));
+}
+}  // namespace hal::mac::inline v1
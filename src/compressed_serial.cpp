@@ -0,0 +1,601 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/compressed_serial.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+#include "frame_header.hpp"
+#include "receive_ring.hpp"
+
+namespace hal::mac::inline v1 {
+
+namespace {
+constexpr hal::byte frame_sync = 0xC5;
+constexpr hal::byte flag_stored = 1 << 0;
+constexpr hal::byte flag_independent = 1 << 1;
+
+// LZ4 block format limits
+constexpr usize min_match = 4;
+/// The last bytes of a block are always literals
+constexpr usize last_literals = 5;
+/// No match starts within this many bytes of the end of a block
+constexpr usize match_find_limit = 12;
+constexpr usize max_offset = std::numeric_limits<hal::u16>::max();
+constexpr hal::byte run_mask = 15;
+constexpr usize match_table_bits = 12;
+
+hal::u32 read_u32(std::span<hal::byte const> p_data, usize p_position)
+{
+  hal::u32 value = 0;
+  std::memcpy(&value, p_data.data() + p_position, sizeof(value));
+  return value;
+}
+
+usize match_table_index(hal::u32 p_sequence)
+{
+  return (p_sequence * 2654435761U) >> (32 - match_table_bits);
+}
+
+/**
+ * @brief Writes into a fixed output, remembering whether it overflowed
+ */
+struct block_writer
+{
+  void put(hal::byte p_byte)
+  {
+    if (size >= output.size()) {
+      overflow = true;
+      return;
+    }
+    output[size++] = p_byte;
+  }
+
+  void put(std::span<hal::byte const> p_data)
+  {
+    if (p_data.size() > output.size() - size) {
+      overflow = true;
+      return;
+    }
+    std::ranges::copy(p_data, output.begin() + size);
+    size += p_data.size();
+  }
+
+  /// Length beyond a token nibble, in LZ4's 255 byte steps
+  void put_length(usize p_length)
+  {
+    for (; p_length >= 255; p_length -= 255) {
+      put(255);
+    }
+    put(static_cast<hal::byte>(p_length));
+  }
+
+  std::span<hal::byte> output;
+  usize size = 0;
+  bool overflow = false;
+};
+
+void put_sequence(block_writer& p_writer,
+                  std::span<hal::byte const> p_literals,
+                  usize p_offset,
+                  usize p_match_length)
+{
+  auto const literal_nibble = std::min<usize>(p_literals.size(), run_mask);
+  auto const match_nibble =
+    p_match_length == 0 ? 0
+                        : std::min<usize>(p_match_length - min_match, run_mask);
+  p_writer.put(static_cast<hal::byte>(literal_nibble << 4 | match_nibble));
+  if (literal_nibble == run_mask) {
+    p_writer.put_length(p_literals.size() - run_mask);
+  }
+  p_writer.put(p_literals);
+
+  // The last sequence of a block has literals only
+  if (p_match_length == 0) {
+    return;
+  }
+  p_writer.put(static_cast<hal::byte>(p_offset & 0xFF));
+  p_writer.put(static_cast<hal::byte>(p_offset >> 8));
+  if (match_nibble == run_mask) {
+    p_writer.put_length(p_match_length - min_match - run_mask);
+  }
+}
+
+/**
+ * @brief Compress p_history[p_start, p_end) in the LZ4 block format
+ *
+ * Matches may start from p_dictionary on, so data before p_start serves as
+ * the dictionary.
+ *
+ * @return Size of the compressed block, 0 if it does not fit into p_output
+ */
+usize compress_block(std::span<hal::byte const> p_history,
+                     usize p_dictionary,
+                     usize p_start,
+                     usize p_end,
+                     std::span<hal::u32> p_table,
+                     std::span<hal::byte> p_output)
+{
+  block_writer writer{ .output = p_output };
+  usize anchor = p_start;
+  usize position = p_start;
+
+  while (position + match_find_limit <= p_end && not writer.overflow) {
+    auto const sequence = read_u32(p_history, position);
+    auto& entry = p_table[match_table_index(sequence)];
+    auto const candidate = entry;
+    entry = static_cast<hal::u32>(position + 1);
+
+    auto reference = static_cast<usize>(candidate) - 1;
+    if (candidate == 0 || reference < p_dictionary || reference >= position ||
+        position - reference > max_offset ||
+        read_u32(p_history, reference) != sequence) {
+      // Skip faster through data that does not compress
+      position += 1 + ((position - anchor) >> 6);
+      continue;
+    }
+
+    while (position > anchor && reference > p_dictionary &&
+           p_history[position - 1] == p_history[reference - 1]) {
+      position--;
+      reference--;
+    }
+    auto length = min_match;
+    while (position + length < p_end - last_literals &&
+           p_history[reference + length] == p_history[position + length]) {
+      length++;
+    }
+
+    put_sequence(writer,
+                 p_history.subspan(anchor, position - anchor),
+                 position - reference,
+                 length);
+    position += length;
+    anchor = position;
+    p_table[match_table_index(read_u32(p_history, position - 2))] =
+      static_cast<hal::u32>(position - 2 + 1);
+  }
+
+  put_sequence(writer, p_history.subspan(anchor, p_end - anchor), 0, 0);
+  return writer.overflow ? 0 : writer.size;
+}
+
+/**
+ * @brief Decompress an LZ4 block, appending to p_history at p_size
+ *
+ * Matches may refer to any data in the history before them.
+ *
+ * @return Whether the block was valid and fit within p_limit
+ */
+bool decompress_block(std::span<hal::byte const> p_block,
+                      std::span<hal::byte> p_history,
+                      usize& p_size,
+                      usize p_limit)
+{
+  usize input = 0;
+  auto output = p_size;
+
+  auto const read_length = [&](usize& p_length) {
+    hal::byte extra = 255;
+    while (extra == 255) {
+      if (input >= p_block.size()) {
+        return false;
+      }
+      extra = p_block[input++];
+      p_length += extra;
+    }
+    return true;
+  };
+
+  while (true) {
+    if (input >= p_block.size()) {
+      return false;
+    }
+    auto const token = p_block[input++];
+
+    usize literals = token >> 4;
+    if (literals == run_mask && not read_length(literals)) {
+      return false;
+    }
+    if (literals > p_block.size() - input || literals > p_limit - output) {
+      return false;
+    }
+    std::copy_n(p_block.begin() + input, literals, p_history.begin() + output);
+    input += literals;
+    output += literals;
+
+    if (input == p_block.size()) {
+      break;
+    }
+
+    if (p_block.size() - input < 2) {
+      return false;
+    }
+    auto const offset =
+      usize{ p_block[input] } | (usize{ p_block[input + 1] } << 8);
+    input += 2;
+    usize length = token & run_mask;
+    if (length == run_mask && not read_length(length)) {
+      return false;
+    }
+    length += min_match;
+    if (offset == 0 || offset > output || length > p_limit - output) {
+      return false;
+    }
+    // Byte by byte, matches may overlap the data they produce
+    for (usize i = 0; i < length; i++, output++) {
+      p_history[output] = p_history[output - offset];
+    }
+  }
+
+  p_size = output;
+  return true;
+}
+}  // namespace
+
+hal::v5::strong_ptr<compressed_serial> compressed_serial::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::v5::serial> p_link)
+{
+  return create(p_allocator, p_link, options{});
+}
+
+hal::v5::strong_ptr<compressed_serial> compressed_serial::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::v5::serial> p_link,
+  options const& p_options)
+{
+  if (p_options.receive_buffer_size == 0 || p_options.block_size == 0 ||
+      p_options.window_size == 0 || p_options.block_size > max_offset ||
+      p_options.window_size > max_offset) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<compressed_serial>(
+    p_allocator, p_allocator, p_link, p_options);
+}
+
+compressed_serial::compressed_serial(
+  hal::v5::strong_ptr_only_token,
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::v5::serial> p_link,
+  options const& p_options)
+  : m_link(p_link)
+  , m_options(p_options)
+  , m_transmit_history(p_options.window_size + p_options.block_size,
+                       0,
+                       p_allocator)
+  , m_match_table(usize{ 1 } << match_table_bits, 0, p_allocator)
+  , m_frame_out(frame_header_size + p_options.block_size, 0, p_allocator)
+  , m_link_cursor(m_link->receive_cursor())
+  , m_frame_in(p_options.block_size, 0, p_allocator)
+  , m_receive_history(p_options.window_size + p_options.block_size,
+                      0,
+                      p_allocator)
+  , m_receive_buffer(p_options.receive_buffer_size, 0, p_allocator)
+{
+  if (m_options.flush_delay.count() > 0) {
+    m_flush_thread =
+      std::thread(&compressed_serial::flush_thread_function, this);
+  }
+}
+
+compressed_serial::~compressed_serial()
+{
+  {
+    std::lock_guard lock(m_transmit_mutex);
+    m_stop_thread = true;
+  }
+  m_flush_requested.notify_all();
+  if (m_flush_thread.joinable()) {
+    m_flush_thread.join();
+  }
+
+  std::lock_guard lock(m_transmit_mutex);
+  if (m_pending > 0) {
+    try {
+      send_block();
+    } catch (...) {
+      // Nobody is left to report the error to
+    }
+  }
+}
+
+void compressed_serial::flush()
+{
+  std::lock_guard lock(m_transmit_mutex);
+  if (m_pending > 0) {
+    send_block();
+  }
+  if (m_deferred_error) {
+    std::rethrow_exception(std::exchange(m_deferred_error, nullptr));
+  }
+}
+
+void compressed_serial::service()
+{
+  std::lock_guard lock(m_receive_mutex);
+
+  auto const buffer = m_link->receive_buffer();
+  auto const cursor = m_link->receive_cursor();
+  if (cursor == m_link_cursor) {
+    return;
+  }
+
+  // Parse in place, in at most two pieces when the link's data wrapped
+  if (cursor > m_link_cursor) {
+    decompress(buffer.subspan(m_link_cursor, cursor - m_link_cursor));
+  } else {
+    decompress(buffer.subspan(m_link_cursor));
+    decompress(buffer.first(cursor));
+  }
+  m_link_cursor = cursor;
+}
+
+compressed_serial::statistics compressed_serial::get_statistics() const
+{
+  return {
+    .bytes_written = m_bytes_written.load(std::memory_order_relaxed),
+    .link_bytes_sent = m_link_bytes_sent.load(std::memory_order_relaxed),
+    .blocks_sent = m_blocks_sent.load(std::memory_order_relaxed),
+    .stored_blocks = m_stored_blocks.load(std::memory_order_relaxed),
+    .bytes_received = m_bytes_received.load(std::memory_order_relaxed),
+    .link_bytes_received =
+      m_link_bytes_received.load(std::memory_order_relaxed),
+    .blocks_received = m_blocks_received.load(std::memory_order_relaxed),
+    .corrupt_blocks = m_corrupt_blocks.load(std::memory_order_relaxed),
+    .header_errors = m_header_errors.load(std::memory_order_relaxed),
+  };
+}
+
+void compressed_serial::driver_configure(
+  hal::v5::serial::settings const& p_settings)
+{
+  m_link->configure(p_settings);
+}
+
+void compressed_serial::driver_write(std::span<hal::byte const> p_data)
+{
+  std::unique_lock lock(m_transmit_mutex);
+  if (m_deferred_error) {
+    std::rethrow_exception(std::exchange(m_deferred_error, nullptr));
+  }
+  m_bytes_written.fetch_add(p_data.size(), std::memory_order_relaxed);
+
+  bool const was_pending = m_pending > 0;
+  while (not p_data.empty()) {
+    if (m_pending == 0) {
+      slide_transmit_history();
+    }
+    auto const count =
+      std::min(p_data.size(), m_options.block_size - m_pending);
+    std::copy_n(p_data.begin(),
+                count,
+                m_transmit_history.begin() + m_transmit_history_size);
+    m_transmit_history_size += count;
+    m_pending += count;
+    p_data = p_data.subspan(count);
+
+    if (m_pending == m_options.block_size) {
+      send_block();
+    }
+  }
+
+  if (m_pending == 0) {
+    return;
+  }
+  if (m_options.flush_delay.count() == 0) {
+    send_block();
+    return;
+  }
+  if (not was_pending) {
+    // The block's delay starts with the first byte written into it
+    m_pending_since = std::chrono::steady_clock::now();
+    lock.unlock();
+    m_flush_requested.notify_all();
+  }
+}
+
+std::span<hal::byte const> compressed_serial::driver_receive_buffer()
+{
+  return m_receive_buffer;
+}
+
+usize compressed_serial::driver_cursor()
+{
+  service();
+  return m_receive_cursor.load(std::memory_order_acquire);
+}
+
+void compressed_serial::send_block()
+{
+  auto const end = m_transmit_history_size;
+  auto const start = end - m_pending;
+  bool const independent = m_options.independent_blocks || start == 0;
+  auto const dictionary =
+    independent ? start : start - std::min(start, m_options.window_size);
+
+  // Only a block that shrinks is sent compressed
+  auto const payload = std::span(m_frame_out).subspan(frame_header_size);
+  auto size = compress_block(m_transmit_history,
+                             dictionary,
+                             start,
+                             end,
+                             m_match_table,
+                             payload.first(m_pending - 1));
+  hal::byte flags = independent ? flag_independent : 0;
+  if (size == 0) {
+    size = m_pending;
+    flags |= flag_stored;
+    std::copy_n(m_transmit_history.begin() + start, size, payload.begin());
+  }
+  m_pending = 0;
+
+  write_frame_header(m_frame_out, frame_sync, flags, size);
+
+  try {
+    m_link->write(std::span(m_frame_out).first(frame_header_size + size));
+  } catch (...) {
+    // The peer never saw this block, so the next one must not refer to it
+    m_transmit_history_size = 0;
+    throw;
+  }
+
+  m_link_bytes_sent.fetch_add(frame_header_size + size,
+                              std::memory_order_relaxed);
+  m_blocks_sent.fetch_add(1, std::memory_order_relaxed);
+  if ((flags & flag_stored) != 0) {
+    m_stored_blocks.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void compressed_serial::slide_transmit_history()
+{
+  if (m_options.independent_blocks) {
+    m_transmit_history_size = 0;
+    return;
+  }
+  if (m_transmit_history_size + m_options.block_size <=
+      m_transmit_history.size()) {
+    return;
+  }
+
+  auto const keep = std::min(m_transmit_history_size, m_options.window_size);
+  auto const shift = m_transmit_history_size - keep;
+  std::copy_n(m_transmit_history.begin() + shift,
+              keep,
+              m_transmit_history.begin());
+  m_transmit_history_size = keep;
+  for (auto& entry : m_match_table) {
+    entry = entry > shift ? static_cast<hal::u32>(entry - shift) : 0;
+  }
+}
+
+void compressed_serial::decompress(std::span<hal::byte const> p_data)
+{
+  m_link_bytes_received.fetch_add(p_data.size(), std::memory_order_relaxed);
+
+  while (not p_data.empty()) {
+    if (m_payload_remaining > 0) {
+      auto const count = std::min(m_payload_remaining, p_data.size());
+      if (m_keep_payload) {
+        std::copy_n(
+          p_data.begin(), count, m_frame_in.begin() + m_frame_in_size);
+        m_frame_in_size += count;
+      }
+      m_payload_remaining -= count;
+      p_data = p_data.subspan(count);
+      if (m_payload_remaining == 0) {
+        receive_block(m_payload_flags);
+      }
+      continue;
+    }
+
+    auto const scan =
+      read_frame_header(frame_sync, m_header, m_header_size, p_data);
+    m_header_errors.fetch_add(scan.rejected, std::memory_order_relaxed);
+    if (not scan.header) {
+      continue;
+    }
+
+    m_payload_flags = scan.header->type;
+    m_payload_remaining = scan.header->length;
+    m_keep_payload = m_payload_remaining <= m_frame_in.size();
+    m_frame_in_size = 0;
+    if (m_payload_remaining == 0) {
+      receive_block(m_payload_flags);
+    }
+  }
+}
+
+void compressed_serial::receive_block(hal::byte p_flags)
+{
+  m_blocks_received.fetch_add(1, std::memory_order_relaxed);
+
+  bool const independent = (p_flags & flag_independent) != 0;
+  if (not m_keep_payload || (not independent && not m_history_valid)) {
+    m_corrupt_blocks.fetch_add(1, std::memory_order_relaxed);
+    m_history_valid = false;
+    return;
+  }
+
+  if (independent) {
+    m_receive_history_size = 0;
+  } else if (m_receive_history_size + m_options.block_size >
+             m_receive_history.size()) {
+    auto const keep = std::min(m_receive_history_size, m_options.window_size);
+    std::copy_n(m_receive_history.begin() + m_receive_history_size - keep,
+                keep,
+                m_receive_history.begin());
+    m_receive_history_size = keep;
+  }
+
+  auto const block = std::span(m_frame_in).first(m_frame_in_size);
+  auto const start = m_receive_history_size;
+  auto size = start;
+  if ((p_flags & flag_stored) != 0) {
+    std::ranges::copy(block, m_receive_history.begin() + start);
+    size += block.size();
+  } else if (not decompress_block(block,
+                                  m_receive_history,
+                                  size,
+                                  start + m_options.block_size)) {
+    m_corrupt_blocks.fetch_add(1, std::memory_order_relaxed);
+    m_history_valid = false;
+    return;
+  }
+
+  m_receive_history_size = size;
+  m_history_valid = true;
+  publish(std::span(m_receive_history).subspan(start, size - start));
+}
+
+void compressed_serial::publish(std::span<hal::byte const> p_data)
+{
+  m_bytes_received.fetch_add(p_data.size(), std::memory_order_relaxed);
+  publish_to_ring(m_receive_buffer, m_receive_cursor, p_data);
+}
+
+void compressed_serial::flush_thread_function()
+{
+  std::unique_lock lock(m_transmit_mutex);
+
+  while (true) {
+    m_flush_requested.wait(
+      lock, [this]() { return m_stop_thread || m_pending > 0; });
+    if (m_stop_thread) {
+      return;
+    }
+
+    auto const deadline = m_pending_since + m_options.flush_delay;
+    if (std::chrono::steady_clock::now() < deadline) {
+      // A write or flush may send the block meanwhile, so check again
+      m_flush_requested.wait_until(lock, deadline);
+      continue;
+    }
+
+    try {
+      send_block();
+    } catch (...) {
+      m_deferred_error = std::current_exception();
+    }
+  }
+}
+}  // namespace hal::mac::inline v1
@@ -14,40 +14,220 @@
 
 #include <libhal-mac/console.hpp>
 
-#include <chrono>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
 #include <cstdio>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <unistd.h>
 
 #include <libhal/error.hpp>
 
+#include "gather_write.hpp"
+
 namespace hal::mac::inline v1 {
 
+namespace {
+/// Signals whose default action ends the process with the terminal left as is
+constexpr std::array restore_signals{ SIGINT, SIGTERM, SIGHUP, SIGQUIT };
+
+/**
+ * @brief Terminal attributes the signal handler restores
+ *
+ * The handler may only call async-signal-safe functions, so the attributes
+ * live in a fixed table instead of behind a lock.
+ */
+struct saved_terminal
+{
+  std::atomic<bool> in_use{ false };
+  /// Terminal descriptor, -1 until the attributes are written
+  std::atomic<int> fd{ -1 };
+  termios attributes{};
+};
+
+std::array<saved_terminal, 8> saved_terminals;
+
+void restore_terminals_handler(int p_signal)
+{
+  for (auto& terminal : saved_terminals) {
+    int const fd = terminal.fd.load(std::memory_order_acquire);
+    if (fd >= 0) {
+      ::tcsetattr(fd, TCSANOW, &terminal.attributes);
+    }
+  }
+  // SA_RESETHAND brought back the default action, which ends the process once
+  // this handler returns
+  ::raise(p_signal);
+}
+
+void install_restore_handlers()
+{
+  static std::once_flag installed;
+  std::call_once(installed, []() {
+    for (int const signal : restore_signals) {
+      struct sigaction current{};
+      // Applications that handle the signal themselves get to shut down
+      // normally, which runs the console's destructor
+      if (::sigaction(signal, nullptr, &current) != 0 ||
+          current.sa_handler != SIG_DFL) {
+        continue;
+      }
+      struct sigaction action{};
+      action.sa_handler = restore_terminals_handler;
+      ::sigemptyset(&action.sa_mask);
+      action.sa_flags = SA_RESETHAND;
+      ::sigaction(signal, &action, nullptr);
+    }
+  });
+}
+
+/**
+ * @brief Record terminal attributes for the signal handler
+ *
+ * @return Slot to release, empty if the table is full
+ */
+std::optional<hal::usize> save_for_signals(int p_fd,
+                                           termios const& p_attributes)
+{
+  for (hal::usize slot = 0; slot < saved_terminals.size(); slot++) {
+    auto& terminal = saved_terminals[slot];
+    bool expected = false;
+    if (terminal.in_use.compare_exchange_strong(
+          expected, true, std::memory_order_acq_rel)) {
+      terminal.attributes = p_attributes;
+      terminal.fd.store(p_fd, std::memory_order_release);
+      return slot;
+    }
+  }
+  return std::nullopt;
+}
+
+void release_for_signals(hal::usize p_slot)
+{
+  saved_terminals[p_slot].fd.store(-1, std::memory_order_release);
+  saved_terminals[p_slot].in_use.store(false, std::memory_order_release);
+}
+}  // namespace
+
 hal::v5::strong_ptr<console_serial> console_serial::create(
   std::pmr::polymorphic_allocator<> p_allocator,
   hal::usize p_buffer_size)
 {
+  return create(p_allocator, p_buffer_size, options{});
+}
+
+hal::v5::strong_ptr<console_serial> console_serial::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::usize p_buffer_size,
+  options const& p_options)
+{
+  if (p_buffer_size == 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
   if (p_buffer_size < 32) {
     p_buffer_size = 32;
   }
 
   return hal::v5::make_strong_ptr<console_serial>(
-    p_allocator, p_allocator, p_buffer_size);
+    p_allocator, p_allocator, p_buffer_size, p_options);
 }
 
 console_serial::console_serial(hal::v5::strong_ptr_only_token,
                                std::pmr::polymorphic_allocator<> p_allocator,
-                               hal::usize p_buffer_size)
+                               hal::usize p_buffer_size,
+                               options const& p_options)
   : m_allocator(p_allocator)
   , m_receive_buffer(p_buffer_size, hal::byte{ 0 }, p_allocator)
-  , m_receive_thread(&console_serial::receive_thread_function, this)
+  , m_options(p_options)
 {
+  enter_terminal_mode();
+
+  if (::pipe(m_wake_pipe.data()) != 0) {
+    restore_terminal();
+    throw hal::operation_not_permitted(this);
+  }
+
+  for (int const fd : m_wake_pipe) {
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+
+  try {
+    m_receive_thread = scheduled_thread(
+      m_options.receive_thread.thread, [this]() { receive_thread_function(); });
+  } catch (...) {
+    ::close(m_wake_pipe[0]);
+    ::close(m_wake_pipe[1]);
+    restore_terminal();
+    throw;
+  }
 }
 
 console_serial::~console_serial()
 {
   m_stop_thread.store(true, std::memory_order_release);
+  char const token = 0;
+  [[maybe_unused]] auto const result = ::write(m_wake_pipe[1], &token, 1);
   if (m_receive_thread.joinable()) {
     m_receive_thread.join();
   }
+  ::close(m_wake_pipe[0]);
+  ::close(m_wake_pipe[1]);
+  restore_terminal();
+}
+
+void console_serial::enter_terminal_mode()
+{
+  int const fd = m_options.input_fd;
+  if (m_options.mode == terminal_mode::unchanged || not ::isatty(fd)) {
+    return;
+  }
+
+  termios original{};
+  if (::tcgetattr(fd, &original) != 0) {
+    throw hal::operation_not_permitted(this);
+  }
+
+  auto attributes = original;
+  if (m_options.mode == terminal_mode::raw) {
+    ::cfmakeraw(&attributes);
+  } else {
+    attributes.c_lflag &= ~static_cast<tcflag_t>(ICANON | ECHO);
+  }
+  // Return from read() as soon as a single byte arrived
+  attributes.c_cc[VMIN] = 1;
+  attributes.c_cc[VTIME] = 0;
+
+  // Registered first so a signal arriving right after tcsetattr() is covered
+  install_restore_handlers();
+  m_restore_slot = save_for_signals(fd, original);
+
+  if (::tcsetattr(fd, TCSANOW, &attributes) != 0) {
+    if (m_restore_slot) {
+      release_for_signals(*m_restore_slot);
+      m_restore_slot.reset();
+    }
+    throw hal::operation_not_permitted(this);
+  }
+
+  m_saved_terminal = original;
+}
+
+void console_serial::restore_terminal()
+{
+  if (m_restore_slot) {
+    release_for_signals(*m_restore_slot);
+    m_restore_slot.reset();
+  }
+
+  if (m_saved_terminal) {
+    // Let output written in the current mode drain before switching back
+    ::tcsetattr(m_options.input_fd, TCSADRAIN, &*m_saved_terminal);
+    m_saved_terminal.reset();
+  }
 }
 
 void console_serial::driver_configure(
@@ -59,9 +239,24 @@ void console_serial::driver_configure(
 
 void console_serial::driver_write(std::span<hal::byte const> p_data)
 {
-  // Use fwrite to stdout for binary safety
-  std::fwrite(p_data.data(), 1, p_data.size(), stdout);
+  std::array<std::span<hal::byte const>, 1> const buffers{ p_data };
+  write(buffers);
+}
+
+void console_serial::write(
+  std::span<std::span<hal::byte const> const> p_buffers)
+{
+  // Output still sitting in stdio's buffer must go out first
   std::fflush(stdout);
+  int const fd = m_options.output_fd;
+
+  write_gathered(fd, p_buffers, [this, fd](int p_error) {
+    if (p_error != EAGAIN && p_error != EWOULDBLOCK) {
+      throw hal::io_error(this);
+    }
+    pollfd descriptor{ .fd = fd, .events = POLLOUT, .revents = 0 };
+    ::poll(&descriptor, 1, -1);
+  });
 }
 
 std::span<hal::byte const> console_serial::driver_receive_buffer()
@@ -74,21 +269,73 @@ hal::usize console_serial::driver_cursor()
   return m_receive_cursor.load(std::memory_order_acquire);
 }
 
+int console_serial::readiness_handle() const
+{
+  return m_readiness.native_handle();
+}
+
+void console_serial::acknowledge_readiness()
+{
+  m_readiness.acknowledge();
+}
+
 void console_serial::receive_thread_function()
 {
-  while (!m_stop_thread.load(std::memory_order_acquire)) {
-    int ch = std::getchar();
+  int const fd = m_options.input_fd;
+  // A terminal reports end of file for each Ctrl+D and keeps working until it
+  // hangs up, any other descriptor stays at end of file
+  bool const terminal = ::isatty(fd);
+  std::array<pollfd, 2> descriptors{ {
+    { .fd = fd, .events = POLLIN, .revents = 0 },
+    { .fd = m_wake_pipe[0], .events = POLLIN, .revents = 0 },
+  } };
+
+  int const timeout = m_options.receive_thread.busy_poll ? 0 : -1;
 
-    if (ch != EOF) {
-      auto current_cursor = m_receive_cursor.load(std::memory_order_acquire);
-      m_receive_buffer[current_cursor] = static_cast<hal::byte>(ch);
+  while (not m_stop_thread.load(std::memory_order_acquire)) {
+    if (::poll(descriptors.data(), descriptors.size(), timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+
+    if (descriptors[1].revents != 0) {
+      return;
+    }
 
-      auto new_cursor = (current_cursor + 1) % m_receive_buffer.size();
-      m_receive_cursor.store(new_cursor, std::memory_order_release);
-    } else {
-      // No data available, sleep briefly to avoid busy waiting
-      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (descriptors[0].revents == 0) {
+      continue;
     }
+
+    // Read straight into the ring, up to its end, so each keystroke is
+    // published as soon as the terminal hands it over. A read moving the
+    // cursor a full lap would look like nothing was received, so one byte of
+    // the ring stays free.
+    auto const size = m_receive_buffer.size();
+    auto const cursor = m_receive_cursor.load(std::memory_order_relaxed);
+    auto const limit = std::max<hal::usize>(size - 1, 1);
+    auto const bytes_read =
+      ::read(fd, &m_receive_buffer[cursor], std::min(size - cursor, limit));
+
+    if (bytes_read < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+        continue;
+      }
+      return;
+    }
+
+    if (bytes_read == 0) {
+      if (terminal && (descriptors[0].revents & POLLHUP) == 0) {
+        continue;
+      }
+      return;
+    }
+
+    auto const new_cursor =
+      (cursor + static_cast<hal::usize>(bytes_read)) % size;
+    m_receive_cursor.store(new_cursor, std::memory_order_release);
+    m_readiness.signal();
   }
 }
 
@@ -0,0 +1,200 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/event_loop.hpp>
+
+#include <algorithm>
+#include <array>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <unistd.h>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+namespace hal::mac::inline v1 {
+
+hal::v5::strong_ptr<event_loop> event_loop::create(
+  std::pmr::polymorphic_allocator<> p_allocator)
+{
+  return hal::v5::make_strong_ptr<event_loop>(p_allocator, p_allocator);
+}
+
+event_loop::event_loop(hal::v5::strong_ptr_only_token,
+                       std::pmr::polymorphic_allocator<> p_allocator)
+  : m_allocator(p_allocator)
+  , m_ready(p_allocator)
+  , m_resuming(p_allocator)
+  , m_writable_waits(p_allocator)
+  , m_writable_ready(p_allocator)
+{
+  if (::pipe(m_wake_pipe.data()) != 0) {
+    throw hal::operation_not_permitted(this);
+  }
+
+  for (int const fd : m_wake_pipe) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+}
+
+event_loop::~event_loop()
+{
+  ::close(m_wake_pipe[0]);
+  ::close(m_wake_pipe[1]);
+}
+
+void event_loop::spawn(task<void> p_task)
+{
+  m_active_tasks.fetch_add(1, std::memory_order_relaxed);
+  auto runner = run_spawned(std::allocator_arg, m_allocator, std::move(p_task));
+  post(runner.handle);
+}
+
+detail::detached_task event_loop::run_spawned(
+  std::allocator_arg_t,
+  std::pmr::polymorphic_allocator<>,
+  task<void> p_task)
+{
+  try {
+    co_await p_task;
+  } catch (...) {
+    if (not m_error) {
+      m_error = std::current_exception();
+    }
+  }
+  m_active_tasks.fetch_sub(1, std::memory_order_release);
+}
+
+void event_loop::run()
+{
+  m_stop.store(false, std::memory_order_relaxed);
+
+  while (m_active_tasks.load(std::memory_order_acquire) > 0 &&
+         not m_stop.load(std::memory_order_acquire)) {
+    {
+      std::lock_guard lock(m_mutex);
+      std::swap(m_ready, m_resuming);
+    }
+
+    if (m_resuming.empty()) {
+      wait_for_events();
+      continue;
+    }
+
+    for (auto const handle : m_resuming) {
+      handle.resume();
+    }
+    m_resuming.clear();
+  }
+
+  if (m_error) {
+    std::rethrow_exception(std::exchange(m_error, nullptr));
+  }
+}
+
+void event_loop::stop()
+{
+  std::lock_guard lock(m_mutex);
+  m_stop.store(true, std::memory_order_release);
+  char const token = 0;
+  [[maybe_unused]] auto const result = ::write(m_wake_pipe[1], &token, 1);
+}
+
+void event_loop::driver_post(std::coroutine_handle<> p_handle)
+{
+  std::lock_guard lock(m_mutex);
+  m_ready.push_back(p_handle);
+
+  if (m_sleeping) {
+    // One byte is enough to end the poll(), later posts skip the write
+    m_sleeping = false;
+    char const token = 0;
+    [[maybe_unused]] auto const result = ::write(m_wake_pipe[1], &token, 1);
+  }
+}
+
+void event_loop::driver_wait_writable(int p_fd,
+                                      hal::callback<void()> p_handler)
+{
+  std::lock_guard lock(m_mutex);
+  m_writable_waits.push_back({ .fd = p_fd, .handler = std::move(p_handler) });
+}
+
+void event_loop::wait_for_events()
+{
+  // Descriptors passed to poll(), the wakeup pipe is always the first. Ports
+  // waiting for writability are few, so a fixed upper bound keeps the wait
+  // allocation free.
+  constexpr usize max_descriptors = 64;
+  std::array<pollfd, max_descriptors> descriptors{};
+  nfds_t descriptor_count = 0;
+
+  {
+    std::lock_guard lock(m_mutex);
+    if (not m_ready.empty() || m_stop.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    descriptors[descriptor_count++] = {
+      .fd = m_wake_pipe[0], .events = POLLIN, .revents = 0
+    };
+    for (auto const& wait : m_writable_waits) {
+      if (descriptor_count == descriptors.size()) {
+        break;
+      }
+      descriptors[descriptor_count++] = {
+        .fd = wait.fd, .events = POLLOUT, .revents = 0
+      };
+    }
+    m_sleeping = true;
+  }
+
+  ::poll(descriptors.data(), descriptor_count, -1);
+
+  std::array<char, 64> drain;
+  while (::read(m_wake_pipe[0], drain.data(), drain.size()) > 0) {
+  }
+
+  {
+    std::lock_guard lock(m_mutex);
+    m_sleeping = false;
+
+    auto const first_ready = std::stable_partition(
+      m_writable_waits.begin(),
+      m_writable_waits.end(),
+      [&descriptors, descriptor_count](writable_wait const& p_wait) {
+        // Errors and hangups count as writable, the handler's write reports
+        // them.
+        auto const end = descriptors.begin() + descriptor_count;
+        return std::none_of(
+          descriptors.begin() + 1, end, [&p_wait](pollfd const& p_entry) {
+            return p_entry.fd == p_wait.fd && p_entry.revents != 0;
+          });
+      });
+
+    for (auto wait = first_ready; wait != m_writable_waits.end(); wait++) {
+      m_writable_ready.push_back(std::move(wait->handler));
+    }
+    m_writable_waits.erase(first_ready, m_writable_waits.end());
+  }
+
+  // Handlers run without the lock so they can wait again
+  for (auto& handler : m_writable_ready) {
+    handler();
+  }
+  m_writable_ready.clear();
+}
+}  // namespace hal::mac::inline v1
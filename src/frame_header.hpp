@@ -0,0 +1,152 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <span>
+
+#include <libhal/units.hpp>
+
+// The 5 byte frame header shared by serial_mux, compressed_serial and
+// bulk_sender/bulk_receiver. Only the sync byte differs between them:
+//
+// | Byte | Content                                       |
+// |------|-----------------------------------------------|
+// | 0    | Sync byte, marks the start of a frame         |
+// | 1    | Type of the frame, e.g. the channel or flags  |
+// | 2..3 | Length of what follows, little endian         |
+// | 4    | Check byte, XOR of bytes 1 to 3 and 0x5A      |
+
+namespace hal::mac::inline v1 {
+constexpr usize frame_header_size = 5;
+
+/**
+ * @brief Fields of a frame header that passed its check
+ */
+struct frame_header
+{
+  hal::byte type;
+  usize length;
+};
+
+/**
+ * @brief Result of read_frame_header()
+ */
+struct frame_header_scan
+{
+  /// The completed header, nothing if the data ran out first
+  std::optional<frame_header> header;
+  /// Bytes dropped while searching for a sync byte
+  usize discarded = 0;
+  /// Headers dropped because their check byte did not match
+  usize rejected = 0;
+};
+
+[[nodiscard]] constexpr hal::byte frame_header_check(hal::byte p_type,
+                                                     hal::byte p_length_low,
+                                                     hal::byte p_length_high)
+{
+  return static_cast<hal::byte>(p_type ^ p_length_low ^ p_length_high ^ 0x5A);
+}
+
+/**
+ * @brief Write a frame header to the start of p_frame
+ *
+ * @param p_frame Frame, at least frame_header_size bytes
+ * @param p_sync Sync byte of the protocol
+ * @param p_type Type of the frame
+ * @param p_length Length of what follows the header, at most 65535
+ */
+inline void write_frame_header(std::span<hal::byte> p_frame,
+                               hal::byte p_sync,
+                               hal::byte p_type,
+                               usize p_length)
+{
+  p_frame[0] = p_sync;
+  p_frame[1] = p_type;
+  p_frame[2] = static_cast<hal::byte>(p_length & 0xFF);
+  p_frame[3] = static_cast<hal::byte>(p_length >> 8);
+  p_frame[4] = frame_header_check(p_frame[1], p_frame[2], p_frame[3]);
+}
+
+/**
+ * @brief Parse received data until a frame header is complete
+ *
+ * Bytes before a sync byte are skipped. A header that fails its check is
+ * dropped and the search for the next sync byte resumes within it, so a
+ * corrupt byte costs at most the frame it hit.
+ *
+ * @param p_sync Sync byte of the protocol
+ * @param p_header Bytes of the header received so far, holds the whole
+ * header once one completed
+ * @param p_header_size Number of bytes in p_header
+ * @param p_data Received data, advanced past the bytes used. Once a header
+ * completed, it starts with what follows the header.
+ * @return The completed header and what was dropped on the way
+ */
+inline frame_header_scan read_frame_header(
+  hal::byte p_sync,
+  std::array<hal::byte, frame_header_size>& p_header,
+  usize& p_header_size,
+  std::span<hal::byte const>& p_data)
+{
+  frame_header_scan scan;
+
+  while (not p_data.empty()) {
+    if (p_header_size == 0) {
+      auto const sync = std::ranges::find(p_data, p_sync);
+      auto const skipped = static_cast<usize>(sync - p_data.begin());
+      scan.discarded += skipped;
+      p_data = p_data.subspan(skipped);
+      if (p_data.empty()) {
+        break;
+      }
+    }
+
+    auto const count =
+      std::min(frame_header_size - p_header_size, p_data.size());
+    std::copy_n(p_data.begin(), count, p_header.begin() + p_header_size);
+    p_header_size += count;
+    p_data = p_data.subspan(count);
+    if (p_header_size < frame_header_size) {
+      continue;
+    }
+
+    auto const check =
+      frame_header_check(p_header[1], p_header[2], p_header[3]);
+    if (p_header[4] != check) {
+      // Resynchronize on the next sync byte within the rejected header
+      scan.rejected++;
+      auto const rest = std::span(p_header).subspan(1);
+      auto const sync = std::ranges::find(rest, p_sync);
+      scan.discarded += 1 + static_cast<usize>(sync - rest.begin());
+      p_header_size = static_cast<usize>(rest.end() - sync);
+      std::copy(sync, rest.end(), p_header.begin());
+      continue;
+    }
+
+    p_header_size = 0;
+    scan.header = frame_header{
+      .type = p_header[1],
+      .length = p_header[2] | (usize{ p_header[3] } << 8),
+    };
+    break;
+  }
+
+  return scan;
+}
+}  // namespace hal::mac::inline v1
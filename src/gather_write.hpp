@@ -0,0 +1,95 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <span>
+#include <sys/uio.h>
+
+#include <libhal/units.hpp>
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Write a list of buffers to a descriptor with writev()
+ *
+ * Up to 16 buffers are handed over per writev() call, enough for typical
+ * header + payload + trailer messages while keeping the vector on the
+ * stack. Longer lists take a call per batch. A partial write resumes mid
+ * buffer and interrupted calls are retried.
+ *
+ * @param p_fd Descriptor to write to
+ * @param p_buffers Buffers to write in order, empty ones are skipped
+ * @param p_on_error Called with errno when writev() fails for any other
+ * reason than an interrupt. Returning retries the call, for example once the
+ * descriptor is writable again after EAGAIN, otherwise it throws.
+ * @return Number of writev() calls made
+ */
+template<typename ErrorHandler>
+usize write_gathered(int p_fd,
+                     std::span<std::span<hal::byte const> const> p_buffers,
+                     ErrorHandler&& p_on_error)
+{
+  constexpr int max_batch = 16;
+  std::array<iovec, max_batch> vectors{};
+  // Position of the first unwritten byte
+  usize index = 0;
+  usize offset = 0;
+  usize calls = 0;
+
+  while (true) {
+    while (index < p_buffers.size() && offset == p_buffers[index].size()) {
+      index++;
+      offset = 0;
+    }
+
+    if (index == p_buffers.size()) {
+      return calls;
+    }
+
+    int count = 0;
+    for (usize i = index; i < p_buffers.size() && count < max_batch; i++) {
+      auto const part =
+        i == index ? p_buffers[i].subspan(offset) : p_buffers[i];
+      if (not part.empty()) {
+        vectors[count++] = { .iov_base = const_cast<hal::byte*>(part.data()),
+                             .iov_len = part.size() };
+      }
+    }
+
+    auto const bytes_written = ::writev(p_fd, vectors.data(), count);
+    calls++;
+    if (bytes_written < 0) {
+      if (errno != EINTR) {
+        p_on_error(errno);
+      }
+      continue;
+    }
+
+    // Step over the accepted bytes, a partial write may end mid buffer
+    auto remaining = static_cast<usize>(bytes_written);
+    while (remaining > 0) {
+      auto const available = p_buffers[index].size() - offset;
+      if (remaining < available) {
+        offset += remaining;
+        break;
+      }
+      remaining -= available;
+      index++;
+      offset = 0;
+    }
+  }
+}
+}  // namespace hal::mac::inline v1
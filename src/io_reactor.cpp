@@ -0,0 +1,244 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/io_reactor.hpp>
+
+#include <array>
+#include <cerrno>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#elif defined(__APPLE__)
+#include <sys/event.h>
+#endif
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+namespace hal::mac::inline v1 {
+
+namespace {
+/// Most readiness events harvested by a single wait system call
+constexpr int max_events_per_wait = 64;
+}  // anonymous namespace
+
+hal::v5::strong_ptr<io_reactor> io_reactor::create(
+  std::pmr::polymorphic_allocator<> p_allocator)
+{
+  return hal::v5::make_strong_ptr<io_reactor>(p_allocator, p_allocator);
+}
+
+io_reactor::io_reactor(hal::v5::strong_ptr_only_token,
+                       std::pmr::polymorphic_allocator<> p_allocator)
+  : m_handlers(p_allocator)
+{
+  if (::pipe(m_wake_pipe.data()) != 0) {
+    throw hal::operation_not_permitted(this);
+  }
+
+  for (int const fd : m_wake_pipe) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+
+  bool poller_ready = true;
+#if defined(__linux__)
+  m_poller = ::epoll_create1(EPOLL_CLOEXEC);
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = m_wake_pipe[0];
+  poller_ready =
+    m_poller != -1 &&
+    ::epoll_ctl(m_poller, EPOLL_CTL_ADD, m_wake_pipe[0], &event) == 0;
+#elif defined(__APPLE__)
+  m_poller = ::kqueue();
+  struct kevent change{};
+  EV_SET(&change, m_wake_pipe[0], EVFILT_READ, EV_ADD, 0, 0, nullptr);
+  poller_ready = m_poller != -1 &&
+                 ::kevent(m_poller, &change, 1, nullptr, 0, nullptr) == 0;
+#endif
+
+  if (not poller_ready) {
+    // The destructor does not run for a throwing constructor
+    if (m_poller != -1) {
+      ::close(m_poller);
+    }
+    ::close(m_wake_pipe[0]);
+    ::close(m_wake_pipe[1]);
+    throw hal::operation_not_permitted(this);
+  }
+
+  m_thread = std::thread(&io_reactor::reactor_thread_function, this);
+}
+
+io_reactor::~io_reactor()
+{
+  m_stop_thread.store(true, std::memory_order_release);
+  wake();
+
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+
+  if (m_poller != -1) {
+    ::close(m_poller);
+  }
+  ::close(m_wake_pipe[0]);
+  ::close(m_wake_pipe[1]);
+}
+
+void io_reactor::watch(int p_fd, hal::callback<handler> p_handler)
+{
+  std::lock_guard lock(m_mutex);
+
+#if defined(__linux__)
+  // Level triggered, a handler that does not drain the descriptor is simply
+  // called again on the next wait.
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = p_fd;
+  if (::epoll_ctl(m_poller, EPOLL_CTL_ADD, p_fd, &event) != 0) {
+    throw hal::operation_not_permitted(this);
+  }
+#elif defined(__APPLE__)
+  struct kevent change{};
+  EV_SET(&change, p_fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+  if (::kevent(m_poller, &change, 1, nullptr, 0, nullptr) != 0) {
+    throw hal::operation_not_permitted(this);
+  }
+#endif
+
+  m_handlers.insert_or_assign(p_fd, std::move(p_handler));
+
+#if !defined(__linux__) && !defined(__APPLE__)
+  // The poll() fallback only picks up new descriptors when it rebuilds its
+  // descriptor list
+  wake();
+#endif
+}
+
+void io_reactor::unwatch(int p_fd)
+{
+  std::lock_guard lock(m_mutex);
+  if (m_handlers.erase(p_fd) != 0) {
+    remove_from_poller(p_fd);
+  }
+}
+
+io_reactor::statistics io_reactor::get_statistics() const
+{
+  return statistics{
+    .wait_calls = m_wait_calls.load(std::memory_order_relaxed),
+    .events = m_events.load(std::memory_order_relaxed),
+  };
+}
+
+void io_reactor::wake()
+{
+  char const token = 0;
+  // A full pipe already guarantees a wakeup, so the result does not matter
+  [[maybe_unused]] auto const result = ::write(m_wake_pipe[1], &token, 1);
+}
+
+void io_reactor::remove_from_poller([[maybe_unused]] int p_fd)
+{
+#if defined(__linux__)
+  ::epoll_ctl(m_poller, EPOLL_CTL_DEL, p_fd, nullptr);
+#elif defined(__APPLE__)
+  struct kevent change{};
+  EV_SET(&change, p_fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+  ::kevent(m_poller, &change, 1, nullptr, 0, nullptr);
+#endif
+}
+
+void io_reactor::reactor_thread_function()
+{
+  std::array<int, max_events_per_wait> ready{};
+#if defined(__linux__)
+  std::array<epoll_event, max_events_per_wait> events{};
+#elif defined(__APPLE__)
+  std::array<struct kevent, max_events_per_wait> events{};
+#else
+  std::vector<pollfd> descriptors;
+#endif
+
+  while (!m_stop_thread.load(std::memory_order_acquire)) {
+    int ready_count = 0;
+
+#if defined(__linux__)
+    int const result =
+      ::epoll_wait(m_poller, events.data(), max_events_per_wait, -1);
+    for (int i = 0; i < result; i++) {
+      ready[ready_count++] = events[i].data.fd;
+    }
+#elif defined(__APPLE__)
+    int const result = ::kevent(
+      m_poller, nullptr, 0, events.data(), max_events_per_wait, nullptr);
+    for (int i = 0; i < result; i++) {
+      ready[ready_count++] = static_cast<int>(events[i].ident);
+    }
+#else
+    descriptors.clear();
+    descriptors.push_back({ .fd = m_wake_pipe[0], .events = POLLIN });
+    {
+      std::lock_guard lock(m_mutex);
+      for (auto const& [fd, handler] : m_handlers) {
+        descriptors.push_back({ .fd = fd, .events = POLLIN });
+      }
+    }
+    int const result =
+      ::poll(descriptors.data(), static_cast<nfds_t>(descriptors.size()), -1);
+    for (auto const& descriptor : descriptors) {
+      if (descriptor.revents != 0 && ready_count < max_events_per_wait) {
+        ready[ready_count++] = descriptor.fd;
+      }
+    }
+#endif
+
+    m_wait_calls.fetch_add(1, std::memory_order_relaxed);
+    if (result < 0) {
+      continue;
+    }
+
+    std::lock_guard lock(m_mutex);
+    for (int i = 0; i < ready_count; i++) {
+      int const fd = ready[i];
+
+      if (fd == m_wake_pipe[0]) {
+        std::array<char, 64> drain;
+        while (::read(fd, drain.data(), drain.size()) > 0) {
+        }
+        continue;
+      }
+
+      // The descriptor may have been unwatched after the wait returned
+      auto const entry = m_handlers.find(fd);
+      if (entry == m_handlers.end()) {
+        continue;
+      }
+
+      m_events.fetch_add(1, std::memory_order_relaxed);
+      if (not entry->second()) {
+        remove_from_poller(fd);
+        m_handlers.erase(entry);
+      }
+    }
+  }
+}
+}  // namespace hal::mac::inline v1
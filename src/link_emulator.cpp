@@ -0,0 +1,341 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/link_emulator.hpp>
+
+#include <algorithm>
+#include <utility>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+#include "receive_ring.hpp"
+
+namespace hal::mac::inline v1 {
+
+namespace {
+/// Bits on the line per byte: start bit, 8 data bits and stop bit
+constexpr hal::u64 bits_per_byte = 10;
+/// Bytes handed over at once, like a UART receive FIFO
+constexpr usize burst_size = 16;
+
+usize index_of(link_emulator::end p_end)
+{
+  return static_cast<usize>(p_end);
+}
+
+link_emulator::end other(link_emulator::end p_end)
+{
+  return p_end == link_emulator::end::a ? link_emulator::end::b
+                                        : link_emulator::end::a;
+}
+}  // namespace
+
+hal::v5::strong_ptr<link_emulator> link_emulator::create(
+  std::pmr::polymorphic_allocator<> p_allocator)
+{
+  return create(p_allocator, settings{});
+}
+
+hal::v5::strong_ptr<link_emulator> link_emulator::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  settings const& p_settings,
+  hal::v5::optional_ptr<simulated_clock> p_clock)
+{
+  auto const is_probability = [](float p_rate) {
+    return p_rate >= 0.0f && p_rate <= 1.0f;
+  };
+  if (p_settings.baud_rate == 0 || p_settings.transmit_buffer_size == 0 ||
+      not is_probability(p_settings.loss_rate) ||
+      not is_probability(p_settings.error_rate)) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<link_emulator>(
+    p_allocator, p_allocator, p_settings, p_clock);
+}
+
+link_emulator::link_emulator(hal::v5::strong_ptr_only_token,
+                             std::pmr::polymorphic_allocator<> p_allocator,
+                             settings const& p_settings,
+                             hal::v5::optional_ptr<simulated_clock> p_clock)
+  : m_allocator(p_allocator)
+  , m_settings(p_settings)
+  , m_byte_time(bits_per_byte * 1'000'000'000 / p_settings.baud_rate)
+  , m_directions{
+    direction{ .in_flight = std::pmr::deque<chunk>(p_allocator) },
+    direction{ .in_flight = std::pmr::deque<chunk>(p_allocator) },
+  }
+  , m_faults(p_settings.seed)
+  , m_clock(p_clock)
+{
+  if (not m_clock) {
+    m_thread = std::thread(&link_emulator::delivery_thread_function, this);
+  }
+}
+
+link_emulator::~link_emulator()
+{
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop_thread = true;
+    if (m_clock && m_delivery_timer != 0) {
+      m_clock->cancel(m_delivery_timer);
+    }
+  }
+  m_work.notify_all();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+link_emulator::statistics link_emulator::get_statistics(end p_from)
+{
+  std::lock_guard lock(m_mutex);
+  return m_directions[index_of(p_from)].counters;
+}
+
+void link_emulator::attach(emulated_serial& p_port, end p_end)
+{
+  std::lock_guard lock(m_mutex);
+  auto& incoming = m_directions[index_of(other(p_end))];
+  if (incoming.receiver != nullptr) {
+    throw hal::device_or_resource_busy(this);
+  }
+  incoming.receiver = &p_port;
+}
+
+void link_emulator::detach(end p_end)
+{
+  std::lock_guard lock(m_mutex);
+  m_directions[index_of(other(p_end))].receiver = nullptr;
+}
+
+void link_emulator::transmit(end p_from, std::span<hal::byte const> p_data)
+{
+  auto& outgoing = m_directions[index_of(p_from)];
+  auto const buffer_size = m_settings.transmit_buffer_size;
+  std::unique_lock lock(m_mutex);
+
+  while (not p_data.empty()) {
+    auto const now = this->now();
+    auto const backlog =
+      outgoing.line_free > now
+        ? static_cast<usize>((outgoing.line_free - now) / m_byte_time)
+        : 0;
+    auto const count = std::min(p_data.size(), buffer_size);
+
+    if (backlog + count > buffer_size) {
+      // Wait until the line made room for this piece of the write
+      auto const wait = m_byte_time * (backlog + count - buffer_size);
+      lock.unlock();
+      if (m_clock) {
+        m_clock->sleep_for(wait);
+      } else {
+        std::this_thread::sleep_for(wait);
+      }
+      lock.lock();
+      continue;
+    }
+
+    auto const start = std::max(now, outgoing.line_free);
+    outgoing.line_free = start + m_byte_time * count;
+    outgoing.in_flight.push_back(chunk{
+      .first_arrival = start + m_byte_time + m_settings.latency,
+      .data = std::pmr::vector<hal::byte>(
+        p_data.begin(), p_data.begin() + count, m_allocator),
+    });
+    outgoing.counters.bytes_sent += count;
+    p_data = p_data.subspan(count);
+    if (m_clock) {
+      schedule_delivery();
+    } else {
+      m_work.notify_all();
+    }
+  }
+}
+
+std::chrono::steady_clock::time_point link_emulator::now()
+{
+  if (m_clock) {
+    return std::chrono::steady_clock::time_point(m_clock->now());
+  }
+  return std::chrono::steady_clock::now();
+}
+
+std::chrono::steady_clock::time_point link_emulator::deliver(
+  direction& p_direction,
+  std::chrono::steady_clock::time_point p_now)
+{
+  auto const inject_loss = m_settings.loss_rate > 0.0f;
+  auto const inject_errors = m_settings.error_rate > 0.0f;
+
+  while (not p_direction.in_flight.empty()) {
+    auto& next = p_direction.in_flight.front();
+    auto const size = next.data.size();
+    usize due = 0;
+    if (p_now >= next.first_arrival) {
+      due = std::min(
+        size,
+        1 + static_cast<usize>((p_now - next.first_arrival) / m_byte_time));
+    }
+
+    while (next.delivered < due) {
+      std::array<hal::byte, burst_size> burst{};
+      usize count = 0;
+      auto const burst_end = std::min(due, next.delivered + burst_size);
+      for (; next.delivered < burst_end; next.delivered++) {
+        auto byte = next.data[next.delivered];
+        if (inject_loss && m_probability(m_faults) < m_settings.loss_rate) {
+          p_direction.counters.bytes_lost++;
+          continue;
+        }
+        if (inject_errors &&
+            m_probability(m_faults) < m_settings.error_rate) {
+          byte ^= static_cast<hal::byte>(1U << (m_faults() % 8));
+          p_direction.counters.bytes_corrupted++;
+        }
+        burst[count++] = byte;
+      }
+
+      p_direction.counters.bytes_delivered += count;
+      if (p_direction.receiver != nullptr && count > 0) {
+        p_direction.receiver->publish(std::span(burst).first(count));
+      }
+    }
+
+    if (next.delivered < size) {
+      // The next burst is handed over once its last byte arrived
+      auto const last = std::min(size, next.delivered + burst_size) - 1;
+      return next.first_arrival + m_byte_time * last;
+    }
+    p_direction.in_flight.pop_front();
+  }
+
+  return std::chrono::steady_clock::time_point::max();
+}
+
+void link_emulator::delivery_thread_function()
+{
+  std::unique_lock lock(m_mutex);
+
+  while (not m_stop_thread) {
+    auto const now = std::chrono::steady_clock::now();
+    auto const next = std::min(deliver(m_directions[0], now),
+                               deliver(m_directions[1], now));
+    if (next == std::chrono::steady_clock::time_point::max()) {
+      m_work.wait(lock);
+    } else {
+      m_work.wait_until(lock, next);
+    }
+  }
+}
+
+void link_emulator::schedule_delivery()
+{
+  auto const now = this->now();
+  auto const next = std::min(deliver(m_directions[0], now),
+                             deliver(m_directions[1], now));
+  if (next >= m_delivery_due) {
+    // The pending delivery comes first and schedules the next one
+    return;
+  }
+
+  // Only the earliest delivery stays scheduled. One that already started
+  // finds a newer generation and does nothing.
+  if (m_delivery_timer != 0) {
+    m_clock->cancel(m_delivery_timer);
+  }
+  m_delivery_due = next;
+  auto const generation = ++m_delivery_generation;
+  m_delivery_timer = m_clock->schedule(
+    next.time_since_epoch(),
+    [this, generation]() { on_delivery_timer(generation); });
+}
+
+void link_emulator::on_delivery_timer(hal::u64 p_generation)
+{
+  std::lock_guard lock(m_mutex);
+  if (p_generation != m_delivery_generation || m_stop_thread) {
+    return;
+  }
+  m_delivery_timer = 0;
+  m_delivery_due = std::chrono::steady_clock::time_point::max();
+  schedule_delivery();
+}
+
+hal::v5::strong_ptr<emulated_serial> emulated_serial::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<link_emulator> p_emulator,
+  link_emulator::end p_end)
+{
+  return create(p_allocator, p_emulator, p_end, options{});
+}
+
+hal::v5::strong_ptr<emulated_serial> emulated_serial::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<link_emulator> p_emulator,
+  link_emulator::end p_end,
+  options const& p_options)
+{
+  if (p_options.receive_buffer_size == 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<emulated_serial>(
+    p_allocator, p_allocator, p_emulator, p_end, p_options);
+}
+
+emulated_serial::emulated_serial(hal::v5::strong_ptr_only_token,
+                                 std::pmr::polymorphic_allocator<> p_allocator,
+                                 hal::v5::strong_ptr<link_emulator> p_emulator,
+                                 link_emulator::end p_end,
+                                 options const& p_options)
+  : m_emulator(p_emulator)
+  , m_end(p_end)
+  , m_receive_buffer(p_options.receive_buffer_size, 0, p_allocator)
+{
+  m_emulator->attach(*this, m_end);
+}
+
+emulated_serial::~emulated_serial()
+{
+  m_emulator->detach(m_end);
+}
+
+void emulated_serial::driver_configure(hal::v5::serial::settings const&)
+{
+  // The emulator's baud rate applies to both directions
+}
+
+void emulated_serial::driver_write(std::span<hal::byte const> p_data)
+{
+  m_emulator->transmit(m_end, p_data);
+}
+
+std::span<hal::byte const> emulated_serial::driver_receive_buffer()
+{
+  return m_receive_buffer;
+}
+
+usize emulated_serial::driver_cursor()
+{
+  return m_receive_cursor.load(std::memory_order_acquire);
+}
+
+void emulated_serial::publish(std::span<hal::byte const> p_data)
+{
+  publish_to_ring(m_receive_buffer, m_receive_cursor, p_data);
+}
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,400 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/log_sink.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <utility>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+namespace hal::mac::inline v1 {
+
+namespace {
+/// Alignment of ring data, keeps the start of each ring on its own cache line
+constexpr usize ring_alignment = 64;
+
+std::atomic<hal::u64> next_sink_id{ 1 };
+
+/**
+ * @brief Sinks that have not been destroyed
+ *
+ * Exiting threads consult it before handing their rings back, as the sink
+ * may have been destroyed first.
+ */
+struct live_sink_registry
+{
+  std::mutex mutex;
+  std::vector<hal::u64> ids;
+};
+
+live_sink_registry& live_sinks()
+{
+  static live_sink_registry registry;
+  return registry;
+}
+}  // namespace
+
+/**
+ * @brief Rings owned by the current thread, handed back when it exits
+ */
+class log_sink_thread_cache
+{
+public:
+  log_sink_thread_cache() = default;
+  log_sink_thread_cache(log_sink_thread_cache const&) = delete;
+  log_sink_thread_cache& operator=(log_sink_thread_cache const&) = delete;
+
+  ~log_sink_thread_cache()
+  {
+    for (usize i = 0; i < m_count; i++) {
+      release(m_entries[i]);
+    }
+  }
+
+  log_sink::producer_ring* find(hal::u64 p_sink_id)
+  {
+    for (usize i = 0; i < m_count; i++) {
+      if (m_entries[i].sink_id == p_sink_id) {
+        return &m_entries[i].sink->m_rings[m_entries[i].ring];
+      }
+    }
+    return nullptr;
+  }
+
+  void add(log_sink& p_sink, usize p_ring)
+  {
+    // Threads rarely log to this many sinks, give up the oldest ring
+    if (m_count == m_entries.size()) {
+      release(m_entries[0]);
+      std::shift_left(m_entries.begin(), m_entries.end(), 1);
+      m_count--;
+    }
+    m_entries[m_count++] = { .sink_id = p_sink.m_id,
+                             .sink = &p_sink,
+                             .ring = p_ring };
+  }
+
+private:
+  struct entry
+  {
+    hal::u64 sink_id = 0;
+    log_sink* sink = nullptr;
+    usize ring = 0;
+  };
+
+  static void release(entry const& p_entry)
+  {
+    auto& registry = live_sinks();
+    std::lock_guard lock(registry.mutex);
+    if (std::ranges::find(registry.ids, p_entry.sink_id) !=
+        registry.ids.end()) {
+      p_entry.sink->m_rings[p_entry.ring].owned.store(
+        false, std::memory_order_release);
+    }
+  }
+
+  std::array<entry, 8> m_entries{};
+  usize m_count = 0;
+};
+
+hal::v5::strong_ptr<log_sink> log_sink::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<console_serial> p_output)
+{
+  return create(p_allocator, p_output, settings{});
+}
+
+hal::v5::strong_ptr<log_sink> log_sink::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<console_serial> p_output,
+  settings const& p_settings)
+{
+  if (p_settings.ring_size == 0 || p_settings.max_producers == 0 ||
+      p_settings.flush_interval.count() <= 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<log_sink>(
+    p_allocator, p_allocator, p_output, p_settings);
+}
+
+log_sink::log_sink(hal::v5::strong_ptr_only_token,
+                   std::pmr::polymorphic_allocator<> p_allocator,
+                   hal::v5::strong_ptr<console_serial> p_output,
+                   settings const& p_settings)
+  : m_allocator(p_allocator)
+  , m_output(p_output)
+  , m_settings(p_settings)
+  , m_id(next_sink_id.fetch_add(1, std::memory_order_relaxed))
+  , m_mask(std::bit_ceil(p_settings.ring_size) - 1)
+  , m_rings(p_settings.max_producers, p_allocator)
+  , m_gather(p_allocator)
+  , m_drain_heads(p_settings.max_producers, 0, p_allocator)
+{
+  // Each ring's data may wrap around, giving two spans
+  m_gather.reserve(2 * p_settings.max_producers);
+
+  {
+    auto& registry = live_sinks();
+    std::lock_guard lock(registry.mutex);
+    registry.ids.push_back(m_id);
+  }
+
+  m_thread = std::thread(&log_sink::drainer_thread_function, this);
+}
+
+log_sink::~log_sink()
+{
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop_thread = true;
+  }
+  m_work.notify_all();
+  m_thread.join();
+
+  {
+    auto& registry = live_sinks();
+    std::lock_guard lock(registry.mutex);
+    std::erase(registry.ids, m_id);
+  }
+
+  auto const count = m_ring_count.load(std::memory_order_acquire);
+  for (usize i = 0; i < count; i++) {
+    m_allocator.deallocate_bytes(
+      m_rings[i].data.data(), m_rings[i].data.size(), ring_alignment);
+  }
+}
+
+bool log_sink::log(std::span<hal::byte const> p_message)
+{
+  auto& ring = ring_for_this_thread();
+  auto const size = p_message.size();
+  auto const capacity = m_mask + 1;
+
+  if (size > capacity) {
+    drop(ring);
+    return false;
+  }
+
+  auto const head = ring.head.load(std::memory_order_relaxed);
+  while (capacity - (head - ring.cached_tail) < size) {
+    auto const tail = ring.tail.load(std::memory_order_acquire);
+    if (tail != ring.cached_tail) {
+      ring.cached_tail = tail;
+      continue;
+    }
+
+    if (m_settings.policy == overflow_policy::drop) {
+      drop(ring);
+      request_drain();
+      return false;
+    }
+    wait_for_drain();
+  }
+
+  auto const start = static_cast<usize>(head) & m_mask;
+  auto const first = std::min(size, capacity - start);
+  std::copy_n(p_message.data(), first, ring.data.data() + start);
+  std::copy_n(p_message.data() + first, size - first, ring.data.data());
+  ring.head.store(head + size, std::memory_order_release);
+
+  // Only this thread writes the counters, so no read-modify-write is needed
+  ring.messages.store(ring.messages.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+  ring.bytes.store(ring.bytes.load(std::memory_order_relaxed) + size,
+                   std::memory_order_relaxed);
+
+  // Wake the drainer early when the ring crosses half full, otherwise it
+  // collects the data on its next flush interval
+  auto const half = capacity / 2;
+  if (head - ring.cached_tail <= half &&
+      head + size - ring.cached_tail > half) {
+    request_drain();
+  }
+  return true;
+}
+
+void log_sink::flush()
+{
+  wait_for_drain();
+
+  std::lock_guard lock(m_mutex);
+  if (m_error) {
+    std::rethrow_exception(std::exchange(m_error, nullptr));
+  }
+}
+
+log_sink::statistics log_sink::get_statistics() const
+{
+  statistics result{ .messages = 0,
+                     .bytes = 0,
+                     .dropped_messages = 0,
+                     .writes = m_writes.load(std::memory_order_relaxed) };
+
+  auto const count = m_ring_count.load(std::memory_order_acquire);
+  for (usize i = 0; i < count; i++) {
+    result.messages += m_rings[i].messages.load(std::memory_order_relaxed);
+    result.bytes += m_rings[i].bytes.load(std::memory_order_relaxed);
+    result.dropped_messages +=
+      m_rings[i].dropped.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+log_sink::producer_ring& log_sink::ring_for_this_thread()
+{
+  thread_local log_sink_thread_cache cache;
+
+  if (auto* const ring = cache.find(m_id)) {
+    return *ring;
+  }
+
+  auto const index = claim_ring();
+  cache.add(*this, index);
+  return m_rings[index];
+}
+
+usize log_sink::claim_ring()
+{
+  std::lock_guard lock(m_mutex);
+  auto const count = m_ring_count.load(std::memory_order_relaxed);
+
+  // Rings of exited threads are reused, including data not yet drained
+  for (usize i = 0; i < count; i++) {
+    auto& ring = m_rings[i];
+    bool expected = false;
+    if (ring.owned.compare_exchange_strong(
+          expected, true, std::memory_order_acq_rel)) {
+      ring.cached_tail = ring.tail.load(std::memory_order_acquire);
+      return i;
+    }
+  }
+
+  if (count == m_rings.size()) {
+    throw hal::resource_unavailable_try_again(this);
+  }
+
+  auto& ring = m_rings[count];
+  auto const capacity = m_mask + 1;
+  ring.data = { static_cast<hal::byte*>(
+                  m_allocator.allocate_bytes(capacity, ring_alignment)),
+                capacity };
+  ring.owned.store(true, std::memory_order_relaxed);
+  m_ring_count.store(count + 1, std::memory_order_release);
+  return count;
+}
+
+void log_sink::drop(producer_ring& p_ring)
+{
+  p_ring.dropped.store(p_ring.dropped.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+}
+
+void log_sink::request_drain()
+{
+  // Only the first request of a pass pays for the notification
+  if (not m_drain_requested.exchange(true, std::memory_order_relaxed)) {
+    m_work.notify_one();
+  }
+}
+
+void log_sink::wait_for_drain()
+{
+  std::unique_lock lock(m_mutex);
+  auto const target = m_passes_started + 1;
+  m_drain_requested.store(true, std::memory_order_relaxed);
+  m_work.notify_one();
+  m_progress.wait(lock, [this, target]() {
+    return m_passes_completed >= target || m_stop_thread;
+  });
+}
+
+void log_sink::drainer_thread_function()
+{
+  std::unique_lock lock(m_mutex);
+
+  while (true) {
+    m_work.wait_for(lock, m_settings.flush_interval, [this]() {
+      return m_stop_thread ||
+             m_drain_requested.load(std::memory_order_relaxed);
+    });
+
+    // A final pass after the stop request writes everything still queued
+    bool const stopping = m_stop_thread;
+    m_drain_requested.store(false, std::memory_order_relaxed);
+    m_passes_started++;
+    lock.unlock();
+
+    drain();
+
+    lock.lock();
+    m_passes_completed++;
+    m_progress.notify_all();
+
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+void log_sink::drain()
+{
+  auto const count = m_ring_count.load(std::memory_order_acquire);
+  auto const capacity = m_mask + 1;
+  m_gather.clear();
+
+  for (usize i = 0; i < count; i++) {
+    auto const& ring = m_rings[i];
+    auto const head = ring.head.load(std::memory_order_acquire);
+    auto const tail = ring.tail.load(std::memory_order_relaxed);
+    m_drain_heads[i] = head;
+
+    auto const used = static_cast<usize>(head - tail);
+    if (used == 0) {
+      continue;
+    }
+
+    auto const start = static_cast<usize>(tail) & m_mask;
+    auto const first = std::min(used, capacity - start);
+    m_gather.emplace_back(ring.data.subspan(start, first));
+    if (used > first) {
+      m_gather.emplace_back(ring.data.first(used - first));
+    }
+  }
+
+  if (m_gather.empty()) {
+    return;
+  }
+
+  try {
+    m_output->write(m_gather);
+    m_writes.fetch_add(1, std::memory_order_relaxed);
+  } catch (...) {
+    std::lock_guard lock(m_mutex);
+    if (not m_error) {
+      m_error = std::current_exception();
+    }
+  }
+
+  // The data is released even after an error, so producers never stall on a
+  // broken console
+  for (usize i = 0; i < count; i++) {
+    m_rings[i].tail.store(m_drain_heads[i], std::memory_order_release);
+  }
+}
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,213 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/precise_delay.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <libhal-mac/simulated_clock.hpp>
+#include <libhal/error.hpp>
+
+namespace hal::mac::inline v1 {
+
+namespace {
+// Starting estimates are deliberately pessimistic so the first few delays
+// spin a little longer than necessary rather than ending late.
+constexpr hal::i64 initial_overshoot_mean_ns = 100'000;
+constexpr hal::i64 initial_overshoot_deviation_ns = 50'000;
+
+// Gains of the exponential moving averages, expressed as shifts: the mean
+// moves 1/8th of the way toward each sample and the deviation 1/4th, the same
+// gains used by TCP's round trip time estimator.
+constexpr int mean_gain_shift = 3;
+constexpr int deviation_gain_shift = 2;
+// Peak overshoot decays by 1/16th per sample so a single outlier does not pin
+// the accuracy mode to a huge spin margin forever.
+constexpr int peak_decay_shift = 4;
+// Number of mean deviations to add on top of the mean in balanced mode
+constexpr hal::i64 balanced_deviations = 4;
+}  // namespace
+
+hal::v5::strong_ptr<precise_delay> precise_delay::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::steady_clock> p_clock)
+{
+  return create(p_allocator, p_clock, settings{});
+}
+
+hal::v5::strong_ptr<precise_delay> precise_delay::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::steady_clock> p_clock,
+  settings const& p_settings)
+{
+  return hal::v5::make_strong_ptr<precise_delay>(
+    p_allocator, p_clock, p_settings);
+}
+
+precise_delay::precise_delay(hal::v5::strong_ptr_only_token,
+                             hal::v5::strong_ptr<hal::steady_clock> p_clock,
+                             settings const& p_settings)
+  : m_clock(p_clock)
+  // Spinning on simulated time would never end, so detect it here whatever
+  // type the clock was handed over as
+  , m_simulated_clock(dynamic_cast<simulated_clock*>(&*p_clock))
+  , m_frequency(static_cast<double>(p_clock->frequency()))
+  , m_mode(p_settings.mode)
+  , m_max_spin_ns(p_settings.max_spin.count())
+  , m_overshoot_mean_ns(initial_overshoot_mean_ns)
+  , m_overshoot_deviation_ns(initial_overshoot_deviation_ns)
+  , m_overshoot_peak_ns(initial_overshoot_mean_ns)
+{
+  if (m_frequency <= 0.0) {
+    throw hal::operation_not_supported(this);
+  }
+}
+
+void precise_delay::configure(settings const& p_settings)
+{
+  m_mode.store(p_settings.mode, std::memory_order_relaxed);
+  m_max_spin_ns.store(p_settings.max_spin.count(), std::memory_order_relaxed);
+}
+
+void precise_delay::delay(hal::time_duration p_duration)
+{
+  if (p_duration.count() <= 0) {
+    return;
+  }
+
+  if (m_simulated_clock) {
+    m_simulated_clock->sleep_for(p_duration);
+    return;
+  }
+
+  auto const now = m_clock->uptime();
+  delay_until(now + static_cast<hal::u64>(ns_to_ticks(p_duration.count())));
+}
+
+void precise_delay::delay_until(hal::u64 p_deadline)
+{
+  if (m_simulated_clock) {
+    // Simulated time never wakes up late, so there is nothing to learn. Its
+    // uptime() counts nanoseconds.
+    m_simulated_clock->sleep_until(
+      hal::time_duration(static_cast<hal::i64>(p_deadline)));
+    return;
+  }
+
+  auto const mode = m_mode.load(std::memory_order_relaxed);
+  auto const now = m_clock->uptime();
+
+  if (now >= p_deadline) {
+    return;
+  }
+
+  auto const remaining_ns =
+    ticks_to_ns(static_cast<hal::i64>(p_deadline - now));
+  auto const margin_ns = spin_margin_ns();
+
+  if (remaining_ns > margin_ns) {
+    auto const sleep_ns = remaining_ns - margin_ns;
+    auto const requested_wakeup =
+      now + static_cast<hal::u64>(ns_to_ticks(sleep_ns));
+
+    std::this_thread::sleep_for(std::chrono::nanoseconds(sleep_ns));
+
+    auto const woke_up = m_clock->uptime();
+    record_overshoot(ticks_to_ns(static_cast<hal::i64>(woke_up) -
+                                 static_cast<hal::i64>(requested_wakeup)));
+  }
+
+  if (mode == power_mode::power_saving) {
+    return;
+  }
+
+  while (m_clock->uptime() < p_deadline) {
+    // Spin until the deadline
+  }
+}
+
+hal::time_duration precise_delay::overshoot_estimate() const
+{
+  return hal::time_duration(
+    m_overshoot_mean_ns.load(std::memory_order_relaxed));
+}
+
+hal::steady_clock& precise_delay::clock()
+{
+  return *m_clock;
+}
+
+hal::i64 precise_delay::ticks_to_ns(hal::i64 p_ticks) const
+{
+  return static_cast<hal::i64>(static_cast<double>(p_ticks) * 1e9 /
+                               m_frequency);
+}
+
+hal::i64 precise_delay::ns_to_ticks(hal::i64 p_nanoseconds) const
+{
+  return static_cast<hal::i64>(static_cast<double>(p_nanoseconds) *
+                               m_frequency / 1e9);
+}
+
+hal::i64 precise_delay::spin_margin_ns() const
+{
+  auto const mean = m_overshoot_mean_ns.load(std::memory_order_relaxed);
+  auto const max_spin = m_max_spin_ns.load(std::memory_order_relaxed);
+
+  switch (m_mode.load(std::memory_order_relaxed)) {
+    case power_mode::power_saving: {
+      // Wake up early by the average amount the OS tends to be late. No spin
+      // follows, so this is not bounded by the max spin time.
+      return mean;
+    }
+    case power_mode::balanced: {
+      auto const deviation =
+        m_overshoot_deviation_ns.load(std::memory_order_relaxed);
+      return std::min(mean + (balanced_deviations * deviation), max_spin);
+    }
+    case power_mode::accuracy: {
+      auto const peak = m_overshoot_peak_ns.load(std::memory_order_relaxed);
+      return std::min(std::max(peak, mean), max_spin);
+    }
+  }
+
+  return max_spin;
+}
+
+void precise_delay::record_overshoot(hal::i64 p_overshoot_ns)
+{
+  // Waking up early only happens due to clock granularity, treat it as on time
+  p_overshoot_ns = std::max<hal::i64>(p_overshoot_ns, 0);
+
+  // Loads and stores are not a single atomic read-modify-write so concurrent
+  // callers may occasionally lose a sample. That is harmless for an estimate
+  // and avoids taking a lock on every delay.
+  auto mean = m_overshoot_mean_ns.load(std::memory_order_relaxed);
+  auto deviation = m_overshoot_deviation_ns.load(std::memory_order_relaxed);
+  auto peak = m_overshoot_peak_ns.load(std::memory_order_relaxed);
+
+  auto const error = p_overshoot_ns - mean;
+  auto const abs_error = error < 0 ? -error : error;
+
+  mean += error >> mean_gain_shift;
+  deviation += (abs_error - deviation) >> deviation_gain_shift;
+  peak = std::max(p_overshoot_ns, peak - (peak >> peak_decay_shift));
+
+  m_overshoot_mean_ns.store(mean, std::memory_order_relaxed);
+  m_overshoot_deviation_ns.store(deviation, std::memory_order_relaxed);
+  m_overshoot_peak_ns.store(peak, std::memory_order_relaxed);
+}
+}  // namespace hal::mac::inline v1
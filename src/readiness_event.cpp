@@ -0,0 +1,83 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/readiness_event.hpp>
+
+#include <array>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+#include <libhal/error.hpp>
+
+namespace hal::mac::inline v1 {
+
+readiness_event::readiness_event()
+{
+#if defined(__linux__)
+  m_fds[0] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  m_fds[1] = m_fds[0];
+  if (m_fds[0] == -1) {
+    throw hal::operation_not_permitted(this);
+  }
+#else
+  if (::pipe(m_fds.data()) != 0) {
+    throw hal::operation_not_permitted(this);
+  }
+  for (int const fd : m_fds) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+#endif
+}
+
+readiness_event::~readiness_event()
+{
+  ::close(m_fds[0]);
+  if (m_fds[1] != m_fds[0]) {
+    ::close(m_fds[1]);
+  }
+}
+
+void readiness_event::signal()
+{
+  if (m_signaled.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+
+  std::uint64_t const value = 1;
+  [[maybe_unused]] auto const result =
+    ::write(m_fds[1], &value, sizeof(value));
+}
+
+void readiness_event::acknowledge()
+{
+  // Draining before clearing the flag means a signal() racing with this
+  // either leaves a byte behind or is covered by the caller's look at the
+  // state that follows, so no wakeup is lost.
+  std::array<std::uint64_t, 8> drain;
+  while (::read(m_fds[0], drain.data(), sizeof(drain)) > 0) {
+  }
+  m_signaled.store(false, std::memory_order_release);
+}
+
+int readiness_event::native_handle() const
+{
+  return m_fds[0];
+}
+}  // namespace hal::mac::inline v1
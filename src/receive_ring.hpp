@@ -0,0 +1,57 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <span>
+
+#include <libhal/units.hpp>
+
+namespace hal::mac::inline v1 {
+/**
+ * @brief Copy received data into a receive ring and publish the new cursor
+ *
+ * Readers tell new data by the cursor moving, so a chunk that moved it a full
+ * lap would read as nothing received. At most capacity - 1 bytes are copied,
+ * of a larger chunk only the newest ones, the older would have been
+ * overwritten anyway.
+ *
+ * Only the one thread that writes the ring may call this.
+ *
+ * @param p_ring Receive buffer
+ * @param p_cursor Receive cursor of p_ring, stored with release ordering
+ * @param p_data Received data
+ */
+inline void publish_to_ring(std::span<hal::byte> p_ring,
+                            std::atomic<usize>& p_cursor,
+                            std::span<hal::byte const> p_data)
+{
+  auto const capacity = p_ring.size();
+  auto const cursor = p_cursor.load(std::memory_order_relaxed);
+  // A single byte ring has no byte to spare
+  auto const limit = std::max<usize>(capacity - 1, 1);
+
+  if (p_data.size() > limit) {
+    p_data = p_data.last(limit);
+  }
+
+  auto const first = std::min(p_data.size(), capacity - cursor);
+  std::copy_n(p_data.begin(), first, p_ring.begin() + cursor);
+  std::copy(p_data.begin() + first, p_data.end(), p_ring.begin());
+  p_cursor.store((cursor + p_data.size()) % capacity,
+                 std::memory_order_release);
+}
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,219 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/scheduled_thread.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <exception>
+#include <memory>
+#include <sched.h>
+#include <unistd.h>
+#include <utility>
+
+#include <libhal/error.hpp>
+
+namespace hal::mac::inline v1 {
+
+namespace {
+/// Longest thread name Linux accepts, macOS allows more
+constexpr usize max_name_length = 15;
+
+/**
+ * @brief What the new thread needs, owned by the thread once it started
+ */
+struct thread_start
+{
+  hal::callback<void()> function;
+  std::array<char, max_name_length + 1> name{};
+};
+
+void* run_thread(void* p_start)
+{
+  std::unique_ptr<thread_start> const start(
+    static_cast<thread_start*>(p_start));
+  if (start->name[0] != '\0') {
+#if defined(__APPLE__)
+    ::pthread_setname_np(start->name.data());
+#else
+    ::pthread_setname_np(::pthread_self(), start->name.data());
+#endif
+  }
+  start->function();
+  return nullptr;
+}
+
+/**
+ * @brief Destroys a pthread attributes object when leaving scope
+ */
+struct thread_attributes
+{
+  thread_attributes()
+  {
+    ::pthread_attr_init(&value);
+  }
+
+  ~thread_attributes()
+  {
+    ::pthread_attr_destroy(&value);
+  }
+
+  thread_attributes(thread_attributes const&) = delete;
+  thread_attributes& operator=(thread_attributes const&) = delete;
+
+  pthread_attr_t value{};
+};
+
+void apply_scheduling(pthread_attr_t& p_attributes,
+                      thread_settings const& p_settings)
+{
+  if (p_settings.scheduling == thread_settings::policy::standard) {
+    if (p_settings.priority != 0) {
+      throw hal::argument_out_of_domain(nullptr);
+    }
+    return;
+  }
+
+  int const policy = p_settings.scheduling == thread_settings::policy::fifo
+                       ? SCHED_FIFO
+                       : SCHED_RR;
+  if (p_settings.priority < ::sched_get_priority_min(policy) ||
+      p_settings.priority > ::sched_get_priority_max(policy)) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  // Without explicit scheduling the thread inherits the creator's policy
+  sched_param parameters{};
+  parameters.sched_priority = p_settings.priority;
+  ::pthread_attr_setinheritsched(&p_attributes, PTHREAD_EXPLICIT_SCHED);
+  ::pthread_attr_setschedpolicy(&p_attributes, policy);
+  ::pthread_attr_setschedparam(&p_attributes, &parameters);
+}
+
+void apply_affinity([[maybe_unused]] pthread_attr_t& p_attributes,
+                    [[maybe_unused]] hal::u64 p_cpus)
+{
+#if defined(__linux__)
+  if (p_cpus == 0) {
+    return;
+  }
+
+  auto const cpu_count = ::sysconf(_SC_NPROCESSORS_CONF);
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int cpu = 0; cpu < 64 && cpu < cpu_count; cpu++) {
+    if ((p_cpus & (hal::u64{ 1 } << cpu)) != 0) {
+      CPU_SET(cpu, &cpus);
+    }
+  }
+  if (CPU_COUNT(&cpus) == 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+  ::pthread_attr_setaffinity_np(&p_attributes, sizeof(cpus), &cpus);
+#endif
+}
+
+void apply_stack_size(pthread_attr_t& p_attributes, usize p_stack_size)
+{
+  if (p_stack_size == 0) {
+    return;
+  }
+  if (p_stack_size < static_cast<usize>(PTHREAD_STACK_MIN)) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  // macOS only accepts whole pages
+  auto const page_size = static_cast<usize>(::sysconf(_SC_PAGESIZE));
+  auto const size = (p_stack_size + page_size - 1) / page_size * page_size;
+  if (::pthread_attr_setstacksize(&p_attributes, size) != 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+}
+}  // namespace
+
+scheduled_thread::scheduled_thread(thread_settings const& p_settings,
+                                   hal::callback<void()> p_function)
+{
+  thread_attributes attributes;
+  apply_scheduling(attributes.value, p_settings);
+  apply_affinity(attributes.value, p_settings.cpu_affinity);
+  apply_stack_size(attributes.value, p_settings.stack_size);
+
+  auto start = std::make_unique<thread_start>();
+  start->function = std::move(p_function);
+  auto const name = p_settings.name.substr(0, max_name_length);
+  std::ranges::copy(name, start->name.begin());
+
+  pthread_t handle{};
+  int const result =
+    ::pthread_create(&handle, &attributes.value, &run_thread, start.get());
+  switch (result) {
+    case 0:
+      break;
+    case EPERM:
+      throw hal::operation_not_permitted(this);
+    case EINVAL:
+      throw hal::argument_out_of_domain(this);
+    default:
+      throw hal::resource_unavailable_try_again(this);
+  }
+
+  // The thread owns its start data from here on
+  static_cast<void>(start.release());
+  m_handle = handle;
+}
+
+scheduled_thread::~scheduled_thread()
+{
+  if (joinable()) {
+    std::terminate();
+  }
+}
+
+scheduled_thread::scheduled_thread(scheduled_thread&& p_other) noexcept
+  : m_handle(std::exchange(p_other.m_handle, std::nullopt))
+{
+}
+
+scheduled_thread& scheduled_thread::operator=(
+  scheduled_thread&& p_other) noexcept
+{
+  if (joinable()) {
+    std::terminate();
+  }
+  m_handle = std::exchange(p_other.m_handle, std::nullopt);
+  return *this;
+}
+
+bool scheduled_thread::joinable() const
+{
+  return m_handle.has_value();
+}
+
+void scheduled_thread::join()
+{
+  if (not m_handle) {
+    throw hal::argument_out_of_domain(this);
+  }
+  ::pthread_join(*m_handle, nullptr);
+  m_handle.reset();
+}
+
+pthread_t scheduled_thread::native_handle() const
+{
+  return m_handle.value_or(pthread_t{});
+}
+}  // namespace hal::mac::inline v1
@@ -14,18 +14,38 @@
 
 #include <libhal-mac/serial.hpp>
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
+#include <chrono>
 #include <cstring>
+#include <exception>
 #include <fcntl.h>
 #include <libhal/output_pin.hpp>
+#include <mutex>
+#include <optional>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
 #include <sys/ioctl.h>
 #include <sys/select.h>
 #include <termios.h>
 #include <unistd.h>
+#include <utility>
+
+#if defined(__linux__)
+#include <linux/serial.h>
+#include <sys/inotify.h>
+#elif defined(__APPLE__)
+#include <sys/event.h>
+#endif
 
 #include <libhal/error.hpp>
 #include <libhal/pointers.hpp>
 
+#include "gather_write.hpp"
+
 namespace hal::mac::inline v1 {
 
 namespace {
@@ -75,32 +95,363 @@ speed_t baud_rate_to_speed(hal::hertz p_baud_rate)
       return B0;
   }
 }
+
+/// TIOCM_* status bits indexed by hal::mac::modem_in
+constexpr std::array<int, 4> modem_input_bits = {
+  TIOCM_DSR,
+  TIOCM_CTS,
+  TIOCM_CD,
+  TIOCM_RI,
+};
+constexpr int modem_input_mask = TIOCM_DSR | TIOCM_CTS | TIOCM_CD | TIOCM_RI;
+/// Poll period of the modem watcher
+constexpr auto modem_poll_interval = std::chrono::milliseconds(1);
+
+/**
+ * @brief State of the modem status lines at one point in time
+ */
+struct modem_snapshot
+{
+  /// TIOCM_* bits of the status lines
+  int status = 0;
+  /// Transitions counted by the driver per line, indexed by modem_in. Empty
+  /// where the driver keeps no counters, e.g. pseudo terminals.
+  std::optional<std::array<int, 4>> counts;
+};
+
+#if defined(TIOCGICOUNT)
+std::optional<std::array<int, 4>> read_modem_counts(int p_fd)
+{
+  serial_icounter_struct counters{};
+  if (::ioctl(p_fd, TIOCGICOUNT, &counters) != 0) {
+    return std::nullopt;
+  }
+  return std::array{ counters.dsr, counters.cts, counters.dcd, counters.rng };
+}
+#endif
+
+/**
+ * @brief Read the modem status lines and their transition counters
+ *
+ * The counters are read before and after the lines. If they differ a line
+ * changed in between, and the snapshot is retaken so that levels and counts
+ * agree. A line toggling faster than that leaves the counts out.
+ *
+ * @return The snapshot, nothing if TIOCMGET failed
+ */
+std::optional<modem_snapshot> read_modem_snapshot(int p_fd)
+{
+  modem_snapshot snapshot;
+#if defined(TIOCGICOUNT)
+  constexpr int attempts = 4;
+  for (int i = 0; i < attempts; i++) {
+    auto const before = read_modem_counts(p_fd);
+    if (::ioctl(p_fd, TIOCMGET, &snapshot.status) != 0) {
+      return std::nullopt;
+    }
+    if (before && before == read_modem_counts(p_fd)) {
+      snapshot.counts = before;
+      break;
+    }
+    if (not before) {
+      break;
+    }
+  }
+#else
+  if (::ioctl(p_fd, TIOCMGET, &snapshot.status) != 0) {
+    return std::nullopt;
+  }
+#endif
+  snapshot.status &= modem_input_mask;
+  return snapshot;
+}
+
+/// First delay between reopen attempts after a hangup
+constexpr auto reconnect_initial_backoff = std::chrono::milliseconds(10);
+/// Longest delay between reopen attempts after a hangup
+constexpr auto reconnect_max_backoff = std::chrono::milliseconds(1000);
+/// Longest single wait, bounds how long a stop request can go unnoticed
+constexpr auto reconnect_wait_slice = std::chrono::milliseconds(100);
+
+/**
+ * @brief Wakes up when entries are added to or changed in a directory
+ *
+ * Used to notice a serial device node reappearing without polling. Uses
+ * inotify on Linux and kqueue on macOS. If neither is available, or setting
+ * up the watch fails, wait() degrades to a plain sleep.
+ */
+class directory_watcher
+{
+public:
+  explicit directory_watcher(std::string const& p_directory)
+  {
+#if defined(__linux__)
+    m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd != -1 &&
+        ::inotify_add_watch(m_fd,
+                            p_directory.c_str(),
+                            IN_CREATE | IN_ATTRIB | IN_MOVED_TO) == -1) {
+      ::close(m_fd);
+      m_fd = -1;
+    }
+#elif defined(__APPLE__)
+    m_directory_fd = ::open(p_directory.c_str(), O_EVTONLY);
+    m_fd = ::kqueue();
+    if (m_directory_fd != -1 && m_fd != -1) {
+      struct kevent change{};
+      EV_SET(&change,
+             m_directory_fd,
+             EVFILT_VNODE,
+             EV_ADD | EV_CLEAR,
+             NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB,
+             0,
+             nullptr);
+      if (::kevent(m_fd, &change, 1, nullptr, 0, nullptr) == -1) {
+        ::close(m_fd);
+        m_fd = -1;
+      }
+    }
+#else
+    static_cast<void>(p_directory);
+#endif
+  }
+
+  directory_watcher(directory_watcher const&) = delete;
+  directory_watcher& operator=(directory_watcher const&) = delete;
+  directory_watcher(directory_watcher&&) = delete;
+  directory_watcher& operator=(directory_watcher&&) = delete;
+
+  ~directory_watcher()
+  {
+    if (m_fd != -1) {
+      ::close(m_fd);
+    }
+    if (m_directory_fd != -1) {
+      ::close(m_directory_fd);
+    }
+  }
+
+  /**
+   * @brief Block until the directory changes or the timeout elapses
+   *
+   * @return true if a change was observed
+   */
+  bool wait(std::chrono::milliseconds p_timeout)
+  {
+    if (m_fd == -1) {
+      std::this_thread::sleep_for(p_timeout);
+      return false;
+    }
+
+#if defined(__linux__)
+    pollfd descriptor{ .fd = m_fd, .events = POLLIN, .revents = 0 };
+    if (::poll(&descriptor, 1, static_cast<int>(p_timeout.count())) <= 0) {
+      return false;
+    }
+    // Drain the queued events, only the wakeup matters
+    std::array<char, 1024> events;
+    while (::read(m_fd, events.data(), events.size()) > 0) {
+    }
+    return true;
+#elif defined(__APPLE__)
+    struct kevent event{};
+    auto const seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(p_timeout);
+    timespec const timeout{
+      .tv_sec = static_cast<time_t>(seconds.count()),
+      .tv_nsec = static_cast<long>(
+        std::chrono::nanoseconds(p_timeout - seconds).count()),
+    };
+    return ::kevent(m_fd, nullptr, 0, &event, 1, &timeout) > 0;
+#else
+    return false;
+#endif
+  }
+
+private:
+  /// inotify instance or kqueue
+  int m_fd = -1;
+  /// Directory opened for kqueue event monitoring
+  int m_directory_fd = -1;
+};
+
+/**
+ * @brief Return the directory part of a path, "." if there is none
+ */
+std::string parent_directory(std::string_view p_path)
+{
+  auto const slash = p_path.find_last_of('/');
+  if (slash == std::string_view::npos) {
+    return ".";
+  }
+  if (slash == 0) {
+    return "/";
+  }
+  return std::string(p_path.substr(0, slash));
+}
+
+/**
+ * @brief Determine if a read() result means the device hung up
+ */
+bool is_hangup(ssize_t p_result, int p_error)
+{
+  if (p_result == 0) {
+    // Non-blocking reads of a terminal only return 0 at end of file, which for
+    // a serial device means a hangup.
+    return true;
+  }
+  return p_result < 0 &&
+         (p_error == EIO || p_error == ENXIO || p_error == ENODEV ||
+          p_error == EBADF);
+}
+
+/**
+ * @brief Wait for events on a descriptor with microsecond precision
+ *
+ * Coalescing windows of receive handlers are often well below a millisecond,
+ * the resolution of poll(). Linux has ppoll(). Elsewhere select() is used,
+ * falling back to poll() for descriptors select() cannot represent.
+ *
+ * @param p_fd Descriptor to wait on
+ * @param p_events POLLIN and/or POLLOUT
+ * @param p_timeout Longest time to wait
+ * @return poll() style revents, 0 on timeout
+ */
+short wait_for_events(int p_fd,
+                      short p_events,
+                      std::chrono::microseconds p_timeout)
+{
+  pollfd descriptor{ .fd = p_fd, .events = p_events, .revents = 0 };
+  auto const seconds =
+    std::chrono::duration_cast<std::chrono::seconds>(p_timeout);
+
+#if defined(__linux__)
+  timespec const timeout{
+    .tv_sec = static_cast<time_t>(seconds.count()),
+    .tv_nsec = static_cast<long>(
+      std::chrono::nanoseconds(p_timeout - seconds).count()),
+  };
+  if (::ppoll(&descriptor, 1, &timeout, nullptr) <= 0) {
+    return 0;
+  }
+  return descriptor.revents;
+#else
+  if (p_fd < FD_SETSIZE) {
+    fd_set read_fds;
+    fd_set write_fds;
+    FD_ZERO(&read_fds);
+    FD_ZERO(&write_fds);
+    if ((p_events & POLLIN) != 0) {
+      FD_SET(p_fd, &read_fds);
+    }
+    if ((p_events & POLLOUT) != 0) {
+      FD_SET(p_fd, &write_fds);
+    }
+    timeval timeout{
+      .tv_sec = static_cast<time_t>(seconds.count()),
+      .tv_usec = static_cast<suseconds_t>((p_timeout - seconds).count()),
+    };
+    if (::select(p_fd + 1, &read_fds, &write_fds, nullptr, &timeout) < 0) {
+      // EBADF and friends are reported as readable so the read that follows
+      // detects the hangup
+      return errno == EINTR ? 0 : POLLIN;
+    }
+    short revents = 0;
+    if (FD_ISSET(p_fd, &read_fds)) {
+      revents |= POLLIN;
+    }
+    if (FD_ISSET(p_fd, &write_fds)) {
+      revents |= POLLOUT;
+    }
+    return revents;
+  }
+
+  auto const timeout_ms =
+    std::chrono::ceil<std::chrono::milliseconds>(p_timeout).count();
+  if (::poll(&descriptor, 1, static_cast<int>(timeout_ms)) <= 0) {
+    return 0;
+  }
+  return descriptor.revents;
+#endif
+}
+
+/**
+ * @brief Request the highest scheduling priority available to this thread
+ *
+ * Real-time policies usually require elevated privileges. Failure is not an
+ * error, the thread simply continues with whatever priority it has.
+ */
+void raise_current_thread_priority()
+{
+#if defined(__APPLE__)
+  ::pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#endif
+  sched_param parameters{};
+  parameters.sched_priority = ::sched_get_priority_max(SCHED_FIFO);
+  ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &parameters);
+}
 }  // anonymous namespace
 
 hal::v5::strong_ptr<serial> serial::create(
   std::pmr::polymorphic_allocator<> p_allocator,
   std::string_view p_device_path,
   usize p_buffer_size,
-  hal::v5::serial::settings const& p_settings)
+  hal::v5::serial::settings const& p_settings,
+  flow_control p_flow_control,
+  receive_thread_settings const& p_receive_thread)
+{
+  if (p_buffer_size == 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<serial>(p_allocator,
+                                         p_allocator,
+                                         nullptr,
+                                         p_device_path,
+                                         p_buffer_size,
+                                         p_settings,
+                                         p_flow_control,
+                                         p_receive_thread);
+}
+
+hal::v5::strong_ptr<serial> serial::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<io_reactor> p_reactor,
+  std::string_view p_device_path,
+  usize p_buffer_size,
+  hal::v5::serial::settings const& p_settings,
+  flow_control p_flow_control)
 {
   if (p_buffer_size == 0) {
     throw hal::argument_out_of_domain(nullptr);
   }
 
-  return hal::v5::make_strong_ptr<serial>(
-    p_allocator, p_allocator, p_device_path, p_buffer_size, p_settings);
+  return hal::v5::make_strong_ptr<serial>(p_allocator,
+                                         p_allocator,
+                                         p_reactor,
+                                         p_device_path,
+                                         p_buffer_size,
+                                         p_settings,
+                                         p_flow_control,
+                                         receive_thread_settings{});
 }
 
 serial::serial(hal::v5::strong_ptr_only_token,
                std::pmr::polymorphic_allocator<> p_allocator,
+               hal::v5::optional_ptr<io_reactor> p_reactor,
                std::string_view p_device_path,
                usize p_buffer_size,
-               hal::v5::serial::settings const& p_settings)
-  : m_receive_buffer(p_buffer_size, hal::byte{ 0 }, p_allocator)
+               hal::v5::serial::settings const& p_settings,
+               flow_control p_flow_control,
+               receive_thread_settings const& p_receive_thread)
+  : m_reactor(p_reactor)
+  , m_device_path(p_device_path, p_allocator)
+  , m_receive_buffer(p_buffer_size, hal::byte{ 0 }, p_allocator)
+  , m_flow_control(p_flow_control)
 {
 
   // Open the serial device
-  m_fd = ::open(p_device_path.data(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  m_fd = ::open(m_device_path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
   if (m_fd == -1) {
     if (errno == ENOENT) {
       throw hal::no_such_device(m_fd, this);
@@ -109,10 +460,45 @@ serial::serial(hal::v5::strong_ptr_only_token,
     }
   }
 
-  driver_configure(p_settings);
+  try {
+    driver_configure(p_settings);
+  } catch (...) {
+    // The destructor does not run for a throwing constructor
+    ::close(m_fd);
+    throw;
+  }
+
+  // Seed the modem output shadow state. Devices without modem lines, such as
+  // pseudo terminals, reject TIOCMGET, in which case both lines read as low.
+  int status = 0;
+  if (::ioctl(m_fd, TIOCMGET, &status) == 0) {
+    m_modem_outputs.store(status & (TIOCM_DTR | TIOCM_RTS),
+                          std::memory_order_release);
+  }
+
+  if (m_reactor) {
+    try {
+      watch_receive();
+    } catch (...) {
+      ::close(m_fd);
+      throw;
+    }
+    return;
+  }
 
   // Start the receive thread
-  m_receive_thread = std::thread(&serial::receive_thread_function, this);
+  try {
+    if (p_receive_thread.busy_poll) {
+      m_receive_thread = scheduled_thread(
+        p_receive_thread.thread, [this]() { busy_poll_thread_function(); });
+    } else {
+      m_receive_thread = scheduled_thread(
+        p_receive_thread.thread, [this]() { receive_thread_function(); });
+    }
+  } catch (...) {
+    ::close(m_fd);
+    throw;
+  }
 }
 
 serial::~serial()
@@ -120,10 +506,26 @@ serial::~serial()
   // Stop the receive thread
   m_stop_thread.store(true, std::memory_order_release);
 
+  if (m_reactor) {
+    // Once unwatch() returns the reactor is not inside on_readable(), and
+    // with the stop flag set it cannot start another reconnect thread.
+    m_reactor->unwatch(m_fd);
+  }
+
   if (m_receive_thread.joinable()) {
     m_receive_thread.join();
   }
 
+  if (m_reactor) {
+    // A reconnect thread that finished just before the join may have
+    // registered the descriptor again
+    m_reactor->unwatch(m_fd);
+  }
+
+  if (m_modem_thread.joinable()) {
+    m_modem_thread.join();
+  }
+
   // Close the file descriptor
   if (m_fd != -1) {
     ::close(m_fd);
@@ -131,46 +533,406 @@ serial::~serial()
 }
 void serial::receive_thread_function()
 {
-  constexpr int select_timeout_ms = 100;
+  constexpr auto idle_timeout = std::chrono::microseconds(100'000);
 
   while (!m_stop_thread.load(std::memory_order_acquire)) {
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(m_fd, &read_fds);
+    auto timeout = idle_timeout;
+    if (m_dispatch_deadline) {
+      auto const remaining =
+        std::chrono::ceil<std::chrono::microseconds>(
+          *m_dispatch_deadline - std::chrono::steady_clock::now());
+      timeout = std::clamp(remaining, std::chrono::microseconds(0), timeout);
+    }
 
-    struct timeval timeout;
-    timeout.tv_sec = 0;
-    timeout.tv_usec = select_timeout_ms * 1000;
+    short events = POLLIN;
+    if (m_transmit_blocked.load(std::memory_order_acquire)) {
+      events |= POLLOUT;
+    }
 
-    int result = ::select(m_fd + 1, &read_fds, nullptr, nullptr, &timeout);
+    auto const revents = wait_for_events(m_fd, events, timeout);
+    m_wait_calls.fetch_add(1, std::memory_order_relaxed);
 
-    if (result > 0 && FD_ISSET(m_fd, &read_fds)) {
-      std::array<hal::byte, 256> temp_buffer;
-      ssize_t bytes_read = ::read(m_fd, temp_buffer.data(), temp_buffer.size());
+    if ((revents & POLLOUT) != 0) {
+      m_transmit_blocked.store(false, std::memory_order_release);
+      m_readiness.signal();
+    }
 
-      if (bytes_read > 0) {
-        usize current_cursor = m_receive_cursor.load(std::memory_order_acquire);
-        usize buffer_size = m_receive_buffer.size();
+    // POLLHUP and POLLERR are reported as events too, the read that follows
+    // turns them into a hangup.
+    if ((revents & ~POLLOUT) != 0 && not service_receive()) {
+      // A hung up descriptor stays readable forever, retrying the read would
+      // spin at full CPU. Wait for the device to come back instead.
+      reconnect();
+      continue;
+    }
 
-        for (ssize_t i = 0; i < bytes_read; ++i) {
-          m_receive_buffer[current_cursor] = temp_buffer[i];
-          current_cursor = (current_cursor + 1) % buffer_size;
-        }
+    if (m_dispatch_deadline &&
+        std::chrono::steady_clock::now() >= *m_dispatch_deadline) {
+      dispatch_receive(m_receive_cursor.load(std::memory_order_relaxed), true);
+    }
+  }
+}
 
-        m_receive_cursor.store(current_cursor, std::memory_order_release);
+void serial::busy_poll_thread_function()
+{
+  while (!m_stop_thread.load(std::memory_order_acquire)) {
+    // The descriptor is non-blocking, so a read without data returns at once
+    if (not service_receive()) {
+      reconnect();
+      continue;
+    }
+
+    if (m_transmit_blocked.load(std::memory_order_acquire) &&
+        (wait_for_events(m_fd, POLLOUT, std::chrono::microseconds(0)) &
+         POLLOUT) != 0) {
+      m_transmit_blocked.store(false, std::memory_order_release);
+      m_readiness.signal();
+    }
+
+    if (m_dispatch_deadline &&
+        std::chrono::steady_clock::now() >= *m_dispatch_deadline) {
+      dispatch_receive(m_receive_cursor.load(std::memory_order_relaxed), true);
+    }
+  }
+}
+
+bool serial::service_receive()
+{
+  std::lock_guard lock(m_bypass_mutex);
+
+  if (m_receive_bypass) {
+    auto const result = m_receive_bypass(m_fd);
+    m_read_calls.fetch_add(1, std::memory_order_relaxed);
+    return not is_hangup(result, errno);
+  }
+
+  // Only the receive path writes the cursor, so it can be read relaxed
+  usize const cursor = m_receive_cursor.load(std::memory_order_relaxed);
+  usize const contiguous =
+    std::min(m_receive_buffer.size() - cursor, receive_space(cursor));
+
+  ssize_t const bytes_read =
+    ::read(m_fd, m_receive_buffer.data() + cursor, contiguous);
+  m_read_calls.fetch_add(1, std::memory_order_relaxed);
+
+  if (is_hangup(bytes_read, errno)) {
+    return false;
+  }
+
+  if (bytes_read > 0) {
+    auto const count = static_cast<usize>(bytes_read);
+    m_bytes_received.fetch_add(count, std::memory_order_relaxed);
+    publish_cursor((cursor + count) % m_receive_buffer.size());
+  }
+
+  return true;
+}
+
+void serial::publish_cursor(usize p_cursor)
+{
+  m_receive_cursor.store(p_cursor, std::memory_order_release);
+  notify_observers(p_cursor);
+  dispatch_receive(p_cursor, false);
+  m_readiness.signal();
+}
+
+void serial::publish_received(std::span<hal::byte const> p_data)
+{
+  auto const size = m_receive_buffer.size();
+
+  // Published in pieces that fit, so a chunk larger than the free space
+  // neither laps the cursor nor overwrites data the handler has not seen.
+  // Each piece is counted as it is published, observers such as
+  // serial_broker take the counter as the amount in the buffer.
+  while (not p_data.empty()) {
+    usize const cursor = m_receive_cursor.load(std::memory_order_relaxed);
+    auto const piece =
+      p_data.first(std::min(receive_space(cursor), p_data.size()));
+    auto const first = std::min(size - cursor, piece.size());
+    std::ranges::copy(piece.first(first), m_receive_buffer.begin() + cursor);
+    std::ranges::copy(piece.subspan(first), m_receive_buffer.begin());
+    m_bytes_received.fetch_add(piece.size(), std::memory_order_relaxed);
+    publish_cursor((cursor + piece.size()) % size);
+    p_data = p_data.subspan(piece.size());
+  }
+}
+
+void serial::set_receive_bypass(hal::callback<receive_bypass> p_bypass)
+{
+  std::lock_guard lock(m_bypass_mutex);
+  if (p_bypass && m_receive_bypass) {
+    throw hal::operation_not_permitted(this);
+  }
+  m_receive_bypass = std::move(p_bypass);
+}
+
+void serial::on_receive(hal::callback<receive_handler> p_handler,
+                        std::chrono::microseconds p_coalesce)
+{
+  if (m_reactor && p_coalesce.count() > 0) {
+    throw hal::operation_not_supported(this);
+  }
+
+  std::lock_guard lock(m_observer_mutex);
+  m_has_receive_handler.store(static_cast<bool>(p_handler),
+                              std::memory_order_release);
+  m_receive_handler = std::move(p_handler);
+  m_receive_coalesce = p_coalesce;
+  // Only data received from now on is delivered
+  m_dispatched_cursor = m_receive_cursor.load(std::memory_order_acquire);
+}
+
+void serial::dispatch_receive(usize p_cursor, bool p_window_expired)
+{
+  if (not m_has_receive_handler.load(std::memory_order_acquire)) {
+    m_dispatch_deadline.reset();
+    return;
+  }
+
+  std::lock_guard lock(m_observer_mutex);
+  auto const size = m_receive_buffer.size();
+  auto const pending = (p_cursor + size - m_dispatched_cursor) % size;
+
+  if (not m_receive_handler || pending == 0) {
+    m_dispatch_deadline.reset();
+    return;
+  }
+
+  if (m_receive_coalesce.count() > 0 && not p_window_expired &&
+      pending < size / 2) {
+    if (not m_dispatch_deadline) {
+      m_dispatch_deadline =
+        std::chrono::steady_clock::now() + m_receive_coalesce;
+    }
+    return;
+  }
+
+  m_dispatch_deadline.reset();
+
+  std::span<hal::byte const> const buffer(m_receive_buffer);
+  std::span<hal::byte const> first;
+  std::span<hal::byte const> second;
+  if (p_cursor > m_dispatched_cursor) {
+    first = buffer.subspan(m_dispatched_cursor, pending);
+  } else {
+    first = buffer.subspan(m_dispatched_cursor);
+    second = buffer.first(p_cursor);
+  }
+
+  m_dispatched_cursor = p_cursor;
+  m_receive_handler(first, second);
+}
+
+usize serial::receive_space(usize p_cursor)
+{
+  auto const size = m_receive_buffer.size();
+  // A single byte buffer has no byte to spare
+  auto const limit = std::max<usize>(size - 1, 1);
+  if (not m_has_receive_handler.load(std::memory_order_acquire)) {
+    return limit;
+  }
+
+  usize pending = 0;
+  {
+    std::lock_guard lock(m_observer_mutex);
+    pending = (p_cursor + size - m_dispatched_cursor) % size;
+  }
+  if (pending < limit) {
+    return limit - pending;
+  }
+
+  // A deferred delivery filled the buffer, hand it over before reading on
+  dispatch_receive(p_cursor, true);
+  return limit;
+}
+
+void serial::notify_observers(usize p_cursor)
+{
+  if (m_observers.load(std::memory_order_acquire) == nullptr) {
+    return;
+  }
+
+  std::lock_guard lock(m_observer_mutex);
+  for (auto* observer = m_observers.load(std::memory_order_relaxed);
+       observer != nullptr;
+       observer = observer->m_next_observer) {
+    observer->on_receive(p_cursor);
+  }
+}
+
+void serial::attach_observer(receive_observer& p_observer)
+{
+  std::lock_guard lock(m_observer_mutex);
+  p_observer.m_next_observer = m_observers.load(std::memory_order_relaxed);
+  m_observers.store(&p_observer, std::memory_order_release);
+}
+
+void serial::detach_observer(receive_observer& p_observer)
+{
+  std::lock_guard lock(m_observer_mutex);
+  auto* previous = static_cast<receive_observer*>(nullptr);
+  auto* observer = m_observers.load(std::memory_order_relaxed);
+  while (observer != nullptr && observer != &p_observer) {
+    previous = observer;
+    observer = observer->m_next_observer;
+  }
+
+  if (observer == nullptr) {
+    return;
+  }
+
+  if (previous == nullptr) {
+    m_observers.store(observer->m_next_observer, std::memory_order_release);
+  } else {
+    previous->m_next_observer = observer->m_next_observer;
+  }
+  observer->m_next_observer = nullptr;
+}
+
+void serial::watch_receive()
+{
+  m_reactor->watch(m_fd, [this]() { return on_readable(); });
+}
+
+bool serial::on_readable()
+{
+  if (service_receive()) {
+    return true;
+  }
+
+  if (m_stop_thread.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  // Reconnecting blocks, which the reactor thread must never do, so it is
+  // handed to a thread of its own. The previous reconnect thread, if any,
+  // has already registered the descriptor and is about to exit.
+  if (m_receive_thread.joinable()) {
+    m_receive_thread.join();
+  }
+
+  m_receive_thread = scheduled_thread({}, [this]() {
+    reconnect();
+    if (not m_stop_thread.load(std::memory_order_acquire)) {
+      try {
+        watch_receive();
+      } catch (...) {
+        // The descriptor can no longer be serviced, report the port as lost
+        set_connection_state(connection_state::disconnected);
       }
     }
+  });
+
+  return false;
+}
+
+void serial::reconnect()
+{
+  set_connection_state(connection_state::disconnected);
+
+  directory_watcher watcher(parent_directory(m_device_path));
+  auto backoff = std::chrono::milliseconds(reconnect_initial_backoff);
+
+  while (!m_stop_thread.load(std::memory_order_acquire)) {
+    int const new_fd =
+      ::open(m_device_path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (new_fd != -1 && adopt_reopened_device(new_fd)) {
+      m_reconnects.fetch_add(1, std::memory_order_relaxed);
+      set_connection_state(connection_state::connected);
+      return;
+    }
+
+    // Wait out the backoff period in slices so a stop request is noticed
+    // promptly. A directory event cuts the wait short, but the node may show
+    // up before its permissions are set, so the backoff still grows.
+    auto remaining = backoff;
+    while (remaining.count() > 0 &&
+           !m_stop_thread.load(std::memory_order_acquire)) {
+      auto const slice = std::min(remaining, reconnect_wait_slice);
+      if (watcher.wait(slice)) {
+        break;
+      }
+      remaining -= slice;
+    }
+
+    backoff = std::min(backoff * 2, reconnect_max_backoff);
+  }
+}
+
+bool serial::adopt_reopened_device(int p_new_fd)
+{
+  // Duplicating onto the existing descriptor number swaps the dead device for
+  // the new one atomically, so concurrent writers never see an invalid or
+  // reused descriptor.
+  if (::dup2(p_new_fd, m_fd) == -1) {
+    ::close(p_new_fd);
+    return false;
+  }
+  ::close(p_new_fd);
+
+  try {
+    std::lock_guard settings_lock(m_settings_mutex);
+    apply_termios_settings(m_settings, m_flow_control);
+  } catch (...) {
+    return false;
+  }
+
+  if (m_rs485_in_kernel.load(std::memory_order_acquire)) {
+    std::lock_guard rs485_lock(m_rs485_mutex);
+    if (m_rs485) {
+      static_cast<void>(apply_kernel_rs485(*m_rs485));
+    }
+  }
+
+  // Restore the modem output lines the application last asked for
+  std::lock_guard lock(m_modem_mutex);
+  int const outputs = m_modem_outputs.load(std::memory_order_relaxed);
+  int assert_bits = outputs & (TIOCM_DTR | TIOCM_RTS);
+  int deassert_bits = ~outputs & (TIOCM_DTR | TIOCM_RTS);
+  ::ioctl(m_fd, TIOCMBIS, &assert_bits);
+  ::ioctl(m_fd, TIOCMBIC, &deassert_bits);
+
+  return true;
+}
+
+connection_state serial::get_connection_state() const
+{
+  return m_connection_state.load(std::memory_order_acquire);
+}
+
+void serial::on_connection_change(
+  hal::callback<void(connection_state)> p_handler)
+{
+  std::lock_guard lock(m_connection_mutex);
+  m_connection_handler = std::move(p_handler);
+}
+
+void serial::set_connection_state(connection_state p_state)
+{
+  m_connection_state.store(p_state, std::memory_order_release);
+
+  std::lock_guard lock(m_connection_mutex);
+  if (m_connection_handler) {
+    m_connection_handler(p_state);
   }
 }
 
 void serial::driver_configure(hal::v5::serial::settings const& p_settings)
 {
+  std::lock_guard lock(m_settings_mutex);
+  apply_termios_settings(p_settings, m_flow_control);
+  m_settings = p_settings;
+}
 
+void serial::apply_termios_settings(
+  hal::v5::serial::settings const& p_settings,
+  flow_control p_flow_control)
+{
   // Configure basic terminal settings
   struct termios tty;
 
   if (::tcgetattr(m_fd, &tty) != 0) {
-    ::close(m_fd);
     throw hal::operation_not_permitted(nullptr);
   }
 
@@ -185,7 +947,8 @@ void serial::driver_configure(hal::v5::serial::settings const& p_settings)
   tty.c_cflag |= CS8;
 
   // Set baud rate
-  speed_t speed = baud_rate_to_speed(p_settings.baud_rate);
+  speed_t speed =
+    baud_rate_to_speed(static_cast<hal::hertz>(p_settings.baud_rate));
 
   if (speed == B0) {
     throw hal::operation_not_supported(this);
@@ -220,84 +983,361 @@ void serial::driver_configure(hal::v5::serial::settings const& p_settings)
       throw hal::operation_not_supported(nullptr);
   }
 
+  // Configure flow control
+  tty.c_cflag &= ~CRTSCTS;
+  tty.c_iflag &= ~(IXON | IXOFF | IXANY);
+  switch (p_flow_control) {
+    case flow_control::none:
+      break;
+    case flow_control::hardware:
+      tty.c_cflag |= CRTSCTS;
+      break;
+    case flow_control::software:
+      tty.c_iflag |= (IXON | IXOFF);
+      tty.c_cc[VSTART] = 0x11;  // XON
+      tty.c_cc[VSTOP] = 0x13;   // XOFF
+      break;
+  }
+
   // Apply the settings
   if (::tcsetattr(m_fd, TCSANOW, &tty) != 0) {
     throw hal::operation_not_permitted(nullptr);
   }
 }
 
+hal::v5::serial::settings serial::get_settings() const
+{
+  std::lock_guard lock(m_settings_mutex);
+  return m_settings;
+}
+
+void serial::set_flow_control(flow_control p_flow_control)
+{
+  std::lock_guard lock(m_settings_mutex);
+  apply_termios_settings(m_settings, p_flow_control);
+  m_flow_control = p_flow_control;
+}
+
+flow_control serial::get_flow_control() const
+{
+  std::lock_guard lock(m_settings_mutex);
+  return m_flow_control;
+}
+
 void serial::driver_write(std::span<hal::byte const> p_data)
 {
   if (p_data.empty()) {
     return;
   }
 
+  std::array<std::span<hal::byte const>, 1> const buffers = { p_data };
+  write(buffers);
+}
+
+void serial::write(std::span<std::span<hal::byte const> const> p_buffers)
+{
+  if (m_rs485_in_software.load(std::memory_order_acquire)) {
+    write_rs485_transaction(p_buffers);
+    return;
+  }
+
+  write_all(p_buffers);
+}
+
+void serial::write_all(std::span<std::span<hal::byte const> const> p_buffers)
+{
+  auto const calls = write_gathered(m_fd, p_buffers, [this](int p_error) {
+    if (p_error != EAGAIN && p_error != EWOULDBLOCK) {
+      throw hal::io_error(nullptr);
+    }
+    // The transmit buffer is full or flow control paused the device, wait for
+    // it to drain instead of spinning. Errors and hangups end the wait, the
+    // next writev() reports them.
+    m_transmit_blocked.store(true, std::memory_order_release);
+    pollfd descriptor{ .fd = m_fd, .events = POLLOUT, .revents = 0 };
+    ::poll(&descriptor, 1, -1);
+  });
+
   usize total_written = 0;
-  while (total_written < p_data.size()) {
-    hal::isize bytes_written = ::write(
-      m_fd, p_data.data() + total_written, p_data.size() - total_written);
+  for (auto const buffer : p_buffers) {
+    total_written += buffer.size();
+  }
+  m_write_calls.fetch_add(calls, std::memory_order_relaxed);
+  m_bytes_transmitted.fetch_add(total_written, std::memory_order_relaxed);
+}
 
-    if (bytes_written < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        // Would block - try again
-        continue;
-      } else {
-        throw hal::io_error(nullptr);
-      }
+void serial::write_rs485_transaction(
+  std::span<std::span<hal::byte const> const> p_buffers)
+{
+  std::lock_guard lock(m_rs485_mutex);
+
+  // RS-485 may have been disabled while waiting for the lock
+  if (not m_rs485 || m_rs485_in_kernel.load(std::memory_order_relaxed)) {
+    write_all(p_buffers);
+    return;
+  }
+
+  set_rs485_driver(true);
+  rs485_wait(m_rs485->delay_before_send);
+
+  try {
+    write_all(p_buffers);
+  } catch (...) {
+    // Never leave the driver enabled, it would jam the bus for every node
+    try {
+      set_rs485_driver(false);
+    } catch (...) {
     }
+    throw;
+  }
 
-    total_written += static_cast<usize>(bytes_written);
+  // tcdrain() returns once the last bit has left the UART
+  ::tcdrain(m_fd);
+  auto const drained = std::chrono::steady_clock::now();
+  rs485_wait(m_rs485->delay_after_send);
+  set_rs485_driver(false);
+  auto const turnaround = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - drained);
+
+  auto const turnaround_ns = static_cast<hal::u64>(turnaround.count());
+  m_rs485_transactions.fetch_add(1, std::memory_order_relaxed);
+  m_rs485_turnaround_total_ns.fetch_add(turnaround_ns,
+                                        std::memory_order_relaxed);
+  // Only transactions update the maximum and they are serialized by the lock
+  auto const max_ns = m_rs485_turnaround_max_ns.load(std::memory_order_relaxed);
+  if (turnaround_ns > max_ns) {
+    m_rs485_turnaround_max_ns.store(turnaround_ns, std::memory_order_relaxed);
   }
 }
 
-std::span<hal::byte const> serial::driver_receive_buffer()
+void serial::enable_rs485(rs485_settings const& p_settings,
+                          hal::v5::optional_ptr<precise_delay> p_delay)
 {
-  return std::span<hal::byte const>(m_receive_buffer);
+  std::lock_guard lock(m_rs485_mutex);
+
+  if (apply_kernel_rs485(p_settings)) {
+    m_rs485 = p_settings;
+    m_rs485_delay = p_delay;
+    m_rs485_in_software.store(false, std::memory_order_release);
+    m_rs485_in_kernel.store(true, std::memory_order_release);
+    return;
+  }
+
+  auto const previous = std::exchange(m_rs485, p_settings);
+  try {
+    // Start out listening to the bus
+    set_rs485_driver(false);
+  } catch (...) {
+    m_rs485 = previous;
+    throw;
+  }
+
+  m_rs485_delay = p_delay;
+  m_rs485_in_kernel.store(false, std::memory_order_release);
+  m_rs485_in_software.store(true, std::memory_order_release);
 }
 
-usize serial::driver_cursor()
+void serial::disable_rs485()
 {
-  return m_receive_cursor.load(std::memory_order_acquire);
+  std::lock_guard lock(m_rs485_mutex);
+
+  if (not m_rs485) {
+    return;
+  }
+
+  if (m_rs485_in_kernel.load(std::memory_order_relaxed)) {
+#if defined(__linux__) && defined(TIOCSRS485)
+    serial_rs485 config{};
+    ::ioctl(m_fd, TIOCSRS485, &config);
+#endif
+  } else {
+    set_rs485_driver(false);
+  }
+
+  m_rs485_in_kernel.store(false, std::memory_order_release);
+  m_rs485_in_software.store(false, std::memory_order_release);
+  m_rs485.reset();
+  m_rs485_delay = nullptr;
 }
 
-// Add these function implementations:
+bool serial::rs485_in_kernel() const
+{
+  return m_rs485_in_kernel.load(std::memory_order_acquire);
+}
 
-void serial::set_dtr(bool p_state)
+bool serial::apply_kernel_rs485(rs485_settings const& p_settings)
 {
-  int status;
-  if (::ioctl(m_fd, TIOCMGET, &status) != 0) {
-    throw hal::operation_not_permitted(this);
+#if defined(__linux__) && defined(TIOCSRS485)
+  // The kernel delays have millisecond resolution, round up so the bus is
+  // never released early
+  auto const to_ms = [](hal::time_duration p_delay) {
+    return static_cast<__u32>(
+      std::chrono::ceil<std::chrono::milliseconds>(p_delay).count());
+  };
+
+  serial_rs485 config{};
+  config.flags = SER_RS485_ENABLED | (p_settings.rts_on_send
+                                        ? SER_RS485_RTS_ON_SEND
+                                        : SER_RS485_RTS_AFTER_SEND);
+  config.delay_rts_before_send = to_ms(p_settings.delay_before_send);
+  config.delay_rts_after_send = to_ms(p_settings.delay_after_send);
+  return ::ioctl(m_fd, TIOCSRS485, &config) == 0;
+#else
+  static_cast<void>(p_settings);
+  return false;
+#endif
+}
+
+void serial::set_rs485_driver(bool p_enabled)
+{
+  if (p_enabled == m_rs485->rts_on_send) {
+    update_modem_outputs(TIOCM_RTS, 0);
+  } else {
+    update_modem_outputs(0, TIOCM_RTS);
   }
+}
 
-  if (p_state) {
-    status |= TIOCM_DTR;  // Set DTR bit
+void serial::rs485_wait(hal::time_duration p_duration)
+{
+  if (p_duration.count() <= 0) {
+    return;
+  }
+
+  if (m_rs485_delay) {
+    m_rs485_delay->delay(p_duration);
   } else {
-    status &= ~TIOCM_DTR;  // Clear DTR bit
+    std::this_thread::sleep_for(p_duration);
   }
+}
 
-  if (::ioctl(m_fd, TIOCMSET, &status) != 0) {
-    throw hal::operation_not_permitted(this);
+usize serial::write_some(std::span<hal::byte const> p_data)
+{
+  if (p_data.empty()) {
+    return 0;
   }
+
+  if (m_rs485_in_software.load(std::memory_order_acquire)) {
+    // Direction control cannot be split across partial writes
+    std::array<std::span<hal::byte const>, 1> const buffers = { p_data };
+    write_rs485_transaction(buffers);
+    return p_data.size();
+  }
+
+  auto const bytes_written = ::write(m_fd, p_data.data(), p_data.size());
+  m_write_calls.fetch_add(1, std::memory_order_relaxed);
+
+  if (bytes_written < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      m_transmit_blocked.store(true, std::memory_order_release);
+      return 0;
+    }
+    throw hal::io_error(this);
+  }
+
+  auto const count = static_cast<usize>(bytes_written);
+  m_bytes_transmitted.fetch_add(count, std::memory_order_relaxed);
+  return count;
 }
 
-void serial::set_rts(bool p_state)
+int serial::native_handle() const
 {
-  int status;
-  if (::ioctl(m_fd, TIOCMGET, &status) != 0) {
+  return m_fd;
+}
+
+int serial::readiness_handle() const
+{
+  return m_readiness.native_handle();
+}
+
+void serial::acknowledge_readiness()
+{
+  m_readiness.acknowledge();
+}
+
+bool serial::rs485_in_software() const
+{
+  return m_rs485_in_software.load(std::memory_order_acquire);
+}
+
+void serial::record_transmitted(usize p_bytes)
+{
+  m_bytes_transmitted.fetch_add(p_bytes, std::memory_order_relaxed);
+}
+
+serial::statistics serial::get_statistics() const
+{
+  return statistics{
+    .bytes_received = m_bytes_received.load(std::memory_order_relaxed),
+    .bytes_transmitted = m_bytes_transmitted.load(std::memory_order_relaxed),
+    .read_calls = m_read_calls.load(std::memory_order_relaxed),
+    .write_calls = m_write_calls.load(std::memory_order_relaxed),
+    .wait_calls = m_wait_calls.load(std::memory_order_relaxed),
+    .reconnects = m_reconnects.load(std::memory_order_relaxed),
+    .rs485_transactions = m_rs485_transactions.load(std::memory_order_relaxed),
+    .rs485_turnaround_total_ns =
+      m_rs485_turnaround_total_ns.load(std::memory_order_relaxed),
+    .rs485_turnaround_max_ns =
+      m_rs485_turnaround_max_ns.load(std::memory_order_relaxed),
+  };
+}
+
+std::span<hal::byte const> serial::driver_receive_buffer()
+{
+  return std::span<hal::byte const>(m_receive_buffer);
+}
+
+usize serial::driver_cursor()
+{
+  return m_receive_cursor.load(std::memory_order_acquire);
+}
+
+void serial::update_modem_outputs(int p_assert, int p_deassert)
+{
+  std::lock_guard lock(m_modem_mutex);
+
+  // TIOCMBIS and TIOCMBIC only touch the bits passed to them, which avoids the
+  // read-modify-write race of a TIOCMGET + TIOCMSET pair.
+  if (p_assert != 0 && ::ioctl(m_fd, TIOCMBIS, &p_assert) != 0) {
+    throw hal::operation_not_permitted(this);
+  }
+
+  if (p_deassert != 0 && ::ioctl(m_fd, TIOCMBIC, &p_deassert) != 0) {
     throw hal::operation_not_permitted(this);
   }
 
+  auto const outputs = m_modem_outputs.load(std::memory_order_relaxed);
+  m_modem_outputs.store((outputs | p_assert) & ~p_deassert,
+                        std::memory_order_release);
+}
+
+void serial::set_dtr(bool p_state)
+{
   if (p_state) {
-    status |= TIOCM_RTS;  // Set RTS bit
+    update_modem_outputs(TIOCM_DTR, 0);
   } else {
-    status &= ~TIOCM_RTS;  // Clear RTS bit
+    update_modem_outputs(0, TIOCM_DTR);
   }
+}
 
-  if (::ioctl(m_fd, TIOCMSET, &status) != 0) {
-    throw hal::operation_not_permitted(this);
+void serial::set_rts(bool p_state)
+{
+  if (p_state) {
+    update_modem_outputs(TIOCM_RTS, 0);
+  } else {
+    update_modem_outputs(0, TIOCM_RTS);
   }
 }
 
+bool serial::get_dtr() const
+{
+  return (m_modem_outputs.load(std::memory_order_acquire) & TIOCM_DTR) != 0;
+}
+
+bool serial::get_rts() const
+{
+  return (m_modem_outputs.load(std::memory_order_acquire) & TIOCM_RTS) != 0;
+}
+
 serial::control_signals serial::get_control_signals()
 {
   int status;
@@ -308,29 +1348,171 @@ serial::control_signals serial::get_control_signals()
   return control_signals{ .dtr = (status & TIOCM_DTR) != 0,
                           .rts = (status & TIOCM_RTS) != 0,
                           .dsr = (status & TIOCM_DSR) != 0,
-                          .cts = (status & TIOCM_CTS) != 0 };
+                          .cts = (status & TIOCM_CTS) != 0,
+                          .dcd = (status & TIOCM_CD) != 0,
+                          .ri = (status & TIOCM_RI) != 0 };
 }
 
-void serial::set_control_signals(bool p_dtr_state, bool p_rts_state)
+bool serial::get_modem_input(modem_in p_line)
 {
+  auto const bit = modem_input_bits[static_cast<usize>(p_line)];
+
+  if (m_modem_thread_running.load(std::memory_order_acquire)) {
+    return (m_modem_inputs.load(std::memory_order_acquire) & bit) != 0;
+  }
+
   int status;
   if (::ioctl(m_fd, TIOCMGET, &status) != 0) {
     throw hal::operation_not_permitted(this);
   }
 
-  // Clear both bits first
-  status &= ~(TIOCM_DTR | TIOCM_RTS);
+  return (status & bit) != 0;
+}
+
+void serial::on_modem_edge(modem_in p_line,
+                           hal::callback<void(modem_edge const&)> p_handler)
+{
+  std::lock_guard lock(m_modem_handler_mutex);
+
+  auto& handler = m_modem_handlers[static_cast<usize>(p_line)];
+  handler = std::move(p_handler);
 
-  // Set the requested states
-  if (p_dtr_state) {
-    status |= TIOCM_DTR;
+  if (m_modem_thread.joinable() || not handler) {
+    return;
   }
-  if (p_rts_state) {
-    status |= TIOCM_RTS;
+
+  // Seed the tracked state so get_modem_input() is valid as soon as the
+  // watcher is marked as running.
+  int status = 0;
+  if (::ioctl(m_fd, TIOCMGET, &status) == 0) {
+    m_modem_inputs.store(status & modem_input_mask, std::memory_order_release);
   }
 
-  if (::ioctl(m_fd, TIOCMSET, &status) != 0) {
-    throw hal::operation_not_permitted(this);
+  m_modem_thread_running.store(true, std::memory_order_release);
+  m_modem_thread = std::thread(&serial::modem_thread_function, this);
+}
+
+void serial::modem_thread_function()
+{
+  // Polling, rather than blocking in TIOCMIWAIT, lets the destructor stop the
+  // watcher without a signal. The driver's transition counters make up for
+  // pulses shorter than the poll interval.
+  auto previous = m_modem_inputs.load(std::memory_order_acquire);
+  std::optional<std::array<int, 4>> previous_counts;
+  if (auto const snapshot = read_modem_snapshot(m_fd)) {
+    previous = snapshot->status;
+    previous_counts = snapshot->counts;
+  }
+
+  while (!m_stop_thread.load(std::memory_order_acquire)) {
+    std::this_thread::sleep_for(modem_poll_interval);
+
+    auto const snapshot = read_modem_snapshot(m_fd);
+    if (not snapshot) {
+      previous_counts.reset();
+      continue;
+    }
+
+    auto const now = std::chrono::steady_clock::now();
+    auto const status = snapshot->status;
+    // Edges per line since the last poll. A line that is back at its level
+    // but was counted changing has pulsed and gets a pair of edges.
+    std::array<int, 4> edges{};
+    bool any = false;
+    for (usize i = 0; i < edges.size(); i++) {
+      auto const bit = modem_input_bits[i];
+      if (((status ^ previous) & bit) != 0) {
+        edges[i] = 1;
+      } else if (snapshot->counts && previous_counts &&
+                 (*snapshot->counts)[i] != (*previous_counts)[i]) {
+        edges[i] = 2;
+      }
+      any = any || edges[i] != 0;
+    }
+    previous = status;
+    previous_counts = snapshot->counts;
+    m_modem_inputs.store(status, std::memory_order_release);
+
+    if (not any) {
+      continue;
+    }
+
+    std::lock_guard lock(m_modem_handler_mutex);
+    for (usize i = 0; i < modem_input_bits.size(); i++) {
+      auto& handler = m_modem_handlers[i];
+      if (edges[i] == 0 || not handler) {
+        continue;
+      }
+      bool const level = (status & modem_input_bits[i]) != 0;
+      auto const line = static_cast<modem_in>(i);
+      if (edges[i] == 2) {
+        handler(modem_edge{ .line = line, .level = !level, .timestamp = now });
+      }
+      handler(modem_edge{ .line = line, .level = level, .timestamp = now });
+    }
+  }
+
+  m_modem_thread_running.store(false, std::memory_order_release);
+}
+
+void serial::set_control_signals(bool p_dtr_state, bool p_rts_state)
+{
+  int assert_bits = 0;
+  int deassert_bits = 0;
+
+  (p_dtr_state ? assert_bits : deassert_bits) |= TIOCM_DTR;
+  (p_rts_state ? assert_bits : deassert_bits) |= TIOCM_RTS;
+
+  update_modem_outputs(assert_bits, deassert_bits);
+}
+
+void serial::run_control_sequence(precise_delay& p_delay,
+                                  std::span<control_step const> p_steps,
+                                  std::span<hal::u64> p_timestamps)
+{
+  if (not p_timestamps.empty() && p_timestamps.size() < p_steps.size()) {
+    throw hal::argument_out_of_domain(this);
+  }
+
+  std::exception_ptr error = nullptr;
+
+  std::thread sequencer([&]() {
+    try {
+      raise_current_thread_priority();
+
+      auto& clock = p_delay.clock();
+      auto const frequency = static_cast<double>(clock.frequency());
+      auto const start = clock.uptime();
+      // Deadlines are computed from the total elapsed time since the start so
+      // rounding and wakeup errors never accumulate from step to step.
+      hal::time_duration elapsed{ 0 };
+
+      for (usize i = 0; i < p_steps.size(); i++) {
+        auto const deadline =
+          start + static_cast<hal::u64>(static_cast<double>(elapsed.count()) *
+                                        frequency / 1e9);
+        p_delay.delay_until(deadline);
+        set_control_signals(p_steps[i].dtr, p_steps[i].rts);
+
+        if (not p_timestamps.empty()) {
+          p_timestamps[i] = clock.uptime();
+        }
+
+        elapsed += p_steps[i].hold;
+      }
+
+      p_delay.delay_until(
+        start + static_cast<hal::u64>(static_cast<double>(elapsed.count()) *
+                                      frequency / 1e9));
+    } catch (...) {
+      error = std::current_exception();
+    }
+  });
+
+  sequencer.join();
+
+  if (error) {
+    std::rethrow_exception(error);
   }
 }
 
@@ -362,7 +1544,7 @@ private:
 
   bool driver_level() override
   {
-    return m_manager->get_control_signals().dtr;
+    return m_manager->get_dtr();
   }
 
   hal::v5::strong_ptr<mac::serial> m_manager;
@@ -401,10 +1583,101 @@ private:
 
   bool driver_level() override
   {
-    return m_manager->get_control_signals().rts;
+    return m_manager->get_rts();
+  }
+
+  hal::v5::strong_ptr<mac::serial> m_manager;
+};
+
+class modem_input_pin : public hal::input_pin
+{
+public:
+  modem_input_pin(hal::v5::strong_ptr_only_token,
+                  hal::v5::strong_ptr<mac::serial> p_manager,
+                  mac::modem_in p_line)
+    : m_manager(p_manager)
+    , m_line(p_line)
+  {
+  }
+
+  modem_input_pin(modem_input_pin const&) = delete;
+  modem_input_pin& operator=(modem_input_pin const&) = delete;
+  modem_input_pin(modem_input_pin&&) = delete;
+  modem_input_pin& operator=(modem_input_pin&&) = delete;
+
+private:
+  void driver_configure(settings const&) override
+  {
+    // Status lines are driven by the device, pull resistors have no meaning
+  }
+
+  bool driver_level() override
+  {
+    return m_manager->get_modem_input(m_line);
+  }
+
+  hal::v5::strong_ptr<mac::serial> m_manager;
+  mac::modem_in m_line;
+};
+
+class modem_interrupt_pin : public hal::interrupt_pin
+{
+public:
+  modem_interrupt_pin(hal::v5::strong_ptr_only_token,
+                      hal::v5::strong_ptr<mac::serial> p_manager,
+                      mac::modem_in p_line)
+    : m_manager(p_manager)
+    , m_line(p_line)
+  {
+  }
+
+  modem_interrupt_pin(modem_interrupt_pin const&) = delete;
+  modem_interrupt_pin& operator=(modem_interrupt_pin const&) = delete;
+  modem_interrupt_pin(modem_interrupt_pin&&) = delete;
+  modem_interrupt_pin& operator=(modem_interrupt_pin&&) = delete;
+
+  ~modem_interrupt_pin() override
+  {
+    if (m_registered) {
+      m_manager->on_modem_edge(m_line, {});
+    }
+  }
+
+private:
+  void driver_configure(settings const& p_settings) override
+  {
+    // Status lines are driven by the device, pull resistors have no meaning
+    m_trigger.store(p_settings.trigger, std::memory_order_relaxed);
+  }
+
+  void driver_on_trigger(hal::callback<handler> p_callback) override
+  {
+    m_registered = true;
+    m_manager->on_modem_edge(
+      m_line,
+      [this, callback = std::move(p_callback)](modem_edge const& p_edge) {
+        switch (m_trigger.load(std::memory_order_relaxed)) {
+          case trigger_edge::rising:
+            if (not p_edge.level) {
+              return;
+            }
+            break;
+          case trigger_edge::falling:
+            if (p_edge.level) {
+              return;
+            }
+            break;
+          case trigger_edge::both:
+            break;
+        }
+        callback(p_edge.level);
+      });
   }
 
   hal::v5::strong_ptr<mac::serial> m_manager;
+  mac::modem_in m_line;
+  std::atomic<trigger_edge> m_trigger{ trigger_edge::rising };
+  bool m_registered = false;
 };
 
 hal::v5::strong_ptr<hal::output_pin> acquire_output_pin(
@@ -423,4 +1696,22 @@ hal::v5::strong_ptr<hal::output_pin> acquire_output_pin(
     }
   }
 }
+
+hal::v5::strong_ptr<hal::input_pin> acquire_input_pin(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<mac::serial> p_manager,
+  mac::modem_in p_pin)
+{
+  return hal::v5::make_strong_ptr<modem_input_pin>(
+    p_allocator, p_manager, p_pin);
+}
+
+hal::v5::strong_ptr<hal::interrupt_pin> acquire_interrupt_pin(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<mac::serial> p_manager,
+  mac::modem_in p_pin)
+{
+  return hal::v5::make_strong_ptr<modem_interrupt_pin>(
+    p_allocator, p_manager, p_pin);
+}
 }  // namespace hal::mac::inline v1
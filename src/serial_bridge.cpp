@@ -0,0 +1,443 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/serial_bridge.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+namespace hal::mac::inline v1 {
+
+namespace {
+/// Longest single wait for a slow descriptor, bounds how long a stop request
+/// can go unnoticed
+constexpr int wait_slice_ms = 100;
+
+/**
+ * @brief Create a non-blocking, close-on-exec pipe
+ *
+ * @return false if the pipe cannot be created
+ */
+bool open_pipe(std::array<int, 2>& p_pipe)
+{
+  if (::pipe(p_pipe.data()) != 0) {
+    return false;
+  }
+  for (int const fd : p_pipe) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+  return true;
+}
+
+void close_pipe(std::array<int, 2>& p_pipe)
+{
+  for (int& fd : p_pipe) {
+    if (fd != -1) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+}
+
+/**
+ * @brief Throw away whatever is left in a pipe
+ */
+void discard_pipe(int p_pipe, std::span<hal::byte> p_scratch)
+{
+  while (::read(p_pipe, p_scratch.data(), p_scratch.size()) > 0) {
+  }
+}
+}  // namespace
+
+hal::v5::strong_ptr<serial_bridge> serial_bridge::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_serial,
+  int p_peer)
+{
+  return create(p_allocator, p_serial, p_peer, settings{});
+}
+
+hal::v5::strong_ptr<serial_bridge> serial_bridge::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_serial,
+  int p_peer,
+  settings const& p_settings)
+{
+  if (p_settings.transfer_size == 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<serial_bridge>(
+    p_allocator, p_allocator, p_serial, p_peer, p_settings);
+}
+
+serial_bridge::serial_bridge(hal::v5::strong_ptr_only_token,
+                             std::pmr::polymorphic_allocator<> p_allocator,
+                             hal::v5::strong_ptr<serial> p_serial,
+                             int p_peer,
+                             settings const& p_settings)
+  : m_serial(p_serial)
+  , m_peer(p_peer)
+  , m_settings(p_settings)
+  , m_receive_buffer(p_settings.transfer_size, hal::byte{ 0 }, p_allocator)
+  , m_transmit_buffer(p_settings.transfer_size, hal::byte{ 0 }, p_allocator)
+  , m_peer_is_terminal(::isatty(p_peer) == 1)
+{
+  bool opened = open_pipe(m_wake_pipe);
+#if defined(__linux__)
+  opened = opened && open_pipe(m_receive_pipe) && open_pipe(m_transmit_pipe);
+  if (m_settings.tee) {
+    opened = opened && open_pipe(m_tee_pipe);
+  }
+  m_receive_zero_copy.store(true, std::memory_order_relaxed);
+  m_transmit_zero_copy.store(true, std::memory_order_relaxed);
+#endif
+
+  try {
+    if (not opened) {
+      throw hal::operation_not_permitted(this);
+    }
+    m_serial->set_receive_bypass(
+      [this](int p_fd) { return forward_from_device(p_fd); });
+  } catch (...) {
+    // The destructor does not run for a throwing constructor
+    close_pipe(m_wake_pipe);
+    close_pipe(m_receive_pipe);
+    close_pipe(m_transmit_pipe);
+    close_pipe(m_tee_pipe);
+    throw;
+  }
+
+  m_peer_thread = std::thread(&serial_bridge::peer_thread_function, this);
+}
+
+serial_bridge::~serial_bridge()
+{
+  m_stop.store(true, std::memory_order_release);
+
+  // Once this returns the receive path no longer calls into the bridge
+  m_serial->set_receive_bypass({});
+
+  char const token = 0;
+  [[maybe_unused]] auto const result = ::write(m_wake_pipe[1], &token, 1);
+  m_peer_thread.join();
+
+  close_pipe(m_wake_pipe);
+  close_pipe(m_receive_pipe);
+  close_pipe(m_transmit_pipe);
+  close_pipe(m_tee_pipe);
+}
+
+bool serial_bridge::peer_connected() const
+{
+  return m_peer_connected.load(std::memory_order_acquire);
+}
+
+serial_bridge::statistics serial_bridge::get_statistics() const
+{
+  return statistics{
+    .bytes_to_peer = m_bytes_to_peer.load(std::memory_order_relaxed),
+    .bytes_to_device = m_bytes_to_device.load(std::memory_order_relaxed),
+    .zero_copy_transfers =
+      m_zero_copy_transfers.load(std::memory_order_relaxed),
+    .buffered_transfers = m_buffered_transfers.load(std::memory_order_relaxed),
+  };
+}
+
+hal::isize serial_bridge::forward_from_device(int p_fd)
+{
+#if defined(__linux__)
+  if (m_receive_zero_copy.load(std::memory_order_relaxed)) {
+    auto const moved = ::splice(p_fd,
+                                nullptr,
+                                m_receive_pipe[1],
+                                nullptr,
+                                m_settings.transfer_size,
+                                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+    if (moved < 0 && errno == EINVAL) {
+      // Terminals only support splice() on recent kernels
+      m_receive_zero_copy.store(false, std::memory_order_relaxed);
+    } else {
+      if (moved <= 0) {
+        return moved;
+      }
+
+      auto const size = static_cast<usize>(moved);
+      if (m_settings.tee) {
+        // tee() duplicates the pipe's pages without consuming them, only the
+        // copy for local consumers enters user space
+        auto const copied = ::tee(
+          m_receive_pipe[0], m_tee_pipe[1], size, SPLICE_F_NONBLOCK);
+        if (copied > 0) {
+          auto const count = ::read(
+            m_tee_pipe[0], m_receive_buffer.data(), static_cast<usize>(copied));
+          if (count > 0) {
+            m_serial->publish_received(
+              std::span(m_receive_buffer).first(static_cast<usize>(count)));
+          }
+        }
+      }
+
+      if (m_peer_connected.load(std::memory_order_relaxed) &&
+          drain_pipe(m_receive_pipe[0],
+                     m_peer,
+                     size,
+                     m_receive_buffer,
+                     m_receive_zero_copy)) {
+        m_bytes_to_peer.fetch_add(size, std::memory_order_relaxed);
+      } else {
+        m_peer_connected.store(false, std::memory_order_release);
+        discard_pipe(m_receive_pipe[0], m_receive_buffer);
+      }
+      m_zero_copy_transfers.fetch_add(1, std::memory_order_relaxed);
+      return moved;
+    }
+  }
+#endif
+
+  auto const count =
+    ::read(p_fd, m_receive_buffer.data(), m_receive_buffer.size());
+  if (count <= 0) {
+    return count;
+  }
+
+  auto const data =
+    std::span(m_receive_buffer).first(static_cast<usize>(count));
+  if (m_settings.tee) {
+    m_serial->publish_received(data);
+  }
+
+  if (m_peer_connected.load(std::memory_order_relaxed)) {
+    if (write_fully(m_peer, data)) {
+      m_bytes_to_peer.fetch_add(data.size(), std::memory_order_relaxed);
+    } else {
+      m_peer_connected.store(false, std::memory_order_release);
+    }
+  }
+  m_buffered_transfers.fetch_add(1, std::memory_order_relaxed);
+  return count;
+}
+
+void serial_bridge::peer_thread_function()
+{
+  // Write-only peers such as stdout or a pipe's write end are one-way bridges
+  auto const flags = ::fcntl(m_peer, F_GETFL);
+  if (flags != -1 && (flags & O_ACCMODE) == O_WRONLY) {
+    return;
+  }
+
+  // A pty whose tool closed its end reports POLLHUP until a tool opens it
+  // again, so while hung up it is probed every wait slice instead of polled
+  bool hung_up = false;
+
+  while (true) {
+    std::array<pollfd, 2> descriptors = { {
+      { .fd = m_wake_pipe[0], .events = POLLIN, .revents = 0 },
+      { .fd = hung_up ? -1 : m_peer, .events = POLLIN, .revents = 0 },
+    } };
+
+    if (::poll(descriptors.data(),
+               descriptors.size(),
+               hung_up ? wait_slice_ms : -1) < 0 &&
+        errno != EINTR) {
+      m_peer_connected.store(false, std::memory_order_release);
+      return;
+    }
+
+    if (descriptors[0].revents != 0) {
+      return;
+    }
+
+    if (hung_up) {
+      pollfd peer{ .fd = m_peer, .events = POLLIN, .revents = 0 };
+      if (::poll(&peer, 1, 0) >= 0 && (peer.revents & POLLHUP) == 0) {
+        hung_up = false;
+        m_peer_connected.store(true, std::memory_order_release);
+      }
+      continue;
+    }
+
+    if (descriptors[1].revents != 0 && not forward_from_peer()) {
+      m_peer_connected.store(false, std::memory_order_release);
+      if (not m_peer_is_terminal) {
+        return;
+      }
+      hung_up = true;
+    }
+  }
+}
+
+bool serial_bridge::forward_from_peer()
+{
+  auto const device = m_serial->native_handle();
+
+#if defined(__linux__)
+  // Software RS-485 direction control must wrap every write, so it goes
+  // through serial::write()
+  if (m_transmit_zero_copy.load(std::memory_order_relaxed) &&
+      not m_serial->rs485_in_software()) {
+    auto const moved = ::splice(m_peer,
+                                nullptr,
+                                m_transmit_pipe[1],
+                                nullptr,
+                                m_settings.transfer_size,
+                                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+    if (moved < 0 && errno == EINVAL) {
+      m_transmit_zero_copy.store(false, std::memory_order_relaxed);
+    } else if (moved == 0) {
+      return false;
+    } else if (moved < 0) {
+      return errno == EAGAIN || errno == EINTR;
+    } else {
+      auto const size = static_cast<usize>(moved);
+      // A failing device is reconnecting, its data is lost like any write
+      // during a disconnect
+      if (drain_pipe(m_transmit_pipe[0],
+                     device,
+                     size,
+                     m_transmit_buffer,
+                     m_transmit_zero_copy)) {
+        m_bytes_to_device.fetch_add(size, std::memory_order_relaxed);
+        m_serial->record_transmitted(size);
+      }
+      m_zero_copy_transfers.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+#endif
+
+  auto const count =
+    ::read(m_peer, m_transmit_buffer.data(), m_transmit_buffer.size());
+  if (count == 0) {
+    return false;
+  }
+  if (count < 0) {
+    return errno == EAGAIN || errno == EINTR;
+  }
+
+  auto const data =
+    std::span(m_transmit_buffer).first(static_cast<usize>(count));
+  try {
+    m_serial->write(data);
+    m_bytes_to_device.fetch_add(data.size(), std::memory_order_relaxed);
+  } catch (hal::io_error const&) {
+    // The device is reconnecting, its data is lost like any write during a
+    // disconnect
+  }
+  m_buffered_transfers.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool serial_bridge::write_fully(int p_fd, std::span<hal::byte const> p_data)
+{
+  while (not p_data.empty()) {
+    auto const written = ::write(p_fd, p_data.data(), p_data.size());
+    if (written > 0) {
+      p_data = p_data.subspan(static_cast<usize>(written));
+      continue;
+    }
+
+    if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (m_stop.load(std::memory_order_acquire)) {
+        return false;
+      }
+      pollfd descriptor{ .fd = p_fd, .events = POLLOUT, .revents = 0 };
+      ::poll(&descriptor, 1, wait_slice_ms);
+      continue;
+    }
+
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+
+    return false;
+  }
+  return true;
+}
+
+bool serial_bridge::drain_pipe(int p_pipe,
+                               int p_fd,
+                               usize p_size,
+                               std::span<hal::byte> p_scratch,
+                               std::atomic<bool>& p_zero_copy)
+{
+#if defined(__linux__)
+  while (p_size > 0) {
+    auto const moved = ::splice(p_pipe,
+                                nullptr,
+                                p_fd,
+                                nullptr,
+                                p_size,
+                                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+    if (moved > 0) {
+      p_size -= static_cast<usize>(moved);
+      continue;
+    }
+
+    if (moved < 0 && errno == EAGAIN) {
+      if (m_stop.load(std::memory_order_acquire)) {
+        discard_pipe(p_pipe, p_scratch);
+        return false;
+      }
+      pollfd descriptor{ .fd = p_fd, .events = POLLOUT, .revents = 0 };
+      ::poll(&descriptor, 1, wait_slice_ms);
+      continue;
+    }
+
+    if (moved < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (moved < 0 && errno == EINVAL) {
+      // The destination does not take splice(), copy the rest through user
+      // space and stop trying
+      p_zero_copy.store(false, std::memory_order_relaxed);
+      break;
+    }
+
+    discard_pipe(p_pipe, p_scratch);
+    return false;
+  }
+#else
+  static_cast<void>(p_zero_copy);
+#endif
+
+  while (p_size > 0) {
+    auto const count =
+      ::read(p_pipe, p_scratch.data(), std::min(p_size, p_scratch.size()));
+    if (count <= 0) {
+      return false;
+    }
+    p_size -= static_cast<usize>(count);
+    if (not write_fully(
+          p_fd,
+          std::span<hal::byte const>(p_scratch).first(
+            static_cast<usize>(count)))) {
+      discard_pipe(p_pipe, p_scratch);
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,480 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/serial_broker.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+namespace hal::mac::inline v1 {
+
+namespace {
+constexpr hal::u32 region_magic = 0x6c68'7362;  // "lhsb"
+constexpr hal::u32 region_version = 1;
+
+/// Sleep of a client waiting for room in the transmit queue
+constexpr auto transmit_full_wait = std::chrono::microseconds(100);
+
+/**
+ * @brief Start of the shared memory region
+ *
+ * Processes share the region, so every field written after creation is
+ * accessed through std::atomic_ref on plain integers. The producer and
+ * consumer positions live on separate cache lines.
+ */
+struct region_header
+{
+  hal::u32 magic;
+  hal::u32 version;
+  hal::u64 receive_size;
+  hal::u64 transmit_size;
+  hal::u64 transmit_offset;
+  hal::u64 receive_offset;
+  /// Bytes received since the broker was created
+  alignas(64) hal::u64 receive_sequence;
+  /// Transmit queue bytes reserved by clients
+  alignas(64) hal::u64 transmit_reserved;
+  /// Transmit queue bytes consumed by the broker
+  alignas(64) hal::u64 transmit_consumed;
+  /// Set once the broker is destroyed
+  alignas(64) hal::u32 closed;
+};
+
+/**
+ * @brief Start of each record in the transmit queue
+ *
+ * Records are 8-byte aligned. Consumed records are zeroed, so a record whose
+ * state is still record_empty is reserved but not yet written.
+ */
+struct record_header
+{
+  hal::u32 state;
+  hal::u32 length;
+};
+
+constexpr hal::u32 record_empty = 0;
+constexpr hal::u32 record_data = 1;
+/// Fills the end of the queue when a record does not fit before wrapping
+constexpr hal::u32 record_padding = 2;
+
+static_assert(std::atomic_ref<hal::u64>::is_always_lock_free,
+              "shared memory counters must be lock free across processes");
+
+template<typename T>
+std::atomic_ref<T> shared(T& p_value)
+{
+  return std::atomic_ref<T>(p_value);
+}
+
+constexpr usize round_up(usize p_value, usize p_multiple)
+{
+  return (p_value + p_multiple - 1) / p_multiple * p_multiple;
+}
+
+usize page_size()
+{
+  return static_cast<usize>(::sysconf(_SC_PAGESIZE));
+}
+
+region_header& header_of(std::span<hal::byte> p_region)
+{
+  return *std::launder(reinterpret_cast<region_header*>(p_region.data()));
+}
+
+record_header& record_at(std::span<hal::byte> p_queue, hal::u64 p_position)
+{
+  auto const offset = static_cast<usize>(p_position % p_queue.size());
+  return *std::launder(
+    reinterpret_cast<record_header*>(p_queue.data() + offset));
+}
+
+/// Queue bytes taken by a record carrying p_length bytes
+constexpr usize record_size(usize p_length)
+{
+  return round_up(sizeof(record_header) + p_length, alignof(record_header));
+}
+}  // namespace
+
+hal::v5::strong_ptr<serial_broker> serial_broker::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_serial,
+  std::string_view p_name)
+{
+  return create(p_allocator, p_serial, p_name, settings{});
+}
+
+hal::v5::strong_ptr<serial_broker> serial_broker::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_serial,
+  std::string_view p_name,
+  settings const& p_settings)
+{
+  if (p_name.size() < 2 || p_name.front() != '/' ||
+      p_settings.receive_ring_size == 0 ||
+      p_settings.transmit_queue_size == 0 ||
+      p_settings.transmit_poll_interval.count() <= 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<serial_broker>(
+    p_allocator, p_allocator, p_serial, p_name, p_settings);
+}
+
+serial_broker::serial_broker(hal::v5::strong_ptr_only_token,
+                             std::pmr::polymorphic_allocator<> p_allocator,
+                             hal::v5::strong_ptr<serial> p_serial,
+                             std::string_view p_name,
+                             settings const& p_settings)
+  : m_serial(p_serial)
+  , m_name(p_name, p_allocator)
+  , m_settings(p_settings)
+{
+  // Every record must fit in half of the queue, see shared_serial::submit()
+  m_settings.transmit_queue_size =
+    std::max(round_up(m_settings.transmit_queue_size, alignof(record_header)),
+             4 * record_size(1));
+
+  auto const page = page_size();
+  auto const transmit_offset = round_up(sizeof(region_header), page);
+  auto const receive_offset =
+    transmit_offset + round_up(m_settings.transmit_queue_size, page);
+  auto const region_size =
+    receive_offset + round_up(m_settings.receive_ring_size, page);
+
+  m_fd = ::shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (m_fd == -1) {
+    if (errno == EEXIST) {
+      throw hal::device_or_resource_busy(this);
+    }
+    throw hal::operation_not_permitted(this);
+  }
+
+  void* mapping = MAP_FAILED;
+  if (::ftruncate(m_fd, static_cast<off_t>(region_size)) == 0) {
+    mapping = ::mmap(
+      nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  }
+
+  if (mapping == MAP_FAILED) {
+    ::close(m_fd);
+    ::shm_unlink(m_name.c_str());
+    throw hal::operation_not_permitted(this);
+  }
+
+  // A new region is zero filled, which already is an empty transmit queue
+  m_region = { static_cast<hal::byte*>(mapping), region_size };
+  auto* const header = new (m_region.data()) region_header{};
+  header->version = region_version;
+  header->receive_size = m_settings.receive_ring_size;
+  header->transmit_size = m_settings.transmit_queue_size;
+  header->transmit_offset = transmit_offset;
+  header->receive_offset = receive_offset;
+  // Clients check the magic number last
+  shared(header->magic).store(region_magic, std::memory_order_release);
+
+  m_bytes_seen = m_serial->get_statistics().bytes_received;
+  m_serial->attach_observer(*this);
+  m_transmit_thread =
+    std::thread(&serial_broker::transmit_thread_function, this);
+}
+
+serial_broker::~serial_broker()
+{
+  m_serial->detach_observer(*this);
+  m_stop_thread.store(true, std::memory_order_release);
+  m_transmit_thread.join();
+
+  shared(header_of(m_region).closed).store(1, std::memory_order_release);
+  ::munmap(m_region.data(), m_region.size());
+  ::close(m_fd);
+  ::shm_unlink(m_name.c_str());
+}
+
+std::string_view serial_broker::name() const
+{
+  return m_name;
+}
+
+serial_broker::statistics serial_broker::get_statistics() const
+{
+  auto& header = header_of(m_region);
+  return {
+    .bytes_published =
+      shared(header.receive_sequence).load(std::memory_order_relaxed),
+    .bytes_transmitted = m_bytes_transmitted.load(std::memory_order_relaxed),
+    .transmit_records = m_transmit_records.load(std::memory_order_relaxed),
+    .transmit_errors = m_transmit_errors.load(std::memory_order_relaxed),
+  };
+}
+
+void serial_broker::on_receive(usize p_cursor)
+{
+  // The byte counter, unlike the cursor, also tells a read that filled the
+  // whole receive buffer apart from no read at all
+  auto const total = m_serial->get_statistics().bytes_received;
+  auto const received = total - m_bytes_seen;
+  if (received == 0) {
+    return;
+  }
+  m_bytes_seen = total;
+
+  auto& header = header_of(m_region);
+  auto const ring =
+    m_region.subspan(header.receive_offset, header.receive_size);
+  auto const source = m_serial->receive_buffer();
+  auto const sequence =
+    shared(header.receive_sequence).load(std::memory_order_relaxed);
+
+  // Only the newest data is still in the port's buffer and fits the ring
+  auto const available = static_cast<usize>(
+    std::min<hal::u64>({ received, source.size(), ring.size() }));
+  auto from = (p_cursor + source.size() - available) % source.size();
+  auto to = static_cast<usize>((sequence + received - available) % ring.size());
+
+  for (auto remaining = available; remaining > 0;) {
+    auto const count =
+      std::min({ remaining, source.size() - from, ring.size() - to });
+    std::memcpy(ring.data() + to, source.data() + from, count);
+    from = (from + count) % source.size();
+    to = (to + count) % ring.size();
+    remaining -= count;
+  }
+
+  shared(header.receive_sequence)
+    .store(sequence + received, std::memory_order_release);
+}
+
+void serial_broker::transmit_thread_function()
+{
+  auto& header = header_of(m_region);
+  auto const queue =
+    m_region.subspan(header.transmit_offset, header.transmit_size);
+  auto consumed =
+    shared(header.transmit_consumed).load(std::memory_order_relaxed);
+
+  while (not m_stop_thread.load(std::memory_order_acquire)) {
+    auto& record = record_at(queue, consumed);
+    auto const state = shared(record.state).load(std::memory_order_acquire);
+
+    if (state == record_empty) {
+      std::this_thread::sleep_for(m_settings.transmit_poll_interval);
+      continue;
+    }
+
+    auto const offset = static_cast<usize>(consumed % queue.size());
+    usize size = record.length + sizeof(record_header);
+
+    if (state == record_data) {
+      size = record_size(record.length);
+      auto const payload =
+        queue.subspan(offset + sizeof(record_header), record.length);
+      try {
+        m_serial->write(payload);
+        m_bytes_transmitted.fetch_add(payload.size(),
+                                      std::memory_order_relaxed);
+        m_transmit_records.fetch_add(1, std::memory_order_relaxed);
+      } catch (...) {
+        m_transmit_errors.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    // Zeroed space reads as unwritten records once it is reserved again
+    std::memset(queue.data() + offset, 0, size);
+    consumed += size;
+    shared(header.transmit_consumed)
+      .store(consumed, std::memory_order_release);
+  }
+}
+
+hal::v5::strong_ptr<shared_serial> shared_serial::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  std::string_view p_name)
+{
+  return hal::v5::make_strong_ptr<shared_serial>(p_allocator, p_name);
+}
+
+shared_serial::shared_serial(hal::v5::strong_ptr_only_token,
+                             std::string_view p_name)
+{
+  std::string const name(p_name);
+  m_fd = ::shm_open(name.c_str(), O_RDWR, 0);
+  if (m_fd == -1) {
+    if (errno == ENOENT) {
+      throw hal::no_such_device(m_fd, this);
+    }
+    throw hal::operation_not_permitted(this);
+  }
+
+  try {
+    auto const page = page_size();
+    auto* const first_page =
+      ::mmap(nullptr, page, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (first_page == MAP_FAILED) {
+      throw hal::operation_not_permitted(this);
+    }
+
+    auto& header = *static_cast<region_header*>(first_page);
+    auto const magic = shared(header.magic).load(std::memory_order_acquire);
+    auto const compatible =
+      magic == region_magic && header.version == region_version;
+    auto const control_size = header.receive_offset;
+    auto const receive_offset = header.receive_offset;
+    auto const receive_size = header.receive_size;
+    ::munmap(first_page, page);
+
+    if (not compatible) {
+      throw hal::operation_not_supported(this);
+    }
+
+    auto* const control = ::mmap(nullptr,
+                                 control_size,
+                                 PROT_READ | PROT_WRITE,
+                                 MAP_SHARED,
+                                 m_fd,
+                                 0);
+    if (control == MAP_FAILED) {
+      throw hal::operation_not_permitted(this);
+    }
+    m_control = { static_cast<hal::byte*>(control), control_size };
+
+    auto* const ring = ::mmap(nullptr,
+                              receive_size,
+                              PROT_READ,
+                              MAP_SHARED,
+                              m_fd,
+                              static_cast<off_t>(receive_offset));
+    if (ring == MAP_FAILED) {
+      ::munmap(m_control.data(), m_control.size());
+      throw hal::operation_not_permitted(this);
+    }
+    m_receive_ring = { static_cast<hal::byte const*>(ring), receive_size };
+  } catch (...) {
+    // The destructor does not run for a throwing constructor
+    ::close(m_fd);
+    throw;
+  }
+}
+
+shared_serial::~shared_serial()
+{
+  ::munmap(const_cast<hal::byte*>(m_receive_ring.data()),
+           m_receive_ring.size());
+  ::munmap(m_control.data(), m_control.size());
+  ::close(m_fd);
+}
+
+hal::u64 shared_serial::receive_sequence() const
+{
+  return shared(header_of(m_control).receive_sequence)
+    .load(std::memory_order_acquire);
+}
+
+bool shared_serial::broker_connected() const
+{
+  return shared(header_of(m_control).closed)
+           .load(std::memory_order_acquire) == 0;
+}
+
+void shared_serial::driver_configure(
+  hal::v5::serial::settings const& p_settings)
+{
+  static_cast<void>(p_settings);
+  throw hal::operation_not_supported(this);
+}
+
+void shared_serial::driver_write(std::span<hal::byte const> p_data)
+{
+  auto const& header = header_of(m_control);
+  // Half of the queue, so a record and the padding before it always fit
+  auto const max_payload =
+    header.transmit_size / 2 - sizeof(record_header);
+
+  while (not p_data.empty()) {
+    auto const chunk = p_data.first(std::min(p_data.size(), max_payload));
+    submit(chunk);
+    p_data = p_data.subspan(chunk.size());
+  }
+}
+
+std::span<hal::byte const> shared_serial::driver_receive_buffer()
+{
+  return m_receive_ring;
+}
+
+usize shared_serial::driver_cursor()
+{
+  return static_cast<usize>(receive_sequence() % m_receive_ring.size());
+}
+
+void shared_serial::submit(std::span<hal::byte const> p_data)
+{
+  auto& header = header_of(m_control);
+  auto const queue =
+    m_control.subspan(header.transmit_offset, header.transmit_size);
+  auto const size = record_size(p_data.size());
+
+  auto reserved =
+    shared(header.transmit_reserved).load(std::memory_order_relaxed);
+  hal::u64 padding = 0;
+
+  while (true) {
+    if (not broker_connected()) {
+      throw hal::io_error(this);
+    }
+
+    // Records never wrap, the space left before the end becomes padding
+    auto const contiguous = queue.size() - (reserved % queue.size());
+    padding = contiguous < size ? contiguous : 0;
+    auto const consumed =
+      shared(header.transmit_consumed).load(std::memory_order_acquire);
+
+    if (reserved + padding + size - consumed > queue.size()) {
+      std::this_thread::sleep_for(transmit_full_wait);
+      reserved =
+        shared(header.transmit_reserved).load(std::memory_order_relaxed);
+      continue;
+    }
+
+    if (shared(header.transmit_reserved)
+          .compare_exchange_weak(reserved,
+                                 reserved + padding + size,
+                                 std::memory_order_acq_rel,
+                                 std::memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  if (padding != 0) {
+    auto& filler = record_at(queue, reserved);
+    filler.length = static_cast<hal::u32>(padding - sizeof(record_header));
+    shared(filler.state).store(record_padding, std::memory_order_release);
+  }
+
+  auto& record = record_at(queue, reserved + padding);
+  auto const offset =
+    static_cast<usize>((reserved + padding) % queue.size());
+  std::ranges::copy(p_data, queue.data() + offset + sizeof(record_header));
+  record.length = static_cast<hal::u32>(p_data.size());
+  shared(record.state).store(record_data, std::memory_order_release);
+}
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,322 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/serial_mux.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+#include "frame_header.hpp"
+#include "receive_ring.hpp"
+
+namespace hal::mac::inline v1 {
+
+namespace {
+constexpr hal::byte frame_sync = 0xA5;
+}  // namespace
+
+hal::v5::strong_ptr<serial_mux> serial_mux::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::v5::serial> p_link)
+{
+  return create(p_allocator, p_link, settings{});
+}
+
+hal::v5::strong_ptr<serial_mux> serial_mux::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<hal::v5::serial> p_link,
+  settings const& p_settings)
+{
+  if (p_settings.max_payload == 0 ||
+      p_settings.max_payload > std::numeric_limits<hal::u16>::max()) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<serial_mux>(
+    p_allocator, p_allocator, p_link, p_settings);
+}
+
+serial_mux::serial_mux(hal::v5::strong_ptr_only_token,
+                       std::pmr::polymorphic_allocator<> p_allocator,
+                       hal::v5::strong_ptr<hal::v5::serial> p_link,
+                       settings const& p_settings)
+  : m_allocator(p_allocator)
+  , m_link(p_link)
+  , m_settings(p_settings)
+  , m_link_cursor(m_link->receive_cursor())
+  , m_transmit_channels(p_allocator)
+  , m_frame(frame_header_size + p_settings.max_payload, 0, p_allocator)
+{
+  m_transmit_channels.reserve(m_channels.size());
+}
+
+void serial_mux::service()
+{
+  std::lock_guard lock(m_receive_mutex);
+
+  auto const buffer = m_link->receive_buffer();
+  auto const cursor = m_link->receive_cursor();
+  if (cursor == m_link_cursor) {
+    return;
+  }
+
+  // Parse in place, in at most two pieces when the link's data wrapped
+  if (cursor > m_link_cursor) {
+    demultiplex(buffer.subspan(m_link_cursor, cursor - m_link_cursor));
+  } else {
+    demultiplex(buffer.subspan(m_link_cursor));
+    demultiplex(buffer.first(cursor));
+  }
+  m_link_cursor = cursor;
+}
+
+serial_mux::statistics serial_mux::get_statistics() const
+{
+  return {
+    .header_errors = m_header_errors.load(std::memory_order_relaxed),
+    .discarded_bytes = m_discarded_bytes.load(std::memory_order_relaxed),
+    .unrouted_frames = m_unrouted_frames.load(std::memory_order_relaxed),
+  };
+}
+
+void serial_mux::attach(mux_channel& p_channel)
+{
+  {
+    std::lock_guard lock(m_receive_mutex);
+    if (m_channels[p_channel.m_id] != nullptr) {
+      throw hal::device_or_resource_busy(this);
+    }
+    m_channels[p_channel.m_id] = &p_channel;
+  }
+
+  std::lock_guard lock(m_transmit_mutex);
+  m_transmit_channels.push_back(&p_channel);
+}
+
+void serial_mux::detach(mux_channel& p_channel)
+{
+  {
+    std::lock_guard lock(m_receive_mutex);
+    m_channels[p_channel.m_id] = nullptr;
+    // The rest of a frame in progress is discarded
+    if (m_payload_channel == &p_channel) {
+      m_payload_channel = nullptr;
+    }
+  }
+
+  // A channel cannot be destroyed during its own write, so it is not waiting
+  std::lock_guard lock(m_transmit_mutex);
+  std::erase(m_transmit_channels, &p_channel);
+}
+
+void serial_mux::demultiplex(std::span<hal::byte const> p_data)
+{
+  while (not p_data.empty()) {
+    if (m_payload_remaining > 0) {
+      auto const count = std::min(m_payload_remaining, p_data.size());
+      if (m_payload_channel != nullptr) {
+        m_payload_channel->publish(p_data.first(count));
+      }
+      m_payload_remaining -= count;
+      p_data = p_data.subspan(count);
+      continue;
+    }
+
+    auto const scan =
+      read_frame_header(frame_sync, m_header, m_header_size, p_data);
+    m_header_errors.fetch_add(scan.rejected, std::memory_order_relaxed);
+    m_discarded_bytes.fetch_add(scan.discarded, std::memory_order_relaxed);
+    if (not scan.header) {
+      continue;
+    }
+
+    m_payload_remaining = scan.header->length;
+    m_payload_channel = m_channels[scan.header->type];
+    if (m_payload_channel != nullptr) {
+      m_payload_channel->m_frames_received.fetch_add(
+        1, std::memory_order_relaxed);
+    } else {
+      m_unrouted_frames.fetch_add(1, std::memory_order_relaxed);
+      m_discarded_bytes.fetch_add(m_payload_remaining,
+                                  std::memory_order_relaxed);
+    }
+  }
+}
+
+void serial_mux::transmit(mux_channel& p_channel,
+                          std::span<hal::byte const> p_data)
+{
+  std::unique_lock lock(m_transmit_mutex);
+  p_channel.m_pending = p_data;
+
+  while (not p_channel.m_pending.empty()) {
+    if (not m_transmitting) {
+      m_transmitting = true;
+      run_transmitter(lock, p_channel);
+      m_transmitting = false;
+      // Hand the link to a waiting channel
+      m_transmit_done.notify_all();
+      break;
+    }
+    m_transmit_done.wait(lock);
+  }
+
+  if (p_channel.m_transmit_error) {
+    std::rethrow_exception(std::exchange(p_channel.m_transmit_error, nullptr));
+  }
+}
+
+void serial_mux::run_transmitter(std::unique_lock<std::mutex>& p_lock,
+                                 mux_channel& p_own)
+{
+  while (not p_own.m_pending.empty()) {
+    auto& channel = next_channel();
+    auto const size =
+      std::min(channel.m_pending.size(), m_settings.max_payload);
+    auto const payload = channel.m_pending.first(size);
+
+    write_frame_header(m_frame, frame_sync, channel.m_id, size);
+    // The channel's writer is blocked until its data was sent, so the data
+    // stays valid while the lock is released
+    std::ranges::copy(payload, m_frame.begin() + frame_header_size);
+
+    p_lock.unlock();
+    std::exception_ptr error = nullptr;
+    try {
+      m_link->write(std::span(m_frame).first(frame_header_size + size));
+    } catch (...) {
+      error = std::current_exception();
+    }
+    p_lock.lock();
+
+    if (error) {
+      // The rest of the write is abandoned, its writer gets the exception
+      channel.m_transmit_error = error;
+      channel.m_pending = {};
+    } else {
+      channel.m_pending = channel.m_pending.subspan(size);
+      channel.m_frames_sent.fetch_add(1, std::memory_order_relaxed);
+      channel.m_bytes_sent.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    if (channel.m_pending.empty() && &channel != &p_own) {
+      m_transmit_done.notify_all();
+    }
+  }
+}
+
+mux_channel& serial_mux::next_channel()
+{
+  // Smooth weighted round robin: every waiting channel earns its weight, the
+  // richest sends and pays back the total
+  hal::i32 total = 0;
+  mux_channel* chosen = nullptr;
+  for (auto* const channel : m_transmit_channels) {
+    if (channel->m_pending.empty()) {
+      continue;
+    }
+    channel->m_credit += channel->m_weight;
+    total += channel->m_weight;
+    if (chosen == nullptr || channel->m_credit > chosen->m_credit) {
+      chosen = channel;
+    }
+  }
+  chosen->m_credit -= total;
+  return *chosen;
+}
+
+hal::v5::strong_ptr<mux_channel> mux_channel::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial_mux> p_mux,
+  hal::u8 p_id)
+{
+  return create(p_allocator, p_mux, p_id, options{});
+}
+
+hal::v5::strong_ptr<mux_channel> mux_channel::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial_mux> p_mux,
+  hal::u8 p_id,
+  options const& p_options)
+{
+  if (p_options.receive_buffer_size == 0 || p_options.weight == 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<mux_channel>(
+    p_allocator, p_allocator, p_mux, p_id, p_options);
+}
+
+mux_channel::mux_channel(hal::v5::strong_ptr_only_token,
+                         std::pmr::polymorphic_allocator<> p_allocator,
+                         hal::v5::strong_ptr<serial_mux> p_mux,
+                         hal::u8 p_id,
+                         options const& p_options)
+  : m_mux(p_mux)
+  , m_id(p_id)
+  , m_weight(p_options.weight)
+  , m_receive_buffer(p_options.receive_buffer_size, 0, p_allocator)
+{
+  m_mux->attach(*this);
+}
+
+mux_channel::~mux_channel()
+{
+  m_mux->detach(*this);
+}
+
+mux_channel::statistics mux_channel::get_statistics() const
+{
+  return {
+    .frames_sent = m_frames_sent.load(std::memory_order_relaxed),
+    .bytes_sent = m_bytes_sent.load(std::memory_order_relaxed),
+    .frames_received = m_frames_received.load(std::memory_order_relaxed),
+    .bytes_received = m_bytes_received.load(std::memory_order_relaxed),
+  };
+}
+
+void mux_channel::driver_configure(hal::v5::serial::settings const&)
+{
+  // The link's settings apply to every channel
+}
+
+void mux_channel::driver_write(std::span<hal::byte const> p_data)
+{
+  if (p_data.empty()) {
+    return;
+  }
+  m_mux->transmit(*this, p_data);
+}
+
+std::span<hal::byte const> mux_channel::driver_receive_buffer()
+{
+  return m_receive_buffer;
+}
+
+usize mux_channel::driver_cursor()
+{
+  m_mux->service();
+  return m_receive_cursor.load(std::memory_order_acquire);
+}
+
+void mux_channel::publish(std::span<hal::byte const> p_data)
+{
+  m_bytes_received.fetch_add(p_data.size(), std::memory_order_relaxed);
+  publish_to_ring(m_receive_buffer, m_receive_cursor, p_data);
+}
+}  // namespace hal::mac::inline v1
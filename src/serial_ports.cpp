@@ -0,0 +1,502 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/serial_ports.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#elif defined(__APPLE__)
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/IOKitLib.h>
+#include <IOKit/serial/IOSerialKeys.h>
+#include <mach/mach.h>
+#endif
+
+#include <libhal/error.hpp>
+
+namespace hal::mac::inline v1 {
+
+namespace {
+/// Longest single wait, bounds how long a stop request can go unnoticed
+constexpr auto watch_wait_slice = std::chrono::milliseconds(100);
+/// Rescan period on platforms without device notifications
+constexpr auto watch_fallback_period = std::chrono::seconds(1);
+/// Upper bound on threads used by open_serial_ports()
+constexpr usize max_open_threads = 16;
+
+bool path_less(serial_port_info const& p_lhs, serial_port_info const& p_rhs)
+{
+  return p_lhs.path < p_rhs.path;
+}
+
+#if defined(__linux__)
+/**
+ * @brief Read a single line sysfs attribute, empty if it does not exist
+ */
+std::pmr::string read_attribute(std::filesystem::path const& p_path,
+                                std::pmr::polymorphic_allocator<> p_allocator)
+{
+  std::pmr::string result(p_allocator);
+  std::FILE* file = std::fopen(p_path.c_str(), "r");
+  if (file == nullptr) {
+    return result;
+  }
+
+  std::array<char, 256> line{};
+  if (std::fgets(line.data(), line.size(), file) != nullptr) {
+    result = line.data();
+    while (not result.empty() &&
+           (result.back() == '\n' || result.back() == '\r')) {
+      result.pop_back();
+    }
+  }
+  std::fclose(file);
+  return result;
+}
+
+hal::u16 read_hex_attribute(std::filesystem::path const& p_path)
+{
+  std::array<char, 16> buffer{};
+  std::pmr::string text = read_attribute(p_path, {});
+  auto const length = std::min(text.size(), buffer.size() - 1);
+  std::copy_n(text.begin(), length, buffer.begin());
+  return static_cast<hal::u16>(std::strtoul(buffer.data(), nullptr, 16));
+}
+
+/**
+ * @brief Fill in USB metadata by walking up from the tty's device to the USB
+ * device that owns it
+ */
+void read_usb_metadata(std::filesystem::path p_device,
+                       serial_port_info& p_info,
+                       std::pmr::polymorphic_allocator<> p_allocator)
+{
+  std::error_code error;
+  p_device = std::filesystem::canonical(p_device, error);
+  if (error) {
+    return;
+  }
+
+  // USB serial adapters sit one (CDC ACM) or two (usb-serial) levels below
+  // the USB device that carries the descriptors.
+  for (int depth = 0; depth < 4 && p_device.has_parent_path(); depth++) {
+    if (std::filesystem::exists(p_device / "idVendor", error)) {
+      p_info.vendor_id = read_hex_attribute(p_device / "idVendor");
+      p_info.product_id = read_hex_attribute(p_device / "idProduct");
+      p_info.serial_number = read_attribute(p_device / "serial", p_allocator);
+      p_info.manufacturer =
+        read_attribute(p_device / "manufacturer", p_allocator);
+      p_info.product = read_attribute(p_device / "product", p_allocator);
+      return;
+    }
+    p_device = p_device.parent_path();
+  }
+}
+
+void enumerate_platform_ports(std::pmr::vector<serial_port_info>& p_ports,
+                              std::pmr::polymorphic_allocator<> p_allocator)
+{
+  std::error_code error;
+  std::filesystem::directory_iterator entries("/sys/class/tty", error);
+  if (error) {
+    return;
+  }
+
+  for (auto const& entry : entries) {
+    auto const device = entry.path() / "device";
+    // Virtual terminals and pseudo terminals have no device behind them
+    if (not std::filesystem::exists(device, error)) {
+      continue;
+    }
+
+    // The 8250 driver registers placeholder ttyS ports whether or not a UART
+    // exists. They are bound to the platform bus, real ones are not.
+    auto const subsystem =
+      std::filesystem::read_symlink(device / "subsystem", error).filename();
+    if (not error && subsystem == "platform") {
+      continue;
+    }
+
+    serial_port_info info{
+      .path = std::pmr::string("/dev/", p_allocator),
+      .serial_number = std::pmr::string(p_allocator),
+      .manufacturer = std::pmr::string(p_allocator),
+      .product = std::pmr::string(p_allocator),
+    };
+    info.path += entry.path().filename().string();
+    read_usb_metadata(device, info, p_allocator);
+    p_ports.push_back(std::move(info));
+  }
+}
+#elif defined(__APPLE__)
+/**
+ * @brief Read a string property from a service or one of its parents
+ */
+std::pmr::string string_property(io_object_t p_service,
+                                 CFStringRef p_key,
+                                 std::pmr::polymorphic_allocator<> p_allocator)
+{
+  std::pmr::string result(p_allocator);
+  CFTypeRef value = ::IORegistryEntrySearchCFProperty(
+    p_service,
+    kIOServicePlane,
+    p_key,
+    kCFAllocatorDefault,
+    kIORegistryIterateRecursively | kIORegistryIterateParents);
+
+  if (value == nullptr) {
+    return result;
+  }
+
+  if (::CFGetTypeID(value) == ::CFStringGetTypeID()) {
+    std::array<char, 256> buffer{};
+    if (::CFStringGetCString(static_cast<CFStringRef>(value),
+                             buffer.data(),
+                             buffer.size(),
+                             kCFStringEncodingUTF8)) {
+      result = buffer.data();
+    }
+  }
+
+  ::CFRelease(value);
+  return result;
+}
+
+/**
+ * @brief Read a numeric property from a service or one of its parents
+ */
+hal::u16 number_property(io_object_t p_service, CFStringRef p_key)
+{
+  CFTypeRef value = ::IORegistryEntrySearchCFProperty(
+    p_service,
+    kIOServicePlane,
+    p_key,
+    kCFAllocatorDefault,
+    kIORegistryIterateRecursively | kIORegistryIterateParents);
+
+  if (value == nullptr) {
+    return 0;
+  }
+
+  SInt32 number = 0;
+  if (::CFGetTypeID(value) == ::CFNumberGetTypeID()) {
+    ::CFNumberGetValue(
+      static_cast<CFNumberRef>(value), kCFNumberSInt32Type, &number);
+  }
+
+  ::CFRelease(value);
+  return static_cast<hal::u16>(number);
+}
+
+CFMutableDictionaryRef serial_service_matching()
+{
+  CFMutableDictionaryRef matching =
+    ::IOServiceMatching(kIOSerialBSDServiceValue);
+  if (matching != nullptr) {
+    ::CFDictionarySetValue(
+      matching, CFSTR(kIOSerialBSDTypeKey), CFSTR(kIOSerialBSDAllTypes));
+  }
+  return matching;
+}
+
+void enumerate_platform_ports(std::pmr::vector<serial_port_info>& p_ports,
+                              std::pmr::polymorphic_allocator<> p_allocator)
+{
+  io_iterator_t iterator = IO_OBJECT_NULL;
+  // IOServiceGetMatchingServices consumes the matching dictionary
+  if (::IOServiceGetMatchingServices(
+        MACH_PORT_NULL, serial_service_matching(), &iterator) != KERN_SUCCESS) {
+    return;
+  }
+
+  while (io_object_t service = ::IOIteratorNext(iterator)) {
+    serial_port_info info{
+      .path =
+        string_property(service, CFSTR(kIOCalloutDeviceKey), p_allocator),
+      .vendor_id = number_property(service, CFSTR("idVendor")),
+      .product_id = number_property(service, CFSTR("idProduct")),
+      .serial_number =
+        string_property(service, CFSTR("USB Serial Number"), p_allocator),
+      .manufacturer =
+        string_property(service, CFSTR("USB Vendor Name"), p_allocator),
+      .product =
+        string_property(service, CFSTR("USB Product Name"), p_allocator),
+    };
+    ::IOObjectRelease(service);
+
+    if (not info.path.empty()) {
+      p_ports.push_back(std::move(info));
+    }
+  }
+
+  ::IOObjectRelease(iterator);
+}
+
+/**
+ * @brief IOKit notification callback, arms the iterator and flags a rescan
+ */
+void on_service_notification(void* p_rescan_needed, io_iterator_t p_iterator)
+{
+  // The notification is only re-armed once the iterator has been drained
+  while (io_object_t service = ::IOIteratorNext(p_iterator)) {
+    ::IOObjectRelease(service);
+  }
+  *static_cast<bool*>(p_rescan_needed) = true;
+}
+#else
+void enumerate_platform_ports(std::pmr::vector<serial_port_info>& p_ports,
+                              std::pmr::polymorphic_allocator<> p_allocator)
+{
+  std::error_code error;
+  std::filesystem::directory_iterator entries("/dev", error);
+  if (error) {
+    return;
+  }
+
+  for (auto const& entry : entries) {
+    auto const name = entry.path().filename().string();
+    if (name.starts_with("cu.")) {
+      serial_port_info info{
+        .path = std::pmr::string(entry.path().string(), p_allocator),
+        .serial_number = std::pmr::string(p_allocator),
+        .manufacturer = std::pmr::string(p_allocator),
+        .product = std::pmr::string(p_allocator),
+      };
+      p_ports.push_back(std::move(info));
+    }
+  }
+}
+#endif
+}  // namespace
+
+std::pmr::vector<serial_port_info> enumerate_serial_ports(
+  std::pmr::polymorphic_allocator<> p_allocator)
+{
+  std::pmr::vector<serial_port_info> ports(p_allocator);
+  enumerate_platform_ports(ports, p_allocator);
+  std::ranges::sort(ports, path_less);
+  return ports;
+}
+
+std::pmr::vector<hal::v5::optional_ptr<serial>> open_serial_ports(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  std::span<serial_port_info const> p_ports,
+  usize p_buffer_size,
+  hal::v5::serial::settings const& p_settings)
+{
+  std::pmr::vector<hal::v5::optional_ptr<serial>> result(p_ports.size(),
+                                                          p_allocator);
+  std::atomic<usize> next_port{ 0 };
+
+  auto const worker = [&]() {
+    for (auto i = next_port.fetch_add(1); i < p_ports.size();
+         i = next_port.fetch_add(1)) {
+      try {
+        result[i] = serial::create(
+          p_allocator, p_ports[i].path, p_buffer_size, p_settings);
+      } catch (...) {
+        // Leave the entry empty, the caller decides what a failure means
+      }
+    }
+  };
+
+  auto const thread_count =
+    std::min({ p_ports.size(),
+               max_open_threads,
+               std::max<usize>(std::thread::hardware_concurrency(), 4) });
+
+  std::pmr::vector<std::thread> threads(p_allocator);
+  threads.reserve(thread_count);
+  for (usize i = 0; i < thread_count; i++) {
+    threads.emplace_back(worker);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  return result;
+}
+
+hal::v5::strong_ptr<serial_port_watcher> serial_port_watcher::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::callback<handler> p_handler)
+{
+  return hal::v5::make_strong_ptr<serial_port_watcher>(
+    p_allocator, p_allocator, std::move(p_handler));
+}
+
+serial_port_watcher::serial_port_watcher(
+  hal::v5::strong_ptr_only_token,
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::callback<handler> p_handler)
+  : m_allocator(p_allocator)
+  , m_handler(std::move(p_handler))
+  , m_known_ports(p_allocator)
+  , m_watch_thread(&serial_port_watcher::watch_thread_function, this)
+{
+}
+
+serial_port_watcher::~serial_port_watcher()
+{
+  m_stop_thread.store(true, std::memory_order_release);
+  if (m_watch_thread.joinable()) {
+    m_watch_thread.join();
+  }
+}
+
+void serial_port_watcher::rescan()
+{
+  auto current = enumerate_serial_ports(m_allocator);
+
+  // Both lists are sorted by path, so a single merge pass finds the changes
+  auto known = m_known_ports.begin();
+  auto found = current.begin();
+  while (known != m_known_ports.end() || found != current.end()) {
+    if (found == current.end() ||
+        (known != m_known_ports.end() && path_less(*known, *found))) {
+      m_handler(event::removed, *known++);
+    } else if (known == m_known_ports.end() || path_less(*found, *known)) {
+      m_handler(event::added, *found++);
+    } else {
+      ++known;
+      ++found;
+    }
+  }
+
+  m_known_ports = std::move(current);
+}
+
+void serial_port_watcher::watch_thread_function()
+{
+  rescan();
+
+#if defined(__linux__)
+  int const inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify != -1 &&
+      ::inotify_add_watch(inotify, "/dev", IN_CREATE | IN_DELETE) != -1) {
+    while (!m_stop_thread.load(std::memory_order_acquire)) {
+      pollfd descriptor{ .fd = inotify, .events = POLLIN, .revents = 0 };
+      if (::poll(&descriptor, 1, static_cast<int>(watch_wait_slice.count())) <=
+          0) {
+        continue;
+      }
+
+      // Drain the queued events, every tty node change leads to a rescan
+      std::array<char, 4096> events;
+      while (::read(inotify, events.data(), events.size()) > 0) {
+      }
+      rescan();
+    }
+    ::close(inotify);
+    return;
+  }
+
+  if (inotify != -1) {
+    ::close(inotify);
+  }
+#elif defined(__APPLE__)
+  bool rescan_needed = false;
+  IONotificationPortRef notification_port =
+    ::IONotificationPortCreate(MACH_PORT_NULL);
+  io_iterator_t added = IO_OBJECT_NULL;
+  io_iterator_t removed = IO_OBJECT_NULL;
+
+  // Each call consumes one reference to the matching dictionary
+  bool const armed =
+    notification_port != nullptr &&
+    ::IOServiceAddMatchingNotification(notification_port,
+                                       kIOFirstMatchNotification,
+                                       serial_service_matching(),
+                                       on_service_notification,
+                                       &rescan_needed,
+                                       &added) == KERN_SUCCESS &&
+    ::IOServiceAddMatchingNotification(notification_port,
+                                       kIOTerminatedNotification,
+                                       serial_service_matching(),
+                                       on_service_notification,
+                                       &rescan_needed,
+                                       &removed) == KERN_SUCCESS;
+
+  if (armed) {
+    // Drain the iterators once to arm the notifications
+    on_service_notification(&rescan_needed, added);
+    on_service_notification(&rescan_needed, removed);
+
+    mach_port_t const port = ::IONotificationPortGetMachPort(notification_port);
+    struct
+    {
+      mach_msg_header_t header;
+      std::array<hal::byte, 4096> body;
+    } message{};
+
+    while (!m_stop_thread.load(std::memory_order_acquire)) {
+      rescan_needed = false;
+      auto const result =
+        ::mach_msg(&message.header,
+                   MACH_RCV_MSG | MACH_RCV_TIMEOUT,
+                   0,
+                   sizeof(message),
+                   port,
+                   static_cast<mach_msg_timeout_t>(watch_wait_slice.count()),
+                   MACH_PORT_NULL);
+      if (result != MACH_MSG_SUCCESS) {
+        continue;
+      }
+
+      ::IODispatchCalloutFromMessage(
+        nullptr, &message.header, notification_port);
+      if (rescan_needed) {
+        rescan();
+      }
+    }
+  }
+
+  if (added != IO_OBJECT_NULL) {
+    ::IOObjectRelease(added);
+  }
+  if (removed != IO_OBJECT_NULL) {
+    ::IOObjectRelease(removed);
+  }
+  if (notification_port != nullptr) {
+    ::IONotificationPortDestroy(notification_port);
+  }
+
+  if (armed) {
+    return;
+  }
+#endif
+
+  // No device notifications available, fall back to periodic rescans
+  auto waited = std::chrono::milliseconds(0);
+  while (!m_stop_thread.load(std::memory_order_acquire)) {
+    std::this_thread::sleep_for(watch_wait_slice);
+    waited += watch_wait_slice;
+    if (waited >= watch_fallback_period) {
+      waited = std::chrono::milliseconds(0);
+      rescan();
+    }
+  }
+}
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,1117 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/serial_server.hpp>
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+#include "receive_ring.hpp"
+
+namespace hal::mac::inline v1 {
+
+namespace {
+// Telnet commands, RFC 854
+constexpr hal::byte telnet_se = 240;
+constexpr hal::byte telnet_sb = 250;
+constexpr hal::byte telnet_will = 251;
+constexpr hal::byte telnet_wont = 252;
+constexpr hal::byte telnet_do = 253;
+constexpr hal::byte telnet_dont = 254;
+constexpr hal::byte telnet_iac = 255;
+
+// Telnet options
+constexpr hal::byte option_binary = 0;
+constexpr hal::byte option_suppress_go_ahead = 3;
+constexpr hal::byte option_com_port = 44;
+
+// RFC 2217 commands, the server answers with the code plus 100
+constexpr hal::byte set_baudrate = 1;
+constexpr hal::byte set_datasize = 2;
+constexpr hal::byte set_parity = 3;
+constexpr hal::byte set_stopsize = 4;
+constexpr hal::byte set_control = 5;
+constexpr hal::byte set_linestate_mask = 10;
+constexpr hal::byte set_modemstate_mask = 11;
+constexpr hal::byte purge_data = 12;
+constexpr hal::byte server_reply_offset = 100;
+
+// SET-CONTROL values
+constexpr hal::byte control_flow_request = 0;
+constexpr hal::byte control_flow_none = 1;
+constexpr hal::byte control_flow_software = 2;
+constexpr hal::byte control_flow_hardware = 3;
+constexpr hal::byte control_break_off = 6;
+constexpr hal::byte control_dtr_request = 7;
+constexpr hal::byte control_dtr_on = 8;
+constexpr hal::byte control_dtr_off = 9;
+constexpr hal::byte control_rts_request = 10;
+constexpr hal::byte control_rts_on = 11;
+constexpr hal::byte control_rts_off = 12;
+
+constexpr usize socket_read_size = 4096;
+
+// The settings member named parity hides the enum of the same name
+using parity_type = decltype(hal::v5::serial::settings::parity);
+using stop_bits = hal::v5::serial::settings::stop_bits;
+
+#if defined(__linux__)
+constexpr int send_flags = MSG_NOSIGNAL;
+#else
+// SO_NOSIGPIPE is set on the socket instead
+constexpr int send_flags = 0;
+#endif
+
+enum parser_state : hal::u8
+{
+  parser_data = 0,
+  parser_command,
+  parser_negotiation,
+  parser_subnegotiation,
+  parser_subnegotiation_command,
+};
+
+/**
+ * @brief Split a Telnet stream into data, negotiations and subnegotiations
+ *
+ * Runs of data are passed on in place, only escaped 0xFF bytes are passed
+ * on one at a time. The parser state is kept in p_session, so a command may
+ * span several calls.
+ */
+template<typename Data, typename Negotiation, typename Subnegotiation>
+void parse_telnet(detail::telnet_session& p_session,
+                  std::span<hal::byte const> p_input,
+                  Data&& p_on_data,
+                  Negotiation&& p_on_negotiation,
+                  Subnegotiation&& p_on_subnegotiation)
+{
+  static constexpr std::array<hal::byte, 1> escaped_iac{ telnet_iac };
+
+  while (not p_input.empty()) {
+    if (p_session.state == parser_data) {
+      auto const iac = std::ranges::find(p_input, telnet_iac);
+      auto const run = static_cast<usize>(iac - p_input.begin());
+      if (run > 0) {
+        p_on_data(p_input.first(run));
+      }
+      if (iac == p_input.end()) {
+        return;
+      }
+      p_input = p_input.subspan(run + 1);
+      p_session.state = parser_command;
+      continue;
+    }
+
+    auto const byte = p_input[0];
+    p_input = p_input.subspan(1);
+
+    switch (p_session.state) {
+      case parser_command:
+        p_session.state = parser_data;
+        if (byte == telnet_iac) {
+          p_on_data(std::span(escaped_iac));
+        } else if (byte >= telnet_will && byte <= telnet_dont) {
+          p_session.verb = byte;
+          p_session.state = parser_negotiation;
+        } else if (byte == telnet_sb) {
+          p_session.subnegotiation_size = 0;
+          p_session.state = parser_subnegotiation;
+        }
+        // Other commands, such as NOP and GA, carry nothing to act on
+        break;
+      case parser_negotiation:
+        p_session.state = parser_data;
+        p_on_negotiation(p_session.verb, byte);
+        break;
+      case parser_subnegotiation:
+        if (byte == telnet_iac) {
+          p_session.state = parser_subnegotiation_command;
+        } else if (p_session.subnegotiation_size <
+                   p_session.subnegotiation.size()) {
+          p_session.subnegotiation[p_session.subnegotiation_size++] = byte;
+        }
+        break;
+      case parser_subnegotiation_command:
+        if (byte == telnet_iac) {
+          if (p_session.subnegotiation_size <
+              p_session.subnegotiation.size()) {
+            p_session.subnegotiation[p_session.subnegotiation_size++] = byte;
+          }
+          p_session.state = parser_subnegotiation;
+        } else {
+          // IAC SE ends the subnegotiation, anything else aborts it
+          p_session.state = parser_data;
+          if (byte == telnet_se) {
+            p_on_subnegotiation(std::span(p_session.subnegotiation)
+                                  .first(p_session.subnegotiation_size));
+          }
+        }
+        break;
+      default:
+        p_session.state = parser_data;
+        break;
+    }
+  }
+}
+
+/**
+ * @brief Append data with every 0xFF doubled, as Telnet requires
+ */
+void append_escaped(std::pmr::vector<hal::byte>& p_output,
+                    std::span<hal::byte const> p_data)
+{
+  while (not p_data.empty()) {
+    auto const iac = std::ranges::find(p_data, telnet_iac);
+    p_output.insert(p_output.end(), p_data.begin(), iac);
+    if (iac == p_data.end()) {
+      return;
+    }
+    p_output.push_back(telnet_iac);
+    p_output.push_back(telnet_iac);
+    p_data = p_data.subspan(static_cast<usize>(iac - p_data.begin()) + 1);
+  }
+}
+
+/**
+ * @brief Request an option and record it as agreed
+ *
+ * Recording it right away means the peer's confirmation needs no answer.
+ */
+void request_option(detail::telnet_session& p_session,
+                    std::pmr::vector<hal::byte>& p_output,
+                    hal::byte p_verb,
+                    hal::byte p_option)
+{
+  if (p_verb == telnet_will) {
+    p_session.local_enabled[p_option] = true;
+  } else if (p_verb == telnet_do) {
+    p_session.remote_enabled[p_option] = true;
+  }
+  p_output.insert(p_output.end(), { telnet_iac, p_verb, p_option });
+}
+
+/**
+ * @brief Answer a negotiation, agreeing to the options both ends use
+ *
+ * Only changes of state are answered, which keeps the two ends from
+ * answering each other forever.
+ */
+void answer_negotiation(detail::telnet_session& p_session,
+                        std::pmr::vector<hal::byte>& p_output,
+                        hal::byte p_verb,
+                        hal::byte p_option)
+{
+  bool const supported = p_option == option_binary ||
+                         p_option == option_suppress_go_ahead ||
+                         p_option == option_com_port;
+  auto& local = p_session.local_enabled[p_option];
+  auto& remote = p_session.remote_enabled[p_option];
+
+  switch (p_verb) {
+    case telnet_do:
+      if (not supported) {
+        p_output.insert(p_output.end(), { telnet_iac, telnet_wont, p_option });
+      } else if (not local) {
+        request_option(p_session, p_output, telnet_will, p_option);
+      }
+      break;
+    case telnet_dont:
+      if (local) {
+        local = false;
+        p_output.insert(p_output.end(), { telnet_iac, telnet_wont, p_option });
+      }
+      break;
+    case telnet_will:
+      if (not supported) {
+        p_output.insert(p_output.end(), { telnet_iac, telnet_dont, p_option });
+      } else if (not remote) {
+        request_option(p_session, p_output, telnet_do, p_option);
+      }
+      break;
+    case telnet_wont:
+      if (remote) {
+        remote = false;
+        p_output.insert(p_output.end(), { telnet_iac, telnet_dont, p_option });
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Append an RFC 2217 command or reply with a big endian value
+ */
+void append_com_port_command(std::pmr::vector<hal::byte>& p_output,
+                             hal::byte p_code,
+                             std::span<hal::byte const> p_value)
+{
+  p_output.insert(p_output.end(),
+                  { telnet_iac, telnet_sb, option_com_port, p_code });
+  append_escaped(p_output, p_value);
+  p_output.insert(p_output.end(), { telnet_iac, telnet_se });
+}
+
+std::array<hal::byte, 4> to_big_endian(hal::u32 p_value)
+{
+  return { static_cast<hal::byte>(p_value >> 24),
+           static_cast<hal::byte>(p_value >> 16),
+           static_cast<hal::byte>(p_value >> 8),
+           static_cast<hal::byte>(p_value) };
+}
+
+hal::u32 from_big_endian(std::span<hal::byte const> p_value)
+{
+  hal::u32 result = 0;
+  for (auto const byte : p_value.first(std::min<usize>(p_value.size(), 4))) {
+    result = (result << 8) | byte;
+  }
+  return result;
+}
+
+hal::byte to_rfc2217(parity_type p_parity)
+{
+  // NONE, ODD, EVEN, MARK and SPACE are 1 to 5, in the order of hal's parity
+  return static_cast<hal::byte>(static_cast<hal::u8>(p_parity) + 1);
+}
+
+hal::byte to_rfc2217(stop_bits p_stop)
+{
+  return p_stop == stop_bits::one ? 1 : 2;
+}
+
+hal::byte to_rfc2217(flow_control p_flow_control)
+{
+  switch (p_flow_control) {
+    case flow_control::software:
+      return control_flow_software;
+    case flow_control::hardware:
+      return control_flow_hardware;
+    default:
+      return control_flow_none;
+  }
+}
+
+void apply_socket_options(int p_fd, bool p_no_delay, usize p_buffer_size)
+{
+  int const no_delay = p_no_delay ? 1 : 0;
+  ::setsockopt(p_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+  if (p_buffer_size > 0) {
+    int const size = static_cast<int>(p_buffer_size);
+    ::setsockopt(p_fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    ::setsockopt(p_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  }
+
+#if defined(__APPLE__)
+  int const no_sigpipe = 1;
+  ::setsockopt(p_fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+}
+}  // namespace
+
+hal::v5::strong_ptr<serial_server> serial_server::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_serial)
+{
+  return create(p_allocator, p_serial, settings{});
+}
+
+hal::v5::strong_ptr<serial_server> serial_server::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_serial,
+  settings const& p_settings)
+{
+  in_addr address{};
+  std::string const bind_address(p_settings.bind_address);
+  if (p_settings.batch_size == 0 ||
+      ::inet_pton(AF_INET, bind_address.c_str(), &address) != 1) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<serial_server>(
+    p_allocator, p_allocator, p_serial, p_settings);
+}
+
+serial_server::serial_server(hal::v5::strong_ptr_only_token,
+                             std::pmr::polymorphic_allocator<> p_allocator,
+                             hal::v5::strong_ptr<serial> p_serial,
+                             settings const& p_settings)
+  : m_serial(p_serial)
+  , m_settings(p_settings)
+  , m_send_buffer(p_allocator)
+  , m_receive_chunk(socket_read_size, 0, p_allocator)
+  , m_port_data(p_allocator)
+{
+  // The address is only used here, the view may not outlive create()
+  std::string const bind_address(m_settings.bind_address);
+  m_settings.bind_address = {};
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(m_settings.port);
+  ::inet_pton(AF_INET, bind_address.c_str(), &address.sin_addr);
+
+  m_listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (m_listen_fd == -1) {
+    throw hal::operation_not_permitted(this);
+  }
+
+  int const reuse = 1;
+  ::setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  auto const* generic_address = reinterpret_cast<sockaddr const*>(&address);
+  if (::bind(m_listen_fd, generic_address, sizeof(address)) != 0 ||
+      ::listen(m_listen_fd, 1) != 0) {
+    auto const error = errno;
+    ::close(m_listen_fd);
+    if (error == EADDRINUSE) {
+      throw hal::device_or_resource_busy(this);
+    }
+    throw hal::operation_not_permitted(this);
+  }
+
+  socklen_t length = sizeof(address);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  ::getsockname(m_listen_fd, reinterpret_cast<sockaddr*>(&address), &length);
+  m_port = ntohs(address.sin_port);
+
+  // Escaping at most doubles a batch, replies to commands come on top
+  m_send_buffer.reserve(2 * m_settings.batch_size + 256);
+  m_port_data.reserve(socket_read_size);
+
+  {
+    std::lock_guard lock(m_port_mutex);
+    m_port_cursor = m_serial->receive_cursor();
+    m_port_received = m_serial->get_statistics().bytes_received;
+  }
+  m_serial->attach_observer(*this);
+  m_thread = std::thread(&serial_server::server_thread_function, this);
+}
+
+serial_server::~serial_server()
+{
+  m_serial->detach_observer(*this);
+  m_stop_thread.store(true, std::memory_order_release);
+  m_wake.signal();
+  m_thread.join();
+  ::close(m_listen_fd);
+}
+
+hal::u16 serial_server::port() const
+{
+  return m_port;
+}
+
+bool serial_server::client_connected() const
+{
+  return m_client_connected.load(std::memory_order_acquire);
+}
+
+serial_server::statistics serial_server::get_statistics() const
+{
+  return {
+    .connections = m_connections.load(std::memory_order_relaxed),
+    .rejected_connections =
+      m_rejected_connections.load(std::memory_order_relaxed),
+    .bytes_to_network = m_bytes_to_network.load(std::memory_order_relaxed),
+    .bytes_to_port = m_bytes_to_port.load(std::memory_order_relaxed),
+    .dropped_bytes = m_dropped_bytes.load(std::memory_order_relaxed),
+    .control_commands = m_control_commands.load(std::memory_order_relaxed),
+  };
+}
+
+void serial_server::on_receive(usize p_cursor)
+{
+  {
+    // The receive path is paused while observers run, so the counter
+    // matches the cursor
+    std::lock_guard lock(m_port_mutex);
+    m_port_cursor = p_cursor;
+    m_port_received = m_serial->get_statistics().bytes_received;
+  }
+  if (m_client_connected.load(std::memory_order_relaxed)) {
+    m_wake.signal();
+  }
+}
+
+void serial_server::server_thread_function()
+{
+  while (not m_stop_thread.load(std::memory_order_acquire)) {
+    m_wake.acknowledge();
+
+    hal::time_duration batch_wait{ 0 };
+    while (m_client_fd != -1) {
+      if (m_send_offset == m_send_buffer.size()) {
+        m_send_buffer.clear();
+        m_send_offset = 0;
+        batch_wait = fill_batch();
+      }
+      if (m_send_buffer.empty()) {
+        break;
+      }
+      if (not send_to_client()) {
+        disconnect_client();
+        break;
+      }
+      // Wait for the socket to accept the rest
+      if (m_send_offset < m_send_buffer.size()) {
+        break;
+      }
+    }
+
+    std::array<pollfd, 3> descriptors{
+      pollfd{ .fd = m_wake.native_handle(), .events = POLLIN, .revents = 0 },
+      pollfd{ .fd = m_listen_fd, .events = POLLIN, .revents = 0 },
+      pollfd{ .fd = m_client_fd, .events = POLLIN, .revents = 0 },
+    };
+    if (m_send_offset < m_send_buffer.size()) {
+      descriptors[2].events |= POLLOUT;
+    }
+    int timeout = -1;
+    if (batch_wait.count() > 0) {
+      auto const wait_ms =
+        std::chrono::ceil<std::chrono::milliseconds>(batch_wait);
+      timeout = static_cast<int>(wait_ms.count());
+    }
+
+    // A descriptor of -1 is ignored by poll()
+    if (::poll(descriptors.data(), descriptors.size(), timeout) <= 0) {
+      continue;
+    }
+
+    if (descriptors[1].revents & POLLIN) {
+      accept_client();
+    }
+    if (descriptors[2].revents & (POLLIN | POLLHUP | POLLERR)) {
+      if (not receive_from_client()) {
+        disconnect_client();
+      }
+    }
+  }
+
+  disconnect_client();
+}
+
+void serial_server::accept_client()
+{
+  int const fd = ::accept(m_listen_fd, nullptr, nullptr);
+  if (fd == -1) {
+    return;
+  }
+  if (m_client_fd != -1) {
+    ::close(fd);
+    m_rejected_connections.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  apply_socket_options(fd, m_settings.no_delay, m_settings.socket_buffer_size);
+  ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  m_client_fd = fd;
+  m_telnet = {};
+  m_send_buffer.clear();
+  m_send_offset = 0;
+  m_batch_pending = false;
+  {
+    // Data received before the client connected is not sent
+    std::lock_guard lock(m_port_mutex);
+    m_bytes_seen = m_port_received;
+  }
+  m_connections.fetch_add(1, std::memory_order_relaxed);
+  m_client_connected.store(true, std::memory_order_release);
+
+  if (m_settings.rfc2217) {
+    request_option(m_telnet, m_send_buffer, telnet_will, option_binary);
+    request_option(m_telnet, m_send_buffer, telnet_do, option_binary);
+    request_option(
+      m_telnet, m_send_buffer, telnet_will, option_suppress_go_ahead);
+    request_option(m_telnet, m_send_buffer, telnet_do, option_com_port);
+  }
+}
+
+void serial_server::disconnect_client()
+{
+  if (m_client_fd == -1) {
+    return;
+  }
+  ::close(m_client_fd);
+  m_client_fd = -1;
+  m_send_buffer.clear();
+  m_send_offset = 0;
+  m_client_connected.store(false, std::memory_order_release);
+}
+
+bool serial_server::receive_from_client()
+{
+  auto const count =
+    ::recv(m_client_fd, m_receive_chunk.data(), m_receive_chunk.size(), 0);
+  if (count == 0) {
+    return false;
+  }
+  if (count < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  }
+
+  auto const chunk = std::span<hal::byte const>(m_receive_chunk)
+                       .first(static_cast<usize>(count));
+
+  auto const write_to_port = [this](std::span<hal::byte const> p_data) {
+    if (p_data.empty()) {
+      return;
+    }
+    try {
+      m_serial->write(p_data);
+      m_bytes_to_port.fetch_add(p_data.size(), std::memory_order_relaxed);
+    } catch (hal::exception const&) {
+      // The port reconnects on its own, data for it is lost meanwhile
+    }
+  };
+
+  if (not m_settings.rfc2217) {
+    write_to_port(chunk);
+    return true;
+  }
+
+  m_port_data.clear();
+  parse_telnet(
+    m_telnet,
+    chunk,
+    [this](std::span<hal::byte const> p_data) {
+      m_port_data.insert(m_port_data.end(), p_data.begin(), p_data.end());
+    },
+    [this](hal::byte p_verb, hal::byte p_option) {
+      negotiate(p_verb, p_option);
+    },
+    [this, &write_to_port](std::span<hal::byte const> p_subnegotiation) {
+      if (p_subnegotiation.size() < 2 ||
+          p_subnegotiation[0] != option_com_port) {
+        return;
+      }
+      // Data sent before a command, such as a baud rate change, goes out
+      // under the old settings
+      write_to_port(m_port_data);
+      m_port_data.clear();
+      handle_command(p_subnegotiation.subspan(1));
+    });
+  write_to_port(m_port_data);
+  return true;
+}
+
+hal::time_duration serial_server::fill_batch()
+{
+  usize cursor = 0;
+  hal::u64 received = 0;
+  {
+    std::lock_guard lock(m_port_mutex);
+    cursor = m_port_cursor;
+    received = m_port_received;
+  }
+
+  auto const buffer = m_serial->receive_buffer();
+  auto available = received - m_bytes_seen;
+  if (available == 0) {
+    m_batch_pending = false;
+    return hal::time_duration{ 0 };
+  }
+  if (available > buffer.size()) {
+    m_dropped_bytes.fetch_add(available - buffer.size(),
+                              std::memory_order_relaxed);
+    m_bytes_seen = received - buffer.size();
+    available = buffer.size();
+  }
+
+  if (m_settings.batch_delay.count() > 0 &&
+      available < m_settings.batch_size) {
+    auto const now = std::chrono::steady_clock::now();
+    if (not m_batch_pending) {
+      m_batch_pending = true;
+      m_batch_start = now;
+    }
+    auto const waited = now - m_batch_start;
+    if (waited < m_settings.batch_delay) {
+      return m_settings.batch_delay - waited;
+    }
+  }
+  m_batch_pending = false;
+
+  auto const count =
+    static_cast<usize>(std::min<hal::u64>(available, m_settings.batch_size));
+  auto const start =
+    (cursor + buffer.size() - static_cast<usize>(available)) % buffer.size();
+  auto const first = std::min(count, buffer.size() - start);
+  std::array const parts{ buffer.subspan(start, first),
+                          buffer.first(count - first) };
+  for (auto const part : parts) {
+    if (m_settings.rfc2217) {
+      append_escaped(m_send_buffer, part);
+    } else {
+      m_send_buffer.insert(m_send_buffer.end(), part.begin(), part.end());
+    }
+  }
+
+  // The port may have overwritten the data while it was copied
+  auto const now_received = m_serial->get_statistics().bytes_received;
+  if (now_received - m_bytes_seen > buffer.size()) {
+    m_send_buffer.clear();
+    m_dropped_bytes.fetch_add(count, std::memory_order_relaxed);
+  } else {
+    m_bytes_to_network.fetch_add(count, std::memory_order_relaxed);
+  }
+  m_bytes_seen += count;
+  return hal::time_duration{ 0 };
+}
+
+bool serial_server::send_to_client()
+{
+  auto const pending = std::span(m_send_buffer).subspan(m_send_offset);
+  auto const count =
+    ::send(m_client_fd, pending.data(), pending.size(), send_flags);
+  if (count < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  }
+  m_send_offset += static_cast<usize>(count);
+  return true;
+}
+
+void serial_server::negotiate(hal::byte p_verb, hal::byte p_option)
+{
+  answer_negotiation(m_telnet, m_send_buffer, p_verb, p_option);
+}
+
+void serial_server::handle_command(std::span<hal::byte const> p_command)
+{
+  m_control_commands.fetch_add(1, std::memory_order_relaxed);
+  auto const code = p_command[0];
+  auto const value = p_command.subspan(1);
+  auto const requested = value.empty() ? hal::byte{ 0 } : value[0];
+
+  // Requests the port rejects are answered with the setting it kept
+  auto const try_configure =
+    [this](hal::v5::serial::settings const& p_settings) {
+      try {
+        m_serial->configure(p_settings);
+      } catch (hal::exception const&) {
+      }
+    };
+
+  switch (code) {
+    case set_baudrate: {
+      auto current = m_serial->get_settings();
+      auto const baud_rate = from_big_endian(value);
+      if (baud_rate != 0 && baud_rate != current.baud_rate) {
+        current.baud_rate = baud_rate;
+        try_configure(current);
+      }
+      reply(code, to_big_endian(m_serial->get_settings().baud_rate));
+      break;
+    }
+    case set_datasize: {
+      // Ports always use 8 data bits
+      std::array<hal::byte, 1> const data_size{ 8 };
+      reply(code, data_size);
+      break;
+    }
+    case set_parity: {
+      auto current = m_serial->get_settings();
+      if (requested >= 1 && requested <= 5) {
+        current.parity = static_cast<parity_type>(requested - 1);
+        try_configure(current);
+      }
+      std::array const parity{ to_rfc2217(m_serial->get_settings().parity) };
+      reply(code, parity);
+      break;
+    }
+    case set_stopsize: {
+      auto current = m_serial->get_settings();
+      if (requested == 1 || requested == 2) {
+        current.stop = requested == 1 ? stop_bits::one : stop_bits::two;
+        try_configure(current);
+      }
+      std::array const stop{ to_rfc2217(m_serial->get_settings().stop) };
+      reply(code, stop);
+      break;
+    }
+    case set_control: {
+      std::array<hal::byte, 1> result{ requested };
+      try {
+        auto const signals = m_serial->get_control_signals();
+        switch (requested) {
+          case control_flow_request:
+            result[0] = to_rfc2217(m_serial->get_flow_control());
+            break;
+          case control_flow_none:
+          case control_flow_software:
+          case control_flow_hardware:
+            m_serial->set_flow_control(
+              requested == control_flow_none       ? flow_control::none
+              : requested == control_flow_software ? flow_control::software
+                                                   : flow_control::hardware);
+            result[0] = to_rfc2217(m_serial->get_flow_control());
+            break;
+          case control_dtr_request:
+            result[0] = signals.dtr ? control_dtr_on : control_dtr_off;
+            break;
+          case control_dtr_on:
+          case control_dtr_off:
+            m_serial->set_control_signals(requested == control_dtr_on,
+                                          signals.rts);
+            break;
+          case control_rts_request:
+            result[0] = signals.rts ? control_rts_on : control_rts_off;
+            break;
+          case control_rts_on:
+          case control_rts_off:
+            m_serial->set_control_signals(signals.dtr,
+                                          requested == control_rts_on);
+            break;
+          default:
+            // BREAK is not supported
+            result[0] = control_break_off;
+            break;
+        }
+      } catch (hal::exception const&) {
+        // Devices without modem lines, such as pseudo terminals, answer
+        // with the requested state
+      }
+      reply(code, result);
+      break;
+    }
+    case set_linestate_mask:
+    case set_modemstate_mask:
+    case purge_data:
+      reply(code, value.first(std::min<usize>(value.size(), 1)));
+      break;
+    default:
+      break;
+  }
+}
+
+void serial_server::reply(hal::byte p_command,
+                          std::span<hal::byte const> p_value)
+{
+  append_com_port_command(
+    m_send_buffer,
+    static_cast<hal::byte>(p_command + server_reply_offset),
+    p_value);
+}
+
+hal::v5::strong_ptr<network_serial> network_serial::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  std::string_view p_host,
+  hal::u16 p_port)
+{
+  return create(p_allocator, p_host, p_port, settings{});
+}
+
+hal::v5::strong_ptr<network_serial> network_serial::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  std::string_view p_host,
+  hal::u16 p_port,
+  settings const& p_settings)
+{
+  if (p_settings.receive_buffer_size == 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<network_serial>(
+    p_allocator, p_allocator, p_host, p_port, p_settings);
+}
+
+network_serial::network_serial(hal::v5::strong_ptr_only_token,
+                               std::pmr::polymorphic_allocator<> p_allocator,
+                               std::string_view p_host,
+                               hal::u16 p_port,
+                               settings const& p_settings)
+  : m_settings(p_settings)
+  // One byte more than asked for, so a full buffer of unread data does not
+  // move the cursor a full lap
+  , m_receive_buffer(p_settings.receive_buffer_size + 1, 0, p_allocator)
+  , m_send_buffer(p_allocator)
+  , m_pending_replies(p_allocator)
+{
+  std::string const host(p_host);
+  std::string const service = std::to_string(p_port);
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses = nullptr;
+  if (::getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0) {
+    throw hal::no_such_device(p_port, this);
+  }
+
+  for (auto* address = addresses; address != nullptr;
+       address = address->ai_next) {
+    m_fd = ::socket(
+      address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (m_fd == -1) {
+      continue;
+    }
+    if (::connect(m_fd, address->ai_addr, address->ai_addrlen) == 0) {
+      break;
+    }
+    ::close(m_fd);
+    m_fd = -1;
+  }
+  ::freeaddrinfo(addresses);
+
+  if (m_fd == -1) {
+    throw hal::no_such_device(p_port, this);
+  }
+  apply_socket_options(
+    m_fd, m_settings.no_delay, m_settings.socket_buffer_size);
+
+  if (m_settings.rfc2217) {
+    request_option(m_telnet, m_send_buffer, telnet_will, option_com_port);
+    request_option(m_telnet, m_send_buffer, telnet_will, option_binary);
+    request_option(m_telnet, m_send_buffer, telnet_do, option_binary);
+    request_option(
+      m_telnet, m_send_buffer, telnet_do, option_suppress_go_ahead);
+    try {
+      send_all(m_send_buffer);
+    } catch (...) {
+      ::close(m_fd);
+      throw;
+    }
+  }
+
+  m_thread = std::thread(&network_serial::receive_thread_function, this);
+}
+
+network_serial::~network_serial()
+{
+  // Wakes the receive thread's blocking recv()
+  ::shutdown(m_fd, SHUT_RDWR);
+  m_thread.join();
+  ::close(m_fd);
+}
+
+void network_serial::set_control_signals(bool p_dtr_state, bool p_rts_state)
+{
+  std::array const commands{
+    std::pair{ set_control,
+               hal::u32{ p_dtr_state ? control_dtr_on : control_dtr_off } },
+    std::pair{ set_control,
+               hal::u32{ p_rts_state ? control_rts_on : control_rts_off } },
+  };
+  static_cast<void>(run_commands(commands));
+}
+
+bool network_serial::connected() const
+{
+  return m_connected.load(std::memory_order_acquire);
+}
+
+network_serial::statistics network_serial::get_statistics() const
+{
+  return {
+    .bytes_sent = m_bytes_sent.load(std::memory_order_relaxed),
+    .bytes_received = m_bytes_received.load(std::memory_order_relaxed),
+    .send_calls = m_send_calls.load(std::memory_order_relaxed),
+  };
+}
+
+void network_serial::driver_configure(
+  hal::v5::serial::settings const& p_settings)
+{
+  std::array const commands{
+    std::pair{ set_baudrate, p_settings.baud_rate },
+    std::pair{ set_datasize, hal::u32{ 8 } },
+    std::pair{ set_parity, hal::u32{ to_rfc2217(p_settings.parity) } },
+    std::pair{ set_stopsize, hal::u32{ to_rfc2217(p_settings.stop) } },
+  };
+  auto const values = run_commands(commands);
+
+  for (auto const& [code, value] : commands) {
+    if (values[code] != value) {
+      throw hal::argument_out_of_domain(this);
+    }
+  }
+}
+
+void network_serial::driver_write(std::span<hal::byte const> p_data)
+{
+  if (not m_connected.load(std::memory_order_acquire)) {
+    throw hal::io_error(this);
+  }
+
+  std::lock_guard lock(m_send_mutex);
+  m_send_buffer.clear();
+  if (m_settings.rfc2217) {
+    append_escaped(m_send_buffer, p_data);
+    send_all(m_send_buffer);
+  } else {
+    send_all(p_data);
+  }
+  m_bytes_sent.fetch_add(p_data.size(), std::memory_order_relaxed);
+}
+
+std::span<hal::byte const> network_serial::driver_receive_buffer()
+{
+  return m_receive_buffer;
+}
+
+usize network_serial::driver_cursor()
+{
+  return m_receive_cursor.load(std::memory_order_acquire);
+}
+
+void network_serial::receive_thread_function()
+{
+  std::array<hal::byte, socket_read_size> chunk{};
+  auto const read_size =
+    std::min(chunk.size(), m_settings.receive_buffer_size);
+
+  while (true) {
+    auto const count = ::recv(m_fd, chunk.data(), read_size, 0);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+
+    auto const data = std::span(chunk).first(static_cast<usize>(count));
+    if (not m_settings.rfc2217) {
+      publish(data);
+      continue;
+    }
+
+    parse_telnet(
+      m_telnet,
+      data,
+      [this](std::span<hal::byte const> p_data) { publish(p_data); },
+      [this](hal::byte p_verb, hal::byte p_option) {
+        negotiate(p_verb, p_option);
+      },
+      [this](std::span<hal::byte const> p_reply) { handle_reply(p_reply); });
+
+    if (not m_pending_replies.empty()) {
+      try {
+        std::lock_guard lock(m_send_mutex);
+        send_all(m_pending_replies);
+      } catch (hal::exception const&) {
+        // The next recv() reports the lost connection
+      }
+      m_pending_replies.clear();
+    }
+  }
+
+  {
+    std::lock_guard lock(m_reply_mutex);
+    m_connected.store(false, std::memory_order_release);
+  }
+  m_reply_received.notify_all();
+}
+
+void network_serial::publish(std::span<hal::byte const> p_data)
+{
+  m_bytes_received.fetch_add(p_data.size(), std::memory_order_relaxed);
+  publish_to_ring(m_receive_buffer, m_receive_cursor, p_data);
+}
+
+void network_serial::negotiate(hal::byte p_verb, hal::byte p_option)
+{
+  answer_negotiation(m_telnet, m_pending_replies, p_verb, p_option);
+}
+
+void network_serial::handle_reply(std::span<hal::byte const> p_reply)
+{
+  if (p_reply.size() < 2 || p_reply[0] != option_com_port ||
+      p_reply[1] <= server_reply_offset) {
+    return;
+  }
+  auto const code = static_cast<usize>(p_reply[1] - server_reply_offset);
+  if (code >= m_reply_count.size()) {
+    return;
+  }
+
+  {
+    std::lock_guard lock(m_reply_mutex);
+    m_reply_value[code] = from_big_endian(p_reply.subspan(2));
+    m_reply_count[code]++;
+  }
+  m_reply_received.notify_all();
+}
+
+std::array<hal::u32, 16> network_serial::run_commands(
+  std::span<std::pair<hal::byte, hal::u32> const> p_commands)
+{
+  if (not m_settings.rfc2217) {
+    throw hal::operation_not_supported(this);
+  }
+
+  std::array<hal::u64, 16> target{};
+  {
+    std::lock_guard lock(m_reply_mutex);
+    target = m_reply_count;
+  }
+
+  {
+    std::lock_guard lock(m_send_mutex);
+    m_send_buffer.clear();
+    for (auto const& [code, value] : p_commands) {
+      auto const bytes = to_big_endian(value);
+      // The baud rate is 4 bytes, every other value is 1 byte
+      auto const size = code == set_baudrate ? bytes.size() : 1;
+      append_com_port_command(
+        m_send_buffer, code, std::span(bytes).last(size));
+      target[code]++;
+    }
+    send_all(m_send_buffer);
+  }
+
+  std::unique_lock lock(m_reply_mutex);
+  bool const answered =
+    m_reply_received.wait_for(lock, m_settings.reply_timeout, [&]() {
+      return not m_connected.load(std::memory_order_relaxed) ||
+             std::ranges::equal(
+               m_reply_count, target, std::ranges::greater_equal{});
+    });
+  if (not m_connected.load(std::memory_order_relaxed)) {
+    throw hal::io_error(this);
+  }
+  if (not answered) {
+    throw hal::timed_out(this);
+  }
+  return m_reply_value;
+}
+
+void network_serial::send_all(std::span<hal::byte const> p_data)
+{
+  while (not p_data.empty()) {
+    auto const count = ::send(m_fd, p_data.data(), p_data.size(), send_flags);
+    m_send_calls.fetch_add(1, std::memory_order_relaxed);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw hal::io_error(this);
+    }
+    p_data = p_data.subspan(static_cast<usize>(count));
+  }
+}
+}  // namespace hal::mac::inline v1
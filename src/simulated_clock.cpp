@@ -0,0 +1,223 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/simulated_clock.hpp>
+
+#include <algorithm>
+
+#include <libhal/error.hpp>
+
+namespace hal::mac::inline v1 {
+
+hal::v5::strong_ptr<simulated_clock> simulated_clock::create(
+  std::pmr::polymorphic_allocator<> p_allocator)
+{
+  return create(p_allocator, settings{});
+}
+
+hal::v5::strong_ptr<simulated_clock> simulated_clock::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  settings const& p_settings)
+{
+  return hal::v5::make_strong_ptr<simulated_clock>(
+    p_allocator, p_allocator, p_settings);
+}
+
+simulated_clock::simulated_clock(hal::v5::strong_ptr_only_token,
+                                 std::pmr::polymorphic_allocator<> p_allocator,
+                                 settings const& p_settings)
+  : m_settings(p_settings)
+  , m_timers(p_allocator)
+  , m_sleepers(p_allocator)
+  , m_attached(p_allocator)
+{
+}
+
+hal::time_duration simulated_clock::now()
+{
+  std::lock_guard lock(m_mutex);
+  return m_now;
+}
+
+void simulated_clock::advance(hal::time_duration p_amount)
+{
+  std::unique_lock lock(m_mutex);
+  auto const target = m_now + std::max(p_amount, hal::time_duration(0));
+  // The caller is running, so it does not count as a thread to wait for
+  usize const caller = caller_attached() ? 1 : 0;
+
+  while (true) {
+    m_changed.wait(lock, [this, caller] {
+      return not m_stepping && running_threads() <= caller;
+    });
+    auto const next = next_deadline();
+    if (not next || *next > target) {
+      break;
+    }
+    step(lock, std::max(*next, m_now));
+  }
+
+  m_now = std::max(m_now, target);
+}
+
+void simulated_clock::sleep_for(hal::time_duration p_duration)
+{
+  if (p_duration.count() <= 0) {
+    return;
+  }
+  sleep_until(now() + p_duration);
+}
+
+void simulated_clock::sleep_until(hal::time_duration p_deadline)
+{
+  std::unique_lock lock(m_mutex);
+  if (p_deadline <= m_now) {
+    return;
+  }
+
+  sleeper self{ .attached = caller_attached() };
+  m_sleepers.emplace(p_deadline, &self);
+  if (self.attached) {
+    m_sleeping_attached++;
+  }
+  // An advance() may be waiting for this thread to go idle
+  m_changed.notify_all();
+
+  while (not self.woken) {
+    if (m_settings.auto_advance && not m_stepping && running_threads() == 0) {
+      // Nothing else can run before the next deadline, so skip to it. This
+      // thread's own deadline is pending, so there always is one.
+      step(lock, std::max(*next_deadline(), m_now));
+      continue;
+    }
+    m_changed.wait(lock);
+  }
+}
+
+simulated_clock::timer_id simulated_clock::schedule(
+  hal::time_duration p_deadline,
+  hal::callback<void()> p_handler)
+{
+  std::lock_guard lock(m_mutex);
+  auto const id = m_next_timer++;
+  m_timers.emplace(std::pair(p_deadline, id), std::move(p_handler));
+  // A thread that went idle earlier may now have a deadline to skip to
+  m_changed.notify_all();
+  return id;
+}
+
+bool simulated_clock::cancel(timer_id p_timer)
+{
+  std::lock_guard lock(m_mutex);
+  auto const timer = std::ranges::find_if(
+    m_timers, [p_timer](auto const& p_entry) {
+      return p_entry.first.second == p_timer;
+    });
+  if (timer == m_timers.end()) {
+    return false;
+  }
+  m_timers.erase(timer);
+  return true;
+}
+
+void simulated_clock::attach()
+{
+  std::lock_guard lock(m_mutex);
+  if (caller_attached()) {
+    throw hal::argument_out_of_domain(this);
+  }
+  m_attached.push_back(std::this_thread::get_id());
+}
+
+void simulated_clock::detach()
+{
+  std::lock_guard lock(m_mutex);
+  auto const thread = std::ranges::find(m_attached, std::this_thread::get_id());
+  if (thread == m_attached.end()) {
+    throw hal::argument_out_of_domain(this);
+  }
+  m_attached.erase(thread);
+  // One less thread to wait for, the rest may be idle now
+  m_changed.notify_all();
+}
+
+hal::hertz simulated_clock::driver_frequency()
+{
+  return 1'000'000'000.0f;
+}
+
+hal::u64 simulated_clock::driver_uptime()
+{
+  return static_cast<hal::u64>(now().count());
+}
+
+bool simulated_clock::caller_attached() const
+{
+  return std::ranges::find(m_attached, std::this_thread::get_id()) !=
+         m_attached.end();
+}
+
+usize simulated_clock::running_threads() const
+{
+  return m_attached.size() - m_sleeping_attached;
+}
+
+std::optional<hal::time_duration> simulated_clock::next_deadline() const
+{
+  std::optional<hal::time_duration> next;
+  if (not m_timers.empty()) {
+    next = m_timers.begin()->first.first;
+  }
+  if (not m_sleepers.empty()) {
+    auto const wake_up = m_sleepers.begin()->first;
+    next = next ? std::min(*next, wake_up) : wake_up;
+  }
+  return next;
+}
+
+void simulated_clock::step(std::unique_lock<std::mutex>& p_lock,
+                           hal::time_duration p_time)
+{
+  m_stepping = true;
+  m_now = p_time;
+
+  // Woken threads count as running right away, so time does not move on
+  // before they had their turn
+  auto const due_sleepers = m_sleepers.upper_bound(m_now);
+  for (auto entry = m_sleepers.begin(); entry != due_sleepers; ++entry) {
+    entry->second->woken = true;
+    if (entry->second->attached) {
+      m_sleeping_attached--;
+    }
+  }
+  m_sleepers.erase(m_sleepers.begin(), due_sleepers);
+
+  while (not m_timers.empty() && m_timers.begin()->first.first <= m_now) {
+    auto timer = m_timers.extract(m_timers.begin());
+    p_lock.unlock();
+    try {
+      timer.mapped()();
+    } catch (...) {
+      p_lock.lock();
+      m_stepping = false;
+      m_changed.notify_all();
+      throw;
+    }
+    p_lock.lock();
+  }
+
+  m_stepping = false;
+  m_changed.notify_all();
+}
+}  // namespace hal::mac::inline v1
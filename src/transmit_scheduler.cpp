@@ -0,0 +1,283 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-mac/transmit_scheduler.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <sys/ioctl.h>
+#include <utility>
+
+#include <libhal/error.hpp>
+#include <libhal/pointers.hpp>
+
+namespace hal::mac::inline v1 {
+
+namespace {
+/// Shortest sleep while waiting for the OS driver to drain
+constexpr auto min_line_wait = std::chrono::microseconds(100);
+
+constexpr usize lane_index(transmit_lane p_lane)
+{
+  return static_cast<usize>(p_lane);
+}
+}  // namespace
+
+hal::v5::strong_ptr<transmit_scheduler> transmit_scheduler::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_serial)
+{
+  return create(p_allocator, p_serial, settings{});
+}
+
+hal::v5::strong_ptr<transmit_scheduler> transmit_scheduler::create(
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_serial,
+  settings const& p_settings)
+{
+  if (p_settings.max_line_hold.count() <= 0) {
+    throw hal::argument_out_of_domain(nullptr);
+  }
+
+  return hal::v5::make_strong_ptr<transmit_scheduler>(
+    p_allocator, p_allocator, p_serial, p_settings);
+}
+
+transmit_scheduler::transmit_scheduler(
+  hal::v5::strong_ptr_only_token,
+  std::pmr::polymorphic_allocator<> p_allocator,
+  hal::v5::strong_ptr<serial> p_serial,
+  settings const& p_settings)
+  : m_serial(p_serial)
+  , m_settings(p_settings)
+  , m_lanes{ std::pmr::deque<message>(p_allocator),
+             std::pmr::deque<message>(p_allocator) }
+{
+  m_thread = std::thread(&transmit_scheduler::writer_thread_function, this);
+}
+
+transmit_scheduler::~transmit_scheduler()
+{
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop_thread.store(true, std::memory_order_release);
+  }
+  m_work.notify_all();
+  m_thread.join();
+}
+
+void transmit_scheduler::send(transmit_lane p_lane,
+                              std::span<hal::byte const> p_data)
+{
+  if (p_data.empty()) {
+    return;
+  }
+
+  std::unique_lock lock(m_mutex);
+
+  if (p_lane == transmit_lane::bulk) {
+    // A message larger than the limit is accepted once the queue is empty,
+    // otherwise it could never be sent
+    m_progress.wait(lock, [this, &p_data]() {
+      return m_error || m_queued_bulk_bytes == 0 ||
+             m_queued_bulk_bytes + p_data.size() <=
+               m_settings.max_queued_bulk_bytes;
+    });
+  }
+
+  if (m_error) {
+    std::rethrow_exception(std::exchange(m_error, nullptr));
+  }
+
+  auto& lane = m_lanes[lane_index(p_lane)];
+  lane.push_back(message{
+    .data = std::pmr::vector<hal::byte>(
+      p_data.begin(), p_data.end(), lane.get_allocator()),
+    .queued_at = std::chrono::steady_clock::now(),
+  });
+
+  if (p_lane == transmit_lane::bulk) {
+    m_queued_bulk_bytes += p_data.size();
+  }
+
+  lock.unlock();
+  m_work.notify_one();
+}
+
+void transmit_scheduler::flush()
+{
+  std::unique_lock lock(m_mutex);
+  m_progress.wait(lock, [this]() {
+    return m_error || (m_lanes[0].empty() && m_lanes[1].empty());
+  });
+
+  if (m_error) {
+    std::rethrow_exception(std::exchange(m_error, nullptr));
+  }
+}
+
+transmit_scheduler::lane_statistics transmit_scheduler::get_statistics(
+  transmit_lane p_lane) const
+{
+  std::lock_guard lock(m_mutex);
+  return m_statistics[lane_index(p_lane)];
+}
+
+void transmit_scheduler::writer_thread_function()
+{
+  auto& urgent = m_lanes[lane_index(transmit_lane::urgent)];
+  auto& bulk = m_lanes[lane_index(transmit_lane::bulk)];
+  std::unique_lock lock(m_mutex);
+
+  while (true) {
+    m_work.wait(lock, [&]() {
+      return m_stop_thread.load(std::memory_order_relaxed) ||
+             not urgent.empty() || not bulk.empty();
+    });
+
+    if (m_stop_thread.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    // Only this thread removes messages and deque::push_back() does not move
+    // existing elements, so the message stays valid while the lock is
+    // released for the write.
+    if (not urgent.empty()) {
+      auto& next = urgent.front();
+      lock.unlock();
+      try {
+        m_serial->write(next.data);
+      } catch (...) {
+        lock.lock();
+        fail(std::current_exception());
+        continue;
+      }
+      lock.lock();
+      next.offset = next.data.size();
+      record(transmit_lane::urgent, next, next.data.size());
+      urgent.pop_front();
+      m_progress.notify_all();
+      continue;
+    }
+
+    auto chunk = std::numeric_limits<usize>::max();
+    if (m_settings.split_bulk_messages) {
+      auto const byte_ns = std::max(byte_time().count(), hal::i64{ 1 });
+      chunk = std::max(
+        usize{ 1 },
+        static_cast<usize>(m_settings.max_line_hold.count() / byte_ns));
+    }
+
+    // Wait for the line without the lock, an urgent message queued in the
+    // meantime goes out before this chunk
+    lock.unlock();
+    wait_for_line(chunk);
+    lock.lock();
+
+    if (m_stop_thread.load(std::memory_order_relaxed) ||
+        not urgent.empty()) {
+      continue;
+    }
+
+    auto& next = bulk.front();
+    auto const remaining = std::span(next.data).subspan(next.offset);
+    auto const part = remaining.first(std::min(chunk, remaining.size()));
+
+    lock.unlock();
+    try {
+      m_serial->write(part);
+    } catch (...) {
+      lock.lock();
+      fail(std::current_exception());
+      continue;
+    }
+    lock.lock();
+
+    next.offset += part.size();
+    m_queued_bulk_bytes -= part.size();
+    record(transmit_lane::bulk, next, part.size());
+    if (next.offset == next.data.size()) {
+      bulk.pop_front();
+    }
+    m_progress.notify_all();
+  }
+}
+
+void transmit_scheduler::wait_for_line(usize p_chunk_size)
+{
+#if defined(TIOCOUTQ)
+  // The kernel accepts far more data than one chunk. Keeping its queue short
+  // is what bounds the wait of an urgent message.
+  auto const fd = m_serial->native_handle();
+  int queued = 0;
+  while (not m_stop_thread.load(std::memory_order_acquire) &&
+         ::ioctl(fd, TIOCOUTQ, &queued) == 0 &&
+         static_cast<usize>(queued) > p_chunk_size) {
+    auto const excess = static_cast<usize>(queued) - p_chunk_size;
+    auto const drain_time = byte_time() * static_cast<hal::i64>(excess);
+    std::this_thread::sleep_for(
+      std::max<std::chrono::nanoseconds>(drain_time, min_line_wait));
+  }
+#else
+  static_cast<void>(p_chunk_size);
+#endif
+}
+
+std::chrono::nanoseconds transmit_scheduler::byte_time() const
+{
+  auto const line = m_serial->get_settings();
+  // Start bit, 8 data bits, optional parity bit and the stop bits
+  double bits = 10.0;
+  if (line.parity != hal::v5::serial::settings::parity::none) {
+    bits += 1.0;
+  }
+  if (line.stop == hal::v5::serial::settings::stop_bits::two) {
+    bits += 1.0;
+  }
+
+  auto const baud_rate = std::max(static_cast<double>(line.baud_rate), 1.0);
+  return std::chrono::nanoseconds(
+    static_cast<hal::i64>(bits * 1e9 / baud_rate));
+}
+
+void transmit_scheduler::record(transmit_lane p_lane,
+                                message const& p_message,
+                                usize p_bytes)
+{
+  auto& statistics = m_statistics[lane_index(p_lane)];
+  statistics.bytes += p_bytes;
+
+  if (p_message.offset < p_message.data.size()) {
+    return;
+  }
+
+  auto const latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - p_message.queued_at);
+  auto const latency_ns = static_cast<hal::u64>(latency.count());
+  statistics.messages++;
+  statistics.latency_total_ns += latency_ns;
+  statistics.latency_max_ns = std::max(statistics.latency_max_ns, latency_ns);
+}
+
+void transmit_scheduler::fail(std::exception_ptr p_error)
+{
+  if (not m_error) {
+    m_error = p_error;
+  }
+  m_lanes[0].clear();
+  m_lanes[1].clear();
+  m_queued_bulk_bytes = 0;
+  m_progress.notify_all();
+}
+}  // namespace hal::mac::inline v1
@@ -0,0 +1,166 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <chrono>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+
+#include <libhal-mac/async_serial.hpp>
+#include <libhal-mac/event_loop.hpp>
+#include <libhal-mac/serial.hpp>
+#include <libhal-util/as_bytes.hpp>
+
+#include <boost/ut.hpp>
+
+#include "pseudo_terminal.hpp"
+
+namespace hal::mac {
+namespace {
+/// Pseudo terminal with an async_serial on the terminal side
+struct async_fixture
+{
+  async_fixture()
+  {
+    auto* resource = std::pmr::new_delete_resource();
+    loop = event_loop::create(resource);
+    port = async_serial::create(
+      resource, serial::create(resource, terminal.path, 64), loop);
+  }
+
+  /// Write to the controller side after a delay, from another thread
+  std::thread send_later(std::string p_data)
+  {
+    return std::thread([this, data = std::move(p_data)] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      [[maybe_unused]] auto const written =
+        ::write(terminal.controller, data.data(), data.size());
+    });
+  }
+
+  /// Declared first so the port closes before the controller side
+  pseudo_terminal terminal;
+  hal::v5::optional_ptr<event_loop> loop;
+  hal::v5::optional_ptr<async_serial> port;
+};
+
+std::string_view as_string(std::span<hal::byte const> p_bytes)
+{
+  return { reinterpret_cast<char const*>(p_bytes.data()), p_bytes.size() };
+}
+
+task<> read_exact(async_serial& p_port, std::string& p_result)
+{
+  std::array<hal::byte, 10> buffer{};
+  auto const data = co_await p_port.async_read(buffer);
+  p_result = as_string(data);
+}
+
+task<> read_64(async_serial& p_port, std::string& p_result)
+{
+  std::array<hal::byte, 64> buffer{};
+  auto const data = co_await p_port.async_read(buffer);
+  p_result = as_string(data);
+}
+
+task<> read_lines(async_serial& p_port, std::string& p_result)
+{
+  std::array<hal::byte, 32> buffer{};
+  for (int i = 0; i < 2; i++) {
+    auto const line = co_await p_port.async_read_until(buffer, '\n');
+    p_result += as_string(line);
+    p_result += '|';
+  }
+}
+
+task<> wait_then_write(async_serial& p_port, usize& p_available)
+{
+  p_available = co_await p_port.wait_readable();
+  co_await p_port.async_write(hal::as_bytes(std::string_view("pong")));
+}
+}  // namespace
+
+boost::ut::suite<"test_async_serial"> test_async_serial = [] {
+  using namespace boost::ut;
+
+  "async_serial::async_read()"_test = []() {
+    // Setup
+    async_fixture fixture;
+    std::string result;
+    auto sender = fixture.send_later("0123456789");
+
+    // Exercise
+    fixture.loop->spawn(read_exact(*fixture.port, result));
+    fixture.loop->run();
+    sender.join();
+
+    // Verify
+    expect(that % result == std::string("0123456789"));
+  };
+
+  "async_serial::async_read() of a full receive buffer"_test = []() {
+    // Setup
+    async_fixture fixture;
+    std::string result;
+    std::string const data(
+      "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+/");
+
+    // Exercise - the 64 bytes fill the 64 byte receive buffer before the read
+    expect(that %
+             ::write(fixture.terminal.controller, data.data(), data.size()) ==
+           64);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    fixture.loop->spawn(read_64(*fixture.port, result));
+    fixture.loop->run();
+
+    // Verify
+    expect(that % result == data);
+  };
+
+  "async_serial::async_read_until()"_test = []() {
+    // Setup
+    async_fixture fixture;
+    std::string result;
+    auto sender = fixture.send_later("first\nsecond\n");
+
+    // Exercise
+    fixture.loop->spawn(read_lines(*fixture.port, result));
+    fixture.loop->run();
+    sender.join();
+
+    // Verify
+    expect(that % result == std::string("first\n|second\n|"));
+  };
+
+  "async_serial::wait_readable() and async_write()"_test = []() {
+    // Setup
+    async_fixture fixture;
+    usize available = 0;
+    auto sender = fixture.send_later("ping");
+
+    // Exercise
+    fixture.loop->spawn(wait_then_write(*fixture.port, available));
+    fixture.loop->run();
+    sender.join();
+
+    // Verify
+    expect(that % available == 4);
+    expect(that % fixture.terminal.read(4, std::chrono::milliseconds(1000)) ==
+           std::string("pong"));
+  };
+};
+}  // namespace hal::mac
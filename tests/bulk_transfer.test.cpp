@@ -0,0 +1,298 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory_resource>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <libhal-mac/bulk_transfer.hpp>
+#include <libhal-mac/link_emulator.hpp>
+#include <libhal-mac/simulated_clock.hpp>
+#include <libhal/error.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::mac {
+namespace {
+std::vector<hal::byte> make_image(usize p_size)
+{
+  std::vector<hal::byte> image(p_size);
+  hal::u32 state = 2024;
+  for (auto& byte : image) {
+    state = state * 1103515245U + 12345U;
+    byte = static_cast<hal::byte>(state >> 24);
+  }
+  return image;
+}
+
+/**
+ * @brief Both ends of an emulated link, the receiver serviced by a thread
+ */
+struct transfer_fixture
+{
+  transfer_fixture(link_emulator::settings const& p_link_settings,
+                   usize p_image_size)
+    : link(link_emulator::create(resource, p_link_settings))
+    , host(emulated_serial::create(resource, link, link_emulator::end::a))
+    , device(emulated_serial::create(resource, link, link_emulator::end::b))
+    , written(p_image_size)
+    , receiver(bulk_receiver::create(
+        resource,
+        device,
+        [this](hal::u32 p_offset, std::span<hal::byte const> p_data) {
+          std::ranges::copy(p_data, written.begin() + p_offset);
+          if (first_offset < 0) {
+            first_offset = p_offset;
+          }
+        }))
+  {
+    service_thread = std::thread([this] {
+      while (not stop) {
+        receiver->service();
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    });
+  }
+
+  ~transfer_fixture()
+  {
+    stop = true;
+    service_thread.join();
+  }
+
+  std::pmr::memory_resource* resource = std::pmr::new_delete_resource();
+  hal::v5::strong_ptr<link_emulator> link;
+  hal::v5::strong_ptr<emulated_serial> host;
+  hal::v5::strong_ptr<emulated_serial> device;
+  std::vector<hal::byte> written;
+  /// Offset of the first data handed to the sink, -1 if none
+  long first_offset = -1;
+  hal::v5::strong_ptr<bulk_receiver> receiver;
+  std::atomic<bool> stop = false;
+  std::thread service_thread;
+};
+}  // namespace
+
+boost::ut::suite<"test_bulk_transfer"> test_bulk_transfer = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "bulk_sender sends an image over a clean link"_test = []() {
+    // Setup
+    auto const image = make_image(24 * 1024);
+    transfer_fixture fixture({ .baud_rate = 921600 }, image.size());
+    auto sender = bulk_sender::create(fixture.resource, fixture.host);
+
+    // Exercise
+    sender->send(42, image);
+
+    // Verify
+    expect(fixture.written == image);
+    auto const progress = fixture.receiver->get_progress();
+    expect(that % progress.transfer_id == 42);
+    expect(that % progress.received == image.size());
+    expect(progress.complete);
+    auto const stats = sender->get_statistics();
+    expect(that % stats.bytes_delivered == image.size());
+    expect(that % stats.bytes_resumed == 0);
+    expect(that % stats.retransmissions == 0);
+    expect(that % stats.data_bytes_sent == image.size());
+    expect(stats.goodput > 0.0f);
+    expect(stats.min_rtt > 0ns);
+    auto const receiver_stats = fixture.receiver->get_statistics();
+    expect(that % receiver_stats.duplicate_blocks == 0);
+    expect(that % receiver_stats.corrupt_frames == 0);
+  };
+
+  "bulk_sender recovers from lost and corrupted bytes"_test = []() {
+    // Setup
+    auto const image = make_image(24 * 1024);
+    transfer_fixture fixture({ .baud_rate = 921600,
+                               .latency = 2ms,
+                               .loss_rate = 5e-5f,
+                               .error_rate = 2e-4f,
+                               .seed = 3 },
+                             image.size());
+    auto sender = bulk_sender::create(fixture.resource, fixture.host);
+
+    // Exercise
+    sender->send(7, image);
+
+    // Verify
+    expect(fixture.written == image);
+    expect(fixture.receiver->get_progress().complete);
+    auto const stats = sender->get_statistics();
+    expect(that % stats.bytes_delivered == image.size());
+    expect(stats.retransmissions > 0);
+    expect(stats.data_bytes_sent > image.size());
+    expect(stats.block_size < 1024);
+    expect(fixture.receiver->get_statistics().corrupt_frames > 0);
+  };
+
+  "bulk_sender resumes from the receiver's progress"_test = []() {
+    // Setup
+    auto const image = make_image(8 * 1024);
+    transfer_fixture fixture({ .baud_rate = 921600 }, image.size());
+    auto sender = bulk_sender::create(fixture.resource, fixture.host);
+    std::copy_n(image.begin(), 3000, fixture.written.begin());
+    fixture.receiver->resume(9, static_cast<hal::u32>(image.size()), 3000);
+
+    // Exercise
+    sender->send(9, image);
+    auto const resumed = sender->get_statistics();
+    sender->send(9, image);
+    auto const repeated = sender->get_statistics();
+
+    // Verify
+    expect(fixture.written == image);
+    expect(that % fixture.first_offset == 3000);
+    expect(that % resumed.bytes_resumed == 3000);
+    expect(that % resumed.bytes_delivered == image.size() - 3000);
+    expect(that % resumed.data_bytes_sent == image.size() - 3000);
+    expect(that % repeated.bytes_resumed == image.size());
+    expect(that % repeated.blocks_sent == 0);
+  };
+
+  "bulk_sender starts over when the transfer id changes"_test = []() {
+    // Setup
+    auto const image = make_image(4 * 1024);
+    transfer_fixture fixture({ .baud_rate = 921600 }, image.size());
+    auto sender = bulk_sender::create(fixture.resource, fixture.host);
+    fixture.receiver->resume(1, static_cast<hal::u32>(image.size()), 2000);
+
+    // Exercise
+    sender->send(2, image);
+
+    // Verify
+    expect(fixture.written == image);
+    expect(that % fixture.first_offset == 0);
+    expect(that % sender->get_statistics().bytes_resumed == 0);
+  };
+
+  "bulk_sender times out without a receiver"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    auto link = link_emulator::create(resource, { .baud_rate = 921600 });
+    auto host = emulated_serial::create(resource, link, link_emulator::end::a);
+    auto sender = bulk_sender::create(
+      resource,
+      host,
+      { .initial_timeout = 5ms, .max_retransmissions = 2 });
+    auto const image = make_image(100);
+
+    // Exercise & Verify
+    expect(throws<hal::timed_out>([&] { sender->send(1, image); }));
+    expect(that % sender->get_statistics().link_bytes_sent == 3 * 17);
+  };
+
+  "bulk_sender sends on simulated time the same way every run"_test = []() {
+    auto const image = make_image(16 * 1024);
+    auto const transfer = [&image]() {
+      auto* const resource = std::pmr::new_delete_resource();
+      auto clock = simulated_clock::create(resource);
+      auto link = link_emulator::create(resource,
+                                        { .baud_rate = 115200,
+                                          .latency = 20ms,
+                                          .error_rate = 1e-4f,
+                                          .seed = 5 },
+                                        clock);
+      auto host =
+        emulated_serial::create(resource, link, link_emulator::end::a);
+      auto device =
+        emulated_serial::create(resource, link, link_emulator::end::b);
+      std::vector<hal::byte> written(image.size());
+      auto receiver = bulk_receiver::create(
+        resource,
+        device,
+        [&written](hal::u32 p_offset, std::span<hal::byte const> p_data) {
+          std::ranges::copy(p_data, written.begin() + p_offset);
+        });
+      // The receiver is serviced by handlers on the sending thread
+      hal::callback<void()> service;
+      service = [&]() {
+        receiver->service();
+        clock->schedule(clock->now() + 1ms, service);
+      };
+      clock->schedule(0ms, service);
+      auto sender = bulk_sender::create(resource, host, {}, clock);
+
+      sender->send(3, image);
+      expect(written == image);
+      return sender->get_statistics();
+    };
+    auto const start = std::chrono::steady_clock::now();
+
+    // Exercise
+    auto const first = transfer();
+    auto const second = transfer();
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+
+    // Verify - 16 KiB at 11.5 KB/s takes well over a second per run
+    expect(first.elapsed > 1s);
+    expect(elapsed < first.elapsed);
+    expect(that % first.elapsed.count() == second.elapsed.count());
+    expect(that % first.retransmissions == second.retransmissions);
+    expect(that % first.link_bytes_sent == second.link_bytes_sent);
+  };
+
+  "bulk_sender times out on simulated time"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    auto clock = simulated_clock::create(resource);
+    auto link =
+      link_emulator::create(resource, { .baud_rate = 921600 }, clock);
+    auto host = emulated_serial::create(resource, link, link_emulator::end::a);
+    auto sender = bulk_sender::create(resource,
+                                      host,
+                                      { .initial_timeout = 30s,
+                                        .max_retransmissions = 2,
+                                        .poll_interval = 10ms },
+                                      clock);
+    auto const image = make_image(100);
+    auto const start = std::chrono::steady_clock::now();
+
+    // Exercise & Verify
+    expect(throws<hal::timed_out>([&] { sender->send(1, image); }));
+    expect(clock->now() >= 90s);
+    expect(std::chrono::steady_clock::now() - start < 5s);
+  };
+
+  "bulk_sender and bulk_receiver reject invalid settings"_test = []() {
+    auto* const resource = std::pmr::new_delete_resource();
+    auto link = link_emulator::create(resource);
+    auto port = emulated_serial::create(resource, link, link_emulator::end::a);
+    auto const ignore = [](hal::u32, std::span<hal::byte const>) {};
+
+    expect(throws<hal::argument_out_of_domain>([&] {
+      static_cast<void>(
+        bulk_sender::create(resource, port, { .max_block_size = 70000 }));
+    }));
+    expect(throws<hal::argument_out_of_domain>([&] {
+      static_cast<void>(bulk_sender::create(
+        resource, port, { .max_block_size = 32, .min_block_size = 64 }));
+    }));
+    expect(throws<hal::argument_out_of_domain>([&] {
+      static_cast<void>(
+        bulk_receiver::create(resource, port, ignore, { .window_size = 16 }));
+    }));
+    expect(throws<hal::argument_out_of_domain>([&] {
+      bulk_receiver::create(resource, port, ignore)->resume(1, 10, 11);
+    }));
+  };
+};
+}  // namespace hal::mac
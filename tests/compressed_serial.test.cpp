@@ -0,0 +1,267 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <libhal-mac/compressed_serial.hpp>
+#include <libhal-util/as_bytes.hpp>
+#include <libhal/error.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::mac {
+namespace {
+/**
+ * @brief Serial port whose writes arrive in its own receive buffer
+ */
+class loopback_serial : public hal::v5::serial
+{
+public:
+  explicit loopback_serial(hal::v5::strong_ptr_only_token)
+  {
+  }
+
+  /// Add data to the receive buffer as if it arrived on the wire
+  void inject(std::span<hal::byte const> p_data)
+  {
+    std::lock_guard lock(m_mutex);
+    for (auto const byte : p_data) {
+      m_buffer[m_cursor] = byte;
+      m_cursor = (m_cursor + 1) % m_buffer.size();
+    }
+  }
+
+private:
+  void driver_configure(hal::v5::serial::settings const&) override
+  {
+  }
+
+  void driver_write(std::span<hal::byte const> p_data) override
+  {
+    inject(p_data);
+  }
+
+  std::span<hal::byte const> driver_receive_buffer() override
+  {
+    return m_buffer;
+  }
+
+  usize driver_cursor() override
+  {
+    std::lock_guard lock(m_mutex);
+    return m_cursor;
+  }
+
+  std::mutex m_mutex;
+  std::array<hal::byte, 8192> m_buffer{};
+  usize m_cursor = 0;
+};
+
+/// Received data of a port, assuming its buffer did not wrap
+std::string received(hal::v5::serial& p_serial)
+{
+  auto const data =
+    p_serial.receive_buffer().first(p_serial.receive_cursor());
+  return { data.begin(), data.end() };
+}
+
+/// Lines as a data logger would write them
+std::string telemetry(int p_lines)
+{
+  std::string result;
+  for (int i = 0; i < p_lines; i++) {
+    result += "[" + std::to_string(i * 125) + "] sensor " +
+              std::to_string(i % 4) + ": temperature=" +
+              std::to_string(20 + i % 7) + "." + std::to_string(i % 10) +
+              " C humidity=" + std::to_string(40 + i % 3) + " %\n";
+  }
+  return result;
+}
+
+template<typename Condition>
+bool wait_for(Condition&& p_condition)
+{
+  auto const deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (not p_condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+}  // namespace
+
+boost::ut::suite<"test_compressed_serial"> test_compressed_serial = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "compressed_serial compresses text using earlier blocks"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    auto linked_link = hal::v5::make_strong_ptr<loopback_serial>(resource);
+    auto independent_link =
+      hal::v5::make_strong_ptr<loopback_serial>(resource);
+    auto linked = compressed_serial::create(resource, linked_link);
+    auto independent = compressed_serial::create(
+      resource, independent_link, { .independent_blocks = true });
+    auto const text = telemetry(60);
+
+    // Exercise
+    for (auto line = text.begin(); line != text.end();) {
+      auto const end = std::find(line, text.end(), '\n') + 1;
+      auto const bytes = hal::as_bytes(std::string_view(line, end));
+      linked->write(bytes);
+      independent->write(bytes);
+      line = end;
+    }
+
+    // Verify
+    expect(received(*linked) == text);
+    expect(received(*independent) == text);
+    auto const stats = linked->get_statistics();
+    expect(that % stats.bytes_written == text.size());
+    expect(that % stats.blocks_sent == 60);
+    expect(that % stats.bytes_received == text.size());
+    expect(that % stats.corrupt_blocks == 0);
+    expect(stats.link_bytes_sent * 2 < text.size());
+    expect(that % stats.link_bytes_received == stats.link_bytes_sent);
+    expect(that % stats.link_bytes_sent <
+           independent->get_statistics().link_bytes_sent);
+  };
+
+  "compressed_serial keeps a window across many blocks"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    auto link = hal::v5::make_strong_ptr<loopback_serial>(resource);
+    auto compressed = compressed_serial::create(
+      resource,
+      link,
+      { .receive_buffer_size = 8192, .block_size = 256, .window_size = 512 });
+    auto const text = telemetry(100);
+
+    // Exercise
+    compressed->write(hal::as_bytes(text));
+
+    // Verify
+    expect(received(*compressed) == text);
+    auto const stats = compressed->get_statistics();
+    expect(that % stats.blocks_sent == (text.size() + 255) / 256);
+    expect(that % stats.stored_blocks == 0);
+    expect(that % stats.corrupt_blocks == 0);
+  };
+
+  "compressed_serial sends incompressible data stored"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    auto link = hal::v5::make_strong_ptr<loopback_serial>(resource);
+    auto compressed = compressed_serial::create(resource, link);
+    std::vector<hal::byte> noise(1000);
+    hal::u32 state = 12345;
+    for (auto& byte : noise) {
+      state = state * 1103515245U + 12345U;
+      byte = static_cast<hal::byte>(state >> 24);
+    }
+
+    // Exercise
+    compressed->write(noise);
+
+    // Verify
+    auto const data =
+      compressed->receive_buffer().first(compressed->receive_cursor());
+    expect(std::ranges::equal(data, noise));
+    auto const stats = compressed->get_statistics();
+    expect(that % stats.stored_blocks == 1);
+    expect(that % stats.link_bytes_sent == noise.size() + 5);
+  };
+
+  "compressed_serial collects writes for flush_delay"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    auto link = hal::v5::make_strong_ptr<loopback_serial>(resource);
+    auto held = compressed_serial::create(
+      resource, link, { .flush_delay = std::chrono::hours(1) });
+    auto timed = compressed_serial::create(
+      resource,
+      hal::v5::make_strong_ptr<loopback_serial>(resource),
+      { .flush_delay = std::chrono::milliseconds(5) });
+
+    // Exercise
+    held->write(hal::as_bytes("one "sv));
+    held->write(hal::as_bytes("two "sv));
+    held->write(hal::as_bytes("three\n"sv));
+    auto const sent_before_flush = held->get_statistics().blocks_sent;
+    held->flush();
+    timed->write(hal::as_bytes("later\n"sv));
+
+    // Verify
+    expect(that % sent_before_flush == 0);
+    expect(that % held->get_statistics().blocks_sent == 1);
+    expect(received(*held) == "one two three\n"sv);
+    expect(wait_for(
+      [&timed] { return timed->get_statistics().blocks_sent == 1; }));
+  };
+
+  "compressed_serial discards blocks it cannot decompress"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    auto link = hal::v5::make_strong_ptr<loopback_serial>(resource);
+    auto compressed = compressed_serial::create(resource, link);
+    // A block that refers to earlier blocks, which were never received
+    std::array<hal::byte, 8> const linked{
+      0xC5, 0x01, 0x03, 0x00, 0x01 ^ 0x03 ^ 0x5A, 'a', 'b', 'c',
+    };
+    // An independent block whose match refers to data before it
+    std::array<hal::byte, 10> const bad_offset{
+      0xC5, 0x02, 0x05, 0x00, 0x02 ^ 0x05 ^ 0x5A, 0x10, 'x', 0x09, 0x00, 0x00,
+    };
+
+    // Exercise
+    link->inject(linked);
+    link->inject(bad_offset);
+    link->inject(hal::as_bytes("noise"sv));
+    compressed->write(hal::as_bytes("recovered\n"sv));
+
+    // Verify
+    expect(received(*compressed) == "recovered\n"sv);
+    auto const stats = compressed->get_statistics();
+    expect(that % stats.blocks_received == 3);
+    expect(that % stats.corrupt_blocks == 2);
+  };
+
+  "compressed_serial rejects sizes the frame cannot carry"_test = []() {
+    auto* const resource = std::pmr::new_delete_resource();
+    auto link = hal::v5::make_strong_ptr<loopback_serial>(resource);
+
+    expect(throws<hal::argument_out_of_domain>([&] {
+      static_cast<void>(
+        compressed_serial::create(resource, link, { .block_size = 0 }));
+    }));
+    expect(throws<hal::argument_out_of_domain>([&] {
+      static_cast<void>(
+        compressed_serial::create(resource, link, { .window_size = 70000 }));
+    }));
+  };
+};
+}  // namespace hal::mac
@@ -12,15 +12,59 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>
 #include <memory_resource>
 #include <print>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
 
-#include <libhal-mac/console_serial.hpp>
+#include <libhal-mac/console.hpp>
 #include <libhal-util/as_bytes.hpp>
+#include <libhal/error.hpp>
 
 #include <boost/ut.hpp>
 
+#include "pseudo_terminal.hpp"
+
 namespace hal::mac {
+namespace {
+/// Terminal pair standing in for the user's terminal, the console is handed
+/// the terminal side
+struct console_terminal : pseudo_terminal
+{
+  console_terminal()
+  {
+    open_terminal();
+  }
+
+  [[nodiscard]] termios attributes() const
+  {
+    termios result{};
+    ::tcgetattr(terminal, &result);
+    return result;
+  }
+
+  /// Type a key and measure how long it takes to show up in the console
+  std::chrono::nanoseconds keystroke_latency(hal::v5::serial& p_console,
+                                             char p_key)
+  {
+    auto const before = p_console.receive_cursor();
+    auto const start = std::chrono::steady_clock::now();
+    [[maybe_unused]] auto const result = ::write(controller, &p_key, 1);
+
+    while (p_console.receive_cursor() == before) {
+      if (std::chrono::steady_clock::now() - start > std::chrono::seconds(1)) {
+        return std::chrono::nanoseconds::max();
+      }
+      std::this_thread::yield();
+    }
+    return std::chrono::steady_clock::now() - start;
+  }
+};
+}  // namespace
+
 boost::ut::suite<"test_console_serial"> test_console_serial = [] {
   using namespace boost::ut;
   using namespace std::literals;
@@ -67,8 +111,122 @@ boost::ut::suite<"test_console_serial"> test_console_serial = [] {
   "console_serial::invalid_buffer_size()"_test = []() {
     // Exercise & Verify
     expect(throws<hal::argument_out_of_domain>([&] {
-      hal::mac::console_serial::create(std::pmr::new_delete_resource(), 0);
+      static_cast<void>(
+        hal::mac::console_serial::create(std::pmr::new_delete_resource(), 0));
     }));
   };
+
+  "console_serial raw mode delivers each keystroke"_test = []() {
+    // Setup
+    console_terminal terminal;
+    auto const original = terminal.attributes();
+
+    {
+      auto console = hal::mac::console_serial::create(
+        std::pmr::new_delete_resource(),
+        64,
+        { .mode = hal::mac::console_serial::terminal_mode::raw,
+          .input_fd = terminal.terminal,
+          .output_fd = terminal.terminal });
+
+      auto const raw = terminal.attributes();
+      expect(that % (raw.c_lflag & (ICANON | ECHO | ISIG)) == 0u);
+      expect(that % (raw.c_oflag & OPOST) == 0u);
+
+      // Exercise
+      std::chrono::nanoseconds worst{ 0 };
+      for (char const key : "hello"sv) {
+        worst = std::max(worst, terminal.keystroke_latency(*console, key));
+      }
+      console->write(hal::as_bytes("ok\n"sv));
+
+      // Verify
+      std::println("Worst keystroke to cursor latency: {} us",
+                   worst.count() / 1000);
+      expect(that % worst < std::chrono::nanoseconds(100ms));
+      expect(that % console->receive_cursor() == 5);
+      auto const received = console->receive_buffer().first(5);
+      expect(std::string(received.begin(), received.end()) == "hello"sv);
+      // No echo and no "\r\n" expansion
+      expect(that % terminal.read(50ms) == "ok\n"sv);
+    }
+
+    // Verify
+    auto const restored = terminal.attributes();
+    expect(that % restored.c_lflag == original.c_lflag);
+    expect(that % restored.c_oflag == original.c_oflag);
+    expect(that % restored.c_iflag == original.c_iflag);
+  };
+
+  "console_serial cbreak mode keeps signal keys"_test = []() {
+    // Setup
+    console_terminal terminal;
+    auto const original = terminal.attributes();
+
+    {
+      auto console = hal::mac::console_serial::create(
+        std::pmr::new_delete_resource(),
+        64,
+        { .mode = hal::mac::console_serial::terminal_mode::cbreak,
+          .input_fd = terminal.terminal,
+          .output_fd = terminal.terminal });
+
+      // Verify
+      auto const cbreak = terminal.attributes();
+      expect(that % (cbreak.c_lflag & (ICANON | ECHO)) == 0u);
+      expect(that % (cbreak.c_lflag & ISIG) != 0u);
+      expect(that % terminal.keystroke_latency(*console, 'x') <
+             std::chrono::nanoseconds(100ms));
+    }
+
+    expect(that % terminal.attributes().c_lflag == original.c_lflag);
+  };
+
+  "console_serial busy polls the input"_test = []() {
+    // Setup
+    console_terminal terminal;
+    auto console = hal::mac::console_serial::create(
+      std::pmr::new_delete_resource(),
+      64,
+      { .mode = hal::mac::console_serial::terminal_mode::raw,
+        .input_fd = terminal.terminal,
+        .output_fd = terminal.terminal,
+        .receive_thread = { .busy_poll = true } });
+
+    // Exercise
+    auto const latency = terminal.keystroke_latency(*console, 'b');
+
+    // Verify
+    expect(that % latency < std::chrono::nanoseconds(100ms));
+    expect(that % console->receive_buffer()[0] == hal::byte{ 'b' });
+    expect(throws<hal::argument_out_of_domain>([&] {
+      static_cast<void>(hal::mac::console_serial::create(
+        std::pmr::new_delete_resource(),
+        64,
+        { .input_fd = terminal.terminal,
+          .output_fd = terminal.terminal,
+          .receive_thread = { .thread = { .priority = 5 } } }));
+    }));
+  };
+
+  "console_serial unchanged mode waits for enter"_test = []() {
+    // Setup
+    console_terminal terminal;
+    auto console = hal::mac::console_serial::create(
+      std::pmr::new_delete_resource(),
+      64,
+      { .input_fd = terminal.terminal, .output_fd = terminal.terminal });
+
+    // Exercise
+    [[maybe_unused]] auto result = ::write(terminal.controller, "ab", 2);
+    std::this_thread::sleep_for(50ms);
+    auto const before_enter = console->receive_cursor();
+    result = ::write(terminal.controller, "\n", 1);
+    std::this_thread::sleep_for(50ms);
+
+    // Verify
+    expect(that % before_enter == 0);
+    expect(that % console->receive_cursor() == 3);
+  };
 };
 }  // namespace hal::mac
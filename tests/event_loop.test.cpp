@@ -0,0 +1,200 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+#include <libhal-mac/event_loop.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::mac {
+namespace {
+/// Memory resource that counts the allocations it serves
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+  usize allocations = 0;
+  usize outstanding = 0;
+
+private:
+  void* do_allocate(std::size_t p_bytes, std::size_t p_alignment) override
+  {
+    allocations++;
+    outstanding++;
+    return std::pmr::new_delete_resource()->allocate(p_bytes, p_alignment);
+  }
+
+  void do_deallocate(void* p_pointer,
+                     std::size_t p_bytes,
+                     std::size_t p_alignment) override
+  {
+    outstanding--;
+    std::pmr::new_delete_resource()->deallocate(
+      p_pointer, p_bytes, p_alignment);
+  }
+
+  bool do_is_equal(
+    std::pmr::memory_resource const& p_other) const noexcept override
+  {
+    return this == &p_other;
+  }
+};
+
+task<int> add(std::allocator_arg_t,
+              std::pmr::polymorphic_allocator<>,
+              int p_left,
+              int p_right)
+{
+  co_return p_left + p_right;
+}
+
+task<> sum(std::allocator_arg_t,
+           std::pmr::polymorphic_allocator<> p_allocator,
+           int& p_result)
+{
+  p_result = co_await add(std::allocator_arg, p_allocator, 1, 2);
+  p_result += co_await add(std::allocator_arg, p_allocator, 3, 4);
+}
+
+task<> fail()
+{
+  throw std::runtime_error("fail");
+  co_return;
+}
+
+task<> wait_for_pipe(scheduler& p_scheduler, int p_fd, bool& p_done)
+{
+  struct writable_awaiter
+  {
+    scheduler& loop;
+    int fd;
+
+    bool await_ready()
+    {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> p_handle)
+    {
+      loop.wait_writable(fd, [this, p_handle]() { loop.post(p_handle); });
+    }
+
+    void await_resume()
+    {
+    }
+  };
+
+  co_await writable_awaiter{ p_scheduler, p_fd };
+  p_done = true;
+}
+}  // namespace
+
+boost::ut::suite<"test_event_loop"> test_event_loop = [] {
+  using namespace boost::ut;
+
+  "event_loop::run() completes spawned tasks"_test = []() {
+    // Setup
+    counting_resource resource;
+    auto loop = event_loop::create(std::pmr::new_delete_resource());
+    int result = 0;
+
+    // Exercise
+    loop->spawn(sum(std::allocator_arg, &resource, result));
+    loop->run();
+
+    // Verify - every frame came from the supplied resource and was returned
+    expect(that % result == 10);
+    expect(that % resource.allocations == 3);
+    expect(that % resource.outstanding == 0);
+  };
+
+  "event_loop::run() rethrows exceptions of spawned tasks"_test = []() {
+    // Setup
+    auto loop = event_loop::create(std::pmr::new_delete_resource());
+
+    // Exercise
+    loop->spawn(fail());
+
+    // Verify
+    expect(throws<std::runtime_error>([&loop] { loop->run(); }));
+  };
+
+  "event_loop::post() from another thread wakes the loop"_test = []() {
+    // Setup
+    auto loop = event_loop::create(std::pmr::new_delete_resource());
+    std::atomic<std::coroutine_handle<>> suspended{ nullptr };
+    bool resumed = false;
+    auto waiter = [](std::atomic<std::coroutine_handle<>>& p_suspended,
+                     bool& p_resumed) -> task<> {
+      struct capture_awaiter
+      {
+        std::atomic<std::coroutine_handle<>>& handle;
+        bool await_ready()
+        {
+          return false;
+        }
+        void await_suspend(std::coroutine_handle<> p_handle)
+        {
+          handle = p_handle;
+        }
+        void await_resume()
+        {
+        }
+      };
+      co_await capture_awaiter{ p_suspended };
+      p_resumed = true;
+    };
+    loop->spawn(waiter(suspended, resumed));
+
+    // Exercise
+    std::thread poster([&loop, &suspended] {
+      while (suspended.load() == nullptr) {
+        std::this_thread::yield();
+      }
+      loop->post(suspended.load());
+    });
+    loop->run();
+    poster.join();
+
+    // Verify
+    expect(that % resumed);
+  };
+
+  "event_loop::wait_writable()"_test = []() {
+    // Setup
+    auto loop = event_loop::create(std::pmr::new_delete_resource());
+    std::array<int, 2> pipe_fds{};
+    expect(that % ::pipe(pipe_fds.data()) == 0);
+    bool done = false;
+
+    // Exercise
+    loop->spawn(wait_for_pipe(*loop, pipe_fds[1], done));
+    loop->run();
+
+    // Verify
+    expect(that % done);
+
+    // Cleanup
+    ::close(pipe_fds[0]);
+    ::close(pipe_fds[1]);
+  };
+};
+}  // namespace hal::mac
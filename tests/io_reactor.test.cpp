@@ -0,0 +1,162 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+
+#include <libhal-mac/io_reactor.hpp>
+#include <libhal-mac/serial.hpp>
+
+#include <boost/ut.hpp>
+
+#include "pseudo_terminal.hpp"
+
+namespace hal::mac {
+namespace {
+/// Wait until the predicate holds or a second has passed
+template<typename Predicate>
+bool wait_until(Predicate p_predicate)
+{
+  using namespace std::chrono_literals;
+  auto const deadline = std::chrono::steady_clock::now() + 1s;
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (p_predicate()) {
+      return true;
+    }
+    std::this_thread::sleep_for(1ms);
+  }
+  return false;
+}
+}  // namespace
+
+boost::ut::suite<"test_io_reactor"> test_io_reactor = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "io_reactor::watch() calls the handler until it returns false"_test = []() {
+    // Setup
+    auto reactor = io_reactor::create(std::pmr::new_delete_resource());
+    std::array<int, 2> pipe_fds{};
+    expect(that % ::pipe(pipe_fds.data()) == 0);
+    std::atomic<int> calls = 0;
+
+    // Exercise
+    reactor->watch(pipe_fds[0], [&calls]() { return ++calls < 3; });
+    expect(that % ::write(pipe_fds[1], "x", 1) == 1);
+
+    // Verify - the byte is never read, so the level triggered descriptor
+    // stays ready until the handler asks to stop.
+    expect(that % wait_until([&calls] { return calls == 3; }));
+    std::this_thread::sleep_for(20ms);
+    expect(that % calls.load() == 3);
+
+    // Cleanup
+    reactor->unwatch(pipe_fds[0]);
+    ::close(pipe_fds[0]);
+    ::close(pipe_fds[1]);
+  };
+
+  "io_reactor::unwatch() stops handler calls"_test = []() {
+    // Setup
+    auto reactor = io_reactor::create(std::pmr::new_delete_resource());
+    std::array<int, 2> pipe_fds{};
+    expect(that % ::pipe(pipe_fds.data()) == 0);
+    std::atomic<int> calls = 0;
+    reactor->watch(pipe_fds[0], [&calls]() {
+      calls++;
+      return true;
+    });
+
+    // Exercise
+    reactor->unwatch(pipe_fds[0]);
+    auto const calls_after_unwatch = calls.load();
+    expect(that % ::write(pipe_fds[1], "x", 1) == 1);
+    std::this_thread::sleep_for(20ms);
+
+    // Verify
+    expect(that % calls.load() == calls_after_unwatch);
+
+    // Cleanup
+    ::close(pipe_fds[0]);
+    ::close(pipe_fds[1]);
+  };
+
+  "serial serviced by io_reactor receives from many ports"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    auto reactor = io_reactor::create(resource);
+    constexpr std::string_view message = "reactor";
+    // Declared before the ports so they close before the controller sides
+    std::array<pseudo_terminal, 8> terminals;
+    std::array<hal::v5::optional_ptr<serial>, 8> ports{};
+    for (usize i = 0; i < terminals.size(); i++) {
+      ports[i] = serial::create(resource, reactor, terminals[i].path, 64);
+    }
+
+    // Exercise
+    for (auto const& terminal : terminals) {
+      expect(that %
+               ::write(terminal.controller, message.data(), message.size()) ==
+             static_cast<ssize_t>(message.size()));
+    }
+
+    // Verify
+    for (auto& port : ports) {
+      expect(that % wait_until([&port, message] {
+               return port->receive_cursor() == message.size();
+             }));
+      auto const buffer = port->receive_buffer();
+      expect(that % std::string_view(reinterpret_cast<char const*>(
+                                       buffer.data()),
+                                     message.size()) == message);
+      auto const stats = port->get_statistics();
+      expect(that % stats.bytes_received == message.size());
+      expect(that % stats.wait_calls == 0);
+    }
+    expect(that % reactor->get_statistics().events >= terminals.size());
+  };
+
+  "serial serviced by io_reactor detects hangup"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    auto reactor = io_reactor::create(resource);
+    auto terminal = std::make_unique<pseudo_terminal>();
+    auto port = serial::create(resource, reactor, terminal->path, 64);
+    std::atomic<int> disconnects = 0;
+    port->on_connection_change([&disconnects](connection_state p_state) {
+      if (p_state == connection_state::disconnected) {
+        disconnects++;
+      }
+    });
+
+    // Exercise - closing the controller side hangs up the terminal
+    terminal.reset();
+
+    // Verify - the hangup is reported once and the reactor stops servicing
+    // the dead descriptor while the reconnect thread waits for the device.
+    expect(that % wait_until([&disconnects] { return disconnects == 1; }));
+    auto const events = reactor->get_statistics().events;
+    std::this_thread::sleep_for(50ms);
+    expect(that % reactor->get_statistics().events == events);
+    expect(that % port->get_connection_state() ==
+           connection_state::disconnected);
+  };
+};
+}  // namespace hal::mac
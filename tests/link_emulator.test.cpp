@@ -0,0 +1,213 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <libhal-mac/link_emulator.hpp>
+#include <libhal-util/as_bytes.hpp>
+#include <libhal/error.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::mac {
+namespace {
+/// Received data of a port, assuming its buffer did not wrap
+std::string received(hal::v5::serial& p_serial)
+{
+  auto const data =
+    p_serial.receive_buffer().first(p_serial.receive_cursor());
+  return { data.begin(), data.end() };
+}
+
+template<typename Condition>
+bool wait_for(Condition&& p_condition)
+{
+  auto const deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (not p_condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  return true;
+}
+}  // namespace
+
+boost::ut::suite<"test_link_emulator"> test_link_emulator = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "link_emulator delivers bytes at the baud rate"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    // 9600 bytes per second, so 192 bytes take 20ms
+    auto link = link_emulator::create(resource, { .baud_rate = 96000 });
+    auto a = emulated_serial::create(resource, link, link_emulator::end::a);
+    auto b = emulated_serial::create(resource, link, link_emulator::end::b);
+    std::string const message(192, 'x');
+    auto const start = std::chrono::steady_clock::now();
+
+    // Exercise
+    a->write(hal::as_bytes(message));
+    auto const arrived =
+      wait_for([&b, &message] { return received(*b) == message; });
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+    b->write(hal::as_bytes("ok"sv));
+
+    // Verify
+    expect(arrived);
+    expect(elapsed >= 19ms);
+    expect(wait_for([&a] { return received(*a) == "ok"sv; }));
+    auto const stats = link->get_statistics(link_emulator::end::a);
+    expect(that % stats.bytes_sent == message.size());
+    expect(that % stats.bytes_delivered == message.size());
+    expect(that % stats.bytes_lost == 0);
+    expect(that % stats.bytes_corrupted == 0);
+  };
+
+  "link_emulator delays bytes by the latency"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    auto link = link_emulator::create(
+      resource, { .baud_rate = 1'000'000, .latency = 30ms });
+    auto a = emulated_serial::create(resource, link, link_emulator::end::a);
+    auto b = emulated_serial::create(resource, link, link_emulator::end::b);
+
+    // Exercise
+    a->write(hal::as_bytes("ping"sv));
+    std::this_thread::sleep_for(10ms);
+    auto const early = received(*b);
+
+    // Verify
+    expect(early.empty());
+    expect(wait_for([&b] { return received(*b) == "ping"sv; }));
+  };
+
+  "link_emulator injects the same faults for the same seed"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    link_emulator::settings const settings{
+      .baud_rate = 10'000'000,
+      .loss_rate = 0.05f,
+      .error_rate = 0.05f,
+      .seed = 7,
+    };
+    std::vector<hal::byte> message(2000);
+    for (usize i = 0; i < message.size(); i++) {
+      message[i] = static_cast<hal::byte>(i);
+    }
+    auto const transfer = [&] {
+      auto link = link_emulator::create(resource, settings);
+      auto a = emulated_serial::create(resource, link, link_emulator::end::a);
+      auto b = emulated_serial::create(resource, link, link_emulator::end::b);
+      a->write(message);
+      static_cast<void>(wait_for([&link] {
+        auto const stats = link->get_statistics(link_emulator::end::a);
+        return stats.bytes_delivered + stats.bytes_lost == 2000;
+      }));
+      return std::pair(received(*b),
+                       link->get_statistics(link_emulator::end::a));
+    };
+
+    // Exercise
+    auto const [first_data, first] = transfer();
+    auto const [second_data, second] = transfer();
+
+    // Verify
+    expect(that % first.bytes_delivered + first.bytes_lost == 2000);
+    expect(that % first.bytes_delivered == first_data.size());
+    expect(first.bytes_lost > 50 && first.bytes_lost < 150);
+    expect(first.bytes_corrupted > 50 && first.bytes_corrupted < 150);
+    expect(first_data == second_data);
+    expect(that % first.bytes_lost == second.bytes_lost);
+    expect(that % first.bytes_corrupted == second.bytes_corrupted);
+  };
+
+  "link_emulator runs on simulated time"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    auto clock = simulated_clock::create(resource);
+    // 960 bytes per second, so 960 bytes take one second
+    auto link = link_emulator::create(
+      resource, { .baud_rate = 9600, .latency = 500ms }, clock);
+    auto a = emulated_serial::create(resource, link, link_emulator::end::a);
+    auto b = emulated_serial::create(resource, link, link_emulator::end::b);
+    std::string const message(960, 'x');
+    auto const start = std::chrono::steady_clock::now();
+
+    // Exercise
+    a->write(hal::as_bytes(message));
+    clock->sleep_for(1400ms);
+    auto const early = received(*b).size();
+    clock->sleep_for(200ms);
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+
+    // Verify - 54 bursts of 16 bytes arrived 900ms after the first byte left
+    expect(that % early == 864);
+    expect(that % received(*b) == message);
+    expect(elapsed < 1s);
+  };
+
+  "emulated_serial keeps the newest bytes of a burst filling its buffer"_test =
+    []() {
+      // Setup
+      auto* const resource = std::pmr::new_delete_resource();
+      auto clock = simulated_clock::create(resource);
+      auto link =
+        link_emulator::create(resource, { .baud_rate = 115200 }, clock);
+      auto a = emulated_serial::create(resource, link, link_emulator::end::a);
+      auto b = emulated_serial::create(
+        resource, link, link_emulator::end::b, { .receive_buffer_size = 16 });
+      std::string const message("0123456789abcdef");
+
+      // Exercise - the 16 bytes arrive as one burst
+      a->write(hal::as_bytes(message));
+      clock->sleep_for(100ms);
+
+      // Verify - a full lap would look like nothing arrived
+      expect(that % b->receive_cursor() == 15);
+      expect(that % received(*b) == message.substr(1));
+    };
+
+  "link_emulator allows one port per end"_test = []() {
+    // Setup
+    auto* const resource = std::pmr::new_delete_resource();
+    auto link = link_emulator::create(resource);
+    auto a = emulated_serial::create(resource, link, link_emulator::end::a);
+
+    // Exercise & Verify
+    expect(throws<hal::device_or_resource_busy>([&] {
+      static_cast<void>(
+        emulated_serial::create(resource, link, link_emulator::end::a));
+    }));
+    a = emulated_serial::create(resource, link, link_emulator::end::b);
+    auto reopened =
+      emulated_serial::create(resource, link, link_emulator::end::a);
+    expect(throws<hal::argument_out_of_domain>([&] {
+      static_cast<void>(link_emulator::create(resource, { .baud_rate = 0 }));
+    }));
+    expect(throws<hal::argument_out_of_domain>([&] {
+      static_cast<void>(
+        link_emulator::create(resource, { .loss_rate = 1.5f }));
+    }));
+  };
+};
+}  // namespace hal::mac
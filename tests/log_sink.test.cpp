@@ -0,0 +1,211 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cstdio>
+#include <fcntl.h>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <libhal-mac/console.hpp>
+#include <libhal-mac/log_sink.hpp>
+#include <libhal-util/as_bytes.hpp>
+#include <libhal/error.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::mac {
+namespace {
+/// Pipe standing in for stdout, with a thread collecting everything written
+struct captured_output
+{
+  captured_output()
+  {
+    if (::pipe(pipe.data()) != 0) {
+      throw std::runtime_error("failed to create a pipe");
+    }
+    input = ::open("/dev/null", O_RDONLY);
+    reader = std::thread([this]() {
+      std::array<char, 4096> buffer{};
+      while (true) {
+        auto const count = ::read(pipe[0], buffer.data(), buffer.size());
+        if (count <= 0) {
+          return;
+        }
+        text.append(buffer.data(), static_cast<std::size_t>(count));
+      }
+    });
+  }
+
+  /// Close the write end and wait for everything written to be read
+  std::string const& finish()
+  {
+    if (pipe[1] != -1) {
+      ::close(pipe[1]);
+      pipe[1] = -1;
+      reader.join();
+    }
+    return text;
+  }
+
+  ~captured_output()
+  {
+    finish();
+    ::close(pipe[0]);
+    ::close(input);
+  }
+
+  hal::v5::strong_ptr<console_serial> console()
+  {
+    return console_serial::create(
+      std::pmr::new_delete_resource(),
+      32,
+      { .input_fd = input, .output_fd = pipe[1] });
+  }
+
+  std::array<int, 2> pipe{ -1, -1 };
+  int input = -1;
+  std::thread reader;
+  std::string text;
+};
+}  // namespace
+
+boost::ut::suite<"test_log_sink"> test_log_sink = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "log_sink keeps every message of every thread in order"_test = []() {
+    // Setup
+    constexpr int thread_count = 4;
+    constexpr int messages_per_thread = 2000;
+    captured_output output;
+
+    {
+      auto sink = log_sink::create(
+        std::pmr::new_delete_resource(),
+        output.console(),
+        { .ring_size = 1024, .policy = log_sink::overflow_policy::block });
+
+      // Exercise
+      std::vector<std::thread> producers;
+      for (int id = 0; id < thread_count; id++) {
+        producers.emplace_back([&sink, id]() {
+          for (int n = 0; n < messages_per_thread; n++) {
+            auto const line = std::to_string(id) + " " + std::to_string(n) +
+                              " lorem ipsum dolor sit amet\n";
+            sink->log(hal::as_bytes(std::string_view(line)));
+          }
+        });
+      }
+      for (auto& producer : producers) {
+        producer.join();
+      }
+      sink->flush();
+
+      auto const stats = sink->get_statistics();
+      expect(that % stats.messages == thread_count * messages_per_thread);
+      expect(that % stats.dropped_messages == 0);
+      expect(that % stats.writes > 0);
+      expect(that % stats.writes < stats.messages);
+    }
+
+    // Verify
+    std::istringstream lines(output.finish());
+    std::array<int, thread_count> expected_next{};
+    int id = 0;
+    int n = 0;
+    std::string rest;
+    int line_count = 0;
+    bool ordered = true;
+    while (lines >> id >> n && std::getline(lines, rest)) {
+      ordered = ordered && id >= 0 && id < thread_count &&
+                expected_next[static_cast<std::size_t>(id)]++ == n &&
+                rest == " lorem ipsum dolor sit amet";
+      line_count++;
+    }
+    expect(ordered);
+    expect(that % line_count == thread_count * messages_per_thread);
+  };
+
+  "log_sink drop policy discards messages instead of waiting"_test = []() {
+    // Setup
+    constexpr int message_count = 100000;
+    captured_output output;
+    hal::u64 accepted_bytes = 0;
+
+    {
+      auto sink = log_sink::create(std::pmr::new_delete_resource(),
+                                   output.console(),
+                                   { .ring_size = 256 });
+      auto const message = hal::as_bytes("0123456789abcdef0123456789abcde\n"sv);
+
+      // Exercise
+      int accepted = 0;
+      for (int i = 0; i < message_count; i++) {
+        accepted += sink->log(message) ? 1 : 0;
+      }
+      sink->flush();
+
+      // Verify
+      auto const stats = sink->get_statistics();
+      expect(that % stats.dropped_messages > 0);
+      expect(that % stats.messages == static_cast<hal::u64>(accepted));
+      expect(that % stats.messages + stats.dropped_messages == message_count);
+      expect(that % sink->log(std::vector<hal::byte>(257)) == false);
+      accepted_bytes = stats.bytes;
+    }
+
+    expect(that % output.finish().size() == accepted_bytes);
+  };
+
+  "log_sink reuses the ring of an exited thread"_test = []() {
+    // Setup
+    captured_output output;
+
+    {
+      auto sink = log_sink::create(std::pmr::new_delete_resource(),
+                                   output.console(),
+                                   { .max_producers = 1 });
+
+      // Exercise
+      for (auto const text : { "first\n"sv, "second\n"sv }) {
+        std::thread([&sink, text]() {
+          sink->log(hal::as_bytes(text));
+        }).join();
+      }
+      sink->flush();
+
+      // Verify
+      expect(that % sink->get_statistics().messages == 2);
+    }
+
+    expect(that % output.finish() == "first\nsecond\n"sv);
+  };
+
+  "log_sink::create() rejects an empty ring"_test = []() {
+    captured_output output;
+    expect(throws<hal::argument_out_of_domain>([&output] {
+      static_cast<void>(log_sink::create(std::pmr::new_delete_resource(),
+                                         output.console(),
+                                         { .ring_size = 0 }));
+    }));
+  };
+};
+}  // namespace hal::mac
@@ -0,0 +1,134 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <memory_resource>
+
+#include <libhal-mac/precise_delay.hpp>
+#include <libhal-mac/simulated_clock.hpp>
+#include <libhal-mac/steady_clock.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::mac {
+boost::ut::suite<"test_precise_delay"> test_precise_delay = [] {
+  using namespace boost::ut;
+  using namespace std::chrono_literals;
+
+  "precise_delay::create()"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    auto clock = hal::mac::steady_clock::create(resource);
+
+    // Exercise
+    auto delay = hal::mac::precise_delay::create(resource, clock);
+
+    // Verify
+    expect(that % delay);
+    expect(that % delay->overshoot_estimate().count() > 0);
+  };
+
+  "precise_delay::delay() waits at least the duration"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    auto clock = hal::mac::steady_clock::create(resource);
+    auto delay = hal::mac::precise_delay::create(resource, clock);
+
+    for (hal::time_duration const duration : { 10us, 200us, 2000us }) {
+      // Exercise
+      auto const start = std::chrono::steady_clock::now();
+      delay->delay(duration);
+      auto const elapsed = std::chrono::steady_clock::now() - start;
+
+      // Verify
+      expect(that % elapsed >= duration);
+    }
+  };
+
+  "precise_delay::delay_until() in the past returns immediately"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    auto clock = hal::mac::steady_clock::create(resource);
+    auto delay = hal::mac::precise_delay::create(resource, clock);
+    auto const deadline = delay->clock().uptime();
+
+    // Exercise
+    auto const start = std::chrono::steady_clock::now();
+    delay->delay_until(deadline);
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+
+    // Verify
+    expect(that % elapsed < 1ms);
+  };
+
+  "precise_delay::configure(power_saving)"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    auto clock = hal::mac::steady_clock::create(resource);
+    auto delay = hal::mac::precise_delay::create(resource, clock);
+
+    // Exercise
+    delay->configure({ .mode = precise_delay::power_mode::power_saving });
+    auto const start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 10; i++) {
+      delay->delay(5ms);
+    }
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+
+    // Verify - power saving can end individual delays early, but never by more
+    // than the learned overshoot, so the total stays in the right ballpark.
+    expect(that % elapsed > 40ms);
+    expect(that % delay->overshoot_estimate().count() >= 0);
+  };
+
+  "precise_delay waits on simulated time"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    auto clock = hal::mac::simulated_clock::create(resource);
+    auto delay = hal::mac::precise_delay::create(resource, clock);
+    auto const start = std::chrono::steady_clock::now();
+
+    // Exercise
+    delay->delay(10s + 3ns);
+    delay->delay_until(delay->clock().uptime() + 250);
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+
+    // Verify
+    expect(that % clock->now().count() == (10s + 253ns).count());
+    expect(that % elapsed < 1s);
+  };
+
+  "precise_delay waits on a simulated clock passed as a steady_clock"_test =
+    []() {
+      // Setup
+      auto* resource = std::pmr::new_delete_resource();
+      auto clock = hal::mac::simulated_clock::create(resource);
+      hal::v5::strong_ptr<hal::steady_clock> steady = clock;
+      auto delay = hal::mac::precise_delay::create(
+        resource,
+        steady,
+        { .mode = hal::mac::precise_delay::power_mode::accuracy });
+      auto const start = std::chrono::steady_clock::now();
+
+      // Exercise
+      delay->delay(5s);
+      delay->delay_until(steady->uptime() + 7);
+      auto const elapsed = std::chrono::steady_clock::now() - start;
+
+      // Verify
+      expect(that % clock->now().count() == (5s + 7ns).count());
+      expect(that % elapsed < 1s);
+    };
+};
+}  // namespace hal::mac
@@ -0,0 +1,100 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fcntl.h>
+#include <limits>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+namespace hal::mac {
+/**
+ * @brief Pseudo terminal pair used to exercise serial ports without hardware
+ *
+ * The port under test opens the terminal side (path) while the test plays
+ * the device on the controller side. Destroying it closes the controller
+ * side, which hangs up the terminal.
+ */
+struct pseudo_terminal
+{
+  pseudo_terminal()
+  {
+    controller = ::posix_openpt(O_RDWR | O_NOCTTY);
+    if (controller == -1 || ::grantpt(controller) != 0 ||
+        ::unlockpt(controller) != 0) {
+      throw std::runtime_error("failed to open a pseudo terminal");
+    }
+    path = ::ptsname(controller);
+  }
+
+  ~pseudo_terminal()
+  {
+    if (terminal != -1) {
+      ::close(terminal);
+    }
+    ::close(controller);
+  }
+
+  pseudo_terminal(pseudo_terminal const&) = delete;
+  pseudo_terminal& operator=(pseudo_terminal const&) = delete;
+
+  /// Open the terminal side for code that takes a descriptor instead of a
+  /// path, it is closed with the pair
+  int open_terminal()
+  {
+    terminal = ::open(path.c_str(), O_RDWR | O_NOCTTY);
+    if (terminal == -1) {
+      throw std::runtime_error("failed to open the pseudo terminal");
+    }
+    return terminal;
+  }
+
+  /// Read until p_size bytes arrived or nothing arrives within the timeout
+  std::string read(std::size_t p_size, std::chrono::milliseconds p_timeout)
+  {
+    std::string result;
+    pollfd descriptor{ .fd = controller, .events = POLLIN, .revents = 0 };
+    while (result.size() < p_size &&
+           ::poll(&descriptor, 1, static_cast<int>(p_timeout.count())) > 0) {
+      std::array<char, 4096> buffer{};
+      auto const count = ::read(controller, buffer.data(), buffer.size());
+      if (count <= 0) {
+        break;
+      }
+      result.append(buffer.data(), static_cast<std::size_t>(count));
+    }
+    return result;
+  }
+
+  /// Read whatever arrives within the timeout
+  std::string read(std::chrono::milliseconds p_timeout)
+  {
+    return read(std::numeric_limits<std::size_t>::max(), p_timeout);
+  }
+
+  /// Device side
+  int controller = -1;
+  /// Terminal side, -1 unless open_terminal() was called
+  int terminal = -1;
+  /// Path of the terminal side
+  std::string path;
+};
+}  // namespace hal::mac
@@ -0,0 +1,61 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <poll.h>
+
+#include <libhal-mac/readiness_event.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::mac {
+namespace {
+/// Check if a descriptor becomes readable within the timeout
+bool readable(int p_fd, int p_timeout_ms)
+{
+  pollfd descriptor{ .fd = p_fd, .events = POLLIN, .revents = 0 };
+  return ::poll(&descriptor, 1, p_timeout_ms) == 1;
+}
+}  // namespace
+
+boost::ut::suite<"test_readiness_event"> test_readiness_event = [] {
+  using namespace boost::ut;
+
+  "readiness_event::signal() and acknowledge()"_test = []() {
+    // Setup
+    readiness_event event;
+
+    // Verify
+    expect(that % not readable(event.native_handle(), 0));
+
+    // Exercise
+    event.signal();
+    event.signal();
+
+    // Verify
+    expect(that % readable(event.native_handle(), 0));
+
+    // Exercise
+    event.acknowledge();
+
+    // Verify
+    expect(that % not readable(event.native_handle(), 0));
+
+    // Exercise
+    event.signal();
+
+    // Verify
+    expect(that % readable(event.native_handle(), 0));
+  };
+};
+}  // namespace hal::mac
@@ -0,0 +1,151 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <utility>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <libhal-mac/scheduled_thread.hpp>
+#include <libhal/error.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::mac {
+boost::ut::suite<"test_scheduled_thread"> test_scheduled_thread = [] {
+  using namespace boost::ut;
+
+  "scheduled_thread runs the function until joined"_test = []() {
+    // Setup
+    std::atomic<int> calls = 0;
+
+    // Exercise
+    scheduled_thread thread({}, [&calls]() { calls++; });
+    auto const joinable = thread.joinable();
+    thread.join();
+
+    // Verify
+    expect(joinable);
+    expect(not thread.joinable());
+    expect(that % calls.load() == 1);
+    expect(throws<hal::argument_out_of_domain>([&] { thread.join(); }));
+  };
+
+  "scheduled_thread names the thread"_test = []() {
+    // Setup
+    std::string name;
+
+    // Exercise
+    scheduled_thread thread({ .name = "libhal-mac-receive" }, [&name]() {
+      std::array<char, 64> buffer{};
+      ::pthread_getname_np(::pthread_self(), buffer.data(), buffer.size());
+      name = buffer.data();
+    });
+    thread.join();
+
+    // Verify
+    expect(that % name == std::string("libhal-mac-rece"));
+  };
+
+  "scheduled_thread applies the stack size and affinity"_test = []() {
+#if defined(__linux__)
+    // Setup
+    usize stack_size = 0;
+    bool only_cpu_0 = false;
+
+    // Exercise
+    scheduled_thread thread(
+      { .cpu_affinity = 0b1, .stack_size = 300'000 },
+      [&stack_size, &only_cpu_0]() {
+        pthread_attr_t attributes;
+        ::pthread_getattr_np(::pthread_self(), &attributes);
+        ::pthread_attr_getstacksize(&attributes, &stack_size);
+        ::pthread_attr_destroy(&attributes);
+
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        ::sched_getaffinity(0, sizeof(cpus), &cpus);
+        only_cpu_0 = CPU_COUNT(&cpus) == 1 && CPU_ISSET(0, &cpus);
+      });
+    thread.join();
+
+    // Verify
+    expect(stack_size >= 300'000);
+    expect(only_cpu_0);
+#endif
+  };
+
+  "scheduled_thread rejects invalid settings"_test = []() {
+    using policy = thread_settings::policy;
+    auto const nothing = []() {};
+
+    expect(throws<hal::argument_out_of_domain>(
+      [&] { scheduled_thread({ .priority = 10 }, nothing); }));
+    expect(throws<hal::argument_out_of_domain>([&] {
+      scheduled_thread({ .scheduling = policy::fifo, .priority = 1000 },
+                       nothing);
+    }));
+    expect(throws<hal::argument_out_of_domain>(
+      [&] { scheduled_thread({ .stack_size = 16 }, nothing); }));
+#if defined(__linux__)
+    expect(throws<hal::argument_out_of_domain>(
+      [&] { scheduled_thread({ .cpu_affinity = 1ULL << 63 }, nothing); }));
+#endif
+  };
+
+  "scheduled_thread uses a real-time policy or reports why not"_test = []() {
+    // Setup
+    int policy = -1;
+    auto const record_policy = [&policy]() {
+      sched_param parameters{};
+      ::pthread_getschedparam(::pthread_self(), &policy, &parameters);
+    };
+
+    // Exercise
+    try {
+      scheduled_thread thread(
+        { .scheduling = thread_settings::policy::fifo, .priority = 10 },
+        record_policy);
+      thread.join();
+    } catch (hal::operation_not_permitted const&) {
+      // Unprivileged processes may not use real-time scheduling
+      policy = SCHED_FIFO;
+    }
+
+    // Verify
+    expect(that % policy == SCHED_FIFO);
+  };
+
+  "scheduled_thread can be moved"_test = []() {
+    // Setup
+    std::atomic<bool> ran = false;
+    scheduled_thread first({}, [&ran]() { ran = true; });
+
+    // Exercise
+    scheduled_thread second(std::move(first));
+    scheduled_thread third;
+    third = std::move(second);
+    third.join();
+
+    // Verify
+    expect(not first.joinable());
+    expect(not second.joinable());
+    expect(not third.joinable());
+    expect(ran.load());
+  };
+};
+}  // namespace hal::mac
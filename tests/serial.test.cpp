@@ -12,15 +12,59 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <memory>
 #include <memory_resource>
+#include <mutex>
+#include <poll.h>
 #include <print>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
+#include <libhal-mac/precise_delay.hpp>
 #include <libhal-mac/serial.hpp>
+#include <libhal-mac/steady_clock.hpp>
 #include <libhal-util/as_bytes.hpp>
 
 #include <boost/ut.hpp>
 
+#include "pseudo_terminal.hpp"
+
 namespace hal::mac {
+namespace {
+/// CPU time consumed by all threads of this process
+std::chrono::microseconds process_cpu_time()
+{
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+  auto const to_us = [](timeval const& p_time) {
+    return std::chrono::seconds(p_time.tv_sec) +
+           std::chrono::microseconds(p_time.tv_usec);
+  };
+  return to_us(usage.ru_utime) + to_us(usage.ru_stime);
+}
+
+/// Wait until the receive cursor reaches the expected value
+bool wait_for_cursor(hal::v5::serial& p_serial, usize p_cursor)
+{
+  using namespace std::chrono_literals;
+  auto const deadline = std::chrono::steady_clock::now() + 2s;
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (p_serial.receive_cursor() == p_cursor) {
+      return true;
+    }
+    std::this_thread::sleep_for(1ms);
+  }
+  return false;
+}
+}  // namespace
+
 boost::ut::suite<"test_mac_serial"> test_mac_serial = [] {
   using namespace boost::ut;
   using namespace std::literals;
@@ -40,5 +84,547 @@ boost::ut::suite<"test_mac_serial"> test_mac_serial = [] {
     }
     // Exercise
   };
+
+  "serial::write() over pty"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+
+    // Exercise
+    serial->write(hal::as_bytes("Hello, pty!"sv));
+
+    // Verify
+    expect(that % terminal.read(100ms) == "Hello, pty!"sv);
+  };
+
+  "serial::receive_buffer() over pty"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+    constexpr auto message = "0123456789"sv;
+
+    // Exercise
+    auto const written =
+      ::write(terminal.controller, message.data(), message.size());
+    expect(that % written == static_cast<ssize_t>(message.size()));
+
+    // Verify
+    expect(wait_for_cursor(*serial, message.size()));
+    auto const buffer = serial->receive_buffer();
+    expect(that % std::string_view(reinterpret_cast<char const*>(buffer.data()),
+                                   message.size()) == message);
+  };
+
+  "serial busy polls on a named receive thread"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(),
+      terminal.path,
+      64,
+      {},
+      hal::mac::flow_control::none,
+      { .thread = { .name = "busy-receive" }, .busy_poll = true });
+    std::mutex mutex;
+    std::string thread_name;
+    serial->on_receive(
+      [&](std::span<hal::byte const>, std::span<hal::byte const>) {
+        std::array<char, 16> name{};
+        ::pthread_getname_np(::pthread_self(), name.data(), name.size());
+        std::lock_guard lock(mutex);
+        thread_name = name.data();
+      });
+    constexpr auto message = "spin"sv;
+
+    // Exercise
+    auto const written =
+      ::write(terminal.controller, message.data(), message.size());
+    expect(that % written == static_cast<ssize_t>(message.size()));
+    serial->write(hal::as_bytes("back"sv));
+
+    // Verify
+    expect(wait_for_cursor(*serial, message.size()));
+    expect(that % terminal.read(100ms) == "back"sv);
+    auto const deadline = std::chrono::steady_clock::now() + 1s;
+    std::unique_lock lock(mutex);
+    while (thread_name.empty() && std::chrono::steady_clock::now() < deadline) {
+      lock.unlock();
+      std::this_thread::sleep_for(1ms);
+      lock.lock();
+    }
+    expect(that % thread_name == std::string("busy-receive"));
+  };
+
+  "serial::write() respects XON/XOFF"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(std::pmr::new_delete_resource(),
+                                           terminal.path,
+                                           64,
+                                           {},
+                                           hal::mac::flow_control::software);
+    expect(that % serial->get_flow_control() ==
+           hal::mac::flow_control::software);
+    constexpr char xoff = 0x13;
+    constexpr char xon = 0x11;
+
+    // Exercise - the device pauses the host
+    expect(that % ::write(terminal.controller, &xoff, 1) == 1);
+    std::this_thread::sleep_for(20ms);
+    std::atomic<bool> written = false;
+    std::thread writer([&serial, &written]() {
+      serial->write(hal::as_bytes("paused"sv));
+      written = true;
+    });
+
+    // Verify
+    expect(that % terminal.read(100ms) == ""sv);
+    expect(that % not written.load());
+    expect(that % serial->write_some(hal::as_bytes("x"sv)) == 0);
+
+    // Exercise - the device resumes the host
+    expect(that % ::write(terminal.controller, &xon, 1) == 1);
+    writer.join();
+
+    // Verify - flow control characters never reach the receive buffer
+    expect(that % terminal.read(100ms) == "paused"sv);
+    expect(that % written.load());
+    expect(that % serial->receive_cursor() == 0);
+  };
+
+  "serial::set_flow_control(none) stops honoring XOFF"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(std::pmr::new_delete_resource(),
+                                           terminal.path,
+                                           64,
+                                           {},
+                                           hal::mac::flow_control::software);
+
+    // Exercise
+    serial->set_flow_control(hal::mac::flow_control::none);
+    constexpr char xoff = 0x13;
+    expect(that % ::write(terminal.controller, &xoff, 1) == 1);
+    expect(wait_for_cursor(*serial, 1));
+    serial->write(hal::as_bytes("free"sv));
+
+    // Verify
+    expect(that % serial->get_flow_control() == hal::mac::flow_control::none);
+    expect(that % terminal.read(100ms) == "free"sv);
+  };
+
+  "serial::configure() and set_flow_control() from two threads"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+
+    // Exercise - each call applies the other's latest setting as well
+    std::thread flow([&serial] {
+      for (int i = 0; i < 200; i++) {
+        serial->set_flow_control(i % 2 == 0 ? hal::mac::flow_control::software
+                                            : hal::mac::flow_control::none);
+      }
+    });
+    for (int i = 0; i < 200; i++) {
+      serial->configure({ .baud_rate = i % 2 == 0 ? 9600U : 115200U });
+    }
+    flow.join();
+
+    // Verify
+    expect(that % serial->get_settings().baud_rate == 115200U);
+    expect(that % serial->get_flow_control() == hal::mac::flow_control::none);
+  };
+
+  "serial::write() gathers buffers"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+    std::array<std::span<hal::byte const>, 4> const frame = {
+      hal::as_bytes("[header]"sv),
+      std::span<hal::byte const>{},
+      hal::as_bytes("payload"sv),
+      hal::as_bytes("[crc]"sv),
+    };
+    auto const calls_before = serial->get_statistics().write_calls;
+
+    // Exercise
+    serial->write(frame);
+
+    // Verify
+    expect(that % terminal.read(100ms) == "[header]payload[crc]"sv);
+    auto const stats = serial->get_statistics();
+    expect(that % stats.write_calls - calls_before == 1);
+    expect(that % stats.bytes_transmitted == 20);
+  };
+
+  "serial::write() resumes partial gathered writes"_test = []() {
+    // Setup - more data than the pty buffers, so writev() must come up short
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+    std::vector<hal::byte> first(50'000, hal::byte{ 'a' });
+    std::vector<hal::byte> second(50'000, hal::byte{ 'b' });
+    std::array<std::span<hal::byte const>, 2> const buffers = { first,
+                                                                second };
+    std::string received;
+    std::thread reader([&terminal, &received]() {
+      while (received.size() < 100'000) {
+        auto const chunk = terminal.read(500ms);
+        if (chunk.empty()) {
+          break;
+        }
+        received += chunk;
+      }
+    });
+
+    // Exercise
+    serial->write(buffers);
+    reader.join();
+
+    // Verify
+    expect(that % received.size() == 100'000);
+    expect(that % received == std::string(50'000, 'a') +
+                                std::string(50'000, 'b'));
+  };
+
+  "serial::set_dtr() updates cached state"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+
+    try {
+      // Exercise
+      serial->set_control_signals(true, false);
+
+      // Verify
+      expect(that % serial->get_dtr());
+      expect(that % not serial->get_rts());
+
+      // Exercise
+      serial->set_dtr(false);
+      serial->set_rts(true);
+
+      // Verify
+      expect(that % not serial->get_dtr());
+      expect(that % serial->get_rts());
+    } catch (hal::operation_not_permitted const&) {
+      // Some pseudo terminal implementations do not have modem lines at all.
+      std::println("Pseudo terminal lacks modem lines, skipping...");
+    }
+  };
+
+  "serial::run_control_sequence()"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(resource, terminal.path, 64);
+    auto clock = hal::mac::steady_clock::create(resource);
+    auto delay = hal::mac::precise_delay::create(resource, clock);
+    std::array<hal::mac::serial::control_step, 3> const steps = { {
+      { .dtr = true, .rts = true, .hold = 2ms },
+      { .dtr = true, .rts = false, .hold = 2ms },
+      { .dtr = false, .rts = false, .hold = 2ms },
+    } };
+    std::array<hal::u64, 3> timestamps{};
+    std::array<hal::u64, 2> short_timestamps{};
+
+    // Exercise & Verify
+    expect(throws<hal::argument_out_of_domain>([&] {
+      serial->run_control_sequence(*delay, steps, short_timestamps);
+    }));
+
+    try {
+      // Exercise
+      serial->run_control_sequence(*delay, steps, timestamps);
+
+      // Verify
+      auto const ticks_per_ms = clock->frequency() / 1000.0f;
+      for (usize i = 1; i < timestamps.size(); i++) {
+        auto const delta_ms =
+          static_cast<float>(timestamps[i] - timestamps[i - 1]) / ticks_per_ms;
+        expect(that % delta_ms > 1.9f);
+      }
+      expect(that % not serial->get_dtr());
+      expect(that % not serial->get_rts());
+    } catch (hal::operation_not_permitted const&) {
+      std::println("Pseudo terminal lacks modem lines, skipping...");
+    }
+  };
+
+  "serial detects hangup"_test = []() {
+    // Setup
+    auto terminal = std::make_unique<pseudo_terminal>();
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal->path, 64);
+    std::atomic<int> disconnects = 0;
+    serial->on_connection_change([&disconnects](connection_state p_state) {
+      if (p_state == connection_state::disconnected) {
+        disconnects++;
+      }
+    });
+    expect(that % serial->get_connection_state() ==
+           connection_state::connected);
+
+    // Exercise - closing the controller side hangs up the terminal
+    terminal.reset();
+    auto const deadline = std::chrono::steady_clock::now() + 2s;
+    while (disconnects == 0 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(1ms);
+    }
+
+    // Verify
+    expect(that % disconnects.load() == 1);
+    expect(that % serial->get_connection_state() ==
+           connection_state::disconnected);
+    expect(throws<hal::io_error>(
+      [&serial] { serial->write(hal::as_bytes("lost"sv)); }));
+
+    // Verify - waiting for the device must not spin on the dead descriptor
+    auto const cpu_before = process_cpu_time();
+    std::this_thread::sleep_for(200ms);
+    expect(that % (process_cpu_time() - cpu_before) < 50ms);
+  };
+
+  "serial::on_receive() delivers each chunk"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 8);
+    std::mutex mutex;
+    std::string received;
+    std::atomic<int> calls = 0;
+    serial->on_receive([&](std::span<hal::byte const> p_first,
+                           std::span<hal::byte const> p_second) {
+      std::lock_guard lock(mutex);
+      for (auto const part : { p_first, p_second }) {
+        received.append(reinterpret_cast<char const*>(part.data()),
+                        part.size());
+      }
+      calls++;
+    });
+
+    // Exercise - 6 + 5 bytes wrap around the 8 byte receive buffer
+    expect(that % ::write(terminal.controller, "abcdef", 6) == 6);
+    std::this_thread::sleep_for(20ms);
+    expect(that % ::write(terminal.controller, "ghijk", 5) == 5);
+    auto const deadline = std::chrono::steady_clock::now() + 1s;
+    while (calls < 2 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(1ms);
+    }
+
+    // Verify
+    std::lock_guard lock(mutex);
+    expect(that % received == std::string("abcdefghijk"));
+  };
+
+  "serial::on_receive() delivers a write the size of the buffer"_test =
+    []() {
+      // Setup
+      pseudo_terminal terminal;
+      auto serial = hal::mac::serial::create(
+        std::pmr::new_delete_resource(), terminal.path, 64);
+      std::mutex mutex;
+      std::string received;
+      serial->on_receive([&](std::span<hal::byte const> p_first,
+                             std::span<hal::byte const> p_second) {
+        std::lock_guard lock(mutex);
+        for (auto const part : { p_first, p_second }) {
+          received.append(reinterpret_cast<char const*>(part.data()),
+                          part.size());
+        }
+      });
+      std::string const data(
+        "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+/");
+
+      // Exercise
+      expect(that % ::write(terminal.controller, data.data(), data.size()) ==
+             64);
+      std::this_thread::sleep_for(200ms);
+
+      // Verify
+      std::lock_guard lock(mutex);
+      expect(that % received == data);
+    };
+
+  "serial::on_receive() does not overwrite a coalesced burst"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+    std::mutex mutex;
+    std::string received;
+    serial->on_receive(
+      [&](std::span<hal::byte const> p_first,
+          std::span<hal::byte const> p_second) {
+        std::lock_guard lock(mutex);
+        for (auto const part : { p_first, p_second }) {
+          received.append(reinterpret_cast<char const*>(part.data()),
+                          part.size());
+        }
+      },
+      100ms);
+    std::string const data(
+      "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+/");
+
+    // Exercise - the first 20 bytes are held back by the window, the next 60
+    // bytes would overwrite them
+    expect(that % ::write(terminal.controller, data.data(), 20) == 20);
+    std::this_thread::sleep_for(10ms);
+    expect(that % ::write(terminal.controller, data.data() + 4, 60) == 60);
+    std::this_thread::sleep_for(300ms);
+
+    // Verify
+    std::lock_guard lock(mutex);
+    expect(that % received == data.substr(0, 20) + data.substr(4));
+  };
+
+  "serial::on_receive() coalesces bursts"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+    std::atomic<int> calls = 0;
+    std::atomic<usize> bytes = 0;
+    serial->on_receive(
+      [&](std::span<hal::byte const> p_first,
+          std::span<hal::byte const> p_second) {
+        bytes += p_first.size() + p_second.size();
+        calls++;
+      },
+      100ms);
+
+    // Exercise
+    expect(that % ::write(terminal.controller, "a", 1) == 1);
+    std::this_thread::sleep_for(10ms);
+    expect(that % ::write(terminal.controller, "b", 1) == 1);
+    std::this_thread::sleep_for(10ms);
+    auto const calls_within_window = calls.load();
+    std::this_thread::sleep_for(200ms);
+
+    // Verify
+    expect(that % calls_within_window == 0);
+    expect(that % calls.load() == 1);
+    expect(that % bytes.load() == 2);
+  };
+
+  "serial::readiness_handle() signals received data"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+    pollfd descriptor{
+      .fd = serial->readiness_handle(), .events = POLLIN, .revents = 0
+    };
+    expect(that % ::poll(&descriptor, 1, 20) == 0);
+
+    // Exercise
+    expect(that % ::write(terminal.controller, "data", 4) == 4);
+
+    // Verify
+    expect(that % ::poll(&descriptor, 1, 1000) == 1);
+    serial->acknowledge_readiness();
+    expect(that % serial->receive_cursor() == 4);
+    expect(that % ::poll(&descriptor, 1, 20) == 0);
+  };
+
+  "serial::enable_rs485() toggles RTS around writes"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(resource, terminal.path, 64);
+    auto clock = hal::mac::steady_clock::create(resource);
+    auto delay = hal::mac::precise_delay::create(resource, clock);
+
+    try {
+      // Exercise
+      serial->enable_rs485({ .delay_after_send = 1ms }, delay);
+      expect(that % not serial->get_rts());
+      serial->write(hal::as_bytes("request"sv));
+
+      // Verify
+      expect(that % terminal.read(100ms) == "request"sv);
+      if (not serial->rs485_in_kernel()) {
+        auto const stats = serial->get_statistics();
+        expect(that % stats.rs485_transactions == 1);
+        expect(that % stats.rs485_turnaround_max_ns >= 1'000'000);
+        expect(that % stats.rs485_turnaround_total_ns ==
+               stats.rs485_turnaround_max_ns);
+        expect(that % not serial->get_rts());
+      }
+
+      // Exercise
+      serial->disable_rs485();
+      serial->write(hal::as_bytes("plain"sv));
+
+      // Verify
+      expect(that % terminal.read(100ms) == "plain"sv);
+      expect(that % serial->get_statistics().rs485_transactions <= 1);
+    } catch (hal::operation_not_permitted const&) {
+      std::println("Pseudo terminal lacks modem lines, skipping...");
+    }
+  };
+
+  "acquire_input_pin(modem_in)"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(resource, terminal.path, 64);
+
+    // Exercise
+    auto cts =
+      hal::acquire_input_pin(resource, serial, hal::mac::modem_in::cts);
+
+    // Verify
+    expect(that % cts);
+    try {
+      auto const expected = serial->get_control_signals().cts;
+      expect(that % cts->level() == expected);
+    } catch (hal::operation_not_permitted const&) {
+      std::println("Pseudo terminal lacks modem lines, skipping...");
+    }
+  };
+
+  "acquire_interrupt_pin(modem_in) starts and stops watcher"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    pseudo_terminal terminal;
+    auto serial = hal::mac::serial::create(resource, terminal.path, 64);
+    auto dsr =
+      hal::acquire_interrupt_pin(resource, serial, hal::mac::modem_in::dsr);
+    int edges = 0;
+
+    // Exercise
+    dsr->configure({ .trigger = hal::interrupt_pin::trigger_edge::both });
+    dsr->on_trigger([&edges](bool) { edges++; });
+    std::this_thread::sleep_for(10ms);
+
+    // Verify - no line changes on a pty, and destroying the pin and port
+    // afterwards must not hang on the watcher thread.
+    expect(that % edges == 0);
+  };
+
+  "serial modem watcher stops whatever the SIGURG disposition"_test = []() {
+    // Setup - an application that ignores SIGURG, which once left the
+    // destructor waiting for a wakeup signal that never arrived.
+    auto const previous = std::signal(SIGURG, SIG_IGN);
+    {
+      pseudo_terminal terminal;
+      auto serial = hal::mac::serial::create(
+        std::pmr::new_delete_resource(), terminal.path, 64);
+      serial->on_modem_edge(hal::mac::modem_in::cts,
+                            [](hal::mac::modem_edge const&) {});
+      std::this_thread::sleep_for(10ms);
+
+      // Exercise - destroying the port joins the watcher
+    }
+
+    // Verify - reaching this point means the watcher stopped
+    expect(that % std::signal(SIGURG, previous) == SIG_IGN);
+  };
 };
 }  // namespace hal::mac
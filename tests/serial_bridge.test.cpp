@@ -0,0 +1,215 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <chrono>
+#include <memory_resource>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+#include <libhal-mac/serial.hpp>
+#include <libhal-mac/serial_bridge.hpp>
+
+#include <boost/ut.hpp>
+
+#include "pseudo_terminal.hpp"
+
+namespace hal::mac {
+namespace {
+/// Pseudo terminal standing in for the device and a socket pair standing in
+/// for the tool that wants to reach it. Closed after the bridge and port.
+struct bridge_endpoints
+{
+  bridge_endpoints()
+  {
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets.data());
+  }
+
+  ~bridge_endpoints()
+  {
+    ::close(sockets[0]);
+    ::close(sockets[1]);
+  }
+
+  /// The test plays the device on its controller side
+  pseudo_terminal terminal;
+  /// sockets[0] is bridged, the test plays the tool on sockets[1]
+  std::array<int, 2> sockets{ -1, -1 };
+};
+
+/// Read whatever arrives within the timeout
+std::string read_some(int p_fd, std::chrono::milliseconds p_timeout)
+{
+  std::string result;
+  pollfd descriptor{ .fd = p_fd, .events = POLLIN, .revents = 0 };
+  while (::poll(&descriptor, 1, static_cast<int>(p_timeout.count())) > 0) {
+    std::array<char, 256> buffer{};
+    auto const count = ::read(p_fd, buffer.data(), buffer.size());
+    if (count <= 0) {
+      break;
+    }
+    result.append(buffer.data(), static_cast<std::size_t>(count));
+  }
+  return result;
+}
+
+/// Open the tool's side of a pty peer in raw mode, as a terminal program
+/// would
+int open_tool(pseudo_terminal& p_tool)
+{
+  auto const fd = p_tool.open_terminal();
+  termios attributes{};
+  ::tcgetattr(fd, &attributes);
+  ::cfmakeraw(&attributes);
+  ::tcsetattr(fd, TCSANOW, &attributes);
+  return fd;
+}
+
+/// Wait until the bridge reports the expected peer state or a second passed
+bool wait_for_peer(serial_bridge const& p_bridge, bool p_connected)
+{
+  auto const deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (p_bridge.peer_connected() != p_connected) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+}  // namespace
+
+boost::ut::suite<"test_serial_bridge"> test_serial_bridge = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "serial_bridge forwards in both directions"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    bridge_endpoints endpoints;
+    auto serial = serial::create(resource, endpoints.terminal.path, 64);
+    auto bridge = serial_bridge::create(resource, serial, endpoints.sockets[0]);
+
+    // Exercise
+    expect(that % ::write(endpoints.terminal.controller, "from device", 11) ==
+           11);
+    auto const at_tool = read_some(endpoints.sockets[1], 100ms);
+    expect(that % ::write(endpoints.sockets[1], "from tool", 9) == 9);
+    auto const at_device = endpoints.terminal.read(100ms);
+
+    // Verify
+    expect(that % at_tool == "from device"sv);
+    expect(that % at_device == "from tool"sv);
+    expect(that % serial->receive_cursor() == 0);
+    expect(that % bridge->peer_connected());
+    auto const stats = bridge->get_statistics();
+    expect(that % stats.bytes_to_peer == 11);
+    expect(that % stats.bytes_to_device == 9);
+    expect(that % stats.zero_copy_transfers + stats.buffered_transfers >= 2);
+  };
+
+  "serial_bridge tees received data into the receive buffer"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    bridge_endpoints endpoints;
+    auto serial = serial::create(resource, endpoints.terminal.path, 8);
+    auto bridge = serial_bridge::create(
+      resource, serial, endpoints.sockets[0], { .tee = true });
+
+    // Exercise - 11 bytes wrap around the 8 byte receive buffer
+    expect(that % ::write(endpoints.terminal.controller, "0123456789A", 11) ==
+           11);
+    auto const at_tool = read_some(endpoints.sockets[1], 100ms);
+
+    // Verify
+    expect(that % at_tool == "0123456789A"sv);
+    expect(that % serial->receive_cursor() == 3);
+    auto const buffer = serial->receive_buffer();
+    expect(that % std::string_view(
+                    reinterpret_cast<char const*>(buffer.data()), 3) ==
+           "89A"sv);
+    expect(that % serial->get_statistics().bytes_received == 11);
+  };
+
+  "serial_bridge restores normal reception when destroyed"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    bridge_endpoints endpoints;
+    auto serial = serial::create(resource, endpoints.terminal.path, 64);
+    {
+      auto bridge =
+        serial_bridge::create(resource, serial, endpoints.sockets[0]);
+
+      // Exercise & Verify - only one bridge per port
+      expect(throws<hal::operation_not_permitted>([&]() {
+        auto second =
+          serial_bridge::create(resource, serial, endpoints.sockets[0]);
+      }));
+
+      // Exercise - the tool goes away
+      ::shutdown(endpoints.sockets[1], SHUT_RDWR);
+      auto const deadline = std::chrono::steady_clock::now() + 1s;
+      while (bridge->peer_connected() &&
+             std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+      }
+
+      // Verify
+      expect(that % not bridge->peer_connected());
+    }
+
+    // Exercise
+    expect(that % ::write(endpoints.terminal.controller, "local", 5) == 5);
+    auto const deadline = std::chrono::steady_clock::now() + 1s;
+    while (serial->receive_cursor() != 5 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(1ms);
+    }
+
+    // Verify
+    expect(that % serial->receive_cursor() == 5);
+  };
+
+  "serial_bridge resumes when a tool reopens a pty peer"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    pseudo_terminal device;
+    pseudo_terminal tool;
+    auto serial = serial::create(resource, device.path, 64);
+    auto bridge = serial_bridge::create(resource, serial, tool.controller);
+    open_tool(tool);
+
+    // Exercise - the tool closes the pty and a new one opens it
+    ::close(tool.terminal);
+    tool.terminal = -1;
+    expect(that % wait_for_peer(*bridge, false));
+    auto const fd = open_tool(tool);
+    expect(that % wait_for_peer(*bridge, true));
+    expect(that % ::write(device.controller, "device", 6) == 6);
+    auto const at_tool = read_some(fd, 100ms);
+    expect(that % ::write(fd, "tool", 4) == 4);
+    auto const at_device = device.read(4, 500ms);
+
+    // Verify
+    expect(that % at_tool == "device"sv);
+    expect(that % at_device == "tool"sv);
+  };
+};
+}  // namespace hal::mac
@@ -0,0 +1,215 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+
+#include <libhal-mac/serial.hpp>
+#include <libhal-mac/serial_broker.hpp>
+#include <libhal-util/as_bytes.hpp>
+#include <libhal/error.hpp>
+
+#include <boost/ut.hpp>
+
+#include "pseudo_terminal.hpp"
+
+namespace hal::mac {
+namespace {
+/// Shared memory name unique to this test process
+std::string broker_name()
+{
+  return "/libhal-mac-test-" + std::to_string(::getpid());
+}
+
+bool wait_for_sequence(shared_serial& p_view, hal::u64 p_sequence)
+{
+  auto const deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (p_view.receive_sequence() < p_sequence) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+}  // namespace
+
+boost::ut::suite<"test_serial_broker"> test_serial_broker = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "serial_broker publishes received data to every view"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto port = serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+    auto broker = serial_broker::create(
+      std::pmr::new_delete_resource(), port, broker_name());
+    auto first = shared_serial::create(std::pmr::new_delete_resource(),
+                                       broker->name());
+    auto second = shared_serial::create(std::pmr::new_delete_resource(),
+                                        broker->name());
+
+    // Exercise
+    [[maybe_unused]] auto const written =
+      ::write(terminal.controller, "hello", 5);
+
+    // Verify
+    for (auto* view : { &*first, &*second }) {
+      expect(wait_for_sequence(*view, 5));
+      expect(that % view->receive_cursor() == 5);
+      auto const data = view->receive_buffer().first(5);
+      expect(std::string(data.begin(), data.end()) == "hello"sv);
+      expect(view->broker_connected());
+    }
+    expect(that % broker->get_statistics().bytes_published == 5);
+  };
+
+  "serial_broker publishes a chunk larger than the port buffer"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto port = serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 16);
+    auto broker = serial_broker::create(
+      std::pmr::new_delete_resource(), port, broker_name());
+    auto view = shared_serial::create(std::pmr::new_delete_resource(),
+                                      broker->name());
+    std::string const sent = "0123456789abcdefghijklmnopqrstuvwxyzABCD";
+
+    // Exercise - published in pieces of at most 15 bytes
+    port->publish_received(hal::as_bytes(sent));
+
+    // Verify
+    expect(that % view->receive_sequence() == sent.size());
+    auto const data = view->receive_buffer().first(sent.size());
+    expect(that % std::string(data.begin(), data.end()) == sent);
+  };
+
+  "serial_broker wraps the shared ring"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto port = serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 256);
+    auto broker = serial_broker::create(std::pmr::new_delete_resource(),
+                                        port,
+                                        broker_name(),
+                                        { .receive_ring_size = 100 });
+    auto view = shared_serial::create(std::pmr::new_delete_resource(),
+                                      broker->name());
+    std::string sent;
+    for (int i = 0; i < 50; i++) {
+      sent += "line " + std::to_string(i) + "\n";
+    }
+
+    // Exercise
+    for (char const c : sent) {
+      [[maybe_unused]] auto const written =
+        ::write(terminal.controller, &c, 1);
+    }
+
+    // Verify
+    expect(wait_for_sequence(*view, sent.size()));
+    expect(that % view->receive_buffer().size() == 100);
+    expect(that % view->receive_cursor() == sent.size() % 100);
+    std::string tail;
+    auto const buffer = view->receive_buffer();
+    for (std::size_t i = 0; i < 20; i++) {
+      tail += static_cast<char>(
+        buffer[(sent.size() - 20 + i) % buffer.size()]);
+    }
+    expect(tail == sent.substr(sent.size() - 20));
+  };
+
+  "shared_serial writes go through the broker in order"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto port = serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+    auto broker = serial_broker::create(std::pmr::new_delete_resource(),
+                                        port,
+                                        broker_name(),
+                                        { .transmit_queue_size = 256 });
+    auto first = shared_serial::create(std::pmr::new_delete_resource(),
+                                       broker->name());
+    auto second = shared_serial::create(std::pmr::new_delete_resource(),
+                                        broker->name());
+    std::string large;
+    for (int i = 0; large.size() < 20000; i++) {
+      large += std::to_string(i) + ",";
+    }
+
+    // Exercise
+    first->write(hal::as_bytes("abc"sv));
+    second->write(hal::as_bytes("def"sv));
+    std::thread writer(
+      [&first, &large]() { first->write(hal::as_bytes(large)); });
+    auto const received = terminal.read(6 + large.size(), 500ms);
+    writer.join();
+
+    // Verify
+    expect(received == "abcdef" + large);
+    // Counters are updated after the port accepted the data
+    auto const deadline = std::chrono::steady_clock::now() + 1s;
+    while (broker->get_statistics().bytes_transmitted < received.size() &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(1ms);
+    }
+    auto const stats = broker->get_statistics();
+    expect(that % stats.bytes_transmitted == 6 + large.size());
+    expect(that % stats.transmit_records > 2);
+    expect(that % stats.transmit_errors == 0);
+  };
+
+  "shared_serial after the broker is gone"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto port = serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 64);
+    auto const name = broker_name();
+
+    expect(throws<hal::no_such_device>([&name] {
+      static_cast<void>(
+        shared_serial::create(std::pmr::new_delete_resource(), name));
+    }));
+
+    auto broker =
+      serial_broker::create(std::pmr::new_delete_resource(), port, name);
+    expect(throws<hal::device_or_resource_busy>([&port, &name] {
+      static_cast<void>(
+        serial_broker::create(std::pmr::new_delete_resource(), port, name));
+    }));
+
+    {
+      auto view = shared_serial::create(std::pmr::new_delete_resource(), name);
+      expect(throws<hal::operation_not_supported>(
+        [&view] { view->configure({}); }));
+
+      // Exercise
+      broker = serial_broker::create(std::pmr::new_delete_resource(),
+                                     port,
+                                     name + "-other");
+
+      // Verify
+      expect(not view->broker_connected());
+      expect(throws<hal::io_error>(
+        [&view] { view->write(hal::as_bytes("late"sv)); }));
+    }
+  };
+};
+}  // namespace hal::mac
@@ -0,0 +1,242 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <libhal-mac/serial_mux.hpp>
+#include <libhal-util/as_bytes.hpp>
+#include <libhal/error.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::mac {
+namespace {
+/**
+ * @brief Serial port whose writes arrive in its own receive buffer
+ */
+class loopback_serial : public hal::v5::serial
+{
+public:
+  explicit loopback_serial(hal::v5::strong_ptr_only_token)
+  {
+  }
+
+  /// Add data to the receive buffer as if it arrived on the wire
+  void inject(std::span<hal::byte const> p_data)
+  {
+    std::lock_guard lock(m_mutex);
+    for (auto const byte : p_data) {
+      m_buffer[m_cursor] = byte;
+      m_cursor = (m_cursor + 1) % m_buffer.size();
+    }
+  }
+
+  /// Block the first write until release() is called
+  void hold_first_write()
+  {
+    std::lock_guard lock(m_mutex);
+    m_hold = true;
+  }
+
+  void release()
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      m_hold = false;
+    }
+    m_released.notify_all();
+  }
+
+  /// Channel id of every frame written so far
+  std::vector<hal::u8> frame_channels()
+  {
+    std::lock_guard lock(m_mutex);
+    return m_frame_channels;
+  }
+
+private:
+  void driver_configure(hal::v5::serial::settings const&) override
+  {
+  }
+
+  void driver_write(std::span<hal::byte const> p_data) override
+  {
+    {
+      std::unique_lock lock(m_mutex);
+      m_released.wait(lock, [this]() { return not m_hold; });
+      m_frame_channels.push_back(p_data[1]);
+    }
+    inject(p_data);
+  }
+
+  std::span<hal::byte const> driver_receive_buffer() override
+  {
+    return m_buffer;
+  }
+
+  usize driver_cursor() override
+  {
+    std::lock_guard lock(m_mutex);
+    return m_cursor;
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_released;
+  std::array<hal::byte, 4096> m_buffer{};
+  usize m_cursor = 0;
+  bool m_hold = false;
+  std::vector<hal::u8> m_frame_channels;
+};
+
+/// Received data of a channel, assuming its buffer did not wrap
+std::string received(mux_channel& p_channel)
+{
+  auto const data =
+    p_channel.receive_buffer().first(p_channel.receive_cursor());
+  return { data.begin(), data.end() };
+}
+}  // namespace
+
+boost::ut::suite<"test_serial_mux"> test_serial_mux = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "serial_mux routes each channel's frames to that channel"_test = []() {
+    // Setup
+    auto link = hal::v5::make_strong_ptr<loopback_serial>(
+      std::pmr::new_delete_resource());
+    auto mux = serial_mux::create(
+      std::pmr::new_delete_resource(), link, { .max_payload = 16 });
+    auto console = mux_channel::create(std::pmr::new_delete_resource(), mux, 0);
+    auto telemetry =
+      mux_channel::create(std::pmr::new_delete_resource(), mux, 7);
+    std::string samples;
+    for (int i = 0; i < 20; i++) {
+      samples += std::to_string(i) + ";";
+    }
+
+    // Exercise
+    console->write(hal::as_bytes("help\n"sv));
+    telemetry->write(hal::as_bytes(samples));
+    console->write(hal::as_bytes("status\n"sv));
+
+    // Verify
+    expect(received(*console) == "help\nstatus\n"sv);
+    expect(received(*telemetry) == samples);
+    auto const stats = telemetry->get_statistics();
+    expect(that % stats.frames_sent == (samples.size() + 15) / 16);
+    expect(that % stats.bytes_sent == samples.size());
+    expect(that % stats.frames_received == stats.frames_sent);
+    expect(that % stats.bytes_received == samples.size());
+    expect(that % console->get_statistics().frames_received == 2);
+    expect(that % mux->get_statistics().header_errors == 0);
+  };
+
+  "serial_mux resynchronizes after noise"_test = []() {
+    // Setup
+    auto link = hal::v5::make_strong_ptr<loopback_serial>(
+      std::pmr::new_delete_resource());
+    auto mux = serial_mux::create(std::pmr::new_delete_resource(), link);
+    auto channel = mux_channel::create(std::pmr::new_delete_resource(), mux, 1);
+    // Noise, a sync byte with a broken header and a frame for channel 9
+    std::array<hal::byte, 13> const garbage{
+      0x00, 0x13, 0xA5, 0x01, 0x04, 0x00, 0x00, 0xA5, 0x09, 0x02, 0x00, 0x51,
+      0x42,
+    };
+
+    // Exercise
+    link->inject(garbage);
+    link->inject(std::array<hal::byte, 1>{ 0x43 });
+    channel->write(hal::as_bytes("after"sv));
+
+    // Verify
+    expect(received(*channel) == "after"sv);
+    auto const stats = mux->get_statistics();
+    expect(that % stats.header_errors == 1);
+    expect(that % stats.unrouted_frames == 1);
+    // Two bytes of noise, the rejected header up to the next sync byte and
+    // the unrouted payload
+    expect(that % stats.discarded_bytes == 2 + 5 + 2);
+  };
+
+  "serial_mux shares the link by weight"_test = []() {
+    // Setup
+    auto link = hal::v5::make_strong_ptr<loopback_serial>(
+      std::pmr::new_delete_resource());
+    auto mux = serial_mux::create(
+      std::pmr::new_delete_resource(), link, { .max_payload = 4 });
+    auto heavy = mux_channel::create(
+      std::pmr::new_delete_resource(), mux, 1, { .weight = 3 });
+    auto light = mux_channel::create(
+      std::pmr::new_delete_resource(), mux, 2, { .weight = 1 });
+    auto const data = std::string(32, 'x');
+    link->hold_first_write();
+
+    // Exercise
+    std::thread heavy_writer([&]() { heavy->write(hal::as_bytes(data)); });
+    // Let the heavy writer block in its first frame, then queue the light one
+    std::this_thread::sleep_for(50ms);
+    std::thread light_writer([&]() { light->write(hal::as_bytes(data)); });
+    std::this_thread::sleep_for(50ms);
+    link->release();
+    heavy_writer.join();
+    light_writer.join();
+
+    // Verify
+    auto const frames = link->frame_channels();
+    expect(that % frames.size() == 16);
+    // After the first frame both channels were waiting
+    auto const window = std::span(frames).subspan(1, 8);
+    expect(that % std::ranges::count(window, hal::u8{ 2 }) == 2);
+    expect(received(*heavy) == data);
+    expect(received(*light) == data);
+  };
+
+  "mux_channel ids are exclusive while open"_test = []() {
+    // Setup
+    auto link = hal::v5::make_strong_ptr<loopback_serial>(
+      std::pmr::new_delete_resource());
+    auto mux = serial_mux::create(std::pmr::new_delete_resource(), link);
+
+    // Exercise & Verify
+    {
+      auto channel =
+        mux_channel::create(std::pmr::new_delete_resource(), mux, 3);
+      expect(throws<hal::device_or_resource_busy>([&mux] {
+        static_cast<void>(
+          mux_channel::create(std::pmr::new_delete_resource(), mux, 3));
+      }));
+    }
+    auto reopened =
+      mux_channel::create(std::pmr::new_delete_resource(), mux, 3);
+    reopened->write(hal::as_bytes("again"sv));
+    expect(received(*reopened) == "again"sv);
+
+    expect(throws<hal::argument_out_of_domain>([&link] {
+      static_cast<void>(serial_mux::create(
+        std::pmr::new_delete_resource(), link, { .max_payload = 0 }));
+    }));
+  };
+};
+}  // namespace hal::mac
@@ -0,0 +1,90 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory_resource>
+#include <thread>
+
+#include <libhal-mac/serial_ports.hpp>
+
+#include <boost/ut.hpp>
+
+#include "pseudo_terminal.hpp"
+
+namespace hal::mac {
+boost::ut::suite<"test_serial_ports"> test_serial_ports = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "enumerate_serial_ports()"_test = []() {
+    // Exercise
+    auto const ports =
+      hal::mac::enumerate_serial_ports(std::pmr::new_delete_resource());
+
+    // Verify - the ports present depend on the machine, but every entry must
+    // be a device path and the list must be sorted.
+    for (auto const& port : ports) {
+      expect(that % port.path.starts_with("/dev/"));
+    }
+    expect(std::ranges::is_sorted(
+      ports, {}, [](auto const& p_port) { return p_port.path; }));
+  };
+
+  "open_serial_ports()"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    std::array<pseudo_terminal, 3> terminals;
+    std::pmr::vector<serial_port_info> ports(resource);
+    for (auto const& terminal : terminals) {
+      ports.push_back({ .path = std::pmr::string(terminal.path) });
+    }
+    ports.push_back({ .path = std::pmr::string("/dev/does-not-exist") });
+
+    // Exercise
+    auto serials = hal::mac::open_serial_ports(resource, ports, 64);
+
+    // Verify
+    expect(that % serials.size() == ports.size());
+    expect(that % serials[0].has_value());
+    expect(that % serials[1].has_value());
+    expect(that % serials[2].has_value());
+    expect(that % not serials[3].has_value());
+  };
+
+  "serial_port_watcher reports existing ports"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    auto const expected = hal::mac::enumerate_serial_ports(resource).size();
+    std::atomic<usize> added = 0;
+
+    // Exercise
+    auto watcher = hal::mac::serial_port_watcher::create(
+      resource,
+      [&added](serial_port_watcher::event p_event, serial_port_info const&) {
+        if (p_event == serial_port_watcher::event::added) {
+          added++;
+        }
+      });
+    auto const deadline = std::chrono::steady_clock::now() + 1s;
+    while (added < expected && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(1ms);
+    }
+
+    // Verify
+    expect(that % added.load() == expected);
+  };
+};
+}  // namespace hal::mac
@@ -0,0 +1,287 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <memory_resource>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include <libhal-mac/serial.hpp>
+#include <libhal-mac/serial_server.hpp>
+#include <libhal-util/as_bytes.hpp>
+#include <libhal/error.hpp>
+
+#include <boost/ut.hpp>
+
+#include "pseudo_terminal.hpp"
+
+namespace hal::mac {
+namespace {
+/// Loopback TCP server that accepts a single connection
+struct tcp_listener
+{
+  tcp_listener()
+  {
+    fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (fd == -1 ||
+        ::bind(fd, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+        ::listen(fd, 1) != 0 ||
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) !=
+          0) {
+      throw std::runtime_error("failed to listen on loopback");
+    }
+    port = ntohs(address.sin_port);
+  }
+
+  ~tcp_listener()
+  {
+    ::close(connection);
+    ::close(fd);
+  }
+
+  /// Accept the connection and shrink its send buffer to p_buffer_size
+  void accept(int p_buffer_size)
+  {
+    connection = ::accept(fd, nullptr, nullptr);
+    ::setsockopt(connection,
+                 SOL_SOCKET,
+                 SO_SNDBUF,
+                 &p_buffer_size,
+                 sizeof(p_buffer_size));
+  }
+
+  int fd = -1;
+  int connection = -1;
+  hal::u16 port = 0;
+};
+
+template<typename Condition>
+bool wait_for(Condition&& p_condition)
+{
+  auto const deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (not p_condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+/// Received data of a port, assuming its buffer did not wrap
+std::string received(hal::v5::serial& p_serial)
+{
+  auto const data =
+    p_serial.receive_buffer().first(p_serial.receive_cursor());
+  return { data.begin(), data.end() };
+}
+}  // namespace
+
+boost::ut::suite<"test_serial_server"> test_serial_server = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "serial_server forwards data both ways, including 0xFF"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto port = serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 256);
+    auto server = serial_server::create(std::pmr::new_delete_resource(), port);
+    auto client = network_serial::create(
+      std::pmr::new_delete_resource(), "127.0.0.1", server->port());
+    expect(wait_for([&server] { return server->client_connected(); }));
+    auto const from_device = "status\xFF\xFFok\n"sv;
+    auto const from_client = "reset\xFF\n"sv;
+
+    // Exercise
+    [[maybe_unused]] auto const written =
+      ::write(terminal.controller, from_device.data(), from_device.size());
+    client->write(hal::as_bytes(from_client));
+
+    // Verify
+    expect(wait_for([&client, &from_device] {
+      return client->get_statistics().bytes_received == from_device.size();
+    }));
+    expect(received(*client) == from_device);
+    expect(terminal.read(from_client.size(), 500ms) == from_client);
+    // The server counts the bytes once its write to the port returned
+    expect(wait_for([&server, &from_client] {
+      return server->get_statistics().bytes_to_port == from_client.size();
+    }));
+    auto const stats = server->get_statistics();
+    expect(that % stats.connections == 1);
+    expect(that % stats.bytes_to_network == from_device.size());
+    expect(that % client->get_statistics().bytes_sent == from_client.size());
+  };
+
+  "network_serial changes the served port's settings"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto port = serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 256);
+    auto server = serial_server::create(std::pmr::new_delete_resource(), port);
+    auto client = network_serial::create(
+      std::pmr::new_delete_resource(), "127.0.0.1", server->port());
+    hal::v5::serial::settings const requested{
+      .baud_rate = 9600,
+      .stop = hal::v5::serial::settings::stop_bits::two,
+    };
+
+    // Exercise
+    client->configure(requested);
+    client->set_control_signals(true, false);
+
+    // Verify
+    expect(port->get_settings() == requested);
+    expect(that % server->get_statistics().control_commands == 6);
+
+    // The server answers a rate the port refuses with the rate it kept
+    expect(throws<hal::argument_out_of_domain>(
+      [&client] { client->configure({ .baud_rate = 12345 }); }));
+    expect(that % port->get_settings().baud_rate == 9600);
+  };
+
+  "serial_server serves one client at a time"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto port = serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 256);
+    auto server = serial_server::create(std::pmr::new_delete_resource(), port);
+
+    {
+      auto first = network_serial::create(
+        std::pmr::new_delete_resource(), "127.0.0.1", server->port());
+      expect(wait_for([&server] { return server->client_connected(); }));
+
+      // Exercise
+      auto second = network_serial::create(
+        std::pmr::new_delete_resource(), "127.0.0.1", server->port());
+
+      // Verify
+      expect(wait_for([&second] { return not second->connected(); }));
+      expect(that % server->get_statistics().rejected_connections == 1);
+      expect(throws<hal::io_error>(
+        [&second] { second->write(hal::as_bytes("late"sv)); }));
+      expect(first->connected());
+    }
+
+    // Exercise
+    expect(wait_for([&server] { return not server->client_connected(); }));
+    auto third = network_serial::create(
+      std::pmr::new_delete_resource(), "127.0.0.1", server->port());
+
+    // Verify
+    expect(wait_for([&server] { return server->client_connected(); }));
+    expect(that % server->get_statistics().connections == 2);
+  };
+
+  "serial_server without RFC 2217 forwards raw bytes"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto port = serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 256);
+    auto server = serial_server::create(
+      std::pmr::new_delete_resource(), port, { .rfc2217 = false });
+    auto client = network_serial::create(std::pmr::new_delete_resource(),
+                                         "127.0.0.1",
+                                         server->port(),
+                                         { .rfc2217 = false });
+    expect(wait_for([&server] { return server->client_connected(); }));
+
+    // Exercise
+    client->write(hal::as_bytes("\xFF\xFA"sv));
+
+    // Verify
+    expect(terminal.read(2, 500ms) == "\xFF\xFA"sv);
+    expect(throws<hal::operation_not_supported>(
+      [&client] { client->configure({}); }));
+  };
+
+  "network_serial keeps every byte of full socket reads"_test = []() {
+    // Setup
+    tcp_listener listener;
+    constexpr usize total = 256 * 1024;
+    auto client = network_serial::create(std::pmr::new_delete_resource(),
+                                         "127.0.0.1",
+                                         listener.port,
+                                         { .receive_buffer_size = total,
+                                           .rfc2217 = false,
+                                           .socket_buffer_size = 16 * 1024 });
+    listener.accept(16 * 1024);
+    std::string data(total, '\0');
+    for (usize i = 0; i < data.size(); i++) {
+      data[i] = static_cast<char>(i * 7 + i / 251);
+    }
+
+    // Exercise - with small socket buffers the sender keeps blocking on a
+    // full buffer, recv() returns whole chunks and the last byte fills the
+    // receive buffer
+    auto const start = std::chrono::steady_clock::now();
+    std::thread sender([&listener, &data] {
+      usize sent = 0;
+      while (sent < data.size()) {
+        auto const count = ::send(
+          listener.connection, data.data() + sent, data.size() - sent, 0);
+        if (count <= 0) {
+          return;
+        }
+        sent += static_cast<usize>(count);
+      }
+    });
+    sender.join();
+    auto const arrived =
+      wait_for([&client] { return client->receive_cursor() == total; });
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+
+    // Verify
+    expect(arrived);
+    expect(that % client->get_statistics().bytes_received == total);
+    expect(received(*client) == data);
+    expect(elapsed < 2s);
+  };
+
+  "network_serial reports a missing server"_test = []() {
+    // Setup
+    pseudo_terminal terminal;
+    auto port = serial::create(
+      std::pmr::new_delete_resource(), terminal.path, 256);
+    auto server = serial_server::create(std::pmr::new_delete_resource(), port);
+    auto const unused_port = server->port();
+
+    // Exercise
+    server = serial_server::create(std::pmr::new_delete_resource(), port);
+
+    // Verify
+    expect(throws<hal::no_such_device>([unused_port] {
+      static_cast<void>(network_serial::create(
+        std::pmr::new_delete_resource(), "127.0.0.1", unused_port));
+    }));
+    expect(throws<hal::argument_out_of_domain>([&port] {
+      static_cast<void>(serial_server::create(
+        std::pmr::new_delete_resource(), port, { .bind_address = "nowhere" }));
+    }));
+  };
+};
+}  // namespace hal::mac
@@ -0,0 +1,179 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <latch>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libhal-mac/simulated_clock.hpp>
+#include <libhal/error.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::mac {
+boost::ut::suite<"test_simulated_clock"> test_simulated_clock = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "simulated_clock only moves when advanced"_test = []() {
+    // Setup
+    auto clock = simulated_clock::create(std::pmr::new_delete_resource(),
+                                         { .auto_advance = false });
+
+    // Exercise
+    auto const start = clock->now();
+    std::this_thread::sleep_for(2ms);
+    auto const later = clock->now();
+    clock->advance(1500ms);
+
+    // Verify
+    expect(that % start.count() == 0);
+    expect(that % later.count() == 0);
+    expect(that % clock->now().count() == hal::time_duration(1500ms).count());
+    expect(that % clock->uptime() == 1'500'000'000);
+    expect(that % clock->frequency() == 1e9f);
+  };
+
+  "simulated_clock skips a sleep of the only thread"_test = []() {
+    // Setup
+    auto clock = simulated_clock::create(std::pmr::new_delete_resource());
+    auto const start = std::chrono::steady_clock::now();
+
+    // Exercise
+    clock->sleep_for(30s);
+    clock->sleep_until(45s);
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+
+    // Verify
+    expect(that % clock->now().count() == hal::time_duration(45s).count());
+    expect(elapsed < 1s);
+  };
+
+  "simulated_clock runs handlers at their deadline in order"_test = []() {
+    // Setup
+    auto clock = simulated_clock::create(std::pmr::new_delete_resource(),
+                                         { .auto_advance = false });
+    std::vector<std::pair<std::string, hal::time_duration>> runs;
+    auto const record = [&runs, &clock](std::string p_name) {
+      return [&runs, &clock, p_name]() {
+        runs.emplace_back(p_name, clock->now());
+      };
+    };
+    clock->schedule(20ms, record("second"));
+    clock->schedule(10ms, record("first"));
+    auto const dropped = clock->schedule(15ms, record("dropped"));
+    clock->schedule(20ms, [&clock, &record]() {
+      clock->schedule(25ms, record("nested"));
+    });
+    clock->schedule(50ms, record("late"));
+
+    // Exercise
+    auto const cancelled = clock->cancel(dropped);
+    clock->advance(30ms);
+
+    // Verify
+    expect(cancelled);
+    expect(not clock->cancel(dropped));
+    expect(that % runs.size() == 3);
+    expect(runs[0] ==
+           std::pair(std::string("first"), hal::time_duration(10ms)));
+    expect(runs[1] ==
+           std::pair(std::string("second"), hal::time_duration(20ms)));
+    expect(runs[2] ==
+           std::pair(std::string("nested"), hal::time_duration(25ms)));
+    expect(that % clock->now().count() == hal::time_duration(30ms).count());
+  };
+
+  "simulated_clock::advance() lets attached threads run at each step"_test =
+    []() {
+      // Setup
+      auto clock = simulated_clock::create(std::pmr::new_delete_resource(),
+                                           { .auto_advance = false });
+      std::vector<hal::time_duration> wakeups;
+      std::latch attached(2);
+      std::thread worker([&]() {
+        clock->attach();
+        attached.arrive_and_wait();
+        for (int i = 0; i < 5; i++) {
+          clock->sleep_for(10ms);
+          wakeups.push_back(clock->now());
+        }
+        clock->detach();
+      });
+      attached.arrive_and_wait();
+
+      // Exercise
+      clock->advance(100ms);
+      worker.join();
+
+      // Verify
+      std::vector<hal::time_duration> const expected{
+        10ms, 20ms, 30ms, 40ms, 50ms
+      };
+      expect(wakeups == expected);
+      expect(that % clock->now().count() == hal::time_duration(100ms).count());
+    };
+
+  "simulated_clock interleaves attached threads the same way every run"_test =
+    []() {
+      auto const simulate = []() {
+        auto clock = simulated_clock::create(std::pmr::new_delete_resource());
+        std::mutex mutex;
+        std::string events;
+        std::latch attached(2);
+        auto const periodic = [&](char p_name, hal::time_duration p_period) {
+          return std::thread([&, p_name, p_period]() {
+            clock->attach();
+            attached.arrive_and_wait();
+            while (clock->now() + p_period <= 30ms) {
+              clock->sleep_for(p_period);
+              std::lock_guard lock(mutex);
+              events += p_name;
+              events += std::to_string(clock->now() / 1ms);
+              events += ' ';
+            }
+            clock->detach();
+          });
+        };
+
+        auto a = periodic('a', 7ms);
+        auto b = periodic('b', 10ms);
+        a.join();
+        b.join();
+        return events;
+      };
+
+      // Exercise
+      auto const first = simulate();
+      auto const second = simulate();
+
+      // Verify
+      expect(that % first == std::string("a7 b10 a14 b20 a21 a28 b30 "));
+      expect(that % second == first);
+    };
+
+  "simulated_clock::attach() and detach() are paired"_test = []() {
+    auto clock = simulated_clock::create(std::pmr::new_delete_resource());
+
+    expect(throws<hal::argument_out_of_domain>([&] { clock->detach(); }));
+    clock->attach();
+    expect(throws<hal::argument_out_of_domain>([&] { clock->attach(); }));
+    clock->detach();
+  };
+};
+}  // namespace hal::mac
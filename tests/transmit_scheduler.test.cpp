@@ -0,0 +1,102 @@
+// Copyright 2024 - 2025 Khalil Estell and the libhal contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <libhal-mac/serial.hpp>
+#include <libhal-mac/transmit_scheduler.hpp>
+#include <libhal-util/as_bytes.hpp>
+
+#include <boost/ut.hpp>
+
+#include "pseudo_terminal.hpp"
+
+namespace hal::mac {
+boost::ut::suite<"test_transmit_scheduler"> test_transmit_scheduler = [] {
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "transmit_scheduler urgent message overtakes bulk data"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    pseudo_terminal terminal;
+    auto serial = serial::create(resource, terminal.path, 64);
+    auto scheduler = transmit_scheduler::create(
+      resource, serial, { .max_queued_bulk_bytes = 1024 * 1024 });
+    constexpr usize bulk_size = 200'000;
+    std::vector<hal::byte> const bulk(bulk_size, hal::byte{ 'b' });
+    constexpr auto urgent = "URGENT"sv;
+
+    // Exercise - the bulk data fills the pty until the test starts reading
+    scheduler->send(transmit_lane::bulk, bulk);
+    std::this_thread::sleep_for(50ms);
+    scheduler->send(transmit_lane::urgent, hal::as_bytes(urgent));
+    auto const received = terminal.read(bulk_size + urgent.size(), 500ms);
+    scheduler->flush();
+
+    // Verify
+    expect(that % received.size() == bulk_size + urgent.size());
+    auto const position = received.find(urgent);
+    expect(that % position != std::string::npos);
+    expect(that % position < bulk_size / 2);
+
+    auto const urgent_stats = scheduler->get_statistics(transmit_lane::urgent);
+    auto const bulk_stats = scheduler->get_statistics(transmit_lane::bulk);
+    expect(that % urgent_stats.messages == 1);
+    expect(that % urgent_stats.bytes == urgent.size());
+    expect(that % bulk_stats.messages == 1);
+    expect(that % bulk_stats.bytes == bulk_size);
+    expect(that % urgent_stats.latency_max_ns < bulk_stats.latency_max_ns);
+  };
+
+  "transmit_scheduler keeps bulk messages whole when not splitting"_test =
+    []() {
+      // Setup
+      auto* resource = std::pmr::new_delete_resource();
+      pseudo_terminal terminal;
+      auto serial = serial::create(resource, terminal.path, 64);
+      auto scheduler = transmit_scheduler::create(
+        resource, serial, { .split_bulk_messages = false });
+      std::vector<hal::byte> const bulk(20'000, hal::byte{ 'b' });
+
+      // Exercise
+      scheduler->send(transmit_lane::bulk, bulk);
+      std::this_thread::sleep_for(20ms);
+      scheduler->send(transmit_lane::urgent, hal::as_bytes("!"sv));
+      auto const received = terminal.read(bulk.size() + 1, 500ms);
+      scheduler->flush();
+
+      // Verify
+      expect(that % received == std::string(20'000, 'b') + "!");
+    };
+
+  "transmit_scheduler::create() rejects a zero line hold"_test = []() {
+    // Setup
+    auto* resource = std::pmr::new_delete_resource();
+    pseudo_terminal terminal;
+    auto serial = serial::create(resource, terminal.path, 64);
+
+    // Exercise & Verify
+    expect(throws<hal::argument_out_of_domain>([&]() {
+      auto scheduler = transmit_scheduler::create(
+        resource, serial, { .max_line_hold = hal::time_duration(0) });
+    }));
+  };
+};
+}  // namespace hal::mac